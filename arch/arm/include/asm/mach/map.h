@@ -30,6 +30,7 @@ struct map_desc {
 #define MT_MEMORY_DTCM		12
 #define MT_MEMORY_ITCM		13
 #define MT_MEMORY_SO		14
+#define MT_MEMORY_DMA_READY	15
 
 #ifdef CONFIG_MMU
 extern void iotable_init(struct map_desc *, int);
@@ -41,6 +42,18 @@ extern const struct mem_type *get_mem_type(unsigned int type);
  */
 extern int ioremap_page(unsigned long virt, unsigned long phys,
 			const struct mem_type *mtype);
+
+struct page;
+#ifdef CONFIG_CMA
+extern int arm_cma_set_cacheable(struct page *page, unsigned long count,
+				 bool cacheable);
+#else
+static inline int arm_cma_set_cacheable(struct page *page,
+					unsigned long count, bool cacheable)
+{
+	return 0;
+}
+#endif
 #else
 #define iotable_init(map,num)	do { } while (0)
 #endif
@@ -525,6 +525,33 @@ static inline unsigned long long __cmpxchg64_mb(volatile void *ptr,
 					 (unsigned long long)(o),	\
 					 (unsigned long long)(n)))
 
+/*
+ * cmpxchg_double() compares and exchanges two adjacent words with one
+ * ldrexd/strexd pair.  The first word must be 8 byte aligned.  SLUB uses
+ * it to update a slab's freelist and object counters together.
+ *
+ * The words are packed into a u64 through memory, so that they end up in
+ * the register pair in the order ldrexd loads them with either endianness.
+ */
+static inline int __cmpxchg_double_mb(volatile unsigned long *ptr,
+				      unsigned long old1, unsigned long old2,
+				      unsigned long new1, unsigned long new2)
+{
+	union {
+		unsigned long w[2];
+		unsigned long long dw;
+	} old = { .w = { old1, old2 } }, new = { .w = { new1, new2 } };
+
+	return __cmpxchg64_mb(ptr, old.dw, new.dw) == old.dw;
+}
+
+#define cmpxchg_double(ptr, o1, o2, n1, n2)				\
+	__cmpxchg_double_mb((volatile unsigned long *)(ptr),		\
+			    (unsigned long)(o1), (unsigned long)(o2),	\
+			    (unsigned long)(n1), (unsigned long)(n2))
+
+#define system_has_cmpxchg_double()	1
+
 #else /* min ARCH = ARMv6 */
 
 #define cmpxchg64_local(ptr, o, n) __cmpxchg64_local_generic((ptr), (o), (n))
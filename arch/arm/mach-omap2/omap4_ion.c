@@ -10,8 +10,10 @@
  * published by the Free Software Foundation.
  */
 
+#include <linux/cma.h>
 #include <linux/ion.h>
 #include <linux/memblock.h>
+#include <linux/mmzone.h>
 #include <linux/omap_ion.h>
 #include <linux/platform_device.h>
 
@@ -58,21 +60,57 @@ void __init omap4_register_ion(void)
 	platform_device_register(&omap4_ion_device);
 }
 
+static void __init omap4_ion_remove(ion_phys_addr_t base, size_t size)
+{
+	if (size && memblock_remove(base, size))
+		pr_err("memblock remove of %x@%lx failed\n", size, base);
+}
+
+#ifdef CONFIG_CMA
+/*
+ * The secure input carveout is empty unless protected content is played.
+ * Its pageblock aligned part becomes a contiguous memory area that holds
+ * movable pages until the heap allocates from it; only the unaligned ends
+ * are still removed from memory.  The range itself does not move, the IPU
+ * maps it statically.
+ */
+static bool __init omap4_ion_reserve_cma(struct ion_platform_heap *heap)
+{
+	phys_addr_t align = PAGE_SIZE << max(MAX_ORDER - 1, pageblock_order);
+	phys_addr_t start = ALIGN(heap->base, align);
+	phys_addr_t end = (heap->base + heap->size) & ~(align - 1);
+	struct cma *cma;
+
+	if (end <= start ||
+	    cma_declare_contiguous(end - start, start, 0, heap->name, &cma))
+		return false;
+
+	heap->priv = cma;
+	omap4_ion_remove(heap->base, start - heap->base);
+	omap4_ion_remove(end, heap->base + heap->size - end);
+	return true;
+}
+#else
+static inline bool omap4_ion_reserve_cma(struct ion_platform_heap *heap)
+{
+	return false;
+}
+#endif
+
 void __init omap_ion_init(void)
 {
 	int i;
-	int ret;
 
 	memblock_remove(OMAP4_RAMCONSOLE_START, OMAP4_RAMCONSOLE_SIZE);
 
-	for (i = 0; i < omap4_ion_data.nr; i++)
-		if (omap4_ion_data.heaps[i].type == ION_HEAP_TYPE_CARVEOUT ||
-		    omap4_ion_data.heaps[i].type == OMAP_ION_HEAP_TYPE_TILER) {
-			ret = memblock_remove(omap4_ion_data.heaps[i].base,
-					      omap4_ion_data.heaps[i].size);
-			if (ret)
-				pr_err("memblock remove of %x@%lx failed\n",
-				       omap4_ion_data.heaps[i].size,
-				       omap4_ion_data.heaps[i].base);
-		}
+	for (i = 0; i < omap4_ion_data.nr; i++) {
+		struct ion_platform_heap *heap = &omap4_ion_data.heaps[i];
+
+		if (heap->id == OMAP_ION_HEAP_SECURE_INPUT &&
+		    omap4_ion_reserve_cma(heap))
+			continue;
+		if (heap->type == ION_HEAP_TYPE_CARVEOUT ||
+		    heap->type == OMAP_ION_HEAP_TYPE_TILER)
+			omap4_ion_remove(heap->base, heap->size);
+	}
 }
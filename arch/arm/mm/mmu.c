@@ -15,6 +15,7 @@
 #include <linux/nodemask.h>
 #include <linux/memblock.h>
 #include <linux/fs.h>
+#include <linux/cma.h>
 
 #include <asm/cputype.h>
 #include <asm/sections.h>
@@ -281,6 +282,11 @@ static struct mem_type mem_types[] = {
 				PMD_SECT_UNCACHED | PMD_SECT_XN,
 		.domain    = DOMAIN_KERNEL,
 	},
+	[MT_MEMORY_DMA_READY] = {
+		.prot_pte  = L_PTE_PRESENT | L_PTE_YOUNG | L_PTE_DIRTY,
+		.prot_l1   = PMD_TYPE_TABLE,
+		.domain    = DOMAIN_KERNEL,
+	},
 };
 
 const struct mem_type *get_mem_type(unsigned int type)
@@ -490,6 +496,7 @@ static void __init build_mem_type_table(void)
 	mem_types[MT_HIGH_VECTORS].prot_l1 |= ecc_mask;
 	mem_types[MT_MEMORY].prot_sect |= ecc_mask | cp->pmd;
 	mem_types[MT_MEMORY].prot_pte |= kern_pgprot;
+	mem_types[MT_MEMORY_DMA_READY].prot_pte |= kern_pgprot;
 	mem_types[MT_MEMORY_NONCACHED].prot_sect |= ecc_mask;
 	mem_types[MT_ROM].prot_sect |= cp->pmd;
 
@@ -569,7 +576,7 @@ static void __init alloc_init_section(pud_t *pud, unsigned long addr,
 	 * L1 entries, whereas PGDs refer to a group of L1 entries making
 	 * up one logical pointer to an L2 table.
 	 */
-	if (((addr | end | phys) & ~SECTION_MASK) == 0) {
+	if (type->prot_sect && ((addr | end | phys) & ~SECTION_MASK) == 0) {
 		pmd_t *p = pmd;
 
 		if (addr & SECTION_SIZE)
@@ -1032,6 +1039,119 @@ static void __init map_lowmem(void)
 	}
 }
 
+#ifdef CONFIG_CMA
+/*
+ * The contiguous memory areas in lowmem are mapped with pages instead of
+ * sections, so that the linear mapping of the pages a driver allocates
+ * from them can be made uncached.  ARMv7 does not allow memory to be
+ * mapped cacheable and uncached at the same time.
+ */
+struct cma_remap {
+	unsigned long	start_pfn;
+	unsigned long	end_pfn;
+};
+
+static struct cma_remap cma_mmu_remap[MAX_CMA_AREAS];
+static int cma_mmu_remap_num;
+
+void __init cma_early_fixup(phys_addr_t base, phys_addr_t size)
+{
+	struct cma_remap *remap;
+
+	if (cma_mmu_remap_num == ARRAY_SIZE(cma_mmu_remap))
+		return;
+	remap = &cma_mmu_remap[cma_mmu_remap_num++];
+	remap->start_pfn = __phys_to_pfn(base);
+	remap->end_pfn = __phys_to_pfn(base + size);
+}
+
+static void __init cma_remap_lowmem(void)
+{
+	int i;
+
+	for (i = 0; i < cma_mmu_remap_num; i++) {
+		struct cma_remap *remap = &cma_mmu_remap[i];
+		phys_addr_t start = __pfn_to_phys(remap->start_pfn);
+		phys_addr_t end = __pfn_to_phys(remap->end_pfn);
+		struct map_desc map;
+		unsigned long addr;
+
+		if (end > lowmem_limit)
+			end = lowmem_limit;
+		if (start >= end) {
+			remap->end_pfn = remap->start_pfn;
+			continue;
+		}
+		remap->end_pfn = __phys_to_pfn(end);
+
+		map.pfn = __phys_to_pfn(start);
+		map.virtual = __phys_to_virt(start);
+		map.length = end - start;
+		map.type = MT_MEMORY_DMA_READY;
+
+		/* Clear the section mappings made by map_lowmem() */
+		for (addr = map.virtual; addr < map.virtual + map.length;
+		     addr += PMD_SIZE)
+			pmd_clear(pmd_off_k(addr));
+
+		create_mapping(&map);
+	}
+}
+
+static int arm_cma_update_pte(pte_t *pte, pgtable_t token,
+			      unsigned long addr, void *data)
+{
+	pgprot_t prot = *(pgprot_t *)data;
+
+	set_pte_ext(pte, mk_pte(virt_to_page(addr), prot), 0);
+	return 0;
+}
+
+/**
+ * arm_cma_set_cacheable() - change the linear mapping of CMA pages
+ * @page:	first page from cma_alloc()
+ * @count:	number of pages
+ * @cacheable:	false to map them write-combined, true to restore them
+ *
+ * The caller flushes the pages from the caches before it makes them
+ * uncached.  Returns 0, also for highmem pages, which have no linear
+ * mapping, or -EINVAL if the pages are mapped with sections.
+ */
+int arm_cma_set_cacheable(struct page *page, unsigned long count,
+			  bool cacheable)
+{
+	pgprot_t prot = __pgprot(mem_types[MT_MEMORY_DMA_READY].prot_pte);
+	unsigned long pfn = page_to_pfn(page);
+	unsigned long start, size;
+	int i;
+
+	if (PageHighMem(page) && PageHighMem(pfn_to_page(pfn + count - 1)))
+		return 0;
+
+	for (i = 0; i < cma_mmu_remap_num; i++)
+		if (pfn >= cma_mmu_remap[i].start_pfn &&
+		    pfn + count <= cma_mmu_remap[i].end_pfn)
+			break;
+	if (i == cma_mmu_remap_num)
+		return -EINVAL;
+
+	if (!cacheable)
+		prot = pgprot_writecombine(prot);
+
+	start = (unsigned long)page_address(page);
+	size = count << PAGE_SHIFT;
+	apply_to_page_range(&init_mm, start, size, arm_cma_update_pte, &prot);
+	dsb();
+	flush_tlb_kernel_range(start, start + size);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(arm_cma_set_cacheable);
+#else
+static inline void cma_remap_lowmem(void)
+{
+}
+#endif /* CONFIG_CMA */
+
 /*
  * paging_init() sets up the page tables, initialises the zone memory
  * maps, and sets up the zero page, bad page and bad page tables.
@@ -1045,6 +1165,7 @@ void __init paging_init(struct machine_desc *mdesc)
 	build_mem_type_table();
 	prepare_page_table();
 	map_lowmem();
+	cma_remap_lowmem();
 	devicemaps_init(mdesc);
 	kmap_init();
 
@@ -39,6 +39,8 @@ EXPORT_TRACEPOINT_SYMBOL_GPL(block_rq_remap);
 EXPORT_TRACEPOINT_SYMBOL_GPL(block_bio_complete);
 
 static int __make_request(struct request_queue *q, struct bio *bio);
+static bool blk_stage_merge(struct request_queue *q, struct bio *bio);
+static void blk_stage_add(struct request_queue *q, struct request *req);
 
 /*
  * For the allocated request tables
@@ -284,8 +286,13 @@ EXPORT_SYMBOL(blk_stop_queue);
  */
 void blk_sync_queue(struct request_queue *q)
 {
+	int cpu;
+
 	del_timer_sync(&q->timeout);
 	cancel_delayed_work_sync(&q->delay_work);
+	if (q->stage)
+		for_each_possible_cpu(cpu)
+			cancel_work_sync(&per_cpu_ptr(q->stage, cpu)->work);
 }
 EXPORT_SYMBOL(blk_sync_queue);
 
@@ -361,6 +368,8 @@ void blk_cleanup_queue(struct request_queue *q)
 	 * are done before moving on. Going into this function, we should
 	 * not have processes doing IO to this device.
 	 */
+	if (q->stage)
+		blk_stage_flush_all(q);
 	blk_sync_queue(q);
 
 	del_timer_sync(&q->backing_dev_info.laptop_mode_wb_timer);
@@ -545,6 +554,8 @@ blk_init_allocated_queue_node(struct request_queue *q, request_fn_proc *rfn,
 
 	q->sg_reserved_size = INT_MAX;
 
+	blk_wbt_init(q);
+
 	/*
 	 * all done
 	 */
@@ -1058,6 +1069,7 @@ void __blk_put_request(struct request_queue *q, struct request *req)
 		BUG_ON(!list_empty(&req->queuelist));
 		BUG_ON(!hlist_unhashed(&req->hash));
 
+		blk_wbt_free(q, req);
 		blk_free_request(q, req);
 		freed_request(q, is_sync, priv);
 	}
@@ -1210,6 +1222,7 @@ void init_request_from_bio(struct request *req, struct bio *bio)
 	req->__sector = bio->bi_sector;
 	req->ioprio = bio_prio(bio);
 	blk_rq_bio_prep(req->q, req, bio);
+	blk_lat_hist_start(req);
 }
 
 static int __make_request(struct request_queue *q, struct bio *bio)
@@ -1218,6 +1231,7 @@ static int __make_request(struct request_queue *q, struct bio *bio)
 	struct blk_plug *plug;
 	int el_ret, rw_flags, where = ELEVATOR_INSERT_SORT;
 	struct request *req;
+	bool wb_acct;
 
 	/*
 	 * low level driver can indicate that it wants pages above a
@@ -1239,6 +1253,9 @@ static int __make_request(struct request_queue *q, struct bio *bio)
 	if (attempt_plug_merge(current, q, bio))
 		goto out;
 
+	if (blk_queue_staged(q) && blk_stage_merge(q, bio))
+		goto out;
+
 	spin_lock_irq(q->queue_lock);
 
 	el_ret = elv_merge(q, &req, bio);
@@ -1266,6 +1283,12 @@ get_rq:
 	if (sync)
 		rw_flags |= REQ_SYNC;
 
+	/*
+	 * Background writeback may first have to wait for writes in flight
+	 * to drop below the throttling limit. This can drop the queue lock.
+	 */
+	wb_acct = blk_wbt_wait(q, bio);
+
 	/*
 	 * Grab a free request. This is might sleep but can not fail.
 	 * Returns with the queue unlocked.
@@ -1279,6 +1302,8 @@ get_rq:
 	 * often, and the elevators are able to handle it.
 	 */
 	init_request_from_bio(req, bio);
+	if (wb_acct)
+		req->cmd_flags |= REQ_WB_TRACKED;
 
 	if (test_bit(QUEUE_FLAG_SAME_COMP, &q->queue_flags) ||
 	    bio_flagged(bio, BIO_CPU_AFFINE)) {
@@ -1286,6 +1311,11 @@ get_rq:
 		put_cpu();
 	}
 
+	if (blk_queue_staged(q) && where == ELEVATOR_INSERT_SORT) {
+		blk_stage_add(q, req);
+		goto out;
+	}
+
 	plug = current->plug;
 	if (plug) {
 		/*
@@ -1954,6 +1984,8 @@ void blk_start_request(struct request *req)
 		req->next_rq->resid_len = blk_rq_bytes(req->next_rq);
 
 	blk_add_timer(req);
+	blk_lat_hist_issue(req);
+	blk_wbt_issue(req);
 }
 EXPORT_SYMBOL(blk_start_request);
 
@@ -2214,6 +2246,8 @@ static void blk_finish_request(struct request *req, int error)
 
 
 	blk_account_io_done(req);
+	blk_lat_hist_done(req);
+	blk_wbt_done(req);
 
 	if (req->end_io)
 		req->end_io(req, error);
@@ -2628,6 +2662,7 @@ void blk_start_plug(struct blk_plug *plug)
 	INIT_LIST_HEAD(&plug->list);
 	INIT_LIST_HEAD(&plug->cb_list);
 	plug->should_sort = 0;
+	plug->stage_q = NULL;
 
 	/*
 	 * If this is a nested plug, don't actually assign it. It will be
@@ -2696,6 +2731,189 @@ static void flush_plug_callbacks(struct blk_plug *plug)
 	}
 }
 
+/*
+ * Per-cpu request staging.
+ *
+ * On a queue with stage_batch set, the requests of __make_request() are
+ * not added to the queue one at a time.  They are staged on a list of the
+ * cpu they were allocated on, under a lock of that cpu rather than the
+ * queue_lock, and new bios are merged into them there.  A cpu's list is
+ * moved to the elevator, and the driver run, under a single queue_lock
+ * hold:
+ *
+ *  - once it holds stage_batch requests
+ *  - when the plug of a task that staged to it is flushed
+ *  - at once for a sync request from a task without a plug
+ *  - from kblockd for an async request from a task without a plug
+ *
+ * The requests themselves are still allocated by the submitter, as the
+ * request list accounting and the elevator need its context.
+ */
+static void blk_stage_flush(struct request_queue *q, int cpu,
+			    bool from_schedule)
+{
+	struct blk_stage *st = per_cpu_ptr(q->stage, cpu);
+	struct request *rq;
+	unsigned long flags;
+	unsigned int depth = 0;
+	LIST_HEAD(list);
+
+	local_irq_save(flags);
+	spin_lock(&st->lock);
+	list_splice_init(&st->list, &list);
+	st->nr = 0;
+	spin_unlock(&st->lock);
+
+	if (list_empty(&list)) {
+		local_irq_restore(flags);
+		return;
+	}
+
+	spin_lock(q->queue_lock);
+	while (!list_empty(&list)) {
+		rq = list_entry_rq(list.next);
+		list_del_init(&rq->queuelist);
+		/*
+		 * rq is already accounted, so use raw insert
+		 */
+		__elv_add_request(q, rq, ELEVATOR_INSERT_SORT_MERGE);
+		depth++;
+	}
+
+	/*
+	 * This drops the queue lock
+	 */
+	queue_unplugged(q, depth, from_schedule);
+	local_irq_restore(flags);
+}
+
+void blk_stage_flush_all(struct request_queue *q)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		blk_stage_flush(q, cpu, false);
+}
+
+static void blk_stage_work(struct work_struct *work)
+{
+	struct blk_stage *st = container_of(work, struct blk_stage, work);
+
+	blk_stage_flush(st->q, st->cpu, false);
+}
+
+/*
+ * Attempts to merge with the requests staged on this cpu, as
+ * attempt_plug_merge() does with the plugged list.
+ */
+static bool blk_stage_merge(struct request_queue *q, struct bio *bio)
+{
+	struct blk_stage *st;
+	struct request *rq;
+	bool ret = false;
+
+	st = per_cpu_ptr(q->stage, get_cpu());
+	spin_lock_irq(&st->lock);
+	list_for_each_entry_reverse(rq, &st->list, queuelist) {
+		int el_ret = elv_try_merge(rq, bio);
+
+		if (el_ret == ELEVATOR_BACK_MERGE) {
+			ret = bio_attempt_back_merge(q, rq, bio);
+			if (ret)
+				break;
+		} else if (el_ret == ELEVATOR_FRONT_MERGE) {
+			ret = bio_attempt_front_merge(q, rq, bio);
+			if (ret)
+				break;
+		}
+	}
+	spin_unlock_irq(&st->lock);
+	put_cpu();
+
+	return ret;
+}
+
+static void blk_stage_add(struct request_queue *q, struct request *req)
+{
+	struct blk_plug *plug = current->plug;
+	struct blk_stage *st;
+	bool flush;
+	int cpu;
+
+	/* Accounted first, another cpu may flush it as soon as it is staged */
+	drive_stat_acct(req, 1);
+
+	cpu = get_cpu();
+	st = per_cpu_ptr(q->stage, cpu);
+	spin_lock_irq(&st->lock);
+	list_add_tail(&req->queuelist, &st->list);
+	flush = ++st->nr >= ACCESS_ONCE(q->stage_batch) ||
+		(!plug && rw_is_sync(req->cmd_flags));
+	spin_unlock_irq(&st->lock);
+	if (!flush && !plug)
+		queue_work_on(cpu, kblockd_workqueue, &st->work);
+	put_cpu();
+
+	if (flush) {
+		blk_stage_flush(q, cpu, false);
+	} else if (plug) {
+		/* A plug flushes one list, the last one it staged to */
+		if (plug->stage_q &&
+		    (plug->stage_q != q || plug->stage_cpu != cpu))
+			blk_stage_flush(plug->stage_q, plug->stage_cpu, false);
+		plug->stage_q = q;
+		plug->stage_cpu = cpu;
+	}
+}
+
+/**
+ * blk_queue_stage - stage requests per cpu before adding them to the queue
+ * @q:		the request queue for the device
+ * @batch:	most requests staged on a cpu, 0 to add them one at a time
+ *
+ * Description:
+ *    Lets __make_request() stage the requests of a request based queue on
+ *    the cpu they were submitted on, and add them to the queue in batches,
+ *    to cut the time spent on the queue_lock by fast devices that are fed
+ *    from several cpus.  Can be changed at any time, also through the
+ *    stage_batch attribute of the queue.
+ */
+int blk_queue_stage(struct request_queue *q, unsigned int batch)
+{
+	struct blk_stage __percpu *stage;
+	int cpu;
+
+	if (!q->request_fn)
+		return -EINVAL;
+
+	if (batch && !q->stage) {
+		stage = alloc_percpu(struct blk_stage);
+		if (!stage)
+			return -ENOMEM;
+
+		for_each_possible_cpu(cpu) {
+			struct blk_stage *st = per_cpu_ptr(stage, cpu);
+
+			spin_lock_init(&st->lock);
+			INIT_LIST_HEAD(&st->list);
+			st->cpu = cpu;
+			st->q = q;
+			INIT_WORK(&st->work, blk_stage_work);
+		}
+		if (cmpxchg(&q->stage, NULL, stage))
+			free_percpu(stage);
+	}
+
+	/* q->stage is set up before staging is seen to be on */
+	smp_wmb();
+	q->stage_batch = min_t(unsigned int, batch, q->nr_requests);
+	if (!batch && q->stage)
+		blk_stage_flush_all(q);
+
+	return 0;
+}
+EXPORT_SYMBOL(blk_queue_stage);
+
 void blk_flush_plug_list(struct blk_plug *plug, bool from_schedule)
 {
 	struct request_queue *q;
@@ -2707,6 +2925,10 @@ void blk_flush_plug_list(struct blk_plug *plug, bool from_schedule)
 	BUG_ON(plug->magic != PLUG_MAGIC);
 
 	flush_plug_callbacks(plug);
+	if (plug->stage_q) {
+		blk_stage_flush(plug->stage_q, plug->stage_cpu, from_schedule);
+		plug->stage_q = NULL;
+	}
 	if (list_empty(&plug->list))
 		return;
 
@@ -0,0 +1,181 @@
+/*
+ * Block layer latency histograms
+ *
+ * Each request is timed from when it is made from its first bio to when
+ * the driver starts it (queue time) and from then to its completion
+ * (service time).  The times go into log2 histograms in microseconds,
+ * kept per cpu, per direction and per io priority class of the task that
+ * submitted the request.  They are read from, and switched on and off
+ * through, the latency_hist attribute of the queue.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/blkdev.h>
+#include <linux/ioprio.h>
+#include <linux/iocontext.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/log2.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+
+#include "blk.h"
+
+/* <1us, <2us, <4us ... <4s, >=4s */
+#define BLK_LAT_BUCKETS		24
+
+enum {
+	BLK_LAT_QUEUE,
+	BLK_LAT_SERVICE,
+	BLK_LAT_STAGES,
+};
+
+#define BLK_LAT_CLASSES		4	/* IOPRIO_CLASS_NONE to IDLE */
+
+struct blk_lat_hist {
+	unsigned long count[2][BLK_LAT_CLASSES][BLK_LAT_STAGES]
+			   [BLK_LAT_BUCKETS];
+};
+
+static const char * const blk_lat_class_names[] = {
+	"none", "rt", "be", "idle"
+};
+
+static const char * const blk_lat_stage_names[] = { "queue", "service" };
+
+void __blk_lat_hist_start(struct request *rq)
+{
+	struct io_context *ioc = current->io_context;
+	int class;
+
+	if (ioprio_valid(rq->ioprio))
+		class = IOPRIO_PRIO_CLASS(rq->ioprio);
+	else if (ioc && ioprio_valid(ioc->ioprio))
+		class = IOPRIO_PRIO_CLASS(ioc->ioprio);
+	else
+		class = task_nice_ioclass(current);
+
+	rq->lat_class = class < BLK_LAT_CLASSES ? class : IOPRIO_CLASS_BE;
+	rq->lat_issue_ns = 0;
+	rq->lat_start_ns = ktime_to_ns(ktime_get());
+}
+
+void __blk_lat_hist_issue(struct request *rq)
+{
+	rq->lat_issue_ns = ktime_to_ns(ktime_get());
+}
+
+static inline unsigned int blk_lat_bucket(u64 ns)
+{
+	u64 us = div_u64(ns, NSEC_PER_USEC);
+
+	if (!us)
+		return 0;
+	return min_t(unsigned int, ilog2(us) + 1, BLK_LAT_BUCKETS - 1);
+}
+
+void __blk_lat_hist_done(struct request *rq)
+{
+	struct request_queue *q = rq->q;
+	int dir = rq_data_dir(rq);
+	unsigned int class = rq->lat_class;
+	u64 now;
+
+	/* not started, or histograms switched on since */
+	if (!rq->lat_issue_ns || !q->lat_hist_on)
+		return;
+
+	now = ktime_to_ns(ktime_get());
+	this_cpu_inc(q->lat_hist->count[dir][class][BLK_LAT_QUEUE]
+		     [blk_lat_bucket(rq->lat_issue_ns - rq->lat_start_ns)]);
+	this_cpu_inc(q->lat_hist->count[dir][class][BLK_LAT_SERVICE]
+		     [blk_lat_bucket(now - rq->lat_issue_ns)]);
+}
+
+/*
+ * One line per direction, class and stage that has seen requests, with
+ * the count of each bucket.
+ */
+ssize_t blk_lat_hist_show(struct request_queue *q, char *page)
+{
+	unsigned long sum[BLK_LAT_BUCKETS], total;
+	int dir, class, stage, cpu, i;
+	ssize_t len = 0;
+
+	if (!q->lat_hist_on)
+		return sprintf(page, "off\n");
+
+	for (dir = READ; dir <= WRITE; dir++) {
+		for (class = 0; class < BLK_LAT_CLASSES; class++) {
+			for (stage = 0; stage < BLK_LAT_STAGES; stage++) {
+				total = 0;
+				for (i = 0; i < BLK_LAT_BUCKETS; i++) {
+					sum[i] = 0;
+					for_each_possible_cpu(cpu)
+						sum[i] += per_cpu_ptr(q->lat_hist,
+							cpu)->count[dir][class]
+							[stage][i];
+					total += sum[i];
+				}
+				if (!total)
+					continue;
+
+				len += scnprintf(page + len, PAGE_SIZE - len,
+						 "%s %s %s",
+						 dir == READ ? "read" : "write",
+						 blk_lat_class_names[class],
+						 blk_lat_stage_names[stage]);
+				for (i = 0; i < BLK_LAT_BUCKETS; i++)
+					len += scnprintf(page + len,
+							 PAGE_SIZE - len,
+							 " %lu", sum[i]);
+				len += scnprintf(page + len, PAGE_SIZE - len,
+						 "\n");
+			}
+		}
+	}
+
+	return len;
+}
+
+/*
+ * 0 switches the histograms off, anything else switches them on and
+ * clears them.
+ */
+ssize_t blk_lat_hist_store(struct request_queue *q, const char *page,
+			   size_t count)
+{
+	struct blk_lat_hist __percpu *hist;
+	unsigned long val;
+	int cpu;
+
+	if (strict_strtoul(page, 10, &val))
+		return -EINVAL;
+
+	if (!val) {
+		q->lat_hist_on = false;
+		return count;
+	}
+
+	if (!q->lat_hist) {
+		hist = alloc_percpu(struct blk_lat_hist);
+		if (!hist)
+			return -ENOMEM;
+		q->lat_hist = hist;
+	}
+
+	/* updates racing with this are lost, or kept, either is fine */
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(q->lat_hist, cpu), 0,
+		       sizeof(struct blk_lat_hist));
+
+	/* the histograms are set up before they are seen to be on */
+	smp_wmb();
+	q->lat_hist_on = true;
+	return count;
+}
+
+void blk_lat_hist_exit(struct request_queue *q)
+{
+	free_percpu(q->lat_hist);
+}
@@ -266,6 +266,22 @@ queue_rq_affinity_store(struct request_queue *q, const char *page, size_t count)
 	return ret;
 }
 
+static ssize_t queue_stage_batch_show(struct request_queue *q, char *page)
+{
+	return queue_var_show(q->stage_batch, page);
+}
+
+static ssize_t
+queue_stage_batch_store(struct request_queue *q, const char *page, size_t count)
+{
+	unsigned long batch;
+	ssize_t ret = queue_var_store(&batch, page, count);
+	int err;
+
+	err = blk_queue_stage(q, batch);
+	return err ? err : ret;
+}
+
 static struct queue_sysfs_entry queue_requests_entry = {
 	.attr = {.name = "nr_requests", .mode = S_IRUGO | S_IWUSR },
 	.show = queue_requests_show,
@@ -380,6 +396,33 @@ static struct queue_sysfs_entry queue_random_entry = {
 	.store = queue_store_random,
 };
 
+static struct queue_sysfs_entry queue_stage_batch_entry = {
+	.attr = {.name = "stage_batch", .mode = S_IRUGO | S_IWUSR },
+	.show = queue_stage_batch_show,
+	.store = queue_stage_batch_store,
+};
+
+#ifdef CONFIG_BLK_DEV_LATENCY_HIST
+static struct queue_sysfs_entry queue_lat_hist_entry = {
+	.attr = {.name = "latency_hist", .mode = S_IRUGO | S_IWUSR },
+	.show = blk_lat_hist_show,
+	.store = blk_lat_hist_store,
+};
+#endif
+
+#ifdef CONFIG_BLK_WBT
+static struct queue_sysfs_entry queue_wbt_lat_entry = {
+	.attr = {.name = "wbt_lat_usec", .mode = S_IRUGO | S_IWUSR },
+	.show = blk_wbt_lat_show,
+	.store = blk_wbt_lat_store,
+};
+
+static struct queue_sysfs_entry queue_wbt_stats_entry = {
+	.attr = {.name = "wbt_stats", .mode = S_IRUGO },
+	.show = blk_wbt_stats_show,
+};
+#endif
+
 static struct attribute *default_attrs[] = {
 	&queue_requests_entry.attr,
 	&queue_ra_entry.attr,
@@ -402,6 +445,14 @@ static struct attribute *default_attrs[] = {
 	&queue_rq_affinity_entry.attr,
 	&queue_iostats_entry.attr,
 	&queue_random_entry.attr,
+	&queue_stage_batch_entry.attr,
+#ifdef CONFIG_BLK_DEV_LATENCY_HIST
+	&queue_lat_hist_entry.attr,
+#endif
+#ifdef CONFIG_BLK_WBT
+	&queue_wbt_lat_entry.attr,
+	&queue_wbt_stats_entry.attr,
+#endif
 	NULL,
 };
 
@@ -480,6 +531,10 @@ static void blk_release_queue(struct kobject *kobj)
 	if (rl->rq_pool)
 		mempool_destroy(rl->rq_pool);
 
+	free_percpu(q->stage);
+	blk_lat_hist_exit(q);
+	blk_wbt_exit(q);
+
 	if (q->queue_tags)
 		__blk_queue_free_tags(q);
 
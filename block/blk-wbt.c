@@ -0,0 +1,279 @@
+/*
+ * Writeback throttling
+ *
+ * Background writeback can fill the whole request queue of a device, and
+ * with a slow eMMC behind it an application read then waits for all of
+ * those writes.  The buffered writes a queue has in flight are limited
+ * here, and the limit follows the latency of the reads of the device:
+ * every window, if the fastest read took longer than the target, the
+ * limit is halved, else it is doubled back towards nr_requests.  While
+ * reads are being made the writes get half of the limit.
+ *
+ * Writes that somebody waits on, from fsync() or O_DIRECT, are sync and
+ * are never throttled.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/blkdev.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/timer.h>
+#include <linux/wait.h>
+
+#include "blk.h"
+
+#define WBT_DEFAULT_LAT_USEC	2000
+#define WBT_WINDOW		msecs_to_jiffies(100)
+
+struct rq_wb {
+	struct request_queue	*q;
+	u64			min_lat_nsec;	/* target, 0 when off */
+	unsigned int		scale_step;	/* limit is nr_requests >> step */
+	unsigned long		last_read;	/* jiffies a read was issued */
+
+	atomic_t		inflight;
+	wait_queue_head_t	wait;
+
+	/* the current window */
+	spinlock_t		lock;
+	struct timer_list	timer;
+	unsigned int		nr_reads;
+	unsigned int		nr_writes;
+	u64			read_min_nsec;
+
+	unsigned long		throttled;
+	unsigned long		scaled_down;
+	unsigned long		scaled_up;
+};
+
+static unsigned int wbt_max_depth(struct rq_wb *rwb)
+{
+	return max_t(unsigned long, rwb->q->nr_requests, 1);
+}
+
+static unsigned int wbt_limit(struct rq_wb *rwb)
+{
+	unsigned int limit;
+
+	limit = wbt_max_depth(rwb) >> ACCESS_ONCE(rwb->scale_step);
+
+	if (time_before(jiffies, ACCESS_ONCE(rwb->last_read) + WBT_WINDOW))
+		limit /= 2;
+	return max(limit, 1U);
+}
+
+static void wbt_arm(struct rq_wb *rwb)
+{
+	if (!timer_pending(&rwb->timer))
+		mod_timer(&rwb->timer, jiffies + WBT_WINDOW);
+}
+
+/* Takes a slot if there is one below the limit. */
+static bool wbt_inflight_get(struct rq_wb *rwb)
+{
+	int limit = wbt_limit(rwb);
+	int cur;
+
+	if (!rwb->min_lat_nsec) {
+		atomic_inc(&rwb->inflight);
+		return true;
+	}
+
+	do {
+		cur = atomic_read(&rwb->inflight);
+		if (cur >= limit)
+			return false;
+	} while (atomic_cmpxchg(&rwb->inflight, cur, cur + 1) != cur);
+
+	return true;
+}
+
+/*
+ * Called with the queue lock held, which is dropped while waiting.  The
+ * plug of the task is flushed when it sleeps, so the writes it holds
+ * back count towards the limit too.  Memory reclaim is not held up.
+ */
+bool __blk_wbt_wait(struct request_queue *q)
+{
+	struct rq_wb *rwb = q->rq_wb;
+	DEFINE_WAIT(wait);
+
+	if (!rwb->min_lat_nsec)
+		return false;
+
+	wbt_arm(rwb);
+	if (current->flags & PF_MEMALLOC) {
+		atomic_inc(&rwb->inflight);
+		return true;
+	}
+	if (wbt_inflight_get(rwb))
+		return true;
+
+	rwb->throttled++;
+	spin_unlock_irq(q->queue_lock);
+	for (;;) {
+		prepare_to_wait_exclusive(&rwb->wait, &wait,
+					  TASK_UNINTERRUPTIBLE);
+		if (wbt_inflight_get(rwb))
+			break;
+		io_schedule();
+	}
+	finish_wait(&rwb->wait, &wait);
+	spin_lock_irq(q->queue_lock);
+
+	return true;
+}
+
+void __blk_wbt_issue(struct request *rq)
+{
+	struct rq_wb *rwb = rq->q->rq_wb;
+
+	if (!rwb->min_lat_nsec)
+		return;
+
+	rq->wbt_issue_ns = ktime_to_ns(ktime_get());
+	rwb->last_read = jiffies;
+	wbt_arm(rwb);
+}
+
+void __blk_wbt_done(struct request *rq)
+{
+	struct rq_wb *rwb = rq->q->rq_wb;
+	u64 lat = 0;
+
+	if (rq->wbt_issue_ns) {
+		lat = ktime_to_ns(ktime_get()) - rq->wbt_issue_ns;
+		rq->wbt_issue_ns = 0;
+	}
+
+	spin_lock(&rwb->lock);
+	if (rq_data_dir(rq) == READ) {
+		if (!rwb->nr_reads++ || lat < rwb->read_min_nsec)
+			rwb->read_min_nsec = lat;
+	} else {
+		rwb->nr_writes++;
+	}
+	spin_unlock(&rwb->lock);
+}
+
+/* queue lock held */
+void __blk_wbt_free(struct request_queue *q)
+{
+	struct rq_wb *rwb = q->rq_wb;
+	int inflight = atomic_dec_return(&rwb->inflight);
+
+	if (waitqueue_active(&rwb->wait) && inflight < (int)wbt_limit(rwb))
+		wake_up(&rwb->wait);
+}
+
+/*
+ * Once a window, scale down if even the fastest read missed the target,
+ * and scale up if reads met it or there were none to slow down.
+ */
+static void wbt_timer_fn(unsigned long data)
+{
+	struct rq_wb *rwb = (struct rq_wb *)data;
+	unsigned int nr_reads, nr_writes;
+	unsigned long flags;
+	u64 read_min;
+
+	spin_lock_irqsave(&rwb->lock, flags);
+	nr_reads = rwb->nr_reads;
+	nr_writes = rwb->nr_writes;
+	read_min = rwb->read_min_nsec;
+	rwb->nr_reads = rwb->nr_writes = 0;
+
+	if (!rwb->min_lat_nsec) {
+		spin_unlock_irqrestore(&rwb->lock, flags);
+		return;
+	}
+
+	if (nr_reads && read_min > rwb->min_lat_nsec) {
+		if (wbt_max_depth(rwb) >> rwb->scale_step > 1) {
+			rwb->scale_step++;
+			rwb->scaled_down++;
+		}
+	} else if (rwb->scale_step) {
+		rwb->scale_step--;
+		rwb->scaled_up++;
+		wake_up_all(&rwb->wait);
+	}
+
+	if (nr_reads || nr_writes || atomic_read(&rwb->inflight))
+		mod_timer(&rwb->timer, jiffies + WBT_WINDOW);
+	else
+		rwb->scale_step = 0;
+	spin_unlock_irqrestore(&rwb->lock, flags);
+}
+
+void blk_wbt_init(struct request_queue *q)
+{
+	struct rq_wb *rwb;
+
+	rwb = kzalloc_node(sizeof(*rwb), GFP_KERNEL, q->node);
+	if (!rwb)
+		return;
+
+	rwb->q = q;
+	rwb->min_lat_nsec = WBT_DEFAULT_LAT_USEC * NSEC_PER_USEC;
+	atomic_set(&rwb->inflight, 0);
+	init_waitqueue_head(&rwb->wait);
+	spin_lock_init(&rwb->lock);
+	setup_timer(&rwb->timer, wbt_timer_fn, (unsigned long)rwb);
+	q->rq_wb = rwb;
+}
+
+void blk_wbt_exit(struct request_queue *q)
+{
+	struct rq_wb *rwb = q->rq_wb;
+
+	if (!rwb)
+		return;
+	del_timer_sync(&rwb->timer);
+	kfree(rwb);
+	q->rq_wb = NULL;
+}
+
+ssize_t blk_wbt_lat_show(struct request_queue *q, char *page)
+{
+	u64 lat = q->rq_wb ? q->rq_wb->min_lat_nsec : 0;
+
+	return sprintf(page, "%llu\n",
+		       (unsigned long long)div_u64(lat, NSEC_PER_USEC));
+}
+
+ssize_t blk_wbt_lat_store(struct request_queue *q, const char *page,
+			  size_t count)
+{
+	struct rq_wb *rwb = q->rq_wb;
+	unsigned long usec;
+
+	if (!rwb)
+		return -EINVAL;
+	if (strict_strtoul(page, 10, &usec))
+		return -EINVAL;
+
+	spin_lock_irq(&rwb->lock);
+	rwb->min_lat_nsec = (u64)usec * NSEC_PER_USEC;
+	rwb->scale_step = 0;
+	spin_unlock_irq(&rwb->lock);
+	wake_up_all(&rwb->wait);
+
+	return count;
+}
+
+ssize_t blk_wbt_stats_show(struct request_queue *q, char *page)
+{
+	struct rq_wb *rwb = q->rq_wb;
+
+	if (!rwb)
+		return sprintf(page, "off\n");
+
+	return sprintf(page,
+		       "limit %u\ninflight %d\nthrottled %lu\n"
+		       "scaled_down %lu\nscaled_up %lu\n",
+		       wbt_limit(rwb), atomic_read(&rwb->inflight),
+		       rwb->throttled, rwb->scaled_down, rwb->scaled_up);
+}
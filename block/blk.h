@@ -49,6 +49,119 @@ static inline void blk_clear_rq_complete(struct request *rq)
  */
 #define ELV_ON_HASH(rq)		(!hlist_unhashed(&(rq)->hash))
 
+/*
+ * Requests staged on one cpu, see blk_queue_stage()
+ */
+struct blk_stage {
+	spinlock_t		lock;
+	struct list_head	list;
+	unsigned int		nr;
+	int			cpu;
+	struct request_queue	*q;
+	struct work_struct	work;
+};
+
+static inline bool blk_queue_staged(struct request_queue *q)
+{
+	if (!ACCESS_ONCE(q->stage_batch))
+		return false;
+	/* pairs with the smp_wmb() in blk_queue_stage() */
+	smp_rmb();
+	return true;
+}
+
+void blk_stage_flush_all(struct request_queue *q);
+
+#ifdef CONFIG_BLK_DEV_LATENCY_HIST
+void __blk_lat_hist_start(struct request *rq);
+void __blk_lat_hist_issue(struct request *rq);
+void __blk_lat_hist_done(struct request *rq);
+ssize_t blk_lat_hist_show(struct request_queue *q, char *page);
+ssize_t blk_lat_hist_store(struct request_queue *q, const char *page,
+			   size_t count);
+void blk_lat_hist_exit(struct request_queue *q);
+
+static inline void blk_lat_hist_start(struct request *rq)
+{
+	if (unlikely(rq->q->lat_hist_on))
+		__blk_lat_hist_start(rq);
+	else
+		rq->lat_start_ns = 0;
+}
+
+static inline void blk_lat_hist_issue(struct request *rq)
+{
+	if (unlikely(rq->lat_start_ns))
+		__blk_lat_hist_issue(rq);
+}
+
+static inline void blk_lat_hist_done(struct request *rq)
+{
+	if (unlikely(rq->lat_start_ns))
+		__blk_lat_hist_done(rq);
+}
+#else
+static inline void blk_lat_hist_start(struct request *rq) { }
+static inline void blk_lat_hist_issue(struct request *rq) { }
+static inline void blk_lat_hist_done(struct request *rq) { }
+static inline void blk_lat_hist_exit(struct request_queue *q) { }
+#endif
+
+#ifdef CONFIG_BLK_WBT
+void blk_wbt_init(struct request_queue *q);
+void blk_wbt_exit(struct request_queue *q);
+bool __blk_wbt_wait(struct request_queue *q);
+void __blk_wbt_issue(struct request *rq);
+void __blk_wbt_done(struct request *rq);
+void __blk_wbt_free(struct request_queue *q);
+ssize_t blk_wbt_lat_show(struct request_queue *q, char *page);
+ssize_t blk_wbt_lat_store(struct request_queue *q, const char *page,
+			  size_t count);
+ssize_t blk_wbt_stats_show(struct request_queue *q, char *page);
+
+/*
+ * Only buffered writes are throttled: writeback that nobody waits on.
+ * Sync writes come from fsync() and O_DIRECT and are waited on like reads.
+ */
+static inline bool blk_wbt_wait(struct request_queue *q, struct bio *bio)
+{
+	if (!q->rq_wb || bio_data_dir(bio) != WRITE ||
+	    (bio->bi_rw & (REQ_SYNC | REQ_FLUSH | REQ_FUA | REQ_DISCARD)))
+		return false;
+	return __blk_wbt_wait(q);
+}
+
+static inline void blk_wbt_issue(struct request *rq)
+{
+	if (rq->q->rq_wb && rq_data_dir(rq) == READ &&
+	    rq->cmd_type == REQ_TYPE_FS)
+		__blk_wbt_issue(rq);
+}
+
+static inline void blk_wbt_done(struct request *rq)
+{
+	if (rq->wbt_issue_ns || (rq->cmd_flags & REQ_WB_TRACKED))
+		__blk_wbt_done(rq);
+}
+
+static inline void blk_wbt_free(struct request_queue *q, struct request *rq)
+{
+	if (rq->cmd_flags & REQ_WB_TRACKED)
+		__blk_wbt_free(q);
+}
+#else
+static inline void blk_wbt_init(struct request_queue *q) { }
+static inline void blk_wbt_exit(struct request_queue *q) { }
+static inline bool blk_wbt_wait(struct request_queue *q, struct bio *bio)
+{
+	return false;
+}
+static inline void blk_wbt_issue(struct request *rq) { }
+static inline void blk_wbt_done(struct request *rq) { }
+static inline void blk_wbt_free(struct request_queue *q,
+				struct request *rq) { }
+#endif
+
 void blk_insert_flush(struct request *rq);
 void blk_abort_flushes(struct request_queue *q);
 
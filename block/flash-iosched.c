@@ -0,0 +1,646 @@
+/*
+ *  Flash i/o scheduler.
+ *
+ *  For non-rotational devices with a flash translation layer, such as
+ *  eMMC.  There is no seek to avoid and no point in idling, so reads are
+ *  served in arrival order, ahead of writes.  Writes are held back and
+ *  sent in batches that each cover one erase block sized region in
+ *  sector order, which gives the FTL whole blocks to program and less
+ *  garbage to collect.  The ioprio class of the submitting task decides
+ *  the order between requests: realtime first, idle only when nothing
+ *  else is queued.
+ *
+ *  See Documentation/block/flash-iosched.txt
+ */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/elevator.h>
+#include <linux/bio.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/compiler.h>
+#include <linux/rbtree.h>
+#include <linux/ioprio.h>
+#include <linux/iocontext.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
+
+static const int write_expire = HZ;	/* max time before a write is submitted */
+static const int idle_expire = 2 * HZ;	/* ditto for the idle class */
+static const int writes_starved = 16;	/* max reads sent while writes wait */
+static const int write_batch = 32;	/* max writes sent as one batch */
+static const int erase_block_kb = 512;	/* size of a write batch region */
+
+enum {
+	FLASH_RT,
+	FLASH_BE,
+	FLASH_IDLE,
+	FLASH_CLASSES,
+};
+
+static const char * const flash_class_names[] = { "rt", "be", "idle" };
+
+/* Latency histogram buckets: <1ms, <2ms, <4ms ... >=512ms */
+#define FLASH_LAT_BUCKETS	11
+
+struct flash_lat_stats {
+	unsigned long	nr;
+	u64		total_us;
+	u64		max_us;
+	unsigned long	hist[FLASH_LAT_BUCKETS];
+};
+
+struct flash_data {
+	struct request_queue *queue;
+
+	/*
+	 * requests are on a sort_list, by sector, and on the fifo of their
+	 * direction and class, by arrival
+	 */
+	struct rb_root sort_list[2];
+	struct list_head fifo_list[2][FLASH_CLASSES];
+	unsigned int queued[2][FLASH_CLASSES];
+
+	struct request *next_write;	/* where the last write batch ended */
+	unsigned int starved;		/* reads sent while writes waited */
+
+	/*
+	 * settings that change how the i/o scheduler behaves
+	 */
+	int write_expire;
+	int idle_expire;
+	int writes_starved;
+	int write_batch;
+	int region_shift;		/* erase block, in sectors, as a shift */
+
+	/*
+	 * queue to completion latency, per class and direction
+	 */
+	struct flash_lat_stats lat[FLASH_CLASSES][2];
+	unsigned long write_batches;
+	unsigned long batched_writes;
+};
+
+/*
+ * elevator_private[0] holds the time the request was queued, in us, and
+ * elevator_private[1] the class of its submitter.
+ */
+#define RQ_QUEUED_US(rq)	((unsigned long) (rq)->elevator_private[0])
+#define RQ_CLASS(rq)		((unsigned long) (rq)->elevator_private[1])
+
+static inline unsigned long flash_now_us(void)
+{
+	return (unsigned long) ktime_to_us(ktime_get());
+}
+
+static inline struct rb_root *
+flash_rb_root(struct flash_data *fd, struct request *rq)
+{
+	return &fd->sort_list[rq_data_dir(rq)];
+}
+
+static inline sector_t flash_region(struct flash_data *fd, struct request *rq)
+{
+	return blk_rq_pos(rq) >> fd->region_shift;
+}
+
+static inline struct request *flash_latter_request(struct request *rq)
+{
+	struct rb_node *node = rb_next(&rq->rb_node);
+
+	return node ? rb_entry_rq(node) : NULL;
+}
+
+static inline struct request *flash_former_request(struct request *rq)
+{
+	struct rb_node *node = rb_prev(&rq->rb_node);
+
+	return node ? rb_entry_rq(node) : NULL;
+}
+
+static void flash_move_to_dispatch(struct flash_data *fd, struct request *rq);
+
+static void flash_add_rq_rb(struct flash_data *fd, struct request *rq)
+{
+	struct rb_root *root = flash_rb_root(fd, rq);
+	struct request *__alias;
+
+	while (unlikely(__alias = elv_rb_add(root, rq)))
+		flash_move_to_dispatch(fd, __alias);
+}
+
+static inline void flash_del_rq_rb(struct flash_data *fd, struct request *rq)
+{
+	if (fd->next_write == rq)
+		fd->next_write = flash_latter_request(rq);
+
+	elv_rb_del(flash_rb_root(fd, rq), rq);
+}
+
+/*
+ * The class is looked up when the request is allocated, in the context
+ * of the submitting task.
+ */
+static int
+flash_set_request(struct request_queue *q, struct request *rq, gfp_t gfp_mask)
+{
+	struct io_context *ioc = current->io_context;
+	int class;
+
+	if (ioc && ioprio_valid(ioc->ioprio))
+		class = IOPRIO_PRIO_CLASS(ioc->ioprio);
+	else
+		class = task_nice_ioclass(current);
+
+	rq->elevator_private[0] = NULL;
+	rq->elevator_private[1] = (void *) (unsigned long)
+		(class == IOPRIO_CLASS_RT ? FLASH_RT :
+		 class == IOPRIO_CLASS_IDLE ? FLASH_IDLE : FLASH_BE);
+	return 0;
+}
+
+/*
+ * add rq to rbtree and fifo
+ */
+static void flash_add_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	const int data_dir = rq_data_dir(rq);
+	unsigned long class = RQ_CLASS(rq);
+
+	/* A priority set on the bio itself wins */
+	if (ioprio_valid(rq->ioprio)) {
+		switch (IOPRIO_PRIO_CLASS(rq->ioprio)) {
+		case IOPRIO_CLASS_RT:
+			class = FLASH_RT;
+			break;
+		case IOPRIO_CLASS_IDLE:
+			class = FLASH_IDLE;
+			break;
+		default:
+			class = FLASH_BE;
+		}
+	}
+	if (class >= FLASH_CLASSES)
+		class = FLASH_BE;
+	rq->elevator_private[1] = (void *) class;
+	rq->elevator_private[0] = (void *) flash_now_us();
+
+	flash_add_rq_rb(fd, rq);
+
+	/* Only writes and the idle class are promoted when they expire */
+	rq_set_fifo_time(rq, jiffies + (class == FLASH_IDLE ? fd->idle_expire :
+					 fd->write_expire));
+	list_add_tail(&rq->queuelist, &fd->fifo_list[data_dir][class]);
+	fd->queued[data_dir][class]++;
+}
+
+/*
+ * remove rq from rbtree and fifo.
+ */
+static void flash_remove_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	rq_fifo_clear(rq);
+	flash_del_rq_rb(fd, rq);
+	fd->queued[rq_data_dir(rq)][RQ_CLASS(rq)]--;
+}
+
+static int
+flash_merge(struct request_queue *q, struct request **req, struct bio *bio)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	sector_t sector = bio->bi_sector + bio_sectors(bio);
+	struct request *__rq;
+
+	/*
+	 * check for front merge, back merges are found by the elevator core
+	 */
+	__rq = elv_rb_find(&fd->sort_list[bio_data_dir(bio)], sector);
+	if (__rq) {
+		BUG_ON(sector != blk_rq_pos(__rq));
+
+		if (elv_rq_merge_ok(__rq, bio)) {
+			*req = __rq;
+			return ELEVATOR_FRONT_MERGE;
+		}
+	}
+
+	return ELEVATOR_NO_MERGE;
+}
+
+static void flash_merged_request(struct request_queue *q,
+				 struct request *req, int type)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	/*
+	 * if the merge was a front merge, we need to reposition request
+	 */
+	if (type == ELEVATOR_FRONT_MERGE) {
+		elv_rb_del(flash_rb_root(fd, req), req);
+		flash_add_rq_rb(fd, req);
+	}
+}
+
+static void
+flash_merged_requests(struct request_queue *q, struct request *req,
+		      struct request *next)
+{
+	/*
+	 * if next expires before rq, and is of the same class, assign its
+	 * expire time to rq and move into next position in fifo
+	 */
+	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist) &&
+	    RQ_CLASS(req) == RQ_CLASS(next)) {
+		if (time_before(rq_fifo_time(next), rq_fifo_time(req))) {
+			list_move(&req->queuelist, &next->queuelist);
+			rq_set_fifo_time(req, rq_fifo_time(next));
+		}
+	}
+
+	/* The latency is that of the older part */
+	if ((long) (RQ_QUEUED_US(next) - RQ_QUEUED_US(req)) < 0)
+		req->elevator_private[0] = next->elevator_private[0];
+
+	/*
+	 * kill knowledge of next, this one is a goner
+	 */
+	flash_remove_request(q, next);
+}
+
+/*
+ * move request from sort list to dispatch queue.
+ */
+static void flash_move_to_dispatch(struct flash_data *fd, struct request *rq)
+{
+	struct request_queue *q = rq->q;
+
+	flash_remove_request(q, rq);
+	elv_dispatch_add_tail(q, rq);
+}
+
+static inline struct request *
+flash_fifo_head(struct flash_data *fd, int data_dir, int class)
+{
+	if (list_empty(&fd->fifo_list[data_dir][class]))
+		return NULL;
+	return rq_entry_fifo(fd->fifo_list[data_dir][class].next);
+}
+
+static inline bool flash_expired(struct request *rq)
+{
+	return rq && time_after(jiffies, rq_fifo_time(rq));
+}
+
+/*
+ * Send the writes of the erase block region of rq, in sector order and
+ * at most write_batch of them.  The next batch starts after the last one
+ * sent, unless something more urgent comes up.
+ */
+static int flash_dispatch_writes(struct flash_data *fd, struct request *rq)
+{
+	sector_t region = flash_region(fd, rq);
+	struct request *prev, *next;
+	int nr = 0;
+
+	while ((prev = flash_former_request(rq)) &&
+	       flash_region(fd, prev) == region)
+		rq = prev;
+
+	do {
+		next = flash_latter_request(rq);
+		flash_move_to_dispatch(fd, rq);
+		nr++;
+		rq = next;
+	} while (rq && flash_region(fd, rq) == region && nr < fd->write_batch);
+
+	fd->next_write = rq;
+	fd->starved = 0;
+	fd->write_batches++;
+	fd->batched_writes += nr;
+	return nr;
+}
+
+static int flash_dispatch_read(struct flash_data *fd, struct request *rq)
+{
+	if (fd->queued[WRITE][FLASH_RT] || fd->queued[WRITE][FLASH_BE])
+		fd->starved++;
+	flash_move_to_dispatch(fd, rq);
+	return 1;
+}
+
+/*
+ * flash_dispatch_requests picks what to send next: expired writes, then
+ * realtime reads and writes, then best effort reads unless they have
+ * starved the writes for too long, then best effort writes.  The idle
+ * class goes last, or once it has waited idle_expire.
+ */
+static int flash_dispatch_requests(struct request_queue *q, int force)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	struct request *rq, *write;
+
+	/* Writes past their deadline, realtime first */
+	write = flash_fifo_head(fd, WRITE, FLASH_RT);
+	if (flash_expired(write))
+		return flash_dispatch_writes(fd, write);
+	rq = flash_fifo_head(fd, WRITE, FLASH_BE);
+	if (flash_expired(rq))
+		return flash_dispatch_writes(fd, rq);
+	if (!write)
+		write = rq;
+
+	rq = flash_fifo_head(fd, READ, FLASH_RT);
+	if (rq)
+		return flash_dispatch_read(fd, rq);
+
+	rq = flash_fifo_head(fd, WRITE, FLASH_RT);
+	if (rq)
+		return flash_dispatch_writes(fd, rq);
+
+	rq = flash_fifo_head(fd, READ, FLASH_BE);
+	if (rq && !(write && fd->starved >= fd->writes_starved))
+		return flash_dispatch_read(fd, rq);
+
+	if (write) {
+		/* Carry on where the last batch ended, unless reads wait */
+		if (!rq && fd->next_write)
+			write = fd->next_write;
+		return flash_dispatch_writes(fd, write);
+	}
+
+	/* Only the idle class is left */
+	rq = flash_fifo_head(fd, READ, FLASH_IDLE);
+	if (rq)
+		return flash_dispatch_read(fd, rq);
+
+	rq = flash_fifo_head(fd, WRITE, FLASH_IDLE);
+	if (rq)
+		return flash_dispatch_writes(fd, rq);
+
+	return 0;
+}
+
+/*
+ * The idle class is held back from the dispatch above only as long as
+ * other requests are queued, so an expired idle request is promoted by
+ * serving it at the next dispatch.
+ */
+static int flash_dispatch(struct request_queue *q, int force)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	struct request *rq;
+
+	rq = flash_fifo_head(fd, READ, FLASH_IDLE);
+	if (flash_expired(rq))
+		return flash_dispatch_read(fd, rq);
+
+	rq = flash_fifo_head(fd, WRITE, FLASH_IDLE);
+	if (flash_expired(rq))
+		return flash_dispatch_writes(fd, rq);
+
+	return flash_dispatch_requests(q, force);
+}
+
+static void flash_completed_request(struct request_queue *q,
+				    struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	struct flash_lat_stats *st;
+	unsigned long class = RQ_CLASS(rq);
+	unsigned int bucket;
+	u64 us;
+
+	if (class >= FLASH_CLASSES)
+		return;
+
+	st = &fd->lat[class][rq_data_dir(rq)];
+	us = flash_now_us() - RQ_QUEUED_US(rq);
+	st->nr++;
+	st->total_us += us;
+	st->max_us = max(st->max_us, us);
+
+	bucket = us < USEC_PER_MSEC ? 0 : ilog2(div_u64(us, USEC_PER_MSEC)) + 1;
+	st->hist[min_t(unsigned int, bucket, FLASH_LAT_BUCKETS - 1)]++;
+}
+
+static void flash_exit_queue(struct elevator_queue *e)
+{
+	struct flash_data *fd = e->elevator_data;
+	int class;
+
+	for (class = 0; class < FLASH_CLASSES; class++) {
+		BUG_ON(!list_empty(&fd->fifo_list[READ][class]));
+		BUG_ON(!list_empty(&fd->fifo_list[WRITE][class]));
+	}
+
+	kfree(fd);
+}
+
+/*
+ * initialize elevator private data (flash_data).
+ */
+static void *flash_init_queue(struct request_queue *q)
+{
+	struct flash_data *fd;
+	int class;
+
+	fd = kmalloc_node(sizeof(*fd), GFP_KERNEL | __GFP_ZERO, q->node);
+	if (!fd)
+		return NULL;
+
+	fd->queue = q;
+	for (class = 0; class < FLASH_CLASSES; class++) {
+		INIT_LIST_HEAD(&fd->fifo_list[READ][class]);
+		INIT_LIST_HEAD(&fd->fifo_list[WRITE][class]);
+	}
+	fd->sort_list[READ] = RB_ROOT;
+	fd->sort_list[WRITE] = RB_ROOT;
+	fd->write_expire = write_expire;
+	fd->idle_expire = idle_expire;
+	fd->writes_starved = writes_starved;
+	fd->write_batch = write_batch;
+	fd->region_shift = ilog2(erase_block_kb * 2);
+	return fd;
+}
+
+/*
+ * sysfs parts below
+ */
+
+static ssize_t
+flash_var_show(int var, char *page)
+{
+	return sprintf(page, "%d\n", var);
+}
+
+static ssize_t
+flash_var_store(int *var, const char *page, size_t count)
+{
+	char *p = (char *) page;
+
+	*var = simple_strtol(p, &p, 10);
+	return count;
+}
+
+#define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data = __VAR;						\
+	if (__CONV)							\
+		__data = jiffies_to_msecs(__data);			\
+	return flash_var_show(__data, (page));				\
+}
+SHOW_FUNCTION(flash_write_expire_show, fd->write_expire, 1);
+SHOW_FUNCTION(flash_idle_expire_show, fd->idle_expire, 1);
+SHOW_FUNCTION(flash_writes_starved_show, fd->writes_starved, 0);
+SHOW_FUNCTION(flash_write_batch_show, fd->write_batch, 0);
+#undef SHOW_FUNCTION
+
+#define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
+static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)	\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data;							\
+	int ret = flash_var_store(&__data, (page), count);		\
+	if (__data < (MIN))						\
+		__data = (MIN);						\
+	else if (__data > (MAX))					\
+		__data = (MAX);						\
+	if (__CONV)							\
+		*(__PTR) = msecs_to_jiffies(__data);			\
+	else								\
+		*(__PTR) = __data;					\
+	return ret;							\
+}
+STORE_FUNCTION(flash_write_expire_store, &fd->write_expire, 0, INT_MAX, 1);
+STORE_FUNCTION(flash_idle_expire_store, &fd->idle_expire, 0, INT_MAX, 1);
+STORE_FUNCTION(flash_writes_starved_store, &fd->writes_starved, 0, INT_MAX, 0);
+STORE_FUNCTION(flash_write_batch_store, &fd->write_batch, 1, INT_MAX, 0);
+#undef STORE_FUNCTION
+
+static ssize_t flash_erase_block_kb_show(struct elevator_queue *e, char *page)
+{
+	struct flash_data *fd = e->elevator_data;
+
+	return flash_var_show(1 << (fd->region_shift - 1), page);
+}
+
+/* Rounded down to a power of two, from 4KB to 64MB */
+static ssize_t flash_erase_block_kb_store(struct elevator_queue *e,
+					  const char *page, size_t count)
+{
+	struct flash_data *fd = e->elevator_data;
+	int kb;
+	int ret = flash_var_store(&kb, page, count);
+
+	kb = clamp(kb, 4, 65536);
+	fd->region_shift = ilog2(kb * 2);
+	return ret;
+}
+
+static ssize_t flash_latency_stats_show(struct elevator_queue *e, char *page)
+{
+	struct flash_data *fd = e->elevator_data;
+	struct request_queue *q = fd->queue;
+	int class, dir, i, len = 0;
+
+	spin_lock_irq(q->queue_lock);
+	for (class = 0; class < FLASH_CLASSES; class++) {
+		for (dir = READ; dir <= WRITE; dir++) {
+			struct flash_lat_stats *st = &fd->lat[class][dir];
+
+			len += sprintf(page + len,
+				       "%s %s nr %lu avg_us %llu max_us %llu ms",
+				       flash_class_names[class],
+				       dir == READ ? "read" : "write", st->nr,
+				       st->nr ? div64_u64(st->total_us, st->nr) : 0,
+				       st->max_us);
+			for (i = 0; i < FLASH_LAT_BUCKETS - 1; i++)
+				len += sprintf(page + len, " <%u:%lu", 1 << i,
+					       st->hist[i]);
+			len += sprintf(page + len, " >=%u:%lu\n",
+				       1 << (FLASH_LAT_BUCKETS - 2),
+				       st->hist[FLASH_LAT_BUCKETS - 1]);
+		}
+	}
+	len += sprintf(page + len, "write_batches %lu batched_writes %lu\n",
+		       fd->write_batches, fd->batched_writes);
+	spin_unlock_irq(q->queue_lock);
+
+	return len;
+}
+
+/* Writing anything clears the statistics */
+static ssize_t flash_latency_stats_store(struct elevator_queue *e,
+					 const char *page, size_t count)
+{
+	struct flash_data *fd = e->elevator_data;
+	struct request_queue *q = fd->queue;
+
+	spin_lock_irq(q->queue_lock);
+	memset(fd->lat, 0, sizeof(fd->lat));
+	fd->write_batches = 0;
+	fd->batched_writes = 0;
+	spin_unlock_irq(q->queue_lock);
+
+	return count;
+}
+
+#define FLASH_ATTR(name) \
+	__ATTR(name, S_IRUGO|S_IWUSR, flash_##name##_show, \
+				      flash_##name##_store)
+
+static struct elv_fs_entry flash_attrs[] = {
+	FLASH_ATTR(write_expire),
+	FLASH_ATTR(idle_expire),
+	FLASH_ATTR(writes_starved),
+	FLASH_ATTR(write_batch),
+	FLASH_ATTR(erase_block_kb),
+	FLASH_ATTR(latency_stats),
+	__ATTR_NULL
+};
+
+static struct elevator_type iosched_flash = {
+	.ops = {
+		.elevator_merge_fn = 		flash_merge,
+		.elevator_merged_fn =		flash_merged_request,
+		.elevator_merge_req_fn =	flash_merged_requests,
+		.elevator_dispatch_fn =		flash_dispatch,
+		.elevator_add_req_fn =		flash_add_request,
+		.elevator_completed_req_fn =	flash_completed_request,
+		.elevator_former_req_fn =	elv_rb_former_request,
+		.elevator_latter_req_fn =	elv_rb_latter_request,
+		.elevator_set_req_fn =		flash_set_request,
+		.elevator_init_fn =		flash_init_queue,
+		.elevator_exit_fn =		flash_exit_queue,
+	},
+
+	.elevator_attrs = flash_attrs,
+	.elevator_name = "flash",
+	.elevator_owner = THIS_MODULE,
+};
+
+static int __init flash_init(void)
+{
+	elv_register(&iosched_flash);
+
+	return 0;
+}
+
+static void __exit flash_exit(void)
+{
+	elv_unregister(&iosched_flash);
+}
+
+module_init(flash_init);
+module_exit(flash_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("flash IO scheduler");
@@ -75,6 +75,8 @@
 #include <linux/kthread.h>
 #include <linux/splice.h>
 #include <linux/sysfs.h>
+#include <linux/mempool.h>
+#include <linux/rwsem.h>
 
 #include <asm/uaccess.h>
 
@@ -84,6 +86,10 @@ static DEFINE_MUTEX(loop_devices_mutex);
 static int max_part;
 static int part_shift;
 
+static bool direct_io;
+module_param(direct_io, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(direct_io, "Turn on direct I/O for new loop devices");
+
 /*
  * Transfer functions
  */
@@ -498,6 +504,425 @@ out:
 	return ret;
 }
 
+/*
+ * Direct I/O
+ *
+ * With direct I/O on, the bios of the loop device are not copied through
+ * the page cache of the backing file by the loop thread, which leaves the
+ * data cached twice.  Instead they are remapped to the blocks the file
+ * has on its own block device and submitted straight away, as many at a
+ * time as the upper layers send.  This needs every block of the file to
+ * be allocated and written, as the blocks are looked up once with fiemap
+ * when direct I/O is turned on, and a filesystem whose fiemap reports
+ * byte offsets on its own block device, which it says with
+ * FS_FIEMAP_BDEV.  The file is marked as a swap file meanwhile, so that
+ * it cannot be truncated, have holes punched or have its blocks moved by
+ * ext4.  A block device backing is remapped as is.
+ *
+ * All buffered I/O is done by the loop thread, so direct I/O is turned on
+ * and off from it, after the bios queued before.
+ */
+#define LO_REMAP_POOL		64
+#define LO_FIEMAP_BATCH		32
+
+/* extents that are not plain data blocks on the device */
+#define LO_FIEMAP_BAD	(FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DELALLOC | \
+			 FIEMAP_EXTENT_ENCODED | FIEMAP_EXTENT_DATA_ENCRYPTED | \
+			 FIEMAP_EXTENT_NOT_ALIGNED | FIEMAP_EXTENT_DATA_INLINE | \
+			 FIEMAP_EXTENT_DATA_TAIL | FIEMAP_EXTENT_UNWRITTEN)
+
+struct loop_extent {
+	loff_t			pos;	/* in the backing file */
+	loff_t			len;
+	sector_t		sector;	/* on the backing device */
+};
+
+struct loop_remap {
+	struct block_device	*bdev;
+	struct inode		*swap_inode;	/* marked S_SWAPFILE */
+	struct bio_set		*bs;
+	mempool_t		*pool;
+	struct loop_extent	*ext;
+	unsigned int		nr, max;
+};
+
+/* one bio of the loop device, split over one or more of the backing device */
+struct loop_remap_io {
+	struct loop_device	*lo;
+	struct loop_remap	*map;
+	struct bio		*bio;
+	atomic_t		pending;
+	int			error;
+};
+
+static int loop_remap_add(struct loop_remap *map, loff_t pos, loff_t len,
+			  sector_t sector)
+{
+	struct loop_extent *e = map->nr ? &map->ext[map->nr - 1] : NULL;
+
+	if (e && e->pos + e->len == pos &&
+	    e->sector + (e->len >> 9) == sector) {
+		e->len += len;
+		return 0;
+	}
+
+	if (map->nr == map->max) {
+		unsigned int max = map->max ? map->max * 2 : 16;
+
+		e = krealloc(map->ext, max * sizeof(*e), GFP_KERNEL);
+		if (!e)
+			return -ENOMEM;
+		map->ext = e;
+		map->max = max;
+	}
+
+	e = &map->ext[map->nr++];
+	e->pos = pos;
+	e->len = len;
+	e->sector = sector;
+	return 0;
+}
+
+/* Looks up the blocks of [start, end) of a regular file with fiemap. */
+static int loop_remap_file(struct loop_remap *map, struct inode *inode,
+			   loff_t start, loff_t end)
+{
+	struct fiemap_extent_info fieinfo;
+	struct fiemap_extent *fe;
+	mm_segment_t old_fs;
+	loff_t pos = start;
+	int i, ret = 0;
+
+	fe = kmalloc(LO_FIEMAP_BATCH * sizeof(*fe), GFP_KERNEL);
+	if (!fe)
+		return -ENOMEM;
+
+	while (pos < end) {
+		memset(&fieinfo, 0, sizeof(fieinfo));
+		fieinfo.fi_extents_max = LO_FIEMAP_BATCH;
+		fieinfo.fi_extents_start = (struct fiemap_extent __user *)fe;
+
+		/* fiemap copies the extents out as if to user space */
+		old_fs = get_fs();
+		set_fs(KERNEL_DS);
+		ret = inode->i_op->fiemap(inode, &fieinfo, pos, end - pos);
+		set_fs(old_fs);
+		if (ret)
+			break;
+
+		/* a hole at the end */
+		ret = -EINVAL;
+		if (!fieinfo.fi_extents_mapped)
+			break;
+
+		for (i = 0; i < fieinfo.fi_extents_mapped && pos < end; i++) {
+			struct fiemap_extent *e = &fe[i];
+			loff_t e_end = e->fe_logical + e->fe_length;
+			loff_t len;
+
+			if (e_end <= pos)
+				continue;
+			if ((e->fe_flags & LO_FIEMAP_BAD) ||
+			    e->fe_logical > pos ||
+			    ((e->fe_logical | e->fe_physical) & 511))
+				goto out;
+
+			len = min(e_end, end) - pos;
+			ret = loop_remap_add(map, pos, len,
+				(e->fe_physical + pos - e->fe_logical) >> 9);
+			if (ret)
+				goto out;
+			pos += len;
+		}
+		ret = 0;
+	}
+out:
+	kfree(fe);
+	return ret;
+}
+
+static void loop_remap_free(struct loop_remap *map)
+{
+	if (map->swap_inode) {
+		mutex_lock(&map->swap_inode->i_mutex);
+		map->swap_inode->i_flags &= ~S_SWAPFILE;
+		mutex_unlock(&map->swap_inode->i_mutex);
+	}
+	if (map->pool)
+		mempool_destroy(map->pool);
+	if (map->bs)
+		bioset_free(map->bs);
+	kfree(map->ext);
+	kfree(map);
+}
+
+/*
+ * Maps the data of the loop device onto the backing device, or fails with
+ * -EINVAL if the backing file cannot be remapped.
+ */
+static struct loop_remap *loop_remap_build(struct loop_device *lo)
+{
+	struct file *file = lo->lo_backing_file;
+	struct inode *inode = file->f_mapping->host;
+	loff_t start = lo->lo_offset;
+	loff_t end = start + ((loff_t)get_capacity(lo->lo_disk) << 9);
+	struct loop_remap *map;
+	int ret;
+
+	if (lo->lo_encryption || (start & 511))
+		return ERR_PTR(-EINVAL);
+	if (S_ISREG(inode->i_mode) &&
+	    (!inode->i_op->fiemap || !inode->i_sb->s_bdev ||
+	     !(inode->i_sb->s_type->fs_flags & FS_FIEMAP_BDEV)))
+		return ERR_PTR(-EINVAL);
+
+	map = kzalloc(sizeof(*map), GFP_KERNEL);
+	if (!map)
+		return ERR_PTR(-ENOMEM);
+
+	/*
+	 * Claim a regular file the way swapon does, before looking up its
+	 * blocks: fiemap takes i_mutex itself, so it cannot be held across.
+	 */
+	if (S_ISREG(inode->i_mode)) {
+		ret = -EINVAL;
+		mutex_lock(&inode->i_mutex);
+		if (!IS_SWAPFILE(inode)) {
+			inode->i_flags |= S_SWAPFILE;
+			map->swap_inode = inode;
+			ret = 0;
+		}
+		mutex_unlock(&inode->i_mutex);
+		if (ret)
+			goto out_free;
+	}
+
+	/* have delayed allocations made */
+	ret = vfs_fsync(file, 0);
+	if (ret && ret != -EINVAL)
+		goto out_free;
+
+	if (S_ISBLK(inode->i_mode)) {
+		map->bdev = I_BDEV(inode);
+		ret = loop_remap_add(map, start, end - start, start >> 9);
+	} else {
+		map->bdev = inode->i_sb->s_bdev;
+		ret = loop_remap_file(map, inode, start, end);
+	}
+	if (ret)
+		goto out_free;
+
+	ret = -ENOMEM;
+	map->bs = bioset_create(LO_REMAP_POOL, 0);
+	map->pool = mempool_create_kmalloc_pool(LO_REMAP_POOL,
+					sizeof(struct loop_remap_io));
+	if (!map->bs || !map->pool)
+		goto out_free;
+
+	return map;
+
+out_free:
+	loop_remap_free(map);
+	return ERR_PTR(ret);
+}
+
+static struct loop_extent *loop_remap_find(struct loop_remap *map, loff_t pos)
+{
+	unsigned int lo = 0, hi = map->nr;
+
+	while (lo < hi) {
+		unsigned int mid = (lo + hi) / 2;
+		struct loop_extent *e = &map->ext[mid];
+
+		if (pos < e->pos)
+			hi = mid;
+		else if (pos >= e->pos + e->len)
+			lo = mid + 1;
+		else
+			return e;
+	}
+	return NULL;
+}
+
+static void loop_remap_put(struct loop_remap_io *io)
+{
+	struct loop_device *lo = io->lo;
+	struct bio *bio = io->bio;
+	int error;
+
+	if (!atomic_dec_and_test(&io->pending))
+		return;
+
+	/* only read once the other clones can no longer set it */
+	error = io->error;
+	mempool_free(io, io->map->pool);
+	bio_endio(bio, error);
+	if (atomic_dec_and_test(&lo->lo_remap_inflight))
+		wake_up(&lo->lo_remap_wait);
+}
+
+static void loop_remap_endio(struct bio *clone, int error)
+{
+	struct loop_remap_io *io = clone->bi_private;
+
+	if (!error && !test_bit(BIO_UPTODATE, &clone->bi_flags))
+		error = -EIO;
+	if (error)
+		io->error = error;
+	bio_put(clone);
+	loop_remap_put(io);
+}
+
+static struct bio *loop_remap_clone(struct loop_remap_io *io,
+				    sector_t sector, int nr_vecs)
+{
+	struct bio *clone;
+
+	clone = bio_alloc_bioset(GFP_NOIO, min(nr_vecs, BIO_MAX_PAGES),
+				 io->map->bs);
+	clone->bi_bdev = io->map->bdev;
+	clone->bi_sector = sector;
+	clone->bi_rw = io->bio->bi_rw & ~REQ_FLUSH;
+	clone->bi_end_io = loop_remap_endio;
+	clone->bi_private = io;
+	return clone;
+}
+
+static void loop_remap_submit(struct loop_remap_io *io, struct bio *clone)
+{
+	atomic_inc(&io->pending);
+	generic_make_request(clone);
+}
+
+/*
+ * Splits the bio at the extents of the backing file, and at the limits
+ * of the backing device, into clones that it submits.
+ */
+static void __loop_remap_bio(struct loop_device *lo, struct loop_remap *map,
+			     struct bio *bio)
+{
+	loff_t pos = ((loff_t)bio->bi_sector << 9) + lo->lo_offset;
+	struct loop_extent *e = NULL;
+	struct loop_remap_io *io;
+	struct bio *clone = NULL;
+	struct bio_vec *bvec;
+	int i;
+
+	io = mempool_alloc(map->pool, GFP_NOIO);
+	io->lo = lo;
+	io->map = map;
+	io->bio = bio;
+	io->error = 0;
+	atomic_set(&io->pending, 1);
+	atomic_inc(&lo->lo_remap_inflight);
+
+	bio_for_each_segment(bvec, bio, i) {
+		unsigned int off = bvec->bv_offset;
+		unsigned int len = bvec->bv_len;
+
+		while (len) {
+			unsigned int n;
+			sector_t sector;
+
+			if (!e || pos >= e->pos + e->len) {
+				e = loop_remap_find(map, pos);
+				if (!e) {
+					io->error = -EIO;
+					goto out;
+				}
+			}
+			n = min_t(loff_t, len, e->pos + e->len - pos);
+			sector = e->sector + ((pos - e->pos) >> 9);
+
+			if (clone && (clone->bi_sector +
+				      bio_sectors(clone) != sector ||
+				      bio_add_page(clone, bvec->bv_page, n,
+						   off) < n)) {
+				loop_remap_submit(io, clone);
+				clone = NULL;
+			}
+			if (!clone) {
+				clone = loop_remap_clone(io, sector,
+							 bio->bi_vcnt - i);
+				if (bio_add_page(clone, bvec->bv_page, n,
+						 off) < n) {
+					bio_put(clone);
+					clone = NULL;
+					io->error = -EIO;
+					goto out;
+				}
+			}
+			pos += n;
+			off += n;
+			len -= n;
+		}
+	}
+out:
+	if (clone)
+		loop_remap_submit(io, clone);
+	loop_remap_put(io);
+}
+
+/*
+ * Remaps the bio if direct I/O is on, a flush only after the flush of the
+ * backing device.  Returns false if it is off.
+ */
+static bool loop_remap_bio(struct loop_device *lo, struct bio *bio)
+{
+	struct loop_remap *map;
+	int ret;
+
+	if (!lo->lo_remap)
+		return false;
+
+	down_read(&lo->lo_remap_sem);
+	map = lo->lo_remap;
+	if (!map ||
+	    (bio_rw(bio) == WRITE && (lo->lo_flags & LO_FLAGS_READ_ONLY))) {
+		up_read(&lo->lo_remap_sem);
+		return false;
+	}
+
+	if (bio->bi_rw & REQ_FLUSH) {
+		ret = blkdev_issue_flush(map->bdev, GFP_NOIO, NULL);
+		if (ret && ret != -EOPNOTSUPP)
+			bio_endio(bio, -EIO);
+		else if (!bio->bi_size)
+			bio_endio(bio, 0);
+		else
+			__loop_remap_bio(lo, map, bio);
+	} else {
+		__loop_remap_bio(lo, map, bio);
+	}
+	up_read(&lo->lo_remap_sem);
+	return true;
+}
+
+/*
+ * Called from the loop thread, with the page cache of the backing file
+ * up to date on the backing device.  Returns the map switched from.
+ */
+static struct loop_remap *loop_remap_switch(struct loop_device *lo,
+					    struct loop_remap *map)
+{
+	struct address_space *mapping = lo->lo_backing_file->f_mapping;
+	struct loop_remap *old;
+
+	down_write(&lo->lo_remap_sem);
+	old = lo->lo_remap;
+	lo->lo_remap = map;
+	if (map)
+		lo->lo_flags |= LO_FLAGS_DIRECT_IO;
+	else
+		lo->lo_flags &= ~LO_FLAGS_DIRECT_IO;
+	up_write(&lo->lo_remap_sem);
+
+	/* what the page cache holds is stale after the direct writes */
+	wait_event(lo->lo_remap_wait, !atomic_read(&lo->lo_remap_inflight));
+	invalidate_mapping_pages(mapping, 0, -1);
+	return old;
+}
+
 /*
  * Add bio to back of pending list
  */
@@ -524,6 +949,11 @@ static int loop_make_request(struct request_queue *q, struct bio *old_bio)
 
 	BUG_ON(!lo || (rw != READ && rw != WRITE));
 
+	/* flushes wait for the backing device, from the loop thread */
+	if (lo->lo_state == Lo_bound && old_bio->bi_bdev &&
+	    !(old_bio->bi_rw & REQ_FLUSH) && loop_remap_bio(lo, old_bio))
+		return 0;
+
 	spin_lock_irq(&lo->lo_lock);
 	if (lo->lo_state != Lo_bound)
 		goto out;
@@ -542,6 +972,9 @@ out:
 
 struct switch_request {
 	struct file *file;
+	bool set_remap;			/* switch direct I/O to remap */
+	struct loop_remap *remap;
+	int error;
 	struct completion wait;
 };
 
@@ -552,7 +985,7 @@ static inline void loop_handle_bio(struct loop_device *lo, struct bio *bio)
 	if (unlikely(!bio->bi_bdev)) {
 		do_loop_switch(lo, bio->bi_private);
 		bio_put(bio);
-	} else {
+	} else if (!loop_remap_bio(lo, bio)) {
 		int ret = do_bio_filebacked(lo, bio);
 		bio_endio(bio, ret);
 	}
@@ -601,18 +1034,61 @@ static int loop_thread(void *data)
  * First it needs to flush existing IO, it does this by sending a magic
  * BIO down the pipe. The completion of this BIO does the actual switch.
  */
-static int loop_switch(struct loop_device *lo, struct file *file)
+static int loop_switch_request(struct loop_device *lo,
+			       struct switch_request *w)
 {
-	struct switch_request w;
 	struct bio *bio = bio_alloc(GFP_KERNEL, 0);
 	if (!bio)
 		return -ENOMEM;
-	init_completion(&w.wait);
-	w.file = file;
-	bio->bi_private = &w;
+	init_completion(&w->wait);
+	bio->bi_private = w;
 	bio->bi_bdev = NULL;
 	loop_make_request(lo->lo_queue, bio);
-	wait_for_completion(&w.wait);
+	wait_for_completion(&w->wait);
+	return 0;
+}
+
+static int loop_switch(struct loop_device *lo, struct file *file)
+{
+	struct switch_request w = { .file = file };
+
+	return loop_switch_request(lo, &w);
+}
+
+/*
+ * Turns direct I/O on or off, with lo_ctl_mutex held.  It stays off if
+ * the backing file cannot be remapped.
+ */
+static int loop_set_direct_io(struct loop_device *lo, unsigned long on)
+{
+	struct switch_request w = { .set_remap = true };
+	struct loop_remap *map = NULL;
+	int err;
+
+	if (lo->lo_state != Lo_bound)
+		return -ENXIO;
+	if (!on == !lo->lo_remap)
+		return 0;
+
+	if (on) {
+		map = loop_remap_build(lo);
+		if (IS_ERR(map))
+			return PTR_ERR(map);
+	}
+
+	w.remap = map;
+	err = loop_switch_request(lo, &w);
+	if (!err)
+		err = w.error;
+	if (err) {
+		if (map)
+			loop_remap_free(map);
+		return err;
+	}
+
+	/* the map switched from */
+	if (w.remap)
+		loop_remap_free(w.remap);
 	return 0;
 }
 
@@ -637,6 +1113,17 @@ static void do_loop_switch(struct loop_device *lo, struct switch_request *p)
 	struct file *old_file = lo->lo_backing_file;
 	struct address_space *mapping;
 
+	if (p->set_remap) {
+		/* the buffered writes before go to disk first */
+		if (p->remap)
+			p->error = vfs_fsync(old_file, 0);
+		if (p->error && p->error != -EINVAL)
+			goto out;
+		p->error = 0;
+		p->remap = loop_remap_switch(lo, p->remap);
+		goto out;
+	}
+
 	/* if no new file, only flush of queued bios requested */
 	if (!file)
 		goto out;
@@ -666,6 +1153,7 @@ static int loop_change_fd(struct loop_device *lo, struct block_device *bdev,
 {
 	struct file	*file, *old_file;
 	struct inode	*inode;
+	bool		dio;
 	int		error;
 
 	error = -ENXIO;
@@ -694,10 +1182,16 @@ static int loop_change_fd(struct loop_device *lo, struct block_device *bdev,
 	if (get_loop_size(lo, file) != get_loop_size(lo, old_file))
 		goto out_putf;
 
-	/* and ... switch */
+	/* and ... switch, the blocks of the old file are no use */
+	dio = lo->lo_remap != NULL;
+	error = loop_set_direct_io(lo, 0);
+	if (error)
+		goto out_putf;
 	error = loop_switch(lo, file);
 	if (error)
 		goto out_putf;
+	if (dio)
+		loop_set_direct_io(lo, 1);
 
 	fput(old_file);
 	if (max_part > 0)
@@ -784,16 +1278,25 @@ static ssize_t loop_attr_autoclear_show(struct loop_device *lo, char *buf)
 	return sprintf(buf, "%s\n", autoclear ? "1" : "0");
 }
 
+static ssize_t loop_attr_dio_show(struct loop_device *lo, char *buf)
+{
+	int dio = (lo->lo_flags & LO_FLAGS_DIRECT_IO);
+
+	return sprintf(buf, "%s\n", dio ? "1" : "0");
+}
+
 LOOP_ATTR_RO(backing_file);
 LOOP_ATTR_RO(offset);
 LOOP_ATTR_RO(sizelimit);
 LOOP_ATTR_RO(autoclear);
+LOOP_ATTR_RO(dio);
 
 static struct attribute *loop_attrs[] = {
 	&loop_attr_backing_file.attr,
 	&loop_attr_offset.attr,
 	&loop_attr_sizelimit.attr,
 	&loop_attr_autoclear.attr,
+	&loop_attr_dio.attr,
 	NULL,
 };
 
@@ -926,6 +1429,8 @@ static int loop_set_fd(struct loop_device *lo, fmode_t mode,
 	}
 	lo->lo_state = Lo_bound;
 	wake_up_process(lo->lo_thread);
+	if (direct_io)
+		loop_set_direct_io(lo, 1);
 	if (max_part > 0)
 		ioctl_by_bdev(bdev, BLKRRPART, 0);
 	return 0;
@@ -1007,6 +1512,10 @@ static int loop_clr_fd(struct loop_device *lo, struct block_device *bdev)
 
 	kthread_stop(lo->lo_thread);
 
+	/* nothing is remapped in the rundown, wait for what was */
+	if (lo->lo_remap)
+		loop_remap_free(loop_remap_switch(lo, NULL));
+
 	spin_lock_irq(&lo->lo_lock);
 	lo->lo_backing_file = NULL;
 	spin_unlock_irq(&lo->lo_lock);
@@ -1056,6 +1565,7 @@ loop_set_status(struct loop_device *lo, const struct loop_info64 *info)
 	int err;
 	struct loop_func_table *xfer;
 	uid_t uid = current_uid();
+	bool dio = false;
 
 	if (lo->lo_encrypt_key_size &&
 	    lo->lo_key_owner != uid &&
@@ -1066,6 +1576,16 @@ loop_set_status(struct loop_device *lo, const struct loop_info64 *info)
 	if ((unsigned int) info->lo_encrypt_key_size > LO_KEY_SIZE)
 		return -EINVAL;
 
+	/* the remapping is for the old offset and size, without encryption */
+	if (lo->lo_remap && (info->lo_encrypt_type ||
+			     lo->lo_offset != info->lo_offset ||
+			     lo->lo_sizelimit != info->lo_sizelimit)) {
+		err = loop_set_direct_io(lo, 0);
+		if (err)
+			return err;
+		dio = true;
+	}
+
 	err = loop_release_xfer(lo);
 	if (err)
 		return err;
@@ -1116,6 +1636,9 @@ loop_set_status(struct loop_device *lo, const struct loop_info64 *info)
 		lo->lo_key_owner = uid;
 	}	
 
+	if (dio)
+		loop_set_direct_io(lo, 1);
+
 	return 0;
 }
 
@@ -1263,11 +1786,18 @@ static int loop_set_capacity(struct loop_device *lo, struct block_device *bdev)
 	int err;
 	sector_t sec;
 	loff_t sz;
+	bool dio;
 
 	err = -ENXIO;
 	if (unlikely(lo->lo_state != Lo_bound))
 		goto out;
+	dio = lo->lo_remap != NULL;
+	err = loop_set_direct_io(lo, 0);
+	if (unlikely(err))
+		goto out;
 	err = figure_loop_size(lo);
+	if (dio)
+		loop_set_direct_io(lo, 1);
 	if (unlikely(err))
 		goto out;
 	sec = get_capacity(lo->lo_disk);
@@ -1321,6 +1851,11 @@ static int lo_ioctl(struct block_device *bdev, fmode_t mode,
 		if ((mode & FMODE_WRITE) || capable(CAP_SYS_ADMIN))
 			err = loop_set_capacity(lo, bdev);
 		break;
+	case LOOP_SET_DIRECT_IO:
+		err = -EPERM;
+		if ((mode & FMODE_WRITE) || capable(CAP_SYS_ADMIN))
+			err = loop_set_direct_io(lo, arg);
+		break;
 	default:
 		err = lo->ioctl ? lo->ioctl(lo, cmd, arg) : -EINVAL;
 	}
@@ -1475,6 +2010,7 @@ static int lo_compat_ioctl(struct block_device *bdev, fmode_t mode,
 		arg = (unsigned long) compat_ptr(arg);
 	case LOOP_SET_FD:
 	case LOOP_CHANGE_FD:
+	case LOOP_SET_DIRECT_IO:
 		err = lo_ioctl(bdev, mode, cmd, arg);
 		break;
 	default:
@@ -1607,6 +2143,9 @@ static struct loop_device *loop_alloc(int i)
 	lo->lo_thread		= NULL;
 	init_waitqueue_head(&lo->lo_event);
 	spin_lock_init(&lo->lo_lock);
+	init_rwsem(&lo->lo_remap_sem);
+	atomic_set(&lo->lo_remap_inflight, 0);
+	init_waitqueue_head(&lo->lo_remap_wait);
 	disk->major		= LOOP_MAJOR;
 	disk->first_minor	= i << part_shift;
 	disk->fops		= &lo_fops;
@@ -0,0 +1,516 @@
+/*
+ * Null block device driver.
+ *
+ * A block device with nothing behind it: reads return whatever is in the
+ * buffer and writes are dropped.  All the time a request takes is spent
+ * in the block layer and in the completion path chosen, which makes the
+ * device the harness to measure block layer overhead with: elevators,
+ * plugging, queue_lock contention and blk-softirq completions.
+ *
+ * queue_mode	0: bio based, bios are handled by ->make_request_fn and
+ *		never see an elevator
+ *		1: request based, through the elevator and ->request_fn
+ * irqmode	0: complete in the context that submitted, as if there were
+ *		no interrupt
+ *		1: raise a simulated interrupt at once, which for requests
+ *		completes them through blk_complete_request() and the
+ *		block softirq
+ *		2: as 1, but completion_nsec after submission, from a
+ *		hrtimer on the submitting cpu
+ * irq_cpu	-1: the interrupt is taken on the submitting cpu, as with a
+ *		queue per cpu; otherwise the cpu all interrupts go to, as
+ *		with a single interrupt line
+ *
+ * At most hw_queue_depth commands are in flight on a device.  Request
+ * based queues are stopped when all are busy, bio based submitters wait.
+ *
+ *   modprobe null_blk queue_mode=1 irqmode=2 completion_nsec=50000
+ *
+ * See Documentation/block/null_blk.txt
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/blkdev.h>
+#include <linux/bio.h>
+#include <linux/genhd.h>
+#include <linux/fs.h>
+#include <linux/list.h>
+#include <linux/log2.h>
+#include <linux/slab.h>
+#include <linux/smp.h>
+#include <linux/percpu.h>
+#include <linux/hrtimer.h>
+#include <linux/wait.h>
+
+enum {
+	NULL_Q_BIO	= 0,
+	NULL_Q_RQ	= 1,
+};
+
+enum {
+	NULL_IRQ_NONE		= 0,
+	NULL_IRQ_SOFTIRQ	= 1,
+	NULL_IRQ_TIMER		= 2,
+};
+
+struct nullb;
+
+struct nullb_cmd {
+	struct list_head	list;
+	struct nullb		*nullb;
+	struct request		*rq;
+	struct bio		*bio;
+	unsigned int		tag;
+	ktime_t			expires;	/* irqmode 2 */
+};
+
+struct nullb {
+	struct list_head	list;
+	unsigned int		index;
+	struct request_queue	*q;
+	struct gendisk		*disk;
+	spinlock_t		lock;
+
+	struct nullb_cmd	*cmds;
+	unsigned long		*tag_map;
+	wait_queue_head_t	wait;		/* bio mode, for a free tag */
+};
+
+/*
+ * Per cpu: the commands waiting for their timer, and the commands whose
+ * interrupt another cpu raised on this one.
+ */
+struct nullb_cpu {
+	struct hrtimer		timer;
+	struct list_head	timer_list;
+
+	spinlock_t		irq_lock;
+	struct list_head	irq_list;
+	struct call_single_data	csd;
+};
+
+static DEFINE_PER_CPU(struct nullb_cpu, nullb_cpus);
+static LIST_HEAD(nullb_list);
+static int null_major;
+
+static unsigned int nr_devices = 1;
+module_param(nr_devices, uint, S_IRUGO);
+MODULE_PARM_DESC(nr_devices, "Number of devices to register (default: 1)");
+
+static unsigned int gb = 250;
+module_param(gb, uint, S_IRUGO);
+MODULE_PARM_DESC(gb, "Size of each device in GB (default: 250)");
+
+static unsigned int bs = 512;
+module_param(bs, uint, S_IRUGO);
+MODULE_PARM_DESC(bs, "Logical block size in bytes (default: 512)");
+
+static unsigned int stage_batch;
+module_param(stage_batch, uint, S_IRUGO);
+MODULE_PARM_DESC(stage_batch,
+		 "Requests staged per cpu, 0 for none (default: 0)");
+
+static unsigned int queue_mode = NULL_Q_RQ;
+module_param(queue_mode, uint, S_IRUGO);
+MODULE_PARM_DESC(queue_mode, "0: bio based, 1: request based (default: 1)");
+
+static unsigned int irqmode = NULL_IRQ_SOFTIRQ;
+module_param(irqmode, uint, S_IRUGO);
+MODULE_PARM_DESC(irqmode,
+		 "Completion: 0 inline, 1 softirq, 2 timer (default: 1)");
+
+static unsigned long completion_nsec = 10000;
+module_param(completion_nsec, ulong, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(completion_nsec,
+		 "Time a command takes with irqmode=2, in ns (default: 10000)");
+
+static unsigned int hw_queue_depth = 64;
+module_param(hw_queue_depth, uint, S_IRUGO);
+MODULE_PARM_DESC(hw_queue_depth, "Commands in flight per device (default: 64)");
+
+static int irq_cpu = -1;
+module_param(irq_cpu, int, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(irq_cpu,
+		 "Cpu taking all interrupts, -1 for the submitter (default: -1)");
+
+static struct nullb_cmd *null_get_cmd(struct nullb *nullb)
+{
+	unsigned int tag;
+
+	do {
+		tag = find_first_zero_bit(nullb->tag_map, hw_queue_depth);
+		if (tag >= hw_queue_depth)
+			return NULL;
+	} while (test_and_set_bit_lock(tag, nullb->tag_map));
+
+	return &nullb->cmds[tag];
+}
+
+static void null_put_cmd(struct nullb_cmd *cmd)
+{
+	struct nullb *nullb = cmd->nullb;
+
+	clear_bit_unlock(cmd->tag, nullb->tag_map);
+	if (queue_mode == NULL_Q_BIO) {
+		/* pairs with the barrier in prepare_to_wait() */
+		smp_mb__after_clear_bit();
+		if (waitqueue_active(&nullb->wait))
+			wake_up(&nullb->wait);
+	}
+}
+
+/*
+ * The interrupt of a command.  Requests go on through the block softirq
+ * to null_softirq_done_fn().
+ */
+static void null_irq_cmd(struct nullb_cmd *cmd)
+{
+	if (queue_mode == NULL_Q_RQ) {
+		blk_complete_request(cmd->rq);
+	} else {
+		bio_endio(cmd->bio, 0);
+		null_put_cmd(cmd);
+	}
+}
+
+static void null_softirq_done_fn(struct request *rq)
+{
+	struct nullb_cmd *cmd = rq->special;
+	struct request_queue *q = rq->q;
+	unsigned long flags;
+
+	spin_lock_irqsave(q->queue_lock, flags);
+	__blk_end_request_all(rq, 0);
+	null_put_cmd(cmd);
+	/* null_request_fn() stops the queue, under this lock, when full */
+	if (blk_queue_stopped(q))
+		blk_start_queue(q);
+	spin_unlock_irqrestore(q->queue_lock, flags);
+}
+
+static void null_ipi(void *data)
+{
+	struct nullb_cpu *nc = data;
+	struct nullb_cmd *cmd;
+	LIST_HEAD(list);
+
+	spin_lock(&nc->irq_lock);
+	list_splice_init(&nc->irq_list, &list);
+	spin_unlock(&nc->irq_lock);
+
+	while (!list_empty(&list)) {
+		cmd = list_first_entry(&list, struct nullb_cmd, list);
+		list_del(&cmd->list);
+		null_irq_cmd(cmd);
+	}
+}
+
+/*
+ * Raise the interrupt of a command, on irq_cpu if that is set.  The
+ * commands sent to another cpu share an IPI while it is pending.
+ */
+static void null_raise_irq(struct nullb_cmd *cmd)
+{
+	unsigned long flags;
+	int target = ACCESS_ONCE(irq_cpu);
+	int cpu;
+
+	local_irq_save(flags);
+	cpu = smp_processor_id();
+#if defined(CONFIG_SMP) && defined(CONFIG_USE_GENERIC_SMP_HELPERS)
+	if (target >= 0 && target != cpu && target < nr_cpu_ids &&
+	    cpu_online(target)) {
+		struct nullb_cpu *nc = &per_cpu(nullb_cpus, target);
+		bool kick;
+
+		spin_lock(&nc->irq_lock);
+		kick = list_empty(&nc->irq_list);
+		list_add_tail(&cmd->list, &nc->irq_list);
+		spin_unlock(&nc->irq_lock);
+		if (kick)
+			__smp_call_function_single(target, &nc->csd, 0);
+		local_irq_restore(flags);
+		return;
+	}
+#endif
+	null_irq_cmd(cmd);
+	local_irq_restore(flags);
+}
+
+static enum hrtimer_restart null_timer_fn(struct hrtimer *timer)
+{
+	struct nullb_cpu *nc = container_of(timer, struct nullb_cpu, timer);
+	struct nullb_cmd *cmd;
+	ktime_t now = ktime_get();
+
+	while (!list_empty(&nc->timer_list)) {
+		cmd = list_first_entry(&nc->timer_list, struct nullb_cmd, list);
+		if (ktime_to_ns(ktime_sub(cmd->expires, now)) > 0) {
+			hrtimer_set_expires(timer, cmd->expires);
+			return HRTIMER_RESTART;
+		}
+		list_del(&cmd->list);
+		null_raise_irq(cmd);
+	}
+
+	return HRTIMER_NORESTART;
+}
+
+/*
+ * completion_nsec is the same for all the commands of a cpu, so its list
+ * is in order of expiry and the timer is only armed for the head.
+ */
+static void null_cmd_start_timer(struct nullb_cmd *cmd)
+{
+	struct nullb_cpu *nc;
+	unsigned long flags;
+
+	cmd->expires = ktime_add_ns(ktime_get(), completion_nsec);
+
+	local_irq_save(flags);
+	nc = &__get_cpu_var(nullb_cpus);
+	list_add_tail(&cmd->list, &nc->timer_list);
+	/* a running null_timer_fn() sees the new entry */
+	if (!hrtimer_active(&nc->timer))
+		hrtimer_start(&nc->timer, cmd->expires,
+			      HRTIMER_MODE_ABS_PINNED);
+	local_irq_restore(flags);
+}
+
+static void null_handle_cmd(struct nullb_cmd *cmd)
+{
+	switch (irqmode) {
+	case NULL_IRQ_SOFTIRQ:
+		null_raise_irq(cmd);
+		break;
+	case NULL_IRQ_TIMER:
+		null_cmd_start_timer(cmd);
+		break;
+	default:
+		/* requests without an interrupt end in null_request_fn() */
+		bio_endio(cmd->bio, 0);
+		null_put_cmd(cmd);
+		break;
+	}
+}
+
+static int null_make_request(struct request_queue *q, struct bio *bio)
+{
+	struct nullb *nullb = q->queuedata;
+	struct nullb_cmd *cmd;
+
+	wait_event(nullb->wait, (cmd = null_get_cmd(nullb)) != NULL);
+	cmd->bio = bio;
+	null_handle_cmd(cmd);
+	return 0;
+}
+
+static void null_request_fn(struct request_queue *q)
+{
+	struct nullb *nullb = q->queuedata;
+	struct nullb_cmd *cmd;
+	struct request *rq;
+
+	while ((rq = blk_peek_request(q)) != NULL) {
+		if (irqmode == NULL_IRQ_NONE) {
+			blk_start_request(rq);
+			__blk_end_request_all(rq, 0);
+			continue;
+		}
+
+		cmd = null_get_cmd(nullb);
+		if (!cmd) {
+			/* restarted by null_softirq_done_fn() */
+			blk_stop_queue(q);
+			break;
+		}
+		blk_start_request(rq);
+		cmd->rq = rq;
+		rq->special = cmd;
+		null_handle_cmd(cmd);
+	}
+}
+
+static int null_open(struct block_device *bdev, fmode_t mode)
+{
+	return 0;
+}
+
+static int null_release(struct gendisk *disk, fmode_t mode)
+{
+	return 0;
+}
+
+static const struct block_device_operations null_fops = {
+	.owner		= THIS_MODULE,
+	.open		= null_open,
+	.release	= null_release,
+};
+
+static void null_free_dev(struct nullb *nullb)
+{
+	kfree(nullb->tag_map);
+	kfree(nullb->cmds);
+	kfree(nullb);
+}
+
+static void null_del_dev(struct nullb *nullb)
+{
+	list_del(&nullb->list);
+	del_gendisk(nullb->disk);
+	put_disk(nullb->disk);
+	blk_cleanup_queue(nullb->q);
+	null_free_dev(nullb);
+}
+
+static int null_add_dev(unsigned int index)
+{
+	struct gendisk *disk;
+	struct nullb *nullb;
+	unsigned int i;
+	int ret = -ENOMEM;
+
+	nullb = kzalloc(sizeof(*nullb), GFP_KERNEL);
+	if (!nullb)
+		return -ENOMEM;
+	nullb->index = index;
+	spin_lock_init(&nullb->lock);
+	init_waitqueue_head(&nullb->wait);
+
+	nullb->cmds = kcalloc(hw_queue_depth, sizeof(*nullb->cmds), GFP_KERNEL);
+	nullb->tag_map = kcalloc(BITS_TO_LONGS(hw_queue_depth),
+				 sizeof(unsigned long), GFP_KERNEL);
+	if (!nullb->cmds || !nullb->tag_map)
+		goto out_free;
+	for (i = 0; i < hw_queue_depth; i++) {
+		nullb->cmds[i].nullb = nullb;
+		nullb->cmds[i].tag = i;
+	}
+
+	if (queue_mode == NULL_Q_BIO) {
+		nullb->q = blk_alloc_queue(GFP_KERNEL);
+		if (!nullb->q)
+			goto out_free;
+		blk_queue_make_request(nullb->q, null_make_request);
+	} else {
+		nullb->q = blk_init_queue(null_request_fn, &nullb->lock);
+		if (!nullb->q)
+			goto out_free;
+		blk_queue_softirq_done(nullb->q, null_softirq_done_fn);
+		if (stage_batch) {
+			ret = blk_queue_stage(nullb->q, stage_batch);
+			if (ret)
+				goto out_cleanup;
+			ret = -ENOMEM;
+		}
+	}
+
+	nullb->q->queuedata = nullb;
+	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, nullb->q);
+	blk_queue_logical_block_size(nullb->q, bs);
+	blk_queue_physical_block_size(nullb->q, bs);
+
+	disk = nullb->disk = alloc_disk(1);
+	if (!disk)
+		goto out_cleanup;
+
+	disk->major		= null_major;
+	disk->first_minor	= index;
+	disk->fops		= &null_fops;
+	disk->private_data	= nullb;
+	disk->queue		= nullb->q;
+	disk->flags |= GENHD_FL_SUPPRESS_PARTITION_INFO;
+	sprintf(disk->disk_name, "nullb%u", index);
+	set_capacity(disk, (sector_t)gb << (30 - 9));
+
+	list_add_tail(&nullb->list, &nullb_list);
+	add_disk(disk);
+	return 0;
+
+out_cleanup:
+	blk_cleanup_queue(nullb->q);
+out_free:
+	null_free_dev(nullb);
+	return ret;
+}
+
+static void null_exit_cpus(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		hrtimer_cancel(&per_cpu(nullb_cpus, cpu).timer);
+	/* for IPIs still in null_ipi() */
+	synchronize_sched();
+}
+
+static int __init null_init(void)
+{
+	unsigned int i;
+	int cpu, ret;
+
+	if (bs < 512 || bs > PAGE_SIZE || !is_power_of_2(bs)) {
+		pr_warning("null_blk: invalid block size %u\n", bs);
+		return -EINVAL;
+	}
+	if (queue_mode > NULL_Q_RQ || irqmode > NULL_IRQ_TIMER) {
+		pr_warning("null_blk: invalid queue_mode or irqmode\n");
+		return -EINVAL;
+	}
+	hw_queue_depth = clamp(hw_queue_depth, 1U, 4096U);
+
+	for_each_possible_cpu(cpu) {
+		struct nullb_cpu *nc = &per_cpu(nullb_cpus, cpu);
+
+		hrtimer_init(&nc->timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+		nc->timer.function = null_timer_fn;
+		INIT_LIST_HEAD(&nc->timer_list);
+		spin_lock_init(&nc->irq_lock);
+		INIT_LIST_HEAD(&nc->irq_list);
+		nc->csd.func = null_ipi;
+		nc->csd.info = nc;
+		nc->csd.flags = 0;
+	}
+
+	null_major = register_blkdev(0, "nullb");
+	if (null_major < 0)
+		return null_major;
+
+	for (i = 0; i < nr_devices; i++) {
+		ret = null_add_dev(i);
+		if (ret)
+			goto out;
+	}
+
+	pr_info("null_blk: %u devices of %u GB, %s based\n", nr_devices, gb,
+		queue_mode == NULL_Q_BIO ? "bio" : "request");
+	return 0;
+
+out:
+	while (!list_empty(&nullb_list))
+		null_del_dev(list_entry(nullb_list.next, struct nullb, list));
+	unregister_blkdev(null_major, "nullb");
+	null_exit_cpus();
+	return ret;
+}
+
+static void __exit null_exit(void)
+{
+	while (!list_empty(&nullb_list))
+		null_del_dev(list_entry(nullb_list.next, struct nullb, list));
+	unregister_blkdev(null_major, "nullb");
+	null_exit_cpus();
+}
+
+module_init(null_init);
+module_exit(null_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Null block device driver");
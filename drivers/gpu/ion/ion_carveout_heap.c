@@ -15,8 +15,10 @@
  */
 #include <linux/spinlock.h>
 
+#include <linux/cma.h>
 #include <linux/err.h>
 #include <linux/genalloc.h>
+#include <linux/highmem.h>
 #include <linux/io.h>
 #include <linux/ion.h>
 #include <linux/mm.h>
@@ -25,21 +27,71 @@
 #include <linux/vmalloc.h>
 #include "ion_priv.h"
 
+#include <asm/cacheflush.h>
 #include <asm/mach/map.h>
 
 struct ion_carveout_heap {
 	struct ion_heap heap;
 	struct gen_pool *pool;
 	ion_phys_addr_t base;
+	/* contiguous memory area backing most of the carveout, if any */
+	struct cma *cma;
+	ion_phys_addr_t cma_base;
+	unsigned long cma_size;
 };
 
+static bool ion_carveout_in_cma(struct ion_carveout_heap *carveout_heap,
+				ion_phys_addr_t addr)
+{
+	return carveout_heap->cma && addr >= carveout_heap->cma_base &&
+	       addr - carveout_heap->cma_base < carveout_heap->cma_size;
+}
+
+/*
+ * Pages from the contiguous memory area held page cache or another
+ * process' memory until now.  Clear them and push them out of the caches,
+ * the buffer is only ever mapped uncached, the linear mapping included.
+ */
+static void ion_carveout_clear_pages(struct page *page, unsigned long nr)
+{
+	ion_phys_addr_t phys = page_to_phys(page);
+	unsigned long i;
+
+	for (i = 0; i < nr; i++) {
+		void *addr = kmap_atomic(nth_page(page, i), KM_USER0);
+
+		memset(addr, 0, PAGE_SIZE);
+		dmac_flush_range(addr, addr + PAGE_SIZE);
+		kunmap_atomic(addr, KM_USER0);
+		cond_resched();
+	}
+	outer_flush_range(phys, phys + (nr << PAGE_SHIFT));
+}
+
 ion_phys_addr_t ion_carveout_allocate(struct ion_heap *heap,
 				      unsigned long size,
 				      unsigned long align)
 {
 	struct ion_carveout_heap *carveout_heap =
 		container_of(heap, struct ion_carveout_heap, heap);
-	unsigned long offset = gen_pool_alloc(carveout_heap->pool, size);
+	unsigned long offset;
+
+	if (carveout_heap->cma) {
+		unsigned long nr = PAGE_ALIGN(size) >> PAGE_SHIFT;
+		struct page *page;
+
+		page = cma_alloc(carveout_heap->cma, nr,
+				 align > PAGE_SIZE ? get_order(align) : 0);
+		if (page) {
+			ion_carveout_clear_pages(page, nr);
+			if (!arm_cma_set_cacheable(page, nr, false))
+				return page_to_phys(page);
+			/* a cacheable alias would remain */
+			cma_release(carveout_heap->cma, page, nr);
+		}
+	}
+
+	offset = gen_pool_alloc(carveout_heap->pool, size);
 
 	if (!offset)
 		return ION_CARVEOUT_ALLOCATE_FAIL;
@@ -55,6 +107,14 @@ void ion_carveout_free(struct ion_heap *heap, ion_phys_addr_t addr,
 
 	if (addr == ION_CARVEOUT_ALLOCATE_FAIL)
 		return;
+	if (ion_carveout_in_cma(carveout_heap, addr)) {
+		struct page *page = pfn_to_page(__phys_to_pfn(addr));
+		unsigned long nr = PAGE_ALIGN(size) >> PAGE_SHIFT;
+
+		arm_cma_set_cacheable(page, nr, true);
+		cma_release(carveout_heap->cma, page, nr);
+		return;
+	}
 	gen_pool_free(carveout_heap->pool, addr, size);
 }
 
@@ -99,14 +159,44 @@ void ion_carveout_heap_unmap_dma(struct ion_heap *heap,
 void *ion_carveout_heap_map_kernel(struct ion_heap *heap,
 				   struct ion_buffer *buffer)
 {
-	return __arch_ioremap(buffer->priv_phys, buffer->size,
-			      MT_MEMORY_NONCACHED);
+	struct ion_carveout_heap *carveout_heap =
+		container_of(heap, struct ion_carveout_heap, heap);
+	struct vm_struct *area;
+	struct page *page;
+	unsigned long addr;
+
+	if (!ion_carveout_in_cma(carveout_heap, buffer->priv_phys))
+		return __arch_ioremap(buffer->priv_phys, buffer->size,
+				      MT_MEMORY_NONCACHED);
+
+	/* lowmem pages are write-combined in the linear mapping already */
+	page = pfn_to_page(__phys_to_pfn(buffer->priv_phys));
+	if (!PageHighMem(page))
+		return page_address(page);
+
+	/* ioremap refuses RAM, map the pages uncached by hand */
+	area = get_vm_area(buffer->size, VM_IOREMAP);
+	if (!area)
+		return NULL;
+	addr = (unsigned long)area->addr;
+	if (ioremap_page_range(addr, addr + buffer->size, buffer->priv_phys,
+			       pgprot_writecombine(PAGE_KERNEL))) {
+		free_vm_area(area);
+		return NULL;
+	}
+	return area->addr;
 }
 
 void ion_carveout_heap_unmap_kernel(struct ion_heap *heap,
 				    struct ion_buffer *buffer)
 {
-	__arch_iounmap(buffer->vaddr);
+	struct ion_carveout_heap *carveout_heap =
+		container_of(heap, struct ion_carveout_heap, heap);
+
+	if (!ion_carveout_in_cma(carveout_heap, buffer->priv_phys))
+		__arch_iounmap(buffer->vaddr);
+	else if (is_vmalloc_addr(buffer->vaddr))
+		vunmap(buffer->vaddr);
 	buffer->vaddr = NULL;
 	return;
 }
@@ -114,10 +204,24 @@ void ion_carveout_heap_unmap_kernel(struct ion_heap *heap,
 int ion_carveout_heap_map_user(struct ion_heap *heap, struct ion_buffer *buffer,
 			       struct vm_area_struct *vma)
 {
+	struct ion_carveout_heap *carveout_heap =
+		container_of(heap, struct ion_carveout_heap, heap);
+	pgprot_t prot = pgprot_noncached(vma->vm_page_prot);
+
+	/* the same memory type as the kernel's mapping of the pages */
+	if (ion_carveout_in_cma(carveout_heap, buffer->priv_phys))
+		prot = pgprot_writecombine(vma->vm_page_prot);
+
 	return remap_pfn_range(vma, vma->vm_start,
 			       __phys_to_pfn(buffer->priv_phys) + vma->vm_pgoff,
-			       buffer->size,
-			       pgprot_noncached(vma->vm_page_prot));
+			       buffer->size, prot);
+}
+
+static void ion_carveout_add(struct ion_carveout_heap *carveout_heap,
+			     ion_phys_addr_t start, ion_phys_addr_t end)
+{
+	if (end > start)
+		gen_pool_add(carveout_heap->pool, start, end - start, -1);
 }
 
 static struct ion_heap_ops carveout_heap_ops = {
@@ -143,8 +247,23 @@ struct ion_heap *ion_carveout_heap_create(struct ion_platform_heap *heap_data)
 		return ERR_PTR(-ENOMEM);
 	}
 	carveout_heap->base = heap_data->base;
-	gen_pool_add(carveout_heap->pool, carveout_heap->base, heap_data->size,
-		     -1);
+	carveout_heap->cma = heap_data->priv;
+	if (carveout_heap->cma) {
+		ion_phys_addr_t end = heap_data->base + heap_data->size;
+
+		carveout_heap->cma_base = cma_get_base(carveout_heap->cma);
+		carveout_heap->cma_size = cma_get_size(carveout_heap->cma);
+		/* the pool gets what the area does not cover */
+		ion_carveout_add(carveout_heap, carveout_heap->base,
+				 min(end, carveout_heap->cma_base));
+		ion_carveout_add(carveout_heap,
+				 max(carveout_heap->base, carveout_heap->cma_base +
+						       carveout_heap->cma_size),
+				 end);
+	} else {
+		ion_carveout_add(carveout_heap, carveout_heap->base,
+				 carveout_heap->base + heap_data->size);
+	}
 	carveout_heap->heap.ops = &carveout_heap_ops;
 	carveout_heap->heap.type = ION_HEAP_TYPE_CARVEOUT;
 
@@ -9,6 +9,7 @@
 #include <linux/completion.h>
 #include <linux/err.h>
 #include <linux/module.h>
+#include <linux/moduleparam.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
 #include <linux/bio.h>
@@ -19,6 +20,9 @@
 #include <linux/workqueue.h>
 #include <linux/backing-dev.h>
 #include <linux/percpu.h>
+#include <linux/hardirq.h>
+#include <linux/spinlock.h>
+#include <linux/list.h>
 #include <asm/atomic.h>
 #include <linux/scatterlist.h>
 #include <asm/page.h>
@@ -54,6 +58,7 @@ struct dm_crypt_io {
 	struct dm_target *target;
 	struct bio *base_bio;
 	struct work_struct work;
+	struct list_head list;
 
 	struct convert_context ctx;
 
@@ -103,7 +108,7 @@ struct iv_lmk_private {
  * Crypt: maps a linear range of a block device
  * and encrypts / decrypts at the same time.
  */
-enum flags { DM_CRYPT_SUSPENDED, DM_CRYPT_KEY_VALID };
+enum flags { DM_CRYPT_SUSPENDED, DM_CRYPT_KEY_VALID, DM_CRYPT_INLINE_READ };
 
 /*
  * Duplicated per-CPU state for cipher.
@@ -112,6 +117,15 @@ struct crypt_cpu {
 	struct ablkcipher_request *req;
 	/* ESSIV: struct crypto_cipher *essiv_tfm */
 	void *iv_private;
+
+	/* ios waiting for kcryptd on this CPU */
+	spinlock_t lock;
+	struct list_head reads;
+	struct list_head writes;
+	unsigned int reads_in_row;	/* taken while writes waited */
+	struct work_struct work;
+	struct crypt_config *cc;
+
 	struct crypto_ablkcipher *tfms[0];
 };
 
@@ -178,11 +192,19 @@ struct crypt_config {
 #define MIN_IOS        16
 #define MIN_POOL_PAGES 32
 #define MIN_BIO_PAGES  8
+#define KCRYPTD_BATCH  16
+#define INLINE_READ_MAX_KB 16
+
+static unsigned int inline_read_kb = 4;
+module_param(inline_read_kb, uint, 0644);
+MODULE_PARM_DESC(inline_read_kb, "Decrypt reads up to this size as they "
+		 "complete instead of in kcryptd, at most 16, 0 to turn off");
 
 static struct kmem_cache *_crypt_io_pool;
 
 static void clone_init(struct dm_crypt_io *, struct bio *);
 static void kcryptd_queue_crypt(struct dm_crypt_io *io);
+static bool kcryptd_crypt_read_inline(struct dm_crypt_io *io);
 static u8 *iv_of_dmreq(struct crypt_config *cc, struct dm_crypt_request *dmreq);
 
 static struct crypt_cpu *this_crypt_config(struct crypt_config *cc)
@@ -970,7 +992,8 @@ static void crypt_endio(struct bio *clone, int error)
 	bio_put(clone);
 
 	if (rw == READ && !error) {
-		kcryptd_queue_crypt(io);
+		if (!kcryptd_crypt_read_inline(io))
+			kcryptd_queue_crypt(io);
 		return;
 	}
 
@@ -1189,6 +1212,50 @@ static void kcryptd_crypt_read_convert(struct dm_crypt_io *io)
 	crypt_dec_pending(io);
 }
 
+/*
+ * With a synchronous cipher a small read is decrypted where its clone
+ * completes, which saves the trip through kcryptd and back.  Nothing here
+ * may sleep, so the read gets a request of its own instead of the per cpu
+ * one kcryptd may be in the middle of using.  The tfms of any cpu will do
+ * then, so preemption stays on.  Completions in hard irq context or with
+ * interrupts off are still left to kcryptd, and so are reads larger than
+ * INLINE_READ_MAX_KB, which would hold up the softirq for too long.
+ */
+static bool kcryptd_crypt_read_inline(struct dm_crypt_io *io)
+{
+	struct crypt_config *cc = io->target->private;
+	struct convert_context *ctx = &io->ctx;
+	struct ablkcipher_request *req;
+	struct crypt_cpu *cpu_cc;
+	unsigned key_index;
+	int r = 0;
+
+	if (!test_bit(DM_CRYPT_INLINE_READ, &cc->flags) ||
+	    io->base_bio->bi_size > (min_t(unsigned int, INLINE_READ_MAX_KB,
+					ACCESS_ONCE(inline_read_kb)) << 10) ||
+	    in_irq() || irqs_disabled())
+		return false;
+
+	req = mempool_alloc(cc->req_pool, GFP_ATOMIC);
+	if (!req)
+		return false;
+
+	crypt_convert_init(cc, ctx, io->base_bio, io->base_bio, io->sector);
+
+	cpu_cc = per_cpu_ptr(cc->cpu, raw_smp_processor_id());
+	while (!r && ctx->idx_in < ctx->bio_in->bi_vcnt) {
+		key_index = ctx->sector & (cc->tfms_count - 1);
+		ablkcipher_request_set_tfm(req, cpu_cc->tfms[key_index]);
+		ablkcipher_request_set_callback(req, 0, NULL, NULL);
+		r = crypt_convert_block(cc, ctx, req);
+		ctx->sector++;
+	}
+
+	mempool_free(req, cc->req_pool);
+	kcryptd_crypt_read_done(io, r);
+	return true;
+}
+
 static void kcryptd_async_done(struct crypto_async_request *async_req,
 			       int error)
 {
@@ -1216,22 +1283,75 @@ static void kcryptd_async_done(struct crypto_async_request *async_req,
 		kcryptd_crypt_write_io_submit(io, error, 1);
 }
 
+static struct dm_crypt_io *kcryptd_next_io(struct crypt_cpu *cpu_cc)
+{
+	struct dm_crypt_io *io = NULL;
+
+	spin_lock_irq(&cpu_cc->lock);
+	if (!list_empty(&cpu_cc->writes) &&
+	    (list_empty(&cpu_cc->reads) ||
+	     cpu_cc->reads_in_row >= KCRYPTD_BATCH)) {
+		io = list_first_entry(&cpu_cc->writes, struct dm_crypt_io, list);
+		cpu_cc->reads_in_row = 0;
+	} else if (!list_empty(&cpu_cc->reads)) {
+		io = list_first_entry(&cpu_cc->reads, struct dm_crypt_io, list);
+		if (!list_empty(&cpu_cc->writes))
+			cpu_cc->reads_in_row++;
+	}
+	if (io)
+		list_del(&io->list);
+	spin_unlock_irq(&cpu_cc->lock);
+
+	return io;
+}
+
+/*
+ * Each CPU has one work item per device, which converts the queued ios
+ * in turn, reads first, so that a read waits behind at most the write
+ * being encrypted.  A write is still taken after every KCRYPTD_BATCH
+ * reads that it waited for, so that a stream of reads cannot starve the
+ * writes.  After a batch it queues itself again to let other work on the
+ * CPU run.
+ */
 static void kcryptd_crypt(struct work_struct *work)
 {
-	struct dm_crypt_io *io = container_of(work, struct dm_crypt_io, work);
+	struct crypt_cpu *cpu_cc = container_of(work, struct crypt_cpu, work);
+	struct dm_crypt_io *io;
+	unsigned i;
 
-	if (bio_data_dir(io->base_bio) == READ)
-		kcryptd_crypt_read_convert(io);
-	else
-		kcryptd_crypt_write_convert(io);
+	for (i = 0; i < KCRYPTD_BATCH; i++) {
+		io = kcryptd_next_io(cpu_cc);
+		if (!io)
+			return;
+
+		if (bio_data_dir(io->base_bio) == READ)
+			kcryptd_crypt_read_convert(io);
+		else
+			kcryptd_crypt_write_convert(io);
+	}
+
+	queue_work(cpu_cc->cc->crypt_queue, work);
 }
 
 static void kcryptd_queue_crypt(struct dm_crypt_io *io)
 {
 	struct crypt_config *cc = io->target->private;
+	struct crypt_cpu *cpu_cc;
+	unsigned long flags;
+	int cpu;
 
-	INIT_WORK(&io->work, kcryptd_crypt);
-	queue_work(cc->crypt_queue, &io->work);
+	cpu = get_cpu();
+	cpu_cc = per_cpu_ptr(cc->cpu, cpu);
+
+	spin_lock_irqsave(&cpu_cc->lock, flags);
+	if (bio_data_dir(io->base_bio) == READ)
+		list_add_tail(&io->list, &cpu_cc->reads);
+	else
+		list_add_tail(&io->list, &cpu_cc->writes);
+	spin_unlock_irqrestore(&cpu_cc->lock, flags);
+
+	queue_work_on(cpu, cc->crypt_queue, &cpu_cc->work);
+	put_cpu();
 }
 
 /*
@@ -1413,6 +1533,7 @@ static int crypt_ctr_cipher(struct dm_target *ti,
 	struct crypt_config *cc = ti->private;
 	char *tmp, *cipher, *chainmode, *ivmode, *ivopts, *keycount;
 	char *cipher_api = NULL;
+	struct crypt_cpu *cpu_cc;
 	int cpu, ret = -EINVAL;
 
 	/* Convert to crypto api definition? */
@@ -1461,6 +1582,15 @@ static int crypt_ctr_cipher(struct dm_target *ti,
 		goto bad_mem;
 	}
 
+	for_each_possible_cpu(cpu) {
+		cpu_cc = per_cpu_ptr(cc->cpu, cpu);
+		spin_lock_init(&cpu_cc->lock);
+		INIT_LIST_HEAD(&cpu_cc->reads);
+		INIT_LIST_HEAD(&cpu_cc->writes);
+		INIT_WORK(&cpu_cc->work, kcryptd_crypt);
+		cpu_cc->cc = cc;
+	}
+
 	/*
 	 * For compatibility with the original dm-crypt mapping format, if
 	 * only the cipher name is supplied, use cbc-plain.
@@ -1558,6 +1688,14 @@ static int crypt_ctr_cipher(struct dm_target *ti,
 		}
 	}
 
+	/*
+	 * Reads can only be decrypted as they complete if neither the cipher
+	 * nor the IV post-processing (lmk) can sleep.
+	 */
+	if (!(crypto_ablkcipher_tfm(any_tfm(cc))->__crt_alg->cra_flags &
+	      CRYPTO_ALG_ASYNC) && !(cc->iv_gen_ops && cc->iv_gen_ops->post))
+		set_bit(DM_CRYPT_INLINE_READ, &cc->flags);
+
 	ret = 0;
 bad:
 	kfree(cipher_api);
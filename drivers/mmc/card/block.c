@@ -31,6 +31,7 @@
 #include <linux/mutex.h>
 #include <linux/scatterlist.h>
 #include <linux/string_helpers.h>
+#include <linux/log2.h>
 #include <linux/delay.h>
 #include <linux/capability.h>
 #include <linux/compat.h>
@@ -83,6 +84,35 @@ static DECLARE_BITMAP(name_use, 256);
 static char brandStr[20];
 //Chuck Chen, 20120102, add for EMMC info virtual file, End.
 
+/* Why gathering a packed write stopped, see mmc_blk_prep_packed_list() */
+enum mmc_blk_pack_stop {
+	MMC_PACK_STOP_EMPTY,		/* no more requests queued */
+	MMC_PACK_STOP_READ,		/* next request is a read */
+	MMC_PACK_STOP_SPECIAL,		/* discard or flush */
+	MMC_PACK_STOP_REL_WR,		/* reliable write */
+	MMC_PACK_STOP_SIZE,		/* host transfer size */
+	MMC_PACK_STOP_SEGS,		/* host segment count */
+	MMC_PACK_STOP_ENTRIES,		/* card or header entry count */
+	MMC_PACK_STOP_NR,
+};
+
+static const char * const mmc_blk_pack_stop_names[] = {
+	"empty", "read", "special", "rel_wr", "size", "segs", "entries",
+};
+
+/* Packed writes by number of entries: 2-3, 4-7 ... 32-63 */
+#define MMC_PACK_HIST		5
+
+struct mmc_blk_packed_stats {
+	unsigned long	packed_cmds;	/* packed writes issued */
+	unsigned long	packed_reqs;	/* requests sent in them */
+	unsigned long	single_wr;	/* writes that could not be packed */
+	unsigned long	entries[MMC_PACK_HIST];
+	unsigned long	stop[MMC_PACK_STOP_NR];
+	unsigned long	failed;		/* packed writes that failed */
+	unsigned long	fallback;	/* requests reissued unpacked */
+};
+
 /*
  * There is one mmc_blk_data per slot.
  */
@@ -95,6 +125,7 @@ struct mmc_blk_data {
 	unsigned int	flags;
 #define MMC_BLK_CMD23	(1 << 0)	/* Can do SET_BLOCK_COUNT for multiblock */
 #define MMC_BLK_REL_WR	(1 << 1)	/* MMC Reliable write support */
+#define MMC_BLK_PACKED_WR (1 << 2)	/* eMMC 4.5 packed writes */
 
 	unsigned int	usage;
 	unsigned int	read_only;
@@ -108,6 +139,8 @@ struct mmc_blk_data {
 	 */
 	unsigned int	part_curr;
 	struct device_attribute force_ro;
+	struct device_attribute packed_attr;
+	struct mmc_blk_packed_stats packed_stats;
 };
 
 static DEFINE_MUTEX(open_lock);
@@ -184,6 +217,53 @@ out:
 	return ret;
 }
 
+static ssize_t packed_stats_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	struct mmc_blk_packed_stats *st = &md->packed_stats;
+	int i, len;
+
+	len = snprintf(buf, PAGE_SIZE,
+		       "packed_cmds %lu\npacked_reqs %lu\nsingle_writes %lu\n"
+		       "entries",
+		       st->packed_cmds, st->packed_reqs, st->single_wr);
+	for (i = 0; i < MMC_PACK_HIST; i++)
+		len += snprintf(buf + len, PAGE_SIZE - len, " %d-%d:%lu",
+				2 << i, (4 << i) - 1, st->entries[i]);
+	len += snprintf(buf + len, PAGE_SIZE - len, "\nstop");
+	for (i = 0; i < MMC_PACK_STOP_NR; i++)
+		len += snprintf(buf + len, PAGE_SIZE - len, " %s:%lu",
+				mmc_blk_pack_stop_names[i], st->stop[i]);
+	len += snprintf(buf + len, PAGE_SIZE - len,
+			"\nfailed %lu\nfallback %lu\n",
+			st->failed, st->fallback);
+
+	mmc_blk_put(md);
+	return len;
+}
+
+/* Writing 0 clears the counters */
+static ssize_t packed_stats_store(struct device *dev,
+				  struct device_attribute *attr,
+				  const char *buf, size_t count)
+{
+	int ret;
+	char *end;
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	unsigned long set = simple_strtoul(buf, &end, 0);
+	if (end == buf || set) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	memset(&md->packed_stats, 0, sizeof(md->packed_stats));
+	ret = count;
+out:
+	mmc_blk_put(md);
+	return ret;
+}
+
 static int mmc_blk_open(struct block_device *bdev, fmode_t mode)
 {
 	struct mmc_blk_data *md = mmc_blk_get(bdev->bd_disk);
@@ -429,14 +509,6 @@ static const struct block_device_operations mmc_bdops = {
 #endif
 };
 
-struct mmc_blk_request {
-	struct mmc_request	mrq;
-	struct mmc_command	sbc;
-	struct mmc_command	cmd;
-	struct mmc_command	stop;
-	struct mmc_data		data;
-};
-
 static inline int mmc_blk_part_switch(struct mmc_card *card,
 				      struct mmc_blk_data *md)
 {
@@ -826,12 +898,185 @@ static inline void mmc_apply_rel_rw(struct mmc_blk_request *brq,
 	 R1_CC_ERROR |		/* Card controller error */		\
 	 R1_ERROR)		/* General/unknown error */
 
-static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *req)
+enum mmc_blk_status {
+	MMC_BLK_SUCCESS = 0,
+	MMC_BLK_PARTIAL,
+	MMC_BLK_RETRY,
+	MMC_BLK_RETRY_SINGLE,
+	MMC_BLK_DATA_ERR,
+	MMC_BLK_CMD_ERR,
+	MMC_BLK_ABORT,
+};
+
+/*
+ * Called by mmc_start_req() once the request has completed, while the
+ * next request, if any, is not yet started.  Returns 0 on success, or the
+ * mmc_blk_status telling mmc_blk_issue_rw_rq() how to carry on.
+ */
+static int mmc_blk_err_check(struct mmc_card *card,
+			     struct mmc_async_req *areq)
+{
+	enum mmc_blk_status ret = MMC_BLK_SUCCESS;
+	struct mmc_queue_req *mq_mrq = container_of(areq, struct mmc_queue_req,
+						    mmc_active);
+	struct mmc_blk_request *brq = &mq_mrq->brq;
+	struct request *req = mq_mrq->req;
+
+	/*
+	 * sbc.error indicates a problem with the set block count
+	 * command.  No data will have been transferred.
+	 *
+	 * cmd.error indicates a problem with the r/w command.  No
+	 * data will have been transferred.
+	 *
+	 * stop.error indicates a problem with the stop command.  Data
+	 * may have been transferred, or may still be transferring.
+	 */
+	if (brq->sbc.error || brq->cmd.error || brq->stop.error) {
+		switch (mmc_blk_cmd_recovery(card, req, brq)) {
+		case ERR_RETRY:
+			return MMC_BLK_RETRY;
+		case ERR_ABORT:
+			return MMC_BLK_ABORT;
+		case ERR_CONTINUE:
+			break;
+		}
+	}
+
+	/*
+	 * Check for errors relating to the execution of the
+	 * initial command - such as address errors.  No data
+	 * has been transferred.
+	 */
+	if (brq->cmd.resp[0] & CMD_ERRORS) {
+		pr_err("%s: r/w command failed, status = %#x\n",
+		       req->rq_disk->disk_name, brq->cmd.resp[0]);
+		return MMC_BLK_ABORT;
+	}
+
+	/*
+	 * Everything else is either success, or a data error of some
+	 * kind.  If it was a write, we may have transitioned to
+	 * program mode, which we have to wait for it to complete.
+	 */
+	if (!mmc_host_is_spi(card->host) && rq_data_dir(req) != READ) {
+		u32 status;
+		do {
+			int err = get_card_status(card, &status, 5);
+			if (err) {
+				printk(KERN_ERR "%s: error %d requesting status\n",
+				       req->rq_disk->disk_name, err);
+				return MMC_BLK_CMD_ERR;
+			}
+			/*
+			 * Some cards mishandle the status bits,
+			 * so make sure to check both the busy
+			 * indication and the card state.
+			 */
+		} while (!(status & R1_READY_FOR_DATA) ||
+			 (R1_CURRENT_STATE(status) == R1_STATE_PRG));
+	}
+
+	if (brq->data.error) {
+		pr_err("%s: error %d transferring data, sector %u, nr %u, cmd response %#x, card status %#x\n",
+		       req->rq_disk->disk_name, brq->data.error,
+		       (unsigned)blk_rq_pos(req),
+		       (unsigned)blk_rq_sectors(req),
+		       brq->cmd.resp[0], brq->stop.resp[0]);
+
+		if (rq_data_dir(req) == READ) {
+			if (brq->data.blocks > 1) {
+				/* Redo read one sector at a time */
+				pr_warning("%s: retrying using single block read\n",
+					   req->rq_disk->disk_name);
+				return MMC_BLK_RETRY_SINGLE;
+			}
+			return MMC_BLK_DATA_ERR;
+		} else {
+			return MMC_BLK_CMD_ERR;
+		}
+	}
+
+	/* A packed write carries more than its first request */
+	if (ret == MMC_BLK_SUCCESS && mq_mrq->cmd_type == MMC_PACKED_NONE &&
+	    blk_rq_bytes(req) != brq->data.bytes_xfered)
+		ret = MMC_BLK_PARTIAL;
+
+	return ret;
+}
+
+/*
+ * As mmc_blk_err_check(), and find out from the card which entry of a
+ * packed write failed, if it can tell.  The entries before it were
+ * written.
+ */
+static int mmc_blk_packed_err_check(struct mmc_card *card,
+				    struct mmc_async_req *areq)
 {
+	struct mmc_queue_req *mq_rq = container_of(areq, struct mmc_queue_req,
+						   mmc_active);
+	struct request *req = mq_rq->req;
+	struct mmc_packed *packed = mq_rq->packed;
+	int err, check, idx;
+	u32 status;
+	u8 *ext_csd;
+
+	packed->idx_failure = -1;
+
+	check = mmc_blk_err_check(card, areq);
+	err = get_card_status(card, &status, 0);
+	if (err) {
+		pr_err("%s: error %d sending status command\n",
+		       req->rq_disk->disk_name, err);
+		return MMC_BLK_ABORT;
+	}
+
+	if (!(status & R1_EXCEPTION_EVENT))
+		return check;
+
+	ext_csd = kzalloc(512, GFP_KERNEL);
+	if (!ext_csd)
+		return MMC_BLK_ABORT;
+
+	err = mmc_send_ext_csd(card, ext_csd);
+	if (err) {
+		pr_err("%s: error %d reading EXT_CSD\n",
+		       req->rq_disk->disk_name, err);
+		check = MMC_BLK_ABORT;
+		goto out;
+	}
+
+	if ((ext_csd[EXT_CSD_EXP_EVENTS_STATUS] & EXT_CSD_PACKED_FAILURE) &&
+	    (ext_csd[EXT_CSD_PACKED_CMD_STATUS] &
+	     EXT_CSD_PACKED_GENERIC_ERROR)) {
+		idx = ext_csd[EXT_CSD_PACKED_FAILURE_INDEX];
+		if ((ext_csd[EXT_CSD_PACKED_CMD_STATUS] &
+		     EXT_CSD_PACKED_INDEXED_ERROR) &&
+		    idx >= 1 && idx <= packed->nr_entries) {
+			/* The index is 1-based */
+			packed->idx_failure = idx - 1;
+			check = MMC_BLK_PARTIAL;
+		} else if (check == MMC_BLK_SUCCESS) {
+			check = MMC_BLK_CMD_ERR;
+		}
+		pr_err("%s: packed write failed, entry %d of %u, status %#x\n",
+		       req->rq_disk->disk_name, idx, packed->nr_entries,
+		       ext_csd[EXT_CSD_PACKED_CMD_STATUS]);
+	}
+out:
+	kfree(ext_csd);
+	return check;
+}
+
+static void mmc_blk_rw_rq_prep(struct mmc_queue_req *mqrq,
+			       struct mmc_card *card,
+			       int disable_multi,
+			       struct mmc_queue *mq)
+{
+	u32 readcmd, writecmd;
+	struct mmc_blk_request *brq = &mqrq->brq;
+	struct request *req = mqrq->req;
 	struct mmc_blk_data *md = mq->data;
-	struct mmc_card *card = md->queue.card;
-	struct mmc_blk_request brq;
-	int ret = 1, disable_multi = 0, retry = 0;
 
 	/*
 	 * Reliable writes are used to implement Forced Unit Access and
@@ -842,224 +1087,457 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *req)
 		(rq_data_dir(req) == WRITE) &&
 		(md->flags & MMC_BLK_REL_WR);
 
-	do {
-		u32 readcmd, writecmd;
+	memset(brq, 0, sizeof(struct mmc_blk_request));
+	brq->mrq.cmd = &brq->cmd;
+	brq->mrq.data = &brq->data;
 
-		memset(&brq, 0, sizeof(struct mmc_blk_request));
-		brq.mrq.cmd = &brq.cmd;
-		brq.mrq.data = &brq.data;
+	brq->cmd.arg = blk_rq_pos(req);
+	if (!mmc_card_blockaddr(card))
+		brq->cmd.arg <<= 9;
+	brq->cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
+	brq->data.blksz = 512;
+	brq->stop.opcode = MMC_STOP_TRANSMISSION;
+	brq->stop.arg = 0;
+	brq->stop.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
+	brq->data.blocks = blk_rq_sectors(req);
 
-		brq.cmd.arg = blk_rq_pos(req);
-		if (!mmc_card_blockaddr(card))
-			brq.cmd.arg <<= 9;
-		brq.cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
-		brq.data.blksz = 512;
-		brq.stop.opcode = MMC_STOP_TRANSMISSION;
-		brq.stop.arg = 0;
-		brq.stop.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
-		brq.data.blocks = blk_rq_sectors(req);
+	/*
+	 * The block layer doesn't support all sector count
+	 * restrictions, so we need to be prepared for too big
+	 * requests.
+	 */
+	if (brq->data.blocks > card->host->max_blk_count)
+		brq->data.blocks = card->host->max_blk_count;
 
-		/*
-		 * The block layer doesn't support all sector count
-		 * restrictions, so we need to be prepared for too big
-		 * requests.
-		 */
-		if (brq.data.blocks > card->host->max_blk_count)
-			brq.data.blocks = card->host->max_blk_count;
+	/*
+	 * After a read error, we redo the request one sector at a time
+	 * in order to accurately determine which sectors can be read
+	 * successfully.
+	 */
+	if (disable_multi && brq->data.blocks > 1)
+		brq->data.blocks = 1;
 
-		/*
-		 * After a read error, we redo the request one sector at a time
-		 * in order to accurately determine which sectors can be read
-		 * successfully.
+	if (brq->data.blocks > 1 || do_rel_wr) {
+		/* SPI multiblock writes terminate using a special
+		 * token, not a STOP_TRANSMISSION request.
 		 */
-		if (disable_multi && brq.data.blocks > 1)
-			brq.data.blocks = 1;
-
-		if (brq.data.blocks > 1 || do_rel_wr) {
-			/* SPI multiblock writes terminate using a special
-			 * token, not a STOP_TRANSMISSION request.
-			 */
-			if (!mmc_host_is_spi(card->host) ||
-			    rq_data_dir(req) == READ)
-				brq.mrq.stop = &brq.stop;
-			readcmd = MMC_READ_MULTIPLE_BLOCK;
-			writecmd = MMC_WRITE_MULTIPLE_BLOCK;
-		} else {
-			brq.mrq.stop = NULL;
-			readcmd = MMC_READ_SINGLE_BLOCK;
-			writecmd = MMC_WRITE_BLOCK;
-		}
-		if (rq_data_dir(req) == READ) {
-			brq.cmd.opcode = readcmd;
-			brq.data.flags |= MMC_DATA_READ;
-		} else {
-			brq.cmd.opcode = writecmd;
-			brq.data.flags |= MMC_DATA_WRITE;
-		}
+		if (!mmc_host_is_spi(card->host) ||
+		    rq_data_dir(req) == READ)
+			brq->mrq.stop = &brq->stop;
+		readcmd = MMC_READ_MULTIPLE_BLOCK;
+		writecmd = MMC_WRITE_MULTIPLE_BLOCK;
+	} else {
+		brq->mrq.stop = NULL;
+		readcmd = MMC_READ_SINGLE_BLOCK;
+		writecmd = MMC_WRITE_BLOCK;
+	}
+	if (rq_data_dir(req) == READ) {
+		brq->cmd.opcode = readcmd;
+		brq->data.flags |= MMC_DATA_READ;
+	} else {
+		brq->cmd.opcode = writecmd;
+		brq->data.flags |= MMC_DATA_WRITE;
+	}
 
-		if (do_rel_wr)
-			mmc_apply_rel_rw(&brq, card, req);
+	if (do_rel_wr)
+		mmc_apply_rel_rw(brq, card, req);
 
-		/*
-		 * Pre-defined multi-block transfers are preferable to
-		 * open ended-ones (and necessary for reliable writes).
-		 * However, it is not sufficient to just send CMD23,
-		 * and avoid the final CMD12, as on an error condition
-		 * CMD12 (stop) needs to be sent anyway. This, coupled
-		 * with Auto-CMD23 enhancements provided by some
-		 * hosts, means that the complexity of dealing
-		 * with this is best left to the host. If CMD23 is
-		 * supported by card and host, we'll fill sbc in and let
-		 * the host deal with handling it correctly. This means
-		 * that for hosts that don't expose MMC_CAP_CMD23, no
-		 * change of behavior will be observed.
-		 *
-		 * N.B: Some MMC cards experience perf degradation.
-		 * We'll avoid using CMD23-bounded multiblock writes for
-		 * these, while retaining features like reliable writes.
-		 */
+	/*
+	 * Pre-defined multi-block transfers are preferable to
+	 * open ended-ones (and necessary for reliable writes).
+	 * However, it is not sufficient to just send CMD23,
+	 * and avoid the final CMD12, as on an error condition
+	 * CMD12 (stop) needs to be sent anyway. This, coupled
+	 * with Auto-CMD23 enhancements provided by some
+	 * hosts, means that the complexity of dealing
+	 * with this is best left to the host. If CMD23 is
+	 * supported by card and host, we'll fill sbc in and let
+	 * the host deal with handling it correctly. This means
+	 * that for hosts that don't expose MMC_CAP_CMD23, no
+	 * change of behavior will be observed.
+	 *
+	 * N.B: Some MMC cards experience perf degradation.
+	 * We'll avoid using CMD23-bounded multiblock writes for
+	 * these, while retaining features like reliable writes.
+	 */
 
-		if ((md->flags & MMC_BLK_CMD23) &&
-		    mmc_op_multi(brq.cmd.opcode) &&
-		    (do_rel_wr || !(card->quirks & MMC_QUIRK_BLK_NO_CMD23))) {
-			brq.sbc.opcode = MMC_SET_BLOCK_COUNT;
-			brq.sbc.arg = brq.data.blocks |
-				(do_rel_wr ? (1 << 31) : 0);
-			brq.sbc.flags = MMC_RSP_R1 | MMC_CMD_AC;
-			brq.mrq.sbc = &brq.sbc;
-		}
+	if ((md->flags & MMC_BLK_CMD23) &&
+	    mmc_op_multi(brq->cmd.opcode) &&
+	    (do_rel_wr || !(card->quirks & MMC_QUIRK_BLK_NO_CMD23))) {
+		brq->sbc.opcode = MMC_SET_BLOCK_COUNT;
+		brq->sbc.arg = brq->data.blocks |
+			(do_rel_wr ? (1 << 31) : 0);
+		brq->sbc.flags = MMC_RSP_R1 | MMC_CMD_AC;
+		brq->mrq.sbc = &brq->sbc;
+	}
 
-		mmc_set_data_timeout(&brq.data, card);
+	mmc_set_data_timeout(&brq->data, card);
 
-		brq.data.sg = mq->sg;
-		brq.data.sg_len = mmc_queue_map_sg(mq);
+	brq->data.sg = mqrq->sg;
+	brq->data.sg_len = mmc_queue_map_sg(mq, mqrq);
 
-		/*
-		 * Adjust the sg list so it is the same size as the
-		 * request.
-		 */
-		if (brq.data.blocks != blk_rq_sectors(req)) {
-			int i, data_size = brq.data.blocks << 9;
-			struct scatterlist *sg;
-
-			for_each_sg(brq.data.sg, sg, brq.data.sg_len, i) {
-				data_size -= sg->length;
-				if (data_size <= 0) {
-					sg->length += data_size;
-					i++;
-					break;
-				}
+	/*
+	 * Adjust the sg list so it is the same size as the
+	 * request.
+	 */
+	if (brq->data.blocks != blk_rq_sectors(req)) {
+		int i, data_size = brq->data.blocks << 9;
+		struct scatterlist *sg;
+
+		for_each_sg(brq->data.sg, sg, brq->data.sg_len, i) {
+			data_size -= sg->length;
+			if (data_size <= 0) {
+				sg->length += data_size;
+				i++;
+				break;
 			}
-			brq.data.sg_len = i;
 		}
+		brq->data.sg_len = i;
+	}
 
-		mmc_queue_bounce_pre(mq);
+	mqrq->mmc_active.mrq = &brq->mrq;
+	mqrq->mmc_active.err_check = mmc_blk_err_check;
 
-		mmc_wait_for_req(card->host, &brq.mrq);
+	mmc_queue_bounce_pre(mqrq);
+}
 
-		mmc_queue_bounce_post(mq);
+static inline bool mmc_blk_rel_wr(struct mmc_blk_data *md,
+				  struct request *req)
+{
+	return (req->cmd_flags & (REQ_FUA | REQ_META)) &&
+		(md->flags & MMC_BLK_REL_WR);
+}
 
-		/*
-		 * sbc.error indicates a problem with the set block count
-		 * command.  No data will have been transferred.
-		 *
-		 * cmd.error indicates a problem with the r/w command.  No
-		 * data will have been transferred.
-		 *
-		 * stop.error indicates a problem with the stop command.  Data
-		 * may have been transferred, or may still be transferring.
-		 */
-		if (brq.sbc.error || brq.cmd.error || brq.stop.error) {
-			switch (mmc_blk_cmd_recovery(card, req, &brq)) {
-			case ERR_RETRY:
-				if (retry++ < 5)
-					continue;
-			case ERR_ABORT:
-				goto cmd_abort;
-			case ERR_CONTINUE:
-				break;
-			}
-		}
+/*
+ * Gather the writes queued behind @req into a packed write, if the card
+ * and the host can take one.  The requests are taken off the block queue
+ * and linked on the packed list by their queuelist, @req first.  Returns
+ * true if at least one more request than @req was found.
+ */
+static bool mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	struct request_queue *q = mq->queue;
+	struct mmc_queue_req *mqrq = mq->mqrq_cur;
+	struct mmc_packed *packed = mqrq->packed;
+	struct mmc_blk_packed_stats *st = &md->packed_stats;
+	unsigned int max_blocks, max_segs, max_entries, segs;
+	enum mmc_blk_pack_stop stop;
+	struct request *next;
+
+	if (!(md->flags & MMC_BLK_PACKED_WR) || rq_data_dir(req) != WRITE)
+		return false;
+
+	if (mq->no_pack) {
+		mq->no_pack--;
+		st->single_wr++;
+		return false;
+	}
 
-		/*
-		 * Check for errors relating to the execution of the
-		 * initial command - such as address errors.  No data
-		 * has been transferred.
-		 */
-		if (brq.cmd.resp[0] & CMD_ERRORS) {
-			pr_err("%s: r/w command failed, status = %#x\n",
-				req->rq_disk->disk_name, brq.cmd.resp[0]);
-			goto cmd_abort;
+	/* One block and one segment go to the header */
+	max_blocks = queue_max_hw_sectors(q) - 1;
+	max_segs = queue_max_segments(q) - 1;
+	max_entries = min_t(unsigned int, card->ext_csd.max_packed_writes,
+			    MMC_PACKED_MAX_ENTRIES);
+
+	if (mmc_blk_rel_wr(md, req) || blk_rq_sectors(req) > max_blocks ||
+	    req->nr_phys_segments > max_segs) {
+		st->single_wr++;
+		return false;
+	}
+
+	packed->blocks = blk_rq_sectors(req);
+	packed->nr_entries = 1;
+	segs = req->nr_phys_segments;
+	list_add_tail(&req->queuelist, &packed->list);
+
+	spin_lock_irq(q->queue_lock);
+	for (;;) {
+		if (packed->nr_entries >= max_entries) {
+			stop = MMC_PACK_STOP_ENTRIES;
+			break;
 		}
 
-		/*
-		 * Everything else is either success, or a data error of some
-		 * kind.  If it was a write, we may have transitioned to
-		 * program mode, which we have to wait for it to complete.
-		 */
-		if (!mmc_host_is_spi(card->host) && rq_data_dir(req) != READ) {
-			u32 status;
-			do {
-				int err = get_card_status(card, &status, 5);
-				if (err) {
-					printk(KERN_ERR "%s: error %d requesting status\n",
-					       req->rq_disk->disk_name, err);
-					goto cmd_err;
-				}
-				/*
-				 * Some cards mishandle the status bits,
-				 * so make sure to check both the busy
-				 * indication and the card state.
-				 */
-			} while (!(status & R1_READY_FOR_DATA) ||
-				 (R1_CURRENT_STATE(status) == R1_STATE_PRG));
+		next = blk_peek_request(q);
+		if (!next) {
+			stop = MMC_PACK_STOP_EMPTY;
+			break;
+		}
+		if (next->cmd_flags & (REQ_DISCARD | REQ_FLUSH)) {
+			stop = MMC_PACK_STOP_SPECIAL;
+			break;
 		}
+		if (rq_data_dir(next) != WRITE) {
+			stop = MMC_PACK_STOP_READ;
+			break;
+		}
+		if (mmc_blk_rel_wr(md, next)) {
+			stop = MMC_PACK_STOP_REL_WR;
+			break;
+		}
+		if (packed->blocks + blk_rq_sectors(next) > max_blocks) {
+			stop = MMC_PACK_STOP_SIZE;
+			break;
+		}
+		if (segs + next->nr_phys_segments > max_segs) {
+			stop = MMC_PACK_STOP_SEGS;
+			break;
+		}
+
+		blk_start_request(next);
+		list_add_tail(&next->queuelist, &packed->list);
+		packed->blocks += blk_rq_sectors(next);
+		segs += next->nr_phys_segments;
+		packed->nr_entries++;
+	}
+	spin_unlock_irq(q->queue_lock);
+
+	st->stop[stop]++;
+	if (packed->nr_entries == 1) {
+		list_del_init(&req->queuelist);
+		st->single_wr++;
+		return false;
+	}
+
+	st->packed_cmds++;
+	st->packed_reqs += packed->nr_entries;
+	st->entries[min(ilog2(packed->nr_entries) - 1, MMC_PACK_HIST - 1)]++;
+	return true;
+}
+
+static void mmc_blk_packed_hdr_wrq_prep(struct mmc_queue_req *mqrq,
+					struct mmc_card *card,
+					struct mmc_queue *mq)
+{
+	struct mmc_blk_request *brq = &mqrq->brq;
+	struct request *req = mqrq->req;
+	struct mmc_packed *packed = mqrq->packed;
+	__le32 *hdr = packed->cmd_hdr;
+	struct request *prq;
+	int i = 1;
+
+	/*
+	 * Header block: version, write, number of entries, then for each
+	 * request the CMD23 and CMD25 arguments it would have been sent
+	 * with on its own.
+	 */
+	memset(hdr, 0, sizeof(packed->cmd_hdr));
+	hdr[0] = cpu_to_le32((packed->nr_entries << 16) |
+			     (MMC_PACKED_CMD_WR << 8) | MMC_PACKED_CMD_VER);
+	list_for_each_entry(prq, &packed->list, queuelist) {
+		u32 addr = blk_rq_pos(prq);
+
+		if (!mmc_card_blockaddr(card))
+			addr <<= 9;
+		hdr[i * 2] = cpu_to_le32(blk_rq_sectors(prq));
+		hdr[i * 2 + 1] = cpu_to_le32(addr);
+		i++;
+	}
+
+	memset(brq, 0, sizeof(struct mmc_blk_request));
+	brq->mrq.cmd = &brq->cmd;
+	brq->mrq.data = &brq->data;
+	brq->mrq.sbc = &brq->sbc;
+	brq->mrq.stop = &brq->stop;
+
+	brq->sbc.opcode = MMC_SET_BLOCK_COUNT;
+	brq->sbc.arg = MMC_CMD23_ARG_PACKED | (packed->blocks + 1);
+	brq->sbc.flags = MMC_RSP_R1 | MMC_CMD_AC;
+
+	brq->cmd.opcode = MMC_WRITE_MULTIPLE_BLOCK;
+	brq->cmd.arg = blk_rq_pos(req);
+	if (!mmc_card_blockaddr(card))
+		brq->cmd.arg <<= 9;
+	brq->cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
+
+	brq->data.blksz = 512;
+	brq->data.blocks = packed->blocks + 1;
+	brq->data.flags |= MMC_DATA_WRITE;
+
+	brq->stop.opcode = MMC_STOP_TRANSMISSION;
+	brq->stop.arg = 0;
+	brq->stop.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
+
+	mmc_set_data_timeout(&brq->data, card);
+
+	brq->data.sg = mqrq->sg;
+	brq->data.sg_len = mmc_queue_map_sg(mq, mqrq);
+
+	mqrq->mmc_active.mrq = &brq->mrq;
+	mqrq->mmc_active.err_check = mmc_blk_packed_err_check;
+}
+
+/*
+ * Complete the requests of a packed write up to the entry that failed,
+ * or all of them.  The ones left are put back at the head of the block
+ * queue to be written one by one, so that the normal error handling
+ * sees them and a request that keeps failing does not take the rest of
+ * a pack with it.
+ */
+static void mmc_blk_end_packed_req(struct mmc_queue *mq,
+				   struct mmc_queue_req *mq_rq, bool failed)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_packed *packed = mq_rq->packed;
+	struct request *prq;
+	int nr_done, left;
+
+	if (!failed)
+		nr_done = packed->nr_entries;
+	else if (packed->idx_failure >= 0)
+		/* The entries before the one that failed were written */
+		nr_done = packed->idx_failure;
+	else
+		nr_done = 0;
+
+	if (failed)
+		md->packed_stats.failed++;
+
+	spin_lock_irq(&md->lock);
+	while (nr_done-- > 0 && !list_empty(&packed->list)) {
+		prq = list_entry_rq(packed->list.next);
+		list_del_init(&prq->queuelist);
+		__blk_end_request_all(prq, 0);
+	}
 
-		if (brq.data.error) {
-			pr_err("%s: error %d transferring data, sector %u, nr %u, cmd response %#x, card status %#x\n",
-				req->rq_disk->disk_name, brq.data.error,
-				(unsigned)blk_rq_pos(req),
-				(unsigned)blk_rq_sectors(req),
-				brq.cmd.resp[0], brq.stop.resp[0]);
-
-			if (rq_data_dir(req) == READ) {
-				if (brq.data.blocks > 1) {
-					/* Redo read one sector at a time */
-					pr_warning("%s: retrying using single block read\n",
-						req->rq_disk->disk_name);
-					disable_multi = 1;
-					continue;
-				}
+	/* Requeue from the tail so that the queue keeps their order */
+	left = 0;
+	while (!list_empty(&packed->list)) {
+		prq = list_entry_rq(packed->list.prev);
+		list_del_init(&prq->queuelist);
+		blk_requeue_request(mq->queue, prq);
+		left++;
+	}
+	spin_unlock_irq(&md->lock);
+
+	if (left) {
+		mq->no_pack += left;
+		md->packed_stats.fallback += left;
+	}
 
+	mq_rq->cmd_type = MMC_PACKED_NONE;
+	packed->nr_entries = 0;
+	packed->blocks = 0;
+}
+
+/*
+ * Start @rqc, if not NULL, and complete the request started by the
+ * previous call, if any.  The host prepares @rqc (DMA mapping, descriptor
+ * set up) while the previous request is still on the bus, and @rqc is
+ * started as soon as that one is done, before it is completed to the
+ * block layer.
+ */
+static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	struct mmc_blk_request *brq = &mq->mqrq_cur->brq;
+	int ret = 1, disable_multi = 0, retry = 0;
+	enum mmc_blk_status status;
+	struct mmc_queue_req *mq_rq;
+	struct request *req;
+	struct mmc_async_req *areq;
+
+	if (!rqc && !mq->mqrq_prev->req)
+		return 0;
+
+	if (rqc)
+		mq->mqrq_cur->cmd_type = mmc_blk_prep_packed_list(mq, rqc) ?
+			MMC_PACKED_WRITE : MMC_PACKED_NONE;
+
+	do {
+		if (rqc) {
+			if (mq->mqrq_cur->cmd_type == MMC_PACKED_WRITE)
+				mmc_blk_packed_hdr_wrq_prep(mq->mqrq_cur, card, mq);
+			else
+				mmc_blk_rw_rq_prep(mq->mqrq_cur, card, 0, mq);
+			areq = &mq->mqrq_cur->mmc_active;
+		} else
+			areq = NULL;
+		areq = mmc_start_req(card->host, areq, (int *) &status);
+		if (!areq)
+			return 0;
+
+		mq_rq = container_of(areq, struct mmc_queue_req, mmc_active);
+		brq = &mq_rq->brq;
+		req = mq_rq->req;
+		mmc_queue_bounce_post(mq_rq);
+
+		if (mq_rq->cmd_type == MMC_PACKED_WRITE) {
+			mmc_blk_end_packed_req(mq, mq_rq,
+					       status != MMC_BLK_SUCCESS);
+			if (status != MMC_BLK_SUCCESS)
+				goto start_new_req;
+			break;
+		}
+
+		switch (status) {
+		case MMC_BLK_SUCCESS:
+		case MMC_BLK_PARTIAL:
+			/*
+			 * A block was successfully transferred.  The bios
+			 * are completed without the queue lock, so that
+			 * their end_io (dm-crypt) runs with irqs enabled.
+			 */
+			ret = blk_end_request(req, 0,
+					      brq->data.bytes_xfered);
+			if (status == MMC_BLK_SUCCESS && ret) {
 				/*
-				 * After an error, we redo I/O one sector at a
-				 * time, so we only reach here after trying to
-				 * read a single sector.
+				 * All the data was transferred without
+				 * error, yet the block layer expects more.
+				 * The request that was started next is
+				 * left to the next call.
 				 */
-				spin_lock_irq(&md->lock);
-				ret = __blk_end_request(req, -EIO, brq.data.blksz);
-				spin_unlock_irq(&md->lock);
-				continue;
-			} else {
-				goto cmd_err;
+				printk(KERN_ERR "%s BUG rq_tot %d d_xfer %d\n",
+				       __func__, blk_rq_bytes(req),
+				       brq->data.bytes_xfered);
+				rqc = NULL;
+				goto cmd_abort;
 			}
+			break;
+		case MMC_BLK_CMD_ERR:
+			goto cmd_err;
+		case MMC_BLK_RETRY_SINGLE:
+			disable_multi = 1;
+			break;
+		case MMC_BLK_RETRY:
+			if (retry++ < 5)
+				break;
+		case MMC_BLK_ABORT:
+			goto cmd_abort;
+		case MMC_BLK_DATA_ERR:
+			/*
+			 * After an error, we redo I/O one sector at a
+			 * time, so we only reach here after trying to
+			 * read a single sector.
+			 */
+			spin_lock_irq(&md->lock);
+			ret = __blk_end_request(req, -EIO,
+						brq->data.blksz);
+			spin_unlock_irq(&md->lock);
+			if (!ret)
+				goto start_new_req;
+			break;
 		}
 
-		/*
-		 * A block was successfully transferred.
-		 */
-		spin_lock_irq(&md->lock);
-		ret = __blk_end_request(req, 0, brq.data.bytes_xfered);
-		spin_unlock_irq(&md->lock);
+		if (ret) {
+			/*
+			 * In case of a none complete request
+			 * prepare it again and resend.
+			 */
+			mmc_blk_rw_rq_prep(mq_rq, card, disable_multi, mq);
+			mmc_start_req(card->host, &mq_rq->mmc_active, NULL);
+		}
 	} while (ret);
 
 	return 1;
 
  cmd_err:
- 	/*
- 	 * If this is an SD card and we're writing, we can first
- 	 * mark the known good sectors as ok.
- 	 *
+	/*
+	 * If this is an SD card and we're writing, we can first
+	 * mark the known good sectors as ok.
+	 *
 	 * If the card is not SD, we can still ok written sectors
 	 * as reported by the controller (which might be less than
 	 * the real number of written sectors, but never more).
@@ -1075,7 +1553,7 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *req)
 		}
 	} else {
 		spin_lock_irq(&md->lock);
-		ret = __blk_end_request(req, 0, brq.data.bytes_xfered);
+		ret = __blk_end_request(req, 0, brq->data.bytes_xfered);
 		spin_unlock_irq(&md->lock);
 	}
 
@@ -1085,6 +1563,16 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *req)
 		ret = __blk_end_request(req, -EIO, blk_rq_cur_bytes(req));
 	spin_unlock_irq(&md->lock);
 
+ start_new_req:
+	/* The failed request kept the new one from being started */
+	if (rqc) {
+		if (mq->mqrq_cur->cmd_type == MMC_PACKED_WRITE)
+			mmc_blk_packed_hdr_wrq_prep(mq->mqrq_cur, card, mq);
+		else
+			mmc_blk_rw_rq_prep(mq->mqrq_cur, card, 0, mq);
+		mmc_start_req(card->host, &mq->mqrq_cur->mmc_active, NULL);
+	}
+
 	return 0;
 }
 
@@ -1104,26 +1592,42 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 	}
 #endif
 
-	mmc_claim_host(card->host);
+	if (req && !mq->mqrq_prev->req)
+		/* claim host only for the first request */
+		mmc_claim_host(card->host);
+
 	ret = mmc_blk_part_switch(card, md);
 	if (ret) {
+		if (req) {
+			spin_lock_irq(&md->lock);
+			__blk_end_request_all(req, -EIO);
+			spin_unlock_irq(&md->lock);
+		}
 		ret = 0;
 		goto out;
 	}
 
-	if (req->cmd_flags & REQ_DISCARD) {
+	if (req && req->cmd_flags & REQ_DISCARD) {
+		/* complete ongoing async transfer before issuing discard */
+		if (card->host->areq)
+			mmc_blk_issue_rw_rq(mq, NULL);
 		if (req->cmd_flags & REQ_SECURE)
 			ret = mmc_blk_issue_secdiscard_rq(mq, req);
 		else
 			ret = mmc_blk_issue_discard_rq(mq, req);
-	} else if (req->cmd_flags & REQ_FLUSH) {
+	} else if (req && req->cmd_flags & REQ_FLUSH) {
+		/* complete ongoing async transfer before issuing flush */
+		if (card->host->areq)
+			mmc_blk_issue_rw_rq(mq, NULL);
 		ret = mmc_blk_issue_flush(mq, req);
 	} else {
 		ret = mmc_blk_issue_rw_rq(mq, req);
 	}
 
 out:
-	mmc_release_host(card->host);
+	if (!req)
+		/* release host only when there are no more requests */
+		mmc_release_host(card->host);
 	return ret;
 }
 
@@ -1232,6 +1736,12 @@ static struct mmc_blk_data *mmc_blk_alloc_req(struct mmc_card *card,
 		blk_queue_flush(md->queue.queue, REQ_FLUSH | REQ_FUA);
 	}
 
+	/* The queue only sets up packing if host and card allow it */
+	if (mmc_card_mmc(card) &&
+	    md->flags & MMC_BLK_CMD23 &&
+	    md->queue.mqrq_cur->packed)
+		md->flags |= MMC_BLK_PACKED_WR;
+
 	return md;
 
  err_putdisk:
@@ -1338,6 +1848,9 @@ static void mmc_blk_remove_req(struct mmc_blk_data *md)
 	if (md) {
 		if (md->disk->flags & GENHD_FL_UP) {
 			device_remove_file(disk_to_dev(md->disk), &md->force_ro);
+			if (md->flags & MMC_BLK_PACKED_WR)
+				device_remove_file(disk_to_dev(md->disk),
+						   &md->packed_attr);
 
 			/* Stop new requests from getting into the queue */
 			del_gendisk(md->disk);
@@ -1375,8 +1888,26 @@ static int mmc_add_disk(struct mmc_blk_data *md)
 	md->force_ro.attr.mode = S_IRUGO | S_IWUSR;
 	ret = device_create_file(disk_to_dev(md->disk), &md->force_ro);
 	if (ret)
-		del_gendisk(md->disk);
+		goto del_disk;
+
+	if (md->flags & MMC_BLK_PACKED_WR) {
+		md->packed_attr.show = packed_stats_show;
+		md->packed_attr.store = packed_stats_store;
+		sysfs_attr_init(&md->packed_attr.attr);
+		md->packed_attr.attr.name = "packed_stats";
+		md->packed_attr.attr.mode = S_IRUGO | S_IWUSR;
+		ret = device_create_file(disk_to_dev(md->disk),
+					 &md->packed_attr);
+		if (ret) {
+			device_remove_file(disk_to_dev(md->disk),
+					   &md->force_ro);
+			goto del_disk;
+		}
+	}
+	return 0;
 
+del_disk:
+	del_gendisk(md->disk);
 	return ret;
 }
 
@@ -745,6 +745,82 @@ static int mmc_test_simple_transfer(struct mmc_test_card *test,
 	return mmc_test_check_result(test, &mrq);
 }
 
+struct mmc_test_async_req {
+	struct mmc_async_req	areq;
+	struct mmc_test_card	*test;
+};
+
+static int mmc_test_check_result_async(struct mmc_card *card,
+				       struct mmc_async_req *areq)
+{
+	struct mmc_test_async_req *test_async =
+		container_of(areq, struct mmc_test_async_req, areq);
+
+	mmc_test_wait_busy(test_async->test);
+
+	return mmc_test_check_result(test_async->test, areq->mrq);
+}
+
+static void mmc_test_nonblock_reset(struct mmc_request *mrq,
+				    struct mmc_command *cmd,
+				    struct mmc_command *stop,
+				    struct mmc_data *data)
+{
+	memset(mrq, 0, sizeof(struct mmc_request));
+	memset(cmd, 0, sizeof(struct mmc_command));
+	memset(data, 0, sizeof(struct mmc_data));
+	memset(stop, 0, sizeof(struct mmc_command));
+
+	mrq->cmd = cmd;
+	mrq->data = data;
+	mrq->stop = stop;
+}
+
+/*
+ * Tests count consecutive transfers with non-blocking requests: each one
+ * is started by mmc_start_req() while the one before is still running.
+ */
+static int mmc_test_nonblock_transfer(struct mmc_test_card *test,
+	struct scatterlist *sg, unsigned sg_len, unsigned dev_addr,
+	unsigned blocks, unsigned blksz, int write, unsigned count)
+{
+	struct mmc_request mrq[2];
+	struct mmc_command cmd[2];
+	struct mmc_command stop[2];
+	struct mmc_data data[2];
+	struct mmc_test_async_req test_areq[2];
+	struct mmc_async_req *done_areq;
+	unsigned i, cur;
+	int ret = 0;
+
+	for (i = 0; i < 2; i++) {
+		mmc_test_nonblock_reset(&mrq[i], &cmd[i], &stop[i], &data[i]);
+		test_areq[i].test = test;
+		test_areq[i].areq.mrq = &mrq[i];
+		test_areq[i].areq.err_check = mmc_test_check_result_async;
+	}
+
+	for (i = 0; i < count; i++) {
+		cur = i & 1;
+		mmc_test_prepare_mrq(test, &mrq[cur], sg, sg_len, dev_addr,
+				     blocks, blksz, write);
+		done_areq = mmc_start_req(test->card->host,
+					  &test_areq[cur].areq, &ret);
+		if (ret || (!done_areq && i > 0))
+			return ret ? ret : RESULT_FAIL;
+
+		/* The other slot is free again */
+		if (done_areq)
+			mmc_test_nonblock_reset(&mrq[!cur], &cmd[!cur],
+						&stop[!cur], &data[!cur]);
+		dev_addr += blocks;
+	}
+
+	mmc_start_req(test->card->host, NULL, &ret);
+
+	return ret;
+}
+
 /*
  * Tests a transfer where the card will fail completely or partly
  */
@@ -1954,6 +2030,83 @@ static int mmc_test_large_seq_write_perf(struct mmc_test_card *test)
 	return mmc_test_large_seq_perf(test, 1);
 }
 
+/*
+ * Transfer the test area in chunks of sz bytes, once waiting for each
+ * request to complete before issuing the next, and once with non-blocking
+ * requests, so that the host prepares each request while the previous one
+ * is still on the bus.
+ */
+static int mmc_test_seq_nonblock_perf(struct mmc_test_card *test, int write,
+				      unsigned long sz)
+{
+	struct mmc_test_area *t = &test->area;
+	unsigned int dev_addr, i, cnt;
+	struct timespec ts1, ts2;
+	int ret, nonblock;
+
+	cnt = t->max_sz / sz;
+	ret = mmc_test_area_map(test, sz, 0);
+	if (ret)
+		return ret;
+
+	for (nonblock = 0; nonblock < 2; nonblock++) {
+		if (write) {
+			ret = mmc_test_area_erase(test);
+			if (ret)
+				return ret;
+		}
+		dev_addr = t->dev_addr;
+		getnstimeofday(&ts1);
+		if (nonblock) {
+			ret = mmc_test_nonblock_transfer(test, t->sg,
+					t->sg_len, dev_addr, t->blocks, 512,
+					write, cnt);
+		} else {
+			for (i = 0; i < cnt && !ret; i++) {
+				ret = mmc_test_area_transfer(test, dev_addr,
+							     write);
+				dev_addr += t->blocks;
+			}
+		}
+		if (ret)
+			return ret;
+		getnstimeofday(&ts2);
+		mmc_test_print_avg_rate(test, sz, cnt, &ts1, &ts2);
+	}
+	return 0;
+}
+
+static int mmc_test_profile_nonblock_perf(struct mmc_test_card *test,
+					  int write)
+{
+	struct mmc_test_area *t = &test->area;
+	unsigned long sz;
+	int ret;
+
+	for (sz = 512; sz < t->max_tfr; sz <<= 1) {
+		ret = mmc_test_seq_nonblock_perf(test, write, sz);
+		if (ret)
+			return ret;
+	}
+	return mmc_test_seq_nonblock_perf(test, write, t->max_tfr);
+}
+
+/*
+ * Consecutive read performance, blocking vs non-blocking requests.
+ */
+static int mmc_test_profile_nonblock_read_perf(struct mmc_test_card *test)
+{
+	return mmc_test_profile_nonblock_perf(test, 0);
+}
+
+/*
+ * Consecutive write performance, blocking vs non-blocking requests.
+ */
+static int mmc_test_profile_nonblock_write_perf(struct mmc_test_card *test)
+{
+	return mmc_test_profile_nonblock_perf(test, 1);
+}
+
 static const struct mmc_test_case mmc_test_cases[] = {
 	{
 		.name = "Basic write (no data verification)",
@@ -2221,6 +2374,20 @@ static const struct mmc_test_case mmc_test_cases[] = {
 		.cleanup = mmc_test_area_cleanup,
 	},
 
+	{
+		.name = "Consecutive read performance, blocking vs non-blocking",
+		.prepare = mmc_test_area_prepare_fill,
+		.run = mmc_test_profile_nonblock_read_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Consecutive write performance, blocking vs non-blocking",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_profile_nonblock_write_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
 };
 
 static DEFINE_MUTEX(mmc_test_lock);
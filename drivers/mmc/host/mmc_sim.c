@@ -0,0 +1,598 @@
+/*
+ * Simulated eMMC host and card
+ *
+ * A host controller driver whose card lives in RAM: the commands the MMC
+ * core and the block driver send are answered as an eMMC 4.5 device
+ * would, so that paths that need particular card features, such as
+ * packed writes, can be run and measured without the hardware.
+ *
+ * The card is byte addressed, runs on a 1-bit bus and supports CMD23,
+ * reliable writes, trim and packed writes.  Each request takes cmd_us
+ * microseconds on top of the copy, which stands for the per command cost
+ * of a real device.  With fail_packed_every set, every so many packed
+ * writes fail at entry fail_packed_entry and report it through the
+ * packed failure exception event, to exercise the error handling.
+ *
+ * With gc_us set, a write that lands in another 512KB erase block than
+ * the previous write takes that much longer, which stands for the garbage
+ * collection a real FTL does for scattered writes.
+ *
+ *   modprobe mmc_sim size_mb=256 cmd_us=200
+ *   cat /sys/block/mmcblkN/packed_stats
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/platform_device.h>
+#include <linux/scatterlist.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
+#include <linux/delay.h>
+
+#include <linux/mmc/host.h>
+#include <linux/mmc/card.h>
+#include <linux/mmc/mmc.h>
+
+#define DRIVER_NAME		"mmc_sim"
+
+#define SIM_OCR			0xc0ff8000	/* ready, sector mode, 2.7-3.6V */
+#define SIM_RCA_NONE		0
+#define SIM_MAX_BLOCKS		1024
+#define SIM_MAX_REQ		(SIM_MAX_BLOCKS * 512)
+
+static unsigned int size_mb = 64;
+module_param(size_mb, uint, 0444);
+MODULE_PARM_DESC(size_mb, "Card size in MiB, 1 to 1024 (default: 64)");
+
+static unsigned int cmd_us = 100;
+module_param(cmd_us, uint, 0644);
+MODULE_PARM_DESC(cmd_us, "Time each request takes in us (default: 100)");
+
+static unsigned int gc_us;
+module_param(gc_us, uint, 0644);
+MODULE_PARM_DESC(gc_us,
+		 "Extra time for a write to another erase block in us (default: 0)");
+
+static bool packed = 1;
+module_param(packed, bool, 0444);
+MODULE_PARM_DESC(packed, "Let the host issue packed writes (default: 1)");
+
+static unsigned int max_packed = 32;
+module_param(max_packed, uint, 0444);
+MODULE_PARM_DESC(max_packed, "MAX_PACKED_WRITES of the card (default: 32)");
+
+static unsigned int fail_packed_every;
+module_param(fail_packed_every, uint, 0644);
+MODULE_PARM_DESC(fail_packed_every,
+		 "Fail every Nth packed write, 0 for never (default: 0)");
+
+static unsigned int fail_packed_entry = 2;
+module_param(fail_packed_entry, uint, 0644);
+MODULE_PARM_DESC(fail_packed_entry,
+		 "Entry of the pack that fails, from 1 (default: 2)");
+
+struct mmc_sim_host {
+	struct mmc_host		*mmc;
+	struct mmc_request	*mrq;
+	struct work_struct	work;
+
+	u8			*ram;
+	unsigned int		nr_sectors;
+	u8			*xfer;		/* packed write data */
+	u8			ext_csd[512];
+	u32			cid[4];
+	u32			csd[4];
+
+	unsigned int		state;		/* R1_STATE_* */
+	u16			rca;
+	u32			status;		/* sticky R1 error bits */
+	bool			exception;	/* R1_EXCEPTION_EVENT */
+	unsigned int		sbc_blocks;
+	bool			sbc_packed;
+	unsigned int		erase_start;
+	unsigned int		erase_end;
+	unsigned long		nr_packed;
+	unsigned int		last_block;	/* erase block last written */
+	unsigned int		gc_delay;	/* us owed by this request */
+};
+
+#define SIM_ERASE_BLOCK_SHIFT	10	/* 512KB, in sectors */
+
+static struct platform_device *mmc_sim_pdev;
+
+/* Inverse of UNSTUFF_BITS() in the core */
+static void sim_stuff(u32 *resp, int start, int size, u32 val)
+{
+	int off = 3 - start / 32;
+	int shft = start & 31;
+
+	resp[off] |= val << shft;
+	if (size + shft > 32)
+		resp[off - 1] |= val >> (32 - shft);
+}
+
+static void mmc_sim_init_card(struct mmc_sim_host *sim)
+{
+	static const char name[] = "MMCSIM";
+	u8 *ext_csd = sim->ext_csd;
+	int i;
+
+	for (i = 0; i < 6; i++)
+		sim_stuff(sim->cid, 96 - i * 8, 8, name[i]);
+	sim_stuff(sim->cid, 120, 8, 0x00);		/* manfid */
+	sim_stuff(sim->cid, 16, 32, 0x12345678);	/* serial */
+	sim_stuff(sim->cid, 12, 4, 1);			/* month */
+	sim_stuff(sim->cid, 8, 4, 15);			/* 2012 */
+
+	sim_stuff(sim->csd, 126, 2, 2);		/* CSD structure 1.2 */
+	sim_stuff(sim->csd, 122, 4, 4);		/* MMC 4.x */
+	sim_stuff(sim->csd, 112, 8, 0x0e);	/* taac 1ms */
+	sim_stuff(sim->csd, 96, 8, 0x32);	/* 25MHz */
+	sim_stuff(sim->csd, 84, 12, 0x0f5);	/* command classes */
+	sim_stuff(sim->csd, 80, 4, 9);		/* 512 byte reads */
+	/* c_size and c_size_mult: (c_size + 1) << 9 sectors */
+	sim_stuff(sim->csd, 62, 12, sim->nr_sectors / 512 - 1);
+	sim_stuff(sim->csd, 47, 3, 7);
+	sim_stuff(sim->csd, 42, 5, 15);		/* 128K erase groups */
+	sim_stuff(sim->csd, 37, 5, 15);
+	sim_stuff(sim->csd, 26, 3, 2);		/* r2w factor */
+	sim_stuff(sim->csd, 22, 4, 9);		/* 512 byte writes */
+
+	memset(ext_csd, 0, sizeof(sim->ext_csd));
+	ext_csd[EXT_CSD_REV] = 6;
+	ext_csd[EXT_CSD_STRUCTURE] = 2;
+	ext_csd[EXT_CSD_CARD_TYPE] = EXT_CSD_CARD_TYPE_26 |
+				     EXT_CSD_CARD_TYPE_52;
+	ext_csd[EXT_CSD_SEC_CNT + 0] = sim->nr_sectors >> 0;
+	ext_csd[EXT_CSD_SEC_CNT + 1] = sim->nr_sectors >> 8;
+	ext_csd[EXT_CSD_SEC_CNT + 2] = sim->nr_sectors >> 16;
+	ext_csd[EXT_CSD_SEC_CNT + 3] = sim->nr_sectors >> 24;
+	ext_csd[EXT_CSD_WR_REL_PARAM] = EXT_CSD_WR_REL_PARAM_EN;
+	ext_csd[EXT_CSD_REL_WR_SEC_C] = 1;
+	ext_csd[EXT_CSD_ERASE_TIMEOUT_MULT] = 1;
+	ext_csd[EXT_CSD_HC_ERASE_GRP_SIZE] = 1;
+	ext_csd[EXT_CSD_SEC_FEATURE_SUPPORT] = EXT_CSD_SEC_GB_CL_EN;
+	ext_csd[EXT_CSD_TRIM_MULT] = 1;
+	ext_csd[EXT_CSD_MAX_PACKED_WRITES] = min(max_packed, 255U);
+
+	sim->state = R1_STATE_IDLE;
+}
+
+static u32 mmc_sim_r1(struct mmc_sim_host *sim)
+{
+	u32 r1 = sim->status | (sim->state << 9) | R1_READY_FOR_DATA;
+
+	if (sim->exception)
+		r1 |= R1_EXCEPTION_EVENT;
+	/* The error bits clear once reported */
+	sim->status = 0;
+	return r1;
+}
+
+static bool mmc_sim_range(struct mmc_sim_host *sim, u32 arg,
+			  unsigned int blocks, unsigned int *sector)
+{
+	*sector = arg >> 9;
+	if ((arg & 511) || *sector >= sim->nr_sectors ||
+	    blocks > sim->nr_sectors - *sector) {
+		sim->status |= R1_OUT_OF_RANGE | R1_ADDRESS_ERROR;
+		return false;
+	}
+	return true;
+}
+
+static void mmc_sim_packed_fail(struct mmc_sim_host *sim, unsigned int idx)
+{
+	u8 *ext_csd = sim->ext_csd;
+
+	ext_csd[EXT_CSD_PACKED_CMD_STATUS] = EXT_CSD_PACKED_GENERIC_ERROR;
+	if (idx) {
+		ext_csd[EXT_CSD_PACKED_CMD_STATUS] |=
+			EXT_CSD_PACKED_INDEXED_ERROR;
+		ext_csd[EXT_CSD_PACKED_FAILURE_INDEX] = idx;
+	}
+	ext_csd[EXT_CSD_EXP_EVENTS_STATUS] |= EXT_CSD_PACKED_FAILURE;
+	if (ext_csd[EXT_CSD_EXP_EVENTS_CTRL] & EXT_CSD_PACKED_EVENT_EN)
+		sim->exception = true;
+	sim->status |= R1_ERROR;
+}
+
+/* Charge gc_us for each erase block switch of a write */
+static void mmc_sim_written(struct mmc_sim_host *sim, unsigned int sector,
+			    unsigned int blocks)
+{
+	unsigned int first = sector >> SIM_ERASE_BLOCK_SHIFT;
+	unsigned int last = (sector + blocks - 1) >> SIM_ERASE_BLOCK_SHIFT;
+
+	if (first != sim->last_block)
+		sim->gc_delay += gc_us;
+	sim->gc_delay += (last - first) * gc_us;
+	sim->last_block = last;
+}
+
+/*
+ * The data of a packed write is a header block followed by the data of
+ * each entry.  Entries are written in order until one fails.
+ */
+static void mmc_sim_packed_write(struct mmc_sim_host *sim,
+				 struct mmc_data *data)
+{
+	__le32 *hdr = (__le32 *)sim->xfer;
+	unsigned int nr, i, blocks, sector, total = 1, fail = 0;
+	unsigned int off = 512;
+	u32 hdr0;
+
+	sg_copy_to_buffer(data->sg, data->sg_len, sim->xfer,
+			  data->blocks * 512);
+
+	hdr0 = le32_to_cpu(hdr[0]);
+	nr = (hdr0 >> 16) & 0xff;
+	for (i = 1; i <= nr && i < 64; i++)
+		total += le32_to_cpu(hdr[i * 2]) & 0xffff;
+	/* A 512 byte header has room for 63 entries */
+	if ((hdr0 & 0xff) != MMC_PACKED_CMD_VER ||
+	    ((hdr0 >> 8) & 0xff) != MMC_PACKED_CMD_WR || !nr || nr > 63 ||
+	    nr > sim->ext_csd[EXT_CSD_MAX_PACKED_WRITES] ||
+	    total != data->blocks) {
+		mmc_sim_packed_fail(sim, 0);
+		data->error = -EIO;
+		return;
+	}
+
+	sim->nr_packed++;
+	if (fail_packed_every && !(sim->nr_packed % fail_packed_every))
+		fail = clamp(fail_packed_entry, 1U, nr);
+
+	for (i = 1; i <= nr; i++) {
+		blocks = le32_to_cpu(hdr[i * 2]) & 0xffff;
+		if (i == fail ||
+		    !mmc_sim_range(sim, le32_to_cpu(hdr[i * 2 + 1]), blocks,
+				   &sector)) {
+			mmc_sim_packed_fail(sim, i);
+			data->error = -EIO;
+			break;
+		}
+		mmc_sim_written(sim, sector, blocks);
+		memcpy(sim->ram + sector * 512, sim->xfer + off, blocks * 512);
+		off += blocks * 512;
+	}
+	data->bytes_xfered = off;
+}
+
+static void mmc_sim_data(struct mmc_sim_host *sim, struct mmc_command *cmd,
+			 struct mmc_data *data)
+{
+	unsigned int len = data->blocks * data->blksz;
+	unsigned int sector;
+
+	if (data->blksz != 512 || len > SIM_MAX_REQ) {
+		data->error = -EINVAL;
+		return;
+	}
+
+	if (cmd->opcode == MMC_SEND_EXT_CSD) {
+		sg_copy_from_buffer(data->sg, data->sg_len, sim->ext_csd, 512);
+		data->bytes_xfered = 512;
+		/* Reading the status ends the exception */
+		sim->ext_csd[EXT_CSD_EXP_EVENTS_STATUS] = 0;
+		sim->ext_csd[EXT_CSD_PACKED_CMD_STATUS] = 0;
+		sim->ext_csd[EXT_CSD_PACKED_FAILURE_INDEX] = 0;
+		sim->exception = false;
+		return;
+	}
+
+	if (sim->sbc_packed) {
+		sim->sbc_packed = false;
+		if (cmd->opcode != MMC_WRITE_MULTIPLE_BLOCK ||
+		    sim->sbc_blocks != data->blocks) {
+			sim->status |= R1_ILLEGAL_COMMAND;
+			data->error = -EIO;
+			return;
+		}
+		mmc_sim_packed_write(sim, data);
+		return;
+	}
+
+	if (!mmc_sim_range(sim, cmd->arg, data->blocks, &sector)) {
+		data->error = -EIO;
+		return;
+	}
+
+	if (data->flags & MMC_DATA_WRITE) {
+		mmc_sim_written(sim, sector, data->blocks);
+		sg_copy_to_buffer(data->sg, data->sg_len,
+				  sim->ram + sector * 512, len);
+	} else {
+		sg_copy_from_buffer(data->sg, data->sg_len,
+				    sim->ram + sector * 512, len);
+	}
+	data->bytes_xfered = len;
+}
+
+static void mmc_sim_cmd(struct mmc_sim_host *sim, struct mmc_command *cmd)
+{
+	unsigned int index, value, start, end;
+	u8 *ext_csd = sim->ext_csd;
+
+	cmd->error = 0;
+	memset(cmd->resp, 0, sizeof(cmd->resp));
+
+	switch (cmd->opcode) {
+	case MMC_GO_IDLE_STATE:
+		sim->state = R1_STATE_IDLE;
+		sim->rca = SIM_RCA_NONE;
+		sim->sbc_packed = false;
+		break;
+	case MMC_SEND_OP_COND:
+		cmd->resp[0] = SIM_OCR;
+		sim->state = R1_STATE_READY;
+		break;
+	case MMC_ALL_SEND_CID:
+		memcpy(cmd->resp, sim->cid, sizeof(sim->cid));
+		sim->state = R1_STATE_IDENT;
+		break;
+	case MMC_SET_RELATIVE_ADDR:
+		sim->rca = cmd->arg >> 16;
+		sim->state = R1_STATE_STBY;
+		cmd->resp[0] = mmc_sim_r1(sim);
+		break;
+	case MMC_SEND_CSD:
+		memcpy(cmd->resp, sim->csd, sizeof(sim->csd));
+		break;
+	case MMC_SEND_CID:
+		memcpy(cmd->resp, sim->cid, sizeof(sim->cid));
+		break;
+	case MMC_SELECT_CARD:
+		sim->state = (cmd->arg >> 16) == sim->rca ?
+			R1_STATE_TRAN : R1_STATE_STBY;
+		cmd->resp[0] = mmc_sim_r1(sim);
+		break;
+	case MMC_SEND_EXT_CSD:
+		/* SEND_IF_COND of SD cards, without data */
+		if (!cmd->data) {
+			cmd->error = -ETIMEDOUT;
+			break;
+		}
+		cmd->resp[0] = mmc_sim_r1(sim);
+		break;
+	case MMC_SWITCH:
+		index = (cmd->arg >> 16) & 0xff;
+		value = (cmd->arg >> 8) & 0xff;
+		/* Only the modes segment can be written */
+		if (index >= EXT_CSD_REV) {
+			sim->status |= R1_SWITCH_ERROR;
+		} else {
+			switch ((cmd->arg >> 24) & 3) {
+			case MMC_SWITCH_MODE_SET_BITS:
+				ext_csd[index] |= value;
+				break;
+			case MMC_SWITCH_MODE_CLEAR_BITS:
+				ext_csd[index] &= ~value;
+				break;
+			case MMC_SWITCH_MODE_WRITE_BYTE:
+				ext_csd[index] = value;
+				break;
+			default:
+				sim->status |= R1_SWITCH_ERROR;
+			}
+		}
+		cmd->resp[0] = mmc_sim_r1(sim);
+		break;
+	case MMC_SET_BLOCK_COUNT:
+		sim->sbc_blocks = cmd->arg & 0xffff;
+		sim->sbc_packed = !!(cmd->arg & MMC_CMD23_ARG_PACKED);
+		cmd->resp[0] = mmc_sim_r1(sim);
+		break;
+	case MMC_ERASE_GROUP_START:
+		sim->erase_start = cmd->arg;
+		cmd->resp[0] = mmc_sim_r1(sim);
+		break;
+	case MMC_ERASE_GROUP_END:
+		sim->erase_end = cmd->arg;
+		cmd->resp[0] = mmc_sim_r1(sim);
+		break;
+	case MMC_ERASE:
+		start = sim->erase_start >> 9;
+		end = sim->erase_end >> 9;
+		if (start > end || end >= sim->nr_sectors)
+			sim->status |= R1_ERASE_PARAM;
+		else
+			memset(sim->ram + start * 512, 0,
+			       (end - start + 1) * 512);
+		cmd->resp[0] = mmc_sim_r1(sim);
+		break;
+	case MMC_STOP_TRANSMISSION:
+	case MMC_SEND_STATUS:
+	case MMC_SET_BLOCKLEN:
+	case MMC_READ_SINGLE_BLOCK:
+	case MMC_READ_MULTIPLE_BLOCK:
+	case MMC_WRITE_BLOCK:
+	case MMC_WRITE_MULTIPLE_BLOCK:
+		cmd->resp[0] = mmc_sim_r1(sim);
+		break;
+	default:
+		/* SD and SDIO commands: this is no such card */
+		cmd->error = -ETIMEDOUT;
+	}
+}
+
+static void mmc_sim_work(struct work_struct *work)
+{
+	struct mmc_sim_host *sim = container_of(work, struct mmc_sim_host,
+						work);
+	struct mmc_request *mrq = sim->mrq;
+
+	if (cmd_us)
+		usleep_range(cmd_us, cmd_us + cmd_us / 8 + 1);
+
+	if (mrq->sbc) {
+		mmc_sim_cmd(sim, mrq->sbc);
+		if (mrq->sbc->error)
+			goto done;
+	}
+
+	mmc_sim_cmd(sim, mrq->cmd);
+	if (mrq->cmd->error || !mrq->data)
+		goto done;
+
+	mrq->data->error = 0;
+	mrq->data->bytes_xfered = 0;
+	mmc_sim_data(sim, mrq->cmd, mrq->data);
+
+	/* Open ended transfers, and failed ones, are stopped with CMD12 */
+	if (mrq->stop && (!mrq->sbc || mrq->data->error))
+		mmc_sim_cmd(sim, mrq->stop);
+
+	if (sim->gc_delay) {
+		usleep_range(sim->gc_delay, sim->gc_delay + sim->gc_delay / 8);
+		sim->gc_delay = 0;
+	}
+done:
+	sim->mrq = NULL;
+	mmc_request_done(sim->mmc, mrq);
+}
+
+static void mmc_sim_request(struct mmc_host *mmc, struct mmc_request *mrq)
+{
+	struct mmc_sim_host *sim = mmc_priv(mmc);
+
+	WARN_ON(sim->mrq);
+	sim->mrq = mrq;
+	schedule_work(&sim->work);
+}
+
+static void mmc_sim_set_ios(struct mmc_host *mmc, struct mmc_ios *ios)
+{
+	struct mmc_sim_host *sim = mmc_priv(mmc);
+
+	if (ios->power_mode == MMC_POWER_OFF)
+		sim->state = R1_STATE_IDLE;
+}
+
+static int mmc_sim_get_ro(struct mmc_host *mmc)
+{
+	return 0;
+}
+
+static int mmc_sim_get_cd(struct mmc_host *mmc)
+{
+	return 1;
+}
+
+static const struct mmc_host_ops mmc_sim_ops = {
+	.request	= mmc_sim_request,
+	.set_ios	= mmc_sim_set_ios,
+	.get_ro		= mmc_sim_get_ro,
+	.get_cd		= mmc_sim_get_cd,
+};
+
+static int __devinit mmc_sim_probe(struct platform_device *pdev)
+{
+	struct mmc_host *mmc;
+	struct mmc_sim_host *sim;
+	int ret;
+
+	mmc = mmc_alloc_host(sizeof(struct mmc_sim_host), &pdev->dev);
+	if (!mmc)
+		return -ENOMEM;
+
+	sim = mmc_priv(mmc);
+	sim->mmc = mmc;
+	INIT_WORK(&sim->work, mmc_sim_work);
+
+	sim->nr_sectors = clamp(size_mb, 1U, 1024U) << 11;
+	sim->ram = vzalloc(sim->nr_sectors * 512);
+	sim->xfer = vmalloc(SIM_MAX_REQ);
+	if (!sim->ram || !sim->xfer) {
+		ret = -ENOMEM;
+		goto err_free;
+	}
+	mmc_sim_init_card(sim);
+
+	mmc->ops = &mmc_sim_ops;
+	mmc->f_min = 400000;
+	mmc->f_max = 52000000;
+	mmc->ocr_avail = MMC_VDD_32_33 | MMC_VDD_33_34;
+	mmc->caps = MMC_CAP_NONREMOVABLE | MMC_CAP_CMD23 | MMC_CAP_ERASE |
+		    MMC_CAP_WAIT_WHILE_BUSY;
+	if (packed)
+		mmc->caps2 = MMC_CAP2_PACKED_WR;
+
+	mmc->max_blk_size = 512;
+	mmc->max_blk_count = SIM_MAX_BLOCKS;
+	mmc->max_req_size = SIM_MAX_REQ;
+	mmc->max_segs = 128;
+	mmc->max_seg_size = SIM_MAX_REQ;
+
+	platform_set_drvdata(pdev, mmc);
+	ret = mmc_add_host(mmc);
+	if (ret)
+		goto err_free;
+
+	dev_info(&pdev->dev, "%u MiB card, packed writes %s\n",
+		 sim->nr_sectors >> 11, packed ? "on" : "off");
+	return 0;
+
+err_free:
+	vfree(sim->xfer);
+	vfree(sim->ram);
+	mmc_free_host(mmc);
+	return ret;
+}
+
+static int __devexit mmc_sim_remove(struct platform_device *pdev)
+{
+	struct mmc_host *mmc = platform_get_drvdata(pdev);
+	struct mmc_sim_host *sim = mmc_priv(mmc);
+
+	mmc_remove_host(mmc);
+	flush_work_sync(&sim->work);
+	vfree(sim->xfer);
+	vfree(sim->ram);
+	mmc_free_host(mmc);
+	platform_set_drvdata(pdev, NULL);
+	return 0;
+}
+
+static struct platform_driver mmc_sim_driver = {
+	.probe		= mmc_sim_probe,
+	.remove		= __devexit_p(mmc_sim_remove),
+	.driver		= {
+		.name	= DRIVER_NAME,
+		.owner	= THIS_MODULE,
+	},
+};
+
+static int __init mmc_sim_init(void)
+{
+	int ret;
+
+	ret = platform_driver_register(&mmc_sim_driver);
+	if (ret)
+		return ret;
+
+	mmc_sim_pdev = platform_device_register_simple(DRIVER_NAME, -1,
+						       NULL, 0);
+	if (IS_ERR(mmc_sim_pdev)) {
+		platform_driver_unregister(&mmc_sim_driver);
+		return PTR_ERR(mmc_sim_pdev);
+	}
+	return 0;
+}
+
+static void __exit mmc_sim_exit(void)
+{
+	platform_device_unregister(mmc_sim_pdev);
+	platform_driver_unregister(&mmc_sim_driver);
+}
+
+module_init(mmc_sim_init);
+module_exit(mmc_sim_exit);
+
+MODULE_DESCRIPTION("Simulated eMMC host and card");
+MODULE_LICENSE("GPL");
@@ -184,6 +184,12 @@ struct adma_desc_table {
 	dma_addr_t addr;
 };
 
+/* A request whose data was mapped for DMA ahead of time by pre_req */
+struct omap_hsmmc_next {
+	unsigned int	dma_len;
+	s32		cookie;
+};
+
 struct omap_hsmmc_host {
 	struct	device		*dev;
 	struct	mmc_host	*mmc;
@@ -230,6 +236,7 @@ struct omap_hsmmc_host {
 	int			use_reg;
 	int			req_in_progress;
 	unsigned int		flags;
+	struct omap_hsmmc_next	next_data;
 
 	struct	omap_mmc_platform_data	*pdata;
 };
@@ -979,8 +986,8 @@ omap_hsmmc_xfer_done(struct omap_hsmmc_host *host, struct mmc_data *data)
 
 	host->data = NULL;
 
-	if (host->dma_type == ADMA_XFER)
-		dma_unmap_sg(mmc_dev(host->mmc), data->sg, host->dma_len,
+	if (host->dma_type == ADMA_XFER && !data->host_cookie)
+		dma_unmap_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
 					omap_hsmmc_get_dma_dir(host, data));
 
 	if (!data->error)
@@ -1059,9 +1066,10 @@ static void omap_hsmmc_dma_cleanup(struct omap_hsmmc_host *host, int errno)
 	spin_unlock(&host->irq_lock);
 
 	if ((host->dma_type == SDMA_XFER) && (dma_ch != -1)) {
-		dma_unmap_sg(mmc_dev(host->mmc), host->data->sg,
-			host->data->sg_len,
-			omap_hsmmc_get_dma_dir(host, host->data));
+		if (!host->data->host_cookie)
+			dma_unmap_sg(mmc_dev(host->mmc), host->data->sg,
+				host->data->sg_len,
+				omap_hsmmc_get_dma_dir(host, host->data));
 		omap_free_dma(dma_ch);
 	}
 	host->data = NULL;
@@ -1478,8 +1486,9 @@ static void omap_hsmmc_dma_cb(int lch, u16 ch_status, void *cb_data)
 		return;
 	}
 
-	dma_unmap_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
-		omap_hsmmc_get_dma_dir(host, data));
+	if (!data->host_cookie)
+		dma_unmap_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
+			     omap_hsmmc_get_dma_dir(host, data));
 
 	req_in_progress = host->req_in_progress;
 	dma_ch = host->dma_ch;
@@ -1497,6 +1506,48 @@ static void omap_hsmmc_dma_cb(int lch, u16 ch_status, void *cb_data)
 	}
 }
 
+/*
+ * Map the data of a request for DMA.  With @next the request is only
+ * being prepared by pre_req while another one is on the bus, and is
+ * tagged with a cookie.  Without, it is about to be started: use the
+ * mapping made by pre_req if the cookie matches, or map it now.
+ */
+static int omap_hsmmc_pre_dma_transfer(struct omap_hsmmc_host *host,
+				       struct mmc_data *data,
+				       struct omap_hsmmc_next *next)
+{
+	int dma_len;
+
+	if (!next && data->host_cookie &&
+	    data->host_cookie != host->next_data.cookie) {
+		dev_warn(mmc_dev(host->mmc), "invalid cookie: "
+			 "data->host_cookie %d host->next_data.cookie %d\n",
+			 data->host_cookie, host->next_data.cookie);
+		data->host_cookie = 0;
+	}
+
+	/* Check if next job is already prepared */
+	if (next || data->host_cookie != host->next_data.cookie) {
+		dma_len = dma_map_sg(mmc_dev(host->mmc), data->sg,
+				     data->sg_len,
+				     omap_hsmmc_get_dma_dir(host, data));
+	} else {
+		dma_len = host->next_data.dma_len;
+		host->next_data.dma_len = 0;
+	}
+
+	if (dma_len == 0)
+		return -EINVAL;
+
+	if (next) {
+		next->dma_len = dma_len;
+		data->host_cookie = ++next->cookie < 0 ? 1 : next->cookie;
+	} else
+		host->dma_len = dma_len;
+
+	return 0;
+}
+
 /*
  * Routine to configure and start DMA for the MMC card
  */
@@ -1531,8 +1582,11 @@ static int omap_hsmmc_start_sdma_transfer(struct omap_hsmmc_host *host,
 		return ret;
 	}
 
-	host->dma_len = dma_map_sg(mmc_dev(host->mmc), data->sg,
-			data->sg_len, omap_hsmmc_get_dma_dir(host, data));
+	ret = omap_hsmmc_pre_dma_transfer(host, data, NULL);
+	if (ret) {
+		omap_free_dma(dma_ch);
+		return ret;
+	}
 	host->dma_ch = dma_ch;
 	host->dma_sg_idx = 0;
 
@@ -1550,8 +1604,8 @@ static int mmc_populate_adma_desc_table(struct omap_hsmmc_host *host,
 	dma_addr_t dmaaddr;
 	struct mmc_data *data = req->data;
 
-	host->dma_len = dma_map_sg(mmc_dev(host->mmc), data->sg,
-			data->sg_len, omap_hsmmc_get_dma_dir(host, data));
+	if (omap_hsmmc_pre_dma_transfer(host, data, NULL))
+		return 0;
 	for (i = 0, j = 0; i < host->dma_len; i++) {
 		dmaaddr = sg_dma_address(data->sg + i);
 		dmalen = sg_dma_len(data->sg + i);
@@ -1672,6 +1726,8 @@ omap_hsmmc_prepare_data(struct omap_hsmmc_host *host, struct mmc_request *req)
 	} else if (host->dma_type == ADMA_XFER) {
 		numblks = mmc_populate_adma_desc_table(host,
 				req, host->adma_table);
+		if (!numblks)
+			return -EINVAL;
 		WARN_ON(numblks != req->data->blocks);
 		omap_hsmmc_start_adma_transfer(host);
 	}
@@ -1753,6 +1809,36 @@ static void omap_hsmmc_request(struct mmc_host *mmc, struct mmc_request *req)
 	omap_hsmmc_start_command(host, req->cmd, req->data, 0);
 }
 
+static void omap_hsmmc_post_req(struct mmc_host *mmc, struct mmc_request *mrq,
+				int err)
+{
+	struct omap_hsmmc_host *host = mmc_priv(mmc);
+	struct mmc_data *data = mrq->data;
+
+	if (data && data->host_cookie) {
+		dma_unmap_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
+			     omap_hsmmc_get_dma_dir(host, data));
+		data->host_cookie = 0;
+	}
+}
+
+static void omap_hsmmc_pre_req(struct mmc_host *mmc, struct mmc_request *mrq,
+			       bool is_first_req)
+{
+	struct omap_hsmmc_host *host = mmc_priv(mmc);
+
+	if (!mrq->data)
+		return;
+
+	if (mrq->data->host_cookie) {
+		mrq->data->host_cookie = 0;
+		return;
+	}
+
+	if (omap_hsmmc_pre_dma_transfer(host, mrq->data, &host->next_data))
+		mrq->data->host_cookie = 0;
+}
+
 /* Routine to configure clock values. Exposed API to core */
 static void omap_hsmmc_set_ios(struct mmc_host *mmc, struct mmc_ios *ios)
 {
@@ -2158,6 +2244,8 @@ static int omap_hsmmc_disable_simple(struct mmc_host *mmc, int lazy)
 static const struct mmc_host_ops omap_hsmmc_ops = {
 	.enable = omap_hsmmc_enable_simple,
 	.disable = omap_hsmmc_disable_simple,
+	.pre_req = omap_hsmmc_pre_req,
+	.post_req = omap_hsmmc_post_req,
 	.request = omap_hsmmc_request,
 	.set_ios = omap_hsmmc_set_ios,
 	.get_cd = omap_hsmmc_get_cd,
@@ -2169,6 +2257,8 @@ static const struct mmc_host_ops omap_hsmmc_ops = {
 static const struct mmc_host_ops omap_hsmmc_ps_ops = {
 	.enable = omap_hsmmc_enable,
 	.disable = omap_hsmmc_disable,
+	.pre_req = omap_hsmmc_pre_req,
+	.post_req = omap_hsmmc_post_req,
 	.request = omap_hsmmc_request,
 	.set_ios = omap_hsmmc_set_ios,
 	.get_cd = omap_hsmmc_get_cd,
@@ -2405,6 +2495,7 @@ static int __init omap_hsmmc_probe(struct platform_device *pdev)
 		     MMC_CAP_WAIT_WHILE_BUSY | MMC_CAP_ERASE | MMC_CAP_CMD23;
 
 	mmc->caps |= mmc_slot(host).caps;
+	mmc->caps2 |= mmc_slot(host).caps2;
 	if (mmc->caps & MMC_CAP_8_BIT_DATA)
 		mmc->caps |= MMC_CAP_4_BIT_DATA;
 
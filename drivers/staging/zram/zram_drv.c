@@ -30,6 +30,7 @@
 #include <linux/highmem.h>
 #include <linux/slab.h>
 #include <linux/lzo.h>
+#include <linux/lz4.h>
 #include <linux/string.h>
 #include <linux/vmalloc.h>
 
@@ -42,6 +43,41 @@ struct zram *devices;
 /* Module params (documentation at end) */
 unsigned int num_devices;
 
+/*
+ * Compression backend, selected at build time.  Both return 0 on success
+ * and a negative value on failure.
+ */
+#ifdef CONFIG_ZRAM_LZ4
+#define ZRAM_COMPRESS_WORKMEM	LZ4_MEM_COMPRESS
+
+static inline int zram_compress(const unsigned char *src, unsigned char *dst,
+				size_t *dst_len, void *wrkmem)
+{
+	*dst_len = 2 * PAGE_SIZE;	/* size of compress_buffer */
+	return lz4_compress(src, PAGE_SIZE, dst, dst_len, wrkmem);
+}
+
+static inline int zram_decompress(const unsigned char *src, size_t src_len,
+				  unsigned char *dst, size_t *dst_len)
+{
+	return lz4_decompress_unknownoutputsize(src, src_len, dst, dst_len);
+}
+#else
+#define ZRAM_COMPRESS_WORKMEM	LZO1X_MEM_COMPRESS
+
+static inline int zram_compress(const unsigned char *src, unsigned char *dst,
+				size_t *dst_len, void *wrkmem)
+{
+	return lzo1x_1_compress(src, PAGE_SIZE, dst, dst_len, wrkmem);
+}
+
+static inline int zram_decompress(const unsigned char *src, size_t src_len,
+				  unsigned char *dst, size_t *dst_len)
+{
+	return lzo1x_decompress_safe(src, src_len, dst, dst_len);
+}
+#endif
+
 static void zram_stat_inc(u32 *v)
 {
 	*v = *v + 1;
@@ -251,7 +287,7 @@ static void zram_read(struct zram *zram, struct bio *bio)
 		cmem = kmap_atomic(zram->table[index].page, KM_USER1) +
 				zram->table[index].offset;
 
-		ret = lzo1x_decompress_safe(
+		ret = zram_decompress(
 			cmem + sizeof(*zheader),
 			xv_get_object_size(cmem) - sizeof(*zheader),
 			user_mem, &clen);
@@ -260,7 +296,7 @@ static void zram_read(struct zram *zram, struct bio *bio)
 		kunmap_atomic(cmem, KM_USER1);
 
 		/* Should NEVER happen. Return bio error if it does. */
-		if (unlikely(ret != LZO_E_OK)) {
+		if (unlikely(ret)) {
 			pr_err("Decompression failed! err=%d, page=%u\n",
 				ret, index);
 			zram_stat64_inc(zram, &zram->stats.failed_reads);
@@ -319,12 +355,12 @@ static void zram_write(struct zram *zram, struct bio *bio)
 			continue;
 		}
 
-		ret = lzo1x_1_compress(user_mem, PAGE_SIZE, src, &clen,
-					zram->compress_workmem);
+		ret = zram_compress(user_mem, src, &clen,
+				    zram->compress_workmem);
 
 		kunmap_atomic(user_mem, KM_USER0);
 
-		if (unlikely(ret != LZO_E_OK)) {
+		if (unlikely(ret)) {
 			mutex_unlock(&zram->lock);
 			pr_err("Compression failed! err=%d\n", ret);
 			zram_stat64_inc(zram, &zram->stats.failed_writes);
@@ -511,7 +547,7 @@ int zram_init_device(struct zram *zram)
 
 	zram_set_disksize(zram, totalram_pages << PAGE_SHIFT);
 
-	zram->compress_workmem = kzalloc(LZO1X_MEM_COMPRESS, GFP_KERNEL);
+	zram->compress_workmem = kzalloc(ZRAM_COMPRESS_WORKMEM, GFP_KERNEL);
 	if (!zram->compress_workmem) {
 		pr_err("Error allocating compressor working memory!\n");
 		ret = -ENOMEM;
@@ -435,6 +435,8 @@ int ext4_should_retry_alloc(struct super_block *sb, int *retries)
 
 	jbd_debug(1, "%s: retrying operation after ENOSPC\n", sb->s_id);
 
+	if (ext4_mb_flush_discards(sb))
+		return 1;
 	return jbd2_journal_force_commit_nested(EXT4_SB(sb)->s_journal);
 }
 
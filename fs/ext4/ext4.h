@@ -27,6 +27,7 @@
 #include <linux/mutex.h>
 #include <linux/timer.h>
 #include <linux/wait.h>
+#include <linux/workqueue.h>
 #include <linux/blockgroup_lock.h>
 #include <linux/percpu_counter.h>
 #ifdef __KERNEL__
@@ -1192,6 +1193,22 @@ struct ext4_sb_info {
 	atomic_t s_mb_discarded;
 	atomic_t s_lock_busy;
 
+	/* freed extents waiting to be discarded, see ext4_discard_work() */
+	spinlock_t s_discard_lock;
+	struct mutex s_discard_mutex;
+	struct list_head s_discard_list;
+	unsigned long s_discard_pending;	/* in blocks */
+	struct delayed_work s_discard_work;
+	unsigned int s_discard_async;
+	unsigned int s_discard_batch_kb;
+	unsigned int s_discard_interval_ms;
+	unsigned int s_discard_max_delay_ms;
+	unsigned long long s_discard_kbytes;
+	unsigned long s_discard_cmds;
+	unsigned long s_discard_deferred;
+	u64 s_discard_time_us;
+	unsigned int s_discard_max_us;
+
 	/* locality groups */
 	struct ext4_locality_group __percpu *s_locality_groups;
 
@@ -1797,6 +1814,7 @@ extern int ext4_mb_add_groupinfo(struct super_block *sb,
 extern void ext4_add_groupblocks(handle_t *handle, struct super_block *sb,
 				ext4_fsblk_t block, unsigned long count);
 extern int ext4_trim_fs(struct super_block *, struct fstrim_range *);
+extern int ext4_mb_flush_discards(struct super_block *);
 
 /* inode.c */
 struct buffer_head *ext4_getblk(handle_t *, struct inode *,
@@ -3038,6 +3038,12 @@ retry:
 			 * and try again
 			 */
 			jbd2_journal_force_commit_nested(sbi->s_journal);
+			/*
+			 * with async discard the blocks it released are
+			 * queued for discard rather than freed, so discard
+			 * and free them now
+			 */
+			ext4_mb_flush_discards(inode->i_sb);
 			ret = 0;
 		} else if (ret == MPAGE_DA_EXTENT_TAIL) {
 			/*
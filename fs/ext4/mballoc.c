@@ -24,6 +24,7 @@
 #include "mballoc.h"
 #include <linux/debugfs.h>
 #include <linux/slab.h>
+#include <linux/list_sort.h>
 #include <trace/events/ext4.h>
 
 /*
@@ -356,6 +357,7 @@ static void ext4_mb_generate_from_pa(struct super_block *sb, void *bitmap,
 static void ext4_mb_generate_from_freelist(struct super_block *sb, void *bitmap,
 						ext4_group_t group);
 static void release_blocks_on_commit(journal_t *journal, transaction_t *txn);
+static void ext4_discard_work(struct work_struct *work);
 
 static inline void *mb_correct_addr_and_bit(int *bit, void *addr)
 {
@@ -2465,6 +2467,10 @@ int ext4_mb_init(struct super_block *sb, int needs_recovery)
 
 	spin_lock_init(&sbi->s_md_lock);
 	spin_lock_init(&sbi->s_bal_lock);
+	spin_lock_init(&sbi->s_discard_lock);
+	mutex_init(&sbi->s_discard_mutex);
+	INIT_LIST_HEAD(&sbi->s_discard_list);
+	INIT_DELAYED_WORK(&sbi->s_discard_work, ext4_discard_work);
 
 	sbi->s_mb_max_to_scan = MB_DEFAULT_MAX_TO_SCAN;
 	sbi->s_mb_min_to_scan = MB_DEFAULT_MIN_TO_SCAN;
@@ -2473,6 +2479,11 @@ int ext4_mb_init(struct super_block *sb, int needs_recovery)
 	sbi->s_mb_order2_reqs = MB_DEFAULT_ORDER2_REQS;
 	sbi->s_mb_group_prealloc = MB_DEFAULT_GROUP_PREALLOC;
 
+	sbi->s_discard_async = MB_DEFAULT_DISCARD_ASYNC;
+	sbi->s_discard_batch_kb = MB_DEFAULT_DISCARD_BATCH_KB;
+	sbi->s_discard_interval_ms = MB_DEFAULT_DISCARD_INTERVAL_MS;
+	sbi->s_discard_max_delay_ms = MB_DEFAULT_DISCARD_MAX_DELAY_MS;
+
 	sbi->s_locality_groups = alloc_percpu(struct ext4_locality_group);
 	if (sbi->s_locality_groups == NULL) {
 		ret = -ENOMEM;
@@ -2528,6 +2539,10 @@ int ext4_mb_release(struct super_block *sb)
 	struct ext4_sb_info *sbi = EXT4_SB(sb);
 	struct kmem_cache *cachep = get_groupinfo_cache(sb->s_blocksize_bits);
 
+	/* the extents still queued for discard pin their buddy pages */
+	cancel_delayed_work_sync(&sbi->s_discard_work);
+	ext4_mb_flush_discards(sb);
+
 	if (sbi->s_group_info) {
 		for (i = 0; i < ngroups; i++) {
 			grinfo = ext4_get_group_info(sb, i);
@@ -2592,6 +2607,215 @@ static inline int ext4_issue_discard(struct super_block *sb,
 	return sb_issue_discard(sb, discard_block, count, GFP_NOFS, 0);
 }
 
+/*
+ * Puts a freed extent, whose transaction has committed, back into the
+ * buddy, where it can be allocated again.
+ */
+static void ext4_free_data_release(struct super_block *sb,
+				   struct ext4_free_data *entry)
+{
+	struct ext4_buddy e4b;
+	struct ext4_group_info *db;
+	int err;
+
+	err = ext4_mb_load_buddy(sb, entry->group, &e4b);
+	/* we expect to find existing buddy because it's pinned */
+	BUG_ON(err != 0);
+
+	db = e4b.bd_info;
+	ext4_lock_group(sb, entry->group);
+	/* Take it out of per group rb tree */
+	rb_erase(&entry->node, &(db->bb_free_root));
+	mb_free_blocks(NULL, &e4b, entry->start_blk, entry->count);
+
+	if (!db->bb_free_root.rb_node) {
+		/* No more items in the per group rb tree
+		 * balance refcounts from ext4_mb_free_metadata()
+		 */
+		page_cache_release(e4b.bd_buddy_page);
+		page_cache_release(e4b.bd_bitmap_page);
+	}
+	ext4_unlock_group(sb, entry->group);
+	kmem_cache_free(ext4_free_ext_cachep, entry);
+	ext4_mb_unload_buddy(&e4b);
+}
+
+/*
+ * Asynchronous discard
+ *
+ * With -o discard, the extents freed by a transaction used to be discarded
+ * one by one from the commit callback, which holds up the commit for as
+ * long as the eMMC takes to erase them.  Instead they are queued here, still
+ * out of the buddy so that nothing can be written to them before the
+ * discard, and a work item discards them in the background: in batches of
+ * discard_batch_kb every discard_interval_ms, sorted so that neighbouring
+ * extents go out as one discard, and only while the device has no requests
+ * unless the oldest extent has waited for discard_max_delay_ms.
+ */
+static void ext4_discard_queue(struct super_block *sb,
+			       struct ext4_free_data *entry)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+
+	entry->discard_time = jiffies;
+	spin_lock(&sbi->s_discard_lock);
+	list_add_tail(&entry->list, &sbi->s_discard_list);
+	sbi->s_discard_pending += entry->count;
+	spin_unlock(&sbi->s_discard_lock);
+}
+
+static unsigned long ext4_discard_interval(struct ext4_sb_info *sbi)
+{
+	return max(msecs_to_jiffies(sbi->s_discard_interval_ms), 1UL);
+}
+
+static int ext4_discard_cmp(void *priv, struct list_head *a,
+			    struct list_head *b)
+{
+	struct ext4_free_data *ea, *eb;
+
+	ea = list_entry(a, struct ext4_free_data, list);
+	eb = list_entry(b, struct ext4_free_data, list);
+	if (ea->group != eb->group)
+		return ea->group < eb->group ? -1 : 1;
+	return ea->start_blk - eb->start_blk;
+}
+
+/*
+ * No requests allocated on its queue, so none waiting or in flight.  A
+ * bio-based queue (dm, md, loop) allocates no requests, so for those the
+ * I/O in flight on the whole disk is used instead; a driver that does not
+ * account it always looks idle.
+ */
+static bool ext4_discard_idle(struct super_block *sb)
+{
+	struct block_device *bdev = sb->s_bdev;
+	struct request_queue *q = bdev_get_queue(bdev);
+
+	if (!q->request_fn)
+		return !part_in_flight(&bdev->bd_disk->part0);
+	return !q->rq.count[BLK_RW_SYNC] && !q->rq.count[BLK_RW_ASYNC];
+}
+
+static void ext4_discard_extent(struct super_block *sb, ext4_group_t group,
+				ext4_grpblk_t start, ext4_grpblk_t count)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	ktime_t t0 = ktime_get();
+	unsigned int us;
+
+	ext4_issue_discard(sb, group, start, count);
+
+	us = ktime_to_us(ktime_sub(ktime_get(), t0));
+	sbi->s_discard_cmds++;
+	sbi->s_discard_kbytes += (u64)count << (sb->s_blocksize_bits - 10);
+	sbi->s_discard_time_us += us;
+	if (us > sbi->s_discard_max_us)
+		sbi->s_discard_max_us = us;
+}
+
+/*
+ * Discards up to max_kb of the queued extents, or all of them if max_kb is
+ * 0, and frees them.  Returns the number of blocks freed.
+ */
+static unsigned long ext4_discard_batch(struct super_block *sb,
+					unsigned int max_kb)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	unsigned long limit = ULONG_MAX, taken = 0;
+	struct ext4_free_data *entry, *tmp, *run = NULL;
+	ext4_grpblk_t run_len = 0;
+	LIST_HEAD(batch);
+
+	if (max_kb)
+		limit = max_kb >> (sb->s_blocksize_bits - 10);
+
+	mutex_lock(&sbi->s_discard_mutex);
+	spin_lock(&sbi->s_discard_lock);
+	while (!list_empty(&sbi->s_discard_list)) {
+		entry = list_first_entry(&sbi->s_discard_list,
+					 struct ext4_free_data, list);
+		if (taken && taken + entry->count > limit)
+			break;
+		list_move_tail(&entry->list, &batch);
+		taken += entry->count;
+	}
+	sbi->s_discard_pending -= taken;
+	spin_unlock(&sbi->s_discard_lock);
+
+	list_sort(NULL, &batch, ext4_discard_cmp);
+	list_for_each_entry(entry, &batch, list) {
+		if (run && run->group == entry->group &&
+		    run->start_blk + run_len == entry->start_blk) {
+			run_len += entry->count;
+			continue;
+		}
+		if (run)
+			ext4_discard_extent(sb, run->group, run->start_blk,
+					    run_len);
+		run = entry;
+		run_len = entry->count;
+	}
+	if (run)
+		ext4_discard_extent(sb, run->group, run->start_blk, run_len);
+
+	list_for_each_entry_safe(entry, tmp, &batch, list) {
+		list_del(&entry->list);
+		ext4_free_data_release(sb, entry);
+	}
+	mutex_unlock(&sbi->s_discard_mutex);
+
+	return taken;
+}
+
+static void ext4_discard_work(struct work_struct *work)
+{
+	struct ext4_sb_info *sbi = container_of(to_delayed_work(work),
+					struct ext4_sb_info, s_discard_work);
+	struct super_block *sb = sbi->s_buddy_cache->i_sb;
+	struct ext4_free_data *entry;
+	unsigned long oldest;
+
+	spin_lock(&sbi->s_discard_lock);
+	if (list_empty(&sbi->s_discard_list)) {
+		spin_unlock(&sbi->s_discard_lock);
+		return;
+	}
+	entry = list_first_entry(&sbi->s_discard_list,
+				 struct ext4_free_data, list);
+	oldest = entry->discard_time;
+	spin_unlock(&sbi->s_discard_lock);
+
+	if (!ext4_discard_idle(sb) &&
+	    time_before(jiffies, oldest +
+			msecs_to_jiffies(sbi->s_discard_max_delay_ms)))
+		sbi->s_discard_deferred++;
+	else
+		ext4_discard_batch(sb, sbi->s_discard_batch_kb);
+
+	if (!list_empty(&sbi->s_discard_list))
+		queue_delayed_work(system_nrt_wq, &sbi->s_discard_work,
+				   ext4_discard_interval(sbi));
+}
+
+/*
+ * Discards and frees the queued extents now, for when an allocation runs
+ * out of space.  Returns 1 if there were any.  A caller with a handle
+ * running keeps its transaction from committing meanwhile, so it only
+ * gets one batch of discard_batch_kb.
+ */
+int ext4_mb_flush_discards(struct super_block *sb)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	unsigned int max_kb = 0;
+
+	if (list_empty(&sbi->s_discard_list))
+		return 0;
+	if (ext4_journal_current_handle())
+		max_kb = max(sbi->s_discard_batch_kb, 1U);
+	return ext4_discard_batch(sb, max_kb) != 0;
+}
+
 /*
  * This function is called by the jbd2 layer once the commit has finished,
  * so we know we can free the blocks that were released with that commit.
@@ -2599,9 +2823,8 @@ static inline int ext4_issue_discard(struct super_block *sb,
 static void release_blocks_on_commit(journal_t *journal, transaction_t *txn)
 {
 	struct super_block *sb = journal->j_private;
-	struct ext4_buddy e4b;
-	struct ext4_group_info *db;
-	int err, count = 0, count2 = 0;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	int count = 0, count2 = 0, queued = 0;
 	struct ext4_free_data *entry;
 	struct list_head *l, *ltmp;
 
@@ -2611,35 +2834,28 @@ static void release_blocks_on_commit(journal_t *journal, transaction_t *txn)
 		mb_debug(1, "gonna free %u blocks in group %u (0x%p):",
 			 entry->count, entry->group, entry);
 
-		if (test_opt(sb, DISCARD))
-			ext4_issue_discard(sb, entry->group,
-					   entry->start_blk, entry->count);
-
-		err = ext4_mb_load_buddy(sb, entry->group, &e4b);
-		/* we expect to find existing buddy because it's pinned */
-		BUG_ON(err != 0);
-
-		db = e4b.bd_info;
 		/* there are blocks to put in buddy to make them really free */
 		count += entry->count;
 		count2++;
-		ext4_lock_group(sb, entry->group);
-		/* Take it out of per group rb tree */
-		rb_erase(&entry->node, &(db->bb_free_root));
-		mb_free_blocks(NULL, &e4b, entry->start_blk, entry->count);
-
-		if (!db->bb_free_root.rb_node) {
-			/* No more items in the per group rb tree
-			 * balance refcounts from ext4_mb_free_metadata()
-			 */
-			page_cache_release(e4b.bd_buddy_page);
-			page_cache_release(e4b.bd_bitmap_page);
+
+		if (test_opt(sb, DISCARD)) {
+			if (sbi->s_discard_async) {
+				list_del(&entry->list);
+				ext4_discard_queue(sb, entry);
+				queued++;
+				continue;
+			}
+			ext4_issue_discard(sb, entry->group,
+					   entry->start_blk, entry->count);
 		}
-		ext4_unlock_group(sb, entry->group);
-		kmem_cache_free(ext4_free_ext_cachep, entry);
-		ext4_mb_unload_buddy(&e4b);
+
+		ext4_free_data_release(sb, entry);
 	}
 
+	if (queued)
+		queue_delayed_work(system_nrt_wq, &sbi->s_discard_work,
+				   ext4_discard_interval(sbi));
+
 	mb_debug(1, "freed %u blocks in %u structures\n", count, count2);
 }
 
@@ -94,6 +94,17 @@ extern u8 mb_enable_debug;
  */
 #define MB_DEFAULT_GROUP_PREALLOC	512
 
+/*
+ * with -o discard, freed extents are discarded in the background: up to
+ * MB_DEFAULT_DISCARD_BATCH_KB every MB_DEFAULT_DISCARD_INTERVAL_MS while
+ * the device is idle, or regardless once the oldest has waited for
+ * MB_DEFAULT_DISCARD_MAX_DELAY_MS
+ */
+#define MB_DEFAULT_DISCARD_ASYNC	1
+#define MB_DEFAULT_DISCARD_BATCH_KB	16384
+#define MB_DEFAULT_DISCARD_INTERVAL_MS	200
+#define MB_DEFAULT_DISCARD_MAX_DELAY_MS	10000
+
 
 struct ext4_free_data {
 	/* this links the free block information from group_info */
@@ -111,6 +122,9 @@ struct ext4_free_data {
 
 	/* transaction which freed this extent */
 	tid_t	t_tid;
+
+	/* jiffies when it was queued for discard */
+	unsigned long discard_time;
 };
 
 struct ext4_prealloc_space {
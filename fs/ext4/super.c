@@ -89,7 +89,7 @@ static struct file_system_type ext2_fs_type = {
 	.name		= "ext2",
 	.mount		= ext4_mount,
 	.kill_sb	= kill_block_super,
-	.fs_flags	= FS_REQUIRES_DEV,
+	.fs_flags	= FS_REQUIRES_DEV | FS_FIEMAP_BDEV,
 };
 #define IS_EXT2_SB(sb) ((sb)->s_bdev->bd_holder == &ext2_fs_type)
 #else
@@ -103,7 +103,7 @@ static struct file_system_type ext3_fs_type = {
 	.name		= "ext3",
 	.mount		= ext4_mount,
 	.kill_sb	= kill_block_super,
-	.fs_flags	= FS_REQUIRES_DEV,
+	.fs_flags	= FS_REQUIRES_DEV | FS_FIEMAP_BDEV,
 };
 #define IS_EXT3_SB(sb) ((sb)->s_bdev->bd_holder == &ext3_fs_type)
 #else
@@ -2479,6 +2479,21 @@ static ssize_t inode_readahead_blks_store(struct ext4_attr *a,
 	return count;
 }
 
+static ssize_t discard_stats_show(struct ext4_attr *a,
+				  struct ext4_sb_info *sbi, char *buf)
+{
+	struct super_block *sb = sbi->s_buddy_cache->i_sb;
+	unsigned long cmds = sbi->s_discard_cmds;
+
+	return snprintf(buf, PAGE_SIZE,
+			"pending_kb %lu\ndiscarded_kb %llu\ndiscards %lu\n"
+			"deferred %lu\navg_us %llu\nmax_us %u\n",
+			sbi->s_discard_pending << (sb->s_blocksize_bits - 10),
+			sbi->s_discard_kbytes, cmds, sbi->s_discard_deferred,
+			cmds ? div_u64(sbi->s_discard_time_us, cmds) : 0,
+			sbi->s_discard_max_us);
+}
+
 static ssize_t sbi_ui_show(struct ext4_attr *a,
 			   struct ext4_sb_info *sbi, char *buf)
 {
@@ -2522,6 +2537,7 @@ EXT4_RO_ATTR(session_write_kbytes);
 EXT4_RO_ATTR(lifetime_write_kbytes);
 EXT4_RO_ATTR(extent_cache_hits);
 EXT4_RO_ATTR(extent_cache_misses);
+EXT4_RO_ATTR(discard_stats);
 EXT4_ATTR_OFFSET(inode_readahead_blks, 0644, sbi_ui_show,
 		 inode_readahead_blks_store, s_inode_readahead_blks);
 EXT4_RW_ATTR_SBI_UI(inode_goal, s_inode_goal);
@@ -2532,6 +2548,10 @@ EXT4_RW_ATTR_SBI_UI(mb_order2_req, s_mb_order2_reqs);
 EXT4_RW_ATTR_SBI_UI(mb_stream_req, s_mb_stream_request);
 EXT4_RW_ATTR_SBI_UI(mb_group_prealloc, s_mb_group_prealloc);
 EXT4_RW_ATTR_SBI_UI(max_writeback_mb_bump, s_max_writeback_mb_bump);
+EXT4_RW_ATTR_SBI_UI(discard_async, s_discard_async);
+EXT4_RW_ATTR_SBI_UI(discard_batch_kb, s_discard_batch_kb);
+EXT4_RW_ATTR_SBI_UI(discard_interval_ms, s_discard_interval_ms);
+EXT4_RW_ATTR_SBI_UI(discard_max_delay_ms, s_discard_max_delay_ms);
 
 static struct attribute *ext4_attrs[] = {
 	ATTR_LIST(delayed_allocation_blocks),
@@ -2548,6 +2568,11 @@ static struct attribute *ext4_attrs[] = {
 	ATTR_LIST(mb_stream_req),
 	ATTR_LIST(mb_group_prealloc),
 	ATTR_LIST(max_writeback_mb_bump),
+	ATTR_LIST(discard_async),
+	ATTR_LIST(discard_batch_kb),
+	ATTR_LIST(discard_interval_ms),
+	ATTR_LIST(discard_max_delay_ms),
+	ATTR_LIST(discard_stats),
 	NULL,
 };
 
@@ -4898,7 +4923,7 @@ static struct file_system_type ext4_fs_type = {
 	.name		= "ext4",
 	.mount		= ext4_mount,
 	.kill_sb	= kill_block_super,
-	.fs_flags	= FS_REQUIRES_DEV,
+	.fs_flags	= FS_REQUIRES_DEV | FS_FIEMAP_BDEV,
 };
 
 static int __init ext4_init_feat_adverts(void)
@@ -30,6 +30,7 @@
 #include "squashfs_fs_sb.h"
 #include "decompressor.h"
 #include "squashfs.h"
+#include "page_actor.h"
 
 /*
  * This file (and decompressor.h) implements a decompressor framework for
@@ -52,6 +53,12 @@ static const struct squashfs_decompressor squashfs_xz_comp_ops = {
 };
 #endif
 
+#ifndef CONFIG_SQUASHFS_LZ4
+static const struct squashfs_decompressor squashfs_lz4_comp_ops = {
+	NULL, NULL, NULL, LZ4_COMPRESSION, "lz4", 0
+};
+#endif
+
 static const struct squashfs_decompressor squashfs_unknown_comp_ops = {
 	NULL, NULL, NULL, 0, "unknown", 0
 };
@@ -60,6 +67,7 @@ static const struct squashfs_decompressor *decompressor[] = {
 	&squashfs_zlib_comp_ops,
 	&squashfs_lzo_comp_ops,
 	&squashfs_xz_comp_ops,
+	&squashfs_lz4_comp_ops,
 	&squashfs_lzma_unsupported_comp_ops,
 	&squashfs_unknown_comp_ops
 };
@@ -81,6 +89,7 @@ void *squashfs_decompressor_init(struct super_block *sb, unsigned short flags)
 {
 	struct squashfs_sb_info *msblk = sb->s_fs_info;
 	void *strm, *buffer = NULL;
+	struct squashfs_page_actor *actor = NULL;
 	int length = 0;
 
 	/*
@@ -91,9 +100,14 @@ void *squashfs_decompressor_init(struct super_block *sb, unsigned short flags)
 		if (buffer == NULL)
 			return ERR_PTR(-ENOMEM);
 
-		length = squashfs_read_data(sb, &buffer,
-			sizeof(struct squashfs_super_block), 0, NULL,
-			PAGE_CACHE_SIZE, 1);
+		actor = squashfs_page_actor_init(&buffer, 1, 0);
+		if (actor == NULL) {
+			strm = ERR_PTR(-ENOMEM);
+			goto finished;
+		}
+
+		length = squashfs_read_data(sb,
+			sizeof(struct squashfs_super_block), 0, NULL, actor);
 
 		if (length < 0) {
 			strm = ERR_PTR(length);
@@ -101,9 +115,10 @@ void *squashfs_decompressor_init(struct super_block *sb, unsigned short flags)
 		}
 	}
 
-	strm = msblk->decompressor->init(msblk, buffer, length);
+	strm = squashfs_decompressor_create(msblk, buffer, length);
 
 finished:
+	kfree(actor);
 	kfree(buffer);
 
 	return strm;
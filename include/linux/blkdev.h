@@ -28,6 +28,9 @@ struct request_queue;
 struct elevator_queue;
 struct request_pm_state;
 struct blk_trace;
+struct blk_stage;
+struct blk_lat_hist;
+struct rq_wb;
 struct request;
 struct sg_io_hdr;
 
@@ -126,6 +129,14 @@ struct request {
 #ifdef CONFIG_BLK_CGROUP
 	unsigned long long start_time_ns;
 	unsigned long long io_start_time_ns;    /* when passed to hardware */
+#endif
+#ifdef CONFIG_BLK_DEV_LATENCY_HIST
+	u64 lat_start_ns;		/* made from its first bio */
+	u64 lat_issue_ns;		/* passed to the driver */
+	unsigned short lat_class;	/* ioprio class of the submitter */
+#endif
+#ifdef CONFIG_BLK_WBT
+	u64 wbt_issue_ns;		/* read passed to the driver */
 #endif
 	/* Number of scatter-gather DMA addr+len pairs after
 	 * physical address coalescing is performed.
@@ -375,6 +386,21 @@ struct request_queue
 
 	struct mutex		sysfs_lock;
 
+	/*
+	 * per-cpu request staging, see blk_queue_stage()
+	 */
+	struct blk_stage __percpu *stage;
+	unsigned int		stage_batch;
+
+#ifdef CONFIG_BLK_DEV_LATENCY_HIST
+	struct blk_lat_hist __percpu *lat_hist;
+	bool			lat_hist_on;
+#endif
+
+#ifdef CONFIG_BLK_WBT
+	struct rq_wb		*rq_wb;
+#endif
+
 #if defined(CONFIG_BLK_DEV_BSG)
 	struct bsg_class_device bsg_dev;
 #endif
@@ -701,6 +727,7 @@ extern void __blk_stop_queue(struct request_queue *q);
 extern void __blk_run_queue(struct request_queue *q);
 extern void blk_run_queue(struct request_queue *);
 extern void blk_run_queue_async(struct request_queue *q);
+extern int blk_queue_stage(struct request_queue *q, unsigned int batch);
 extern int blk_rq_map_user(struct request_queue *, struct request *,
 			   struct rq_map_data *, void __user *, unsigned long,
 			   gfp_t);
@@ -862,6 +889,8 @@ struct blk_plug {
 	struct list_head list;
 	struct list_head cb_list;
 	unsigned int should_sort;
+	struct request_queue *stage_q;	/* queue and cpu staged to */
+	int stage_cpu;
 };
 struct blk_plug_cb {
 	struct list_head list;
@@ -892,7 +921,8 @@ static inline bool blk_needs_flush_plug(struct task_struct *tsk)
 {
 	struct blk_plug *plug = tsk->plug;
 
-	return plug && (!list_empty(&plug->list) || !list_empty(&plug->cb_list));
+	return plug && (!list_empty(&plug->list) ||
+			!list_empty(&plug->cb_list) || plug->stage_q);
 }
 
 /*
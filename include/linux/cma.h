@@ -0,0 +1,71 @@
+#ifndef _LINUX_CMA_H
+#define _LINUX_CMA_H
+
+/*
+ * Contiguous Memory Allocator
+ *
+ * A contiguous memory area is reserved from memblock at boot and given to
+ * the page allocator, which fills it with movable pages only: page cache
+ * and anonymous memory.  cma_alloc() migrates whatever is in the way out
+ * of the range it picks and hands the range to the driver.
+ *
+ * See mm/cma.c.
+ */
+
+#include <linux/errno.h>
+#include <linux/types.h>
+
+struct cma;
+struct page;
+
+#ifdef CONFIG_CMA
+
+#define MAX_CMA_AREAS		4
+
+extern int cma_declare_contiguous(phys_addr_t size, phys_addr_t base,
+				  phys_addr_t limit, const char *name,
+				  struct cma **res_cma);
+extern struct page *cma_alloc(struct cma *cma, unsigned long count,
+			      unsigned int align);
+extern bool cma_release(struct cma *cma, struct page *pages,
+			unsigned long count);
+extern phys_addr_t cma_get_base(struct cma *cma);
+extern unsigned long cma_get_size(struct cma *cma);
+
+/* Called for each area as it is reserved, for the architecture's use */
+extern void cma_early_fixup(phys_addr_t base, phys_addr_t size);
+
+#else
+
+static inline int cma_declare_contiguous(phys_addr_t size, phys_addr_t base,
+					 phys_addr_t limit, const char *name,
+					 struct cma **res_cma)
+{
+	return -ENOSYS;
+}
+
+static inline struct page *cma_alloc(struct cma *cma, unsigned long count,
+				     unsigned int align)
+{
+	return NULL;
+}
+
+static inline bool cma_release(struct cma *cma, struct page *pages,
+			       unsigned long count)
+{
+	return false;
+}
+
+static inline phys_addr_t cma_get_base(struct cma *cma)
+{
+	return 0;
+}
+
+static inline unsigned long cma_get_size(struct cma *cma)
+{
+	return 0;
+}
+
+#endif /* CONFIG_CMA */
+
+#endif /* _LINUX_CMA_H */
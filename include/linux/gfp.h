@@ -372,4 +372,13 @@ extern gfp_t gfp_allowed_mask;
 extern void pm_restrict_gfp_mask(void);
 extern void pm_restore_gfp_mask(void);
 
+#ifdef CONFIG_CMA
+/* The range must lie in a single zone */
+extern int alloc_contig_range(unsigned long start, unsigned long end,
+			      int migratetype);
+extern void free_contig_range(unsigned long pfn, unsigned long nr_pages);
+
+extern void init_cma_reserved_pageblock(struct page *page);
+#endif
+
 #endif /* __LINUX_GFP_H */
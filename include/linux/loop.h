@@ -18,6 +18,7 @@
 #include <linux/blkdev.h>
 #include <linux/spinlock.h>
 #include <linux/mutex.h>
+#include <linux/rwsem.h>
 
 /* Possible states of device */
 enum {
@@ -27,6 +28,7 @@ enum {
 };
 
 struct loop_func_table;
+struct loop_remap;
 
 struct loop_device {
 	int		lo_number;
@@ -65,6 +67,12 @@ struct loop_device {
 	struct request_queue	*lo_queue;
 	struct gendisk		*lo_disk;
 	struct list_head	lo_list;
+
+	/* direct I/O: bios remapped to the blocks of the backing file */
+	struct loop_remap	*lo_remap;
+	struct rw_semaphore	lo_remap_sem;
+	atomic_t		lo_remap_inflight;
+	wait_queue_head_t	lo_remap_wait;
 };
 
 #endif /* __KERNEL__ */
@@ -76,6 +84,7 @@ enum {
 	LO_FLAGS_READ_ONLY	= 1,
 	LO_FLAGS_USE_AOPS	= 2,
 	LO_FLAGS_AUTOCLEAR	= 4,
+	LO_FLAGS_DIRECT_IO	= 16,
 };
 
 #include <asm/posix_types.h>	/* for __kernel_old_dev_t */
@@ -160,5 +169,6 @@ int loop_unregister_transfer(int number);
 #define LOOP_GET_STATUS64	0x4C05
 #define LOOP_CHANGE_FD		0x4C06
 #define LOOP_SET_CAPACITY	0x4C07
+#define LOOP_SET_DIRECT_IO	0x4C08
 
 #endif
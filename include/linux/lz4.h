@@ -0,0 +1,61 @@
+#ifndef __LZ4_H__
+#define __LZ4_H__
+/*
+ *  LZ4 Kernel Interface
+ *
+ *  LZ4 is a byte-oriented LZ77 compressor that trades some compression
+ *  ratio for very high compression and decompression speed.  This is a
+ *  compact implementation of the LZ4 block format, compatible with the
+ *  reference library found at:
+ *  http://code.google.com/p/lz4/
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ */
+
+#include <linux/types.h>
+
+#define LZ4_HASH_LOG		12
+#define LZ4_MEM_COMPRESS	((1 << LZ4_HASH_LOG) * sizeof(u32))
+
+/*
+ * lz4_compressbound()
+ * Provides the maximum size that LZ4 may output in a "worst case" scenario
+ * (input data not compressible)
+ */
+#define lz4_compressbound(isize) ((isize) + ((isize) / 255) + 16)
+
+/*
+ * lz4_compress()
+ *	src     : source address of the original data
+ *	src_len : size of the original data
+ *	dst	: output buffer address of the compressed data
+ *	dst_len : in: size of the output buffer,
+ *		  out: size of the compressed data on success.
+ *		  The output is only guaranteed to fit if the buffer is
+ *		  at least lz4_compressbound(src_len) bytes
+ *	wrkmem  : address of the working memory.
+ *		  This requires 'workmem' of size LZ4_MEM_COMPRESS.
+ *	return  : Success if return 0
+ *		  Error if return (< 0)
+ */
+int lz4_compress(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len, void *wrkmem);
+
+/*
+ * lz4_decompress_unknownoutputsize()
+ *	src     : source address of the compressed data
+ *	src_len : is the input size, therefore the compressed size
+ *	dest	: output buffer address of the decompressed data
+ *	dest_len: in: maximum size of the output buffer,
+ *		  out: number of bytes actually decompressed.
+ *	return  : Success if return 0
+ *		  Error if return (< 0)
+ *	note :  Never reads outside of the input buffer and never writes
+ *		outside of the output buffer, whatever the input contains.
+ */
+int lz4_decompress_unknownoutputsize(const unsigned char *src, size_t src_len,
+		unsigned char *dest, size_t *dest_len);
+
+#endif
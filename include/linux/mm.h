@@ -1494,6 +1494,25 @@ unsigned long ra_submit(struct file_ra_state *ra,
 			struct address_space *mapping,
 			struct file *filp);
 
+/* readahead_history.c */
+#ifdef CONFIG_READAHEAD_HISTORY
+void readahead_history_open(struct file *file);
+void readahead_history_record(struct address_space *mapping, pgoff_t offset,
+			      unsigned long nr);
+void readahead_history_free(struct address_space *mapping);
+#else
+static inline void readahead_history_open(struct file *file)
+{
+}
+static inline void readahead_history_record(struct address_space *mapping,
+					    pgoff_t offset, unsigned long nr)
+{
+}
+static inline void readahead_history_free(struct address_space *mapping)
+{
+}
+#endif
+
 /* Generic expand stack which grows the stack according to GROWS{UP,DOWN} */
 extern int expand_stack(struct vm_area_struct *vma, unsigned long address);
 
@@ -35,16 +35,6 @@ struct page {
 	unsigned long flags;		/* Atomic flags, some possibly
 					 * updated asynchronously */
 	atomic_t _count;		/* Usage count, see below. */
-	union {
-		atomic_t _mapcount;	/* Count of ptes mapped in mms,
-					 * to show when page is mapped
-					 * & limit reverse map searches.
-					 */
-		struct {		/* SLUB */
-			u16 inuse;
-			u16 objects;
-		};
-	};
 	union {
 	    struct {
 		unsigned long private;		/* Mapping-private opaque data:
@@ -68,13 +58,41 @@ struct page {
 	    struct kmem_cache *slab;	/* SLUB: Pointer to slab */
 	    struct page *first_page;	/* Compound tail pages */
 	};
+	/*
+	 * SLUB updates freelist and counters together with cmpxchg_double(),
+	 * so they must stay adjacent and double word aligned.
+	 */
 	union {
 		pgoff_t index;		/* Our offset within mapping. */
-		void *freelist;		/* SLUB: freelist req. slab lock */
+		void *freelist;		/* SLUB: first free object */
 	};
-	struct list_head lru;		/* Pageout list, eg. active_list
+	union {
+		atomic_t _mapcount;	/* Count of ptes mapped in mms,
+					 * to show when page is mapped
+					 * & limit reverse map searches.
+					 */
+		unsigned counters;	/* SLUB: the fields below as one */
+		struct {		/* SLUB */
+			unsigned inuse:16;
+			unsigned objects:15;
+			unsigned frozen:1;
+		};
+	};
+	union {
+		struct list_head lru;	/* Pageout list, eg. active_list
 					 * protected by zone->lru_lock !
 					 */
+		struct {		/* SLUB: per cpu partial slabs */
+			struct page *next;	/* Next partial slab */
+#ifdef CONFIG_64BIT
+			int pages;	/* Nr of partial slabs left */
+			int pobjects;	/* Approximate nr of objects */
+#else
+			short int pages;
+			short int pobjects;
+#endif
+		};
+	};
 	/*
 	 * On machines where all RAM is mapped into kernel address space,
 	 * we can simply calculate the virtual address. On machines with
@@ -100,7 +118,11 @@ struct page {
 	 */
 	void *shadow;
 #endif
-};
+}
+#ifdef CONFIG_CMPXCHG_DOUBLE
+	__aligned(2 * sizeof(unsigned long))
+#endif
+;
 
 typedef unsigned long __nocast vm_flags_t;
 
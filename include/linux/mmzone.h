@@ -40,8 +40,21 @@
 #define MIGRATE_MOVABLE       2
 #define MIGRATE_PCPTYPES      3 /* the number of types on the pcp lists */
 #define MIGRATE_RESERVE       3
+#ifdef CONFIG_CMA
+/*
+ * Pageblocks of a contiguous memory area.  Only movable allocations are
+ * served from them, so that cma_alloc() can always migrate the pages out.
+ * The type of these pageblocks never changes.
+ */
+#define MIGRATE_CMA           4
+#define MIGRATE_ISOLATE       5 /* can't allocate from here */
+#define MIGRATE_TYPES         6
+#define is_migrate_cma(migratetype) unlikely((migratetype) == MIGRATE_CMA)
+#else
 #define MIGRATE_ISOLATE       4 /* can't allocate from here */
 #define MIGRATE_TYPES         5
+#define is_migrate_cma(migratetype) false
+#endif
 
 #define for_each_migratetype_order(order, type) \
 	for (order = 0; order < MAX_ORDER; order++) \
@@ -106,6 +119,8 @@ enum zone_stat_item {
 	NR_SHMEM,		/* shmem pages (included tmpfs/GEM pages) */
 	NR_DIRTIED,		/* page dirtyings since bootup */
 	NR_WRITTEN,		/* page writings since bootup */
+	WORKINGSET_REFAULT,	/* evicted pages read back in */
+	WORKINGSET_ACTIVATE,	/* ... and put on the active list */
 #ifdef CONFIG_NUMA
 	NUMA_HIT,		/* allocated in intended node */
 	NUMA_MISS,		/* allocated in non intended node */
@@ -169,6 +184,22 @@ enum zone_watermarks {
 #define low_wmark_pages(z) (z->watermark[WMARK_LOW])
 #define high_wmark_pages(z) (z->watermark[WMARK_HIGH])
 
+/*
+ * Orders 1 to PCP_MAX_ORDER are cached per cpu as well, they back kernel
+ * stacks, slabs and network buffers and would otherwise all contend on
+ * zone->lock.
+ */
+#define PCP_MAX_ORDER	PAGE_ALLOC_COSTLY_ORDER
+
+/* Free blocks of one order above 0 */
+struct per_cpu_order_pages {
+	int count;		/* number of blocks in the lists */
+	int high;		/* high watermark in blocks, emptying needed */
+	int batch;		/* chunk size for buddy add/remove, in blocks */
+
+	struct list_head lists[MIGRATE_PCPTYPES];
+};
+
 struct per_cpu_pages {
 	int count;		/* number of pages in the list */
 	int high;		/* high watermark, emptying needed */
@@ -176,6 +207,9 @@ struct per_cpu_pages {
 
 	/* Lists of pages, one per migrate type stored on the pcp-lists */
 	struct list_head lists[MIGRATE_PCPTYPES];
+
+	/* Blocks of order 1 to PCP_MAX_ORDER, indexed by order - 1 */
+	struct per_cpu_order_pages orders[PCP_MAX_ORDER];
 };
 
 struct per_cpu_pageset {
@@ -349,6 +383,9 @@ struct zone {
 	unsigned long		pages_scanned;	   /* since last reclaim */
 	unsigned long		flags;		   /* zone flags, see below */
 
+	/* Evictions and activations, for refault distances */
+	atomic_long_t		inactive_age;
+
 	/* Zone statistics */
 	atomic_long_t		vm_stat[NR_VM_ZONE_STAT_ITEMS];
 
@@ -636,6 +673,11 @@ typedef struct pglist_data {
 	struct task_struct *kswapd;
 	int kswapd_max_order;
 	enum zone_type classzone_idx;
+#ifdef CONFIG_COMPACTION
+	wait_queue_head_t kcompactd_wait;
+	struct task_struct *kcompactd;
+	bool kcompactd_woken;		/* a direct compactor asked for work */
+#endif
 } pg_data_t;
 
 #define node_present_pages(nid)	(NODE_DATA(nid)->node_present_pages)
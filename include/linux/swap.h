@@ -214,6 +214,13 @@ extern unsigned int nr_free_pagecache_pages(void);
 #define nr_free_pages() global_page_state(NR_FREE_PAGES)
 
 
+/* linux/mm/workingset.c */
+extern void workingset_eviction(struct address_space *mapping,
+				struct page *page);
+extern bool workingset_refault(struct address_space *mapping, pgoff_t index);
+extern void workingset_activation(struct page *page);
+extern void workingset_forget(struct address_space *mapping);
+
 /* linux/mm/swap.c */
 extern void __lru_cache_add(struct page *, enum lru_list lru);
 extern void lru_cache_add_lru(struct page *, enum lru_list lru);
@@ -36,9 +36,13 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		KSWAPD_LOW_WMARK_HIT_QUICKLY, KSWAPD_HIGH_WMARK_HIT_QUICKLY,
 		KSWAPD_SKIP_CONGESTION_WAIT,
 		PAGEOUTRUN, ALLOCSTALL, PGROTATED,
+		LRU_LOCK_ACQUIRE, LRU_LOCK_CONTENDED, LRU_BATCH_GROW,
+		VMAP_CACHE_HIT, VMAP_CACHE_MISS, VMAP_PURGE, VMAP_PURGE_PAGES,
+		VMAP_FLUSH_ALL,
 #ifdef CONFIG_COMPACTION
 		COMPACTBLOCKS, COMPACTPAGES, COMPACTPAGEFAILED,
 		COMPACTSTALL, COMPACTFAIL, COMPACTSUCCESS,
+		COMPACTDIRECTPAGES, KCOMPACTD_WAKE, KCOMPACTD_PAGES,
 #endif
 #ifdef CONFIG_HUGETLB_PAGE
 		HTLB_BUDDY_PGALLOC, HTLB_BUDDY_PGALLOC_FAIL,
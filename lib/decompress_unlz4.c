@@ -0,0 +1,174 @@
+/*
+ * LZ4 decompressor for the Linux kernel, handling the "legacy" LZ4 stream
+ * format produced by "lz4 -l": a 32-bit magic followed by chunks that
+ * each carry a 32-bit little endian compressed size and decompress to at
+ * most 8 MiB.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifdef STATIC
+#include "lz4/lz4_decompress.c"
+#else
+#include <linux/decompress/unlz4.h>
+#endif
+
+#include <linux/types.h>
+#include <linux/lz4.h>
+#include <linux/decompress/mm.h>
+
+#include <linux/compiler.h>
+#include <asm/unaligned.h>
+
+#define LZ4_ARCHIVE_MAGIC	0x184C2102
+#define LZ4_CHUNK_SIZE		(8 << 20)
+
+STATIC inline int INIT unlz4(u8 *input, int in_len,
+				int (*fill) (void *, unsigned int),
+				int (*flush) (void *, unsigned int),
+				u8 *output, int *posp,
+				void (*error) (char *x))
+{
+	int ret = -1;
+	size_t chunksize = 0;
+	size_t dest_len;
+	u8 *inp, *inp_start;
+	u8 *outp;
+	int size = in_len;
+
+	if (output) {
+		outp = output;
+	} else if (!flush) {
+		error("NULL output pointer and no flush function provided");
+		goto exit_0;
+	} else {
+		outp = large_malloc(LZ4_CHUNK_SIZE);
+		if (!outp) {
+			error("Could not allocate output buffer");
+			goto exit_0;
+		}
+	}
+
+	if (input && fill) {
+		error("Both input pointer and fill function provided,");
+		goto exit_1;
+	} else if (input) {
+		inp = input;
+	} else if (!fill) {
+		error("NULL input pointer and missing fill function");
+		goto exit_1;
+	} else {
+		inp = large_malloc(lz4_compressbound(LZ4_CHUNK_SIZE));
+		if (!inp) {
+			error("Could not allocate input buffer");
+			goto exit_1;
+		}
+	}
+	inp_start = inp;
+
+	if (posp)
+		*posp = 0;
+
+	if (fill)
+		size = fill(inp, 4);
+
+	if (size < 4 || get_unaligned_le32(inp) != LZ4_ARCHIVE_MAGIC) {
+		error("invalid header");
+		goto exit_2;
+	}
+	if (!fill) {
+		inp += 4;
+		size -= 4;
+	}
+	if (posp)
+		*posp += 4;
+
+	for (;;) {
+		if (fill) {
+			size = fill(inp, 4);
+			if (size == 0)
+				break;
+			if (size < 4) {
+				error("data corrupted");
+				goto exit_2;
+			}
+		} else if (size < 4) {
+			/* end of input, possibly with padding */
+			break;
+		}
+
+		chunksize = get_unaligned_le32(inp);
+		if (!fill) {
+			inp += 4;
+			size -= 4;
+		}
+
+		/* Concatenated streams: skip the magic of the next one */
+		if (chunksize == LZ4_ARCHIVE_MAGIC) {
+			if (posp)
+				*posp += 4;
+			continue;
+		}
+
+		/* The uncompressed size may be appended after the last chunk */
+		if (!fill && size == 0)
+			break;
+
+		if (chunksize > lz4_compressbound(LZ4_CHUNK_SIZE)) {
+			error("chunk length is longer than allowed");
+			goto exit_2;
+		}
+
+		if (fill) {
+			size = fill(inp, chunksize);
+			if (size == 0) {
+				/* trailing uncompressed size appended */
+				break;
+			}
+			if (size < 0 || (size_t)size < chunksize) {
+				error("data corrupted");
+				goto exit_2;
+			}
+		} else if ((size_t)size < chunksize) {
+			error("data corrupted");
+			goto exit_2;
+		}
+		if (posp)
+			*posp += 4;
+
+		dest_len = LZ4_CHUNK_SIZE;
+		ret = lz4_decompress_unknownoutputsize(inp, chunksize,
+						       outp, &dest_len);
+		if (ret < 0) {
+			error("Decoding failed");
+			goto exit_2;
+		}
+		ret = -1;
+
+		if (flush && flush(outp, dest_len) != dest_len)
+			goto exit_2;
+		if (output)
+			outp += dest_len;
+		if (posp)
+			*posp += chunksize;
+
+		if (!fill) {
+			size -= chunksize;
+			inp += chunksize;
+		}
+	}
+
+	ret = 0;
+exit_2:
+	if (!input)
+		large_free(inp_start);
+exit_1:
+	if (!output)
+		large_free(outp);
+exit_0:
+	return ret;
+}
+
+#define decompress unlz4
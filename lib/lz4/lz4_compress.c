@@ -0,0 +1,166 @@
+/*
+ *  LZ4 Compressor
+ *
+ *  A single pass, greedy hash-table based compressor for the LZ4 block
+ *  format.  It favours speed over compression ratio and is meant for
+ *  in-kernel users such as zram and the crypto API.
+ *
+ *  The block format is the one described by the reference implementation:
+ *  http://code.google.com/p/lz4/
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/lz4.h>
+#include <asm/unaligned.h>
+#include "lz4defs.h"
+
+#define LZ4_HASH_SHIFT	(MINMATCH * 8 - LZ4_HASH_LOG)
+
+static inline u32 lz4_hash(const unsigned char *p)
+{
+	return (LZ4_READ32(p) * 2654435761U) >> LZ4_HASH_SHIFT;
+}
+
+static inline unsigned char *lz4_put_length(unsigned char *op, size_t len)
+{
+	while (len >= 255) {
+		*op++ = 255;
+		len -= 255;
+	}
+	*op++ = (unsigned char)len;
+	return op;
+}
+
+int lz4_compress(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len, void *wrkmem)
+{
+	u32 *hash_table = wrkmem;
+	const unsigned char *ip = src;
+	const unsigned char *anchor = src;
+	const unsigned char * const iend = src + src_len;
+	const unsigned char * const mflimit = iend - MFLIMIT;
+	const unsigned char * const matchlimit = iend - LASTLITERALS;
+	unsigned char *op = dst;
+	unsigned char * const oend = dst + *dst_len;
+	const unsigned char *ref;
+	unsigned char *token;
+	size_t len;
+
+	if (src_len < MFLIMIT + 1)
+		goto last_literals;
+
+	memset(hash_table, 0, LZ4_MEM_COMPRESS);
+	ip++;
+
+	for (;;) {
+		unsigned int search = 1U << SKIPSTRENGTH;
+		const unsigned char *forward = ip;
+		u32 h;
+
+		/* Find a match, accelerating over incompressible data */
+		do {
+			ip = forward;
+			forward += search++ >> SKIPSTRENGTH;
+			if (unlikely(forward > mflimit))
+				goto last_literals;
+
+			h = lz4_hash(ip);
+			ref = src + hash_table[h];
+			hash_table[h] = ip - src;
+		} while (ip - ref > MAX_DISTANCE ||
+			 LZ4_READ32(ref) != LZ4_READ32(ip));
+
+		/* Extend the match backwards */
+		while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+			ip--;
+			ref--;
+		}
+
+		/* Encode the literal run */
+		len = ip - anchor;
+		token = op++;
+		if (unlikely(op + len + (2 + 1 + LASTLITERALS) + len / 255 >
+			     oend))
+			return -1;
+
+		if (len >= RUN_MASK) {
+			*token = RUN_MASK << ML_BITS;
+			op = lz4_put_length(op, len - RUN_MASK);
+		} else {
+			*token = len << ML_BITS;
+		}
+		memcpy(op, anchor, len);
+		op += len;
+
+next_match:
+		/* Encode the offset */
+		LZ4_WRITE_LE16(op, ip - ref);
+		op += 2;
+
+		/* Count the match length */
+		ip += MINMATCH;
+		ref += MINMATCH;
+		anchor = ip;
+		while (ip < matchlimit && *ip == *ref) {
+			ip++;
+			ref++;
+		}
+		len = ip - anchor;
+
+		if (unlikely(op + 1 + LASTLITERALS + len / 255 > oend))
+			return -1;
+
+		if (len >= ML_MASK) {
+			*token += ML_MASK;
+			op = lz4_put_length(op, len - ML_MASK);
+		} else {
+			*token += len;
+		}
+
+		anchor = ip;
+		if (ip > mflimit)
+			break;
+
+		hash_table[lz4_hash(ip - 2)] = ip - 2 - src;
+
+		/* Try an immediate match at the current position */
+		h = lz4_hash(ip);
+		ref = src + hash_table[h];
+		hash_table[h] = ip - src;
+		if (ip - ref <= MAX_DISTANCE &&
+		    LZ4_READ32(ref) == LZ4_READ32(ip)) {
+			token = op++;
+			*token = 0;
+			goto next_match;
+		}
+
+		ip++;
+	}
+
+last_literals:
+	len = iend - anchor;
+	if (op + len + 1 + (len + 255 - RUN_MASK) / 255 > oend)
+		return -1;
+
+	if (len >= RUN_MASK) {
+		*op++ = RUN_MASK << ML_BITS;
+		op = lz4_put_length(op, len - RUN_MASK);
+	} else {
+		*op++ = len << ML_BITS;
+	}
+	memcpy(op, anchor, len);
+	op += len;
+
+	*dst_len = op - dst;
+	return 0;
+}
+EXPORT_SYMBOL_GPL(lz4_compress);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 Compressor");
@@ -0,0 +1,140 @@
+/*
+ *  LZ4 Decompressor
+ *
+ *  Safe decoder for the LZ4 block format: it never reads past the end of
+ *  the input buffer nor writes past the end of the output buffer, so it
+ *  can be used on untrusted data (filesystem images, swap, initramfs).
+ *
+ *  The block format is the one described by the reference implementation:
+ *  http://code.google.com/p/lz4/
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ */
+
+#ifndef STATIC
+#include <linux/module.h>
+#include <linux/kernel.h>
+#endif
+
+#include <asm/unaligned.h>
+#include <linux/lz4.h>
+#include "lz4defs.h"
+
+/*
+ * Read an extended length: a run of 255 bytes terminated by a smaller one.
+ * Returns -1 if the input runs out before the terminating byte.
+ */
+static inline int lz4_get_length(const unsigned char **ipp,
+				 const unsigned char *iend, size_t *len)
+{
+	const unsigned char *ip = *ipp;
+	unsigned int s;
+
+	do {
+		if (unlikely(ip >= iend))
+			return -1;
+		s = *ip++;
+		*len += s;
+	} while (s == 255);
+
+	*ipp = ip;
+	return 0;
+}
+
+int lz4_decompress_unknownoutputsize(const unsigned char *src, size_t src_len,
+		unsigned char *dest, size_t *dest_len)
+{
+	const unsigned char *ip = src;
+	const unsigned char * const iend = src + src_len;
+	unsigned char *op = dest;
+	unsigned char * const oend = dest + *dest_len;
+	const unsigned char *ref;
+	unsigned char *cpy;
+	unsigned int token;
+	size_t length, offset;
+
+	while (ip < iend) {
+		token = *ip++;
+
+		/* Literal run */
+		length = token >> ML_BITS;
+		if (length == RUN_MASK && lz4_get_length(&ip, iend, &length))
+			goto malformed;
+
+		if (unlikely(length > (size_t)(iend - ip) ||
+			     length > (size_t)(oend - op)))
+			goto malformed;
+
+		cpy = op + length;
+		if (likely((size_t)(oend - cpy) >= COPYLENGTH &&
+			   (size_t)(iend - ip) >= length + COPYLENGTH)) {
+			/* Wide copy, may spill up to 7 bytes past cpy */
+			do {
+				LZ4_COPY8(op, ip);
+				op += 8;
+				ip += 8;
+			} while (op < cpy);
+			ip -= op - cpy;
+			op = cpy;
+		} else {
+			while (op < cpy)
+				*op++ = *ip++;
+		}
+
+		/* A block always ends with a literal run */
+		if (ip == iend)
+			break;
+
+		if (unlikely(iend - ip < 2))
+			goto malformed;
+		offset = LZ4_READ_LE16(ip);
+		ip += 2;
+		if (unlikely(offset == 0 || offset > (size_t)(op - dest)))
+			goto malformed;
+		ref = op - offset;
+
+		/* Match */
+		length = token & ML_MASK;
+		if (length == ML_MASK && lz4_get_length(&ip, iend, &length))
+			goto malformed;
+		length += MINMATCH;
+
+		if (unlikely(length > (size_t)(oend - op)))
+			goto malformed;
+
+		cpy = op + length;
+		if (likely(offset >= COPYLENGTH &&
+			   (size_t)(oend - cpy) >= COPYLENGTH)) {
+			/*
+			 * Source and destination are at least 8 bytes apart,
+			 * so each 8 byte step only reads already written
+			 * output.
+			 */
+			do {
+				LZ4_COPY8(op, ref);
+				op += 8;
+				ref += 8;
+			} while (op < cpy);
+			op = cpy;
+		} else {
+			/* Overlapping match, replicate byte by byte */
+			while (op < cpy)
+				*op++ = *ref++;
+		}
+	}
+
+	*dest_len = op - dest;
+	return 0;
+
+malformed:
+	*dest_len = op - dest;
+	return -1;
+}
+#ifndef STATIC
+EXPORT_SYMBOL_GPL(lz4_decompress_unknownoutputsize);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 Decompressor");
+#endif
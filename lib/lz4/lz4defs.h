@@ -0,0 +1,45 @@
+/*
+ *  lz4defs.h -- architecture independent definitions for the LZ4 block format
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ */
+
+/*
+ * Every sequence starts with a token byte: the upper nibble holds the
+ * literal run length, the lower nibble the match length minus MINMATCH.
+ * A nibble value of 15 means more length bytes follow, each adding up
+ * to 255 until a byte smaller than 255 is found.
+ */
+#define MINMATCH	4
+#define ML_BITS		4
+#define ML_MASK		((1U << ML_BITS) - 1)
+#define RUN_BITS	(8 - ML_BITS)
+#define RUN_MASK	((1U << RUN_BITS) - 1)
+
+#define MAX_DISTANCE	((1 << 16) - 1)
+
+/*
+ * The last LASTLITERALS bytes of a block are always literals, and the
+ * last match must start at least MFLIMIT bytes before the end of the
+ * block, so that the decompressor can use wide copies safely.
+ */
+#define LASTLITERALS	5
+#define MFLIMIT		(COPYLENGTH + MINMATCH)
+#define COPYLENGTH	8
+
+/* Controls how fast the match finder skips over incompressible data */
+#define SKIPSTRENGTH	6
+
+#define LZ4_READ32(p)		get_unaligned((const u32 *)(p))
+#define LZ4_WRITE_LE16(p, v)	put_unaligned_le16((v), (p))
+#define LZ4_READ_LE16(p)	get_unaligned_le16(p)
+
+#define LZ4_COPY4(d, s)		\
+		put_unaligned(get_unaligned((const u32 *)(s)), (u32 *)(d))
+#define LZ4_COPY8(d, s)		\
+	do {			\
+		LZ4_COPY4(d, s);	\
+		LZ4_COPY4((d) + 4, (s) + 4);	\
+	} while (0)
@@ -41,3 +41,56 @@
 #define DX2(p, s1, s2)	(((((size_t)((p)[2]) << (s2)) ^ (p)[1]) \
 							<< (s1)) ^ (p)[0])
 #define DX3(p, s1, s2, s3)	((DX2((p)+1, s2, s3) << (s1)) ^ (p)[0])
+
+/*
+ * Word-sized copies used by the decompressor fast paths, which are only
+ * enabled where unaligned word accesses are cheap.
+ *
+ * ARMv6 and later handle unaligned LDR/STR in hardware (the alignment
+ * trap is turned off for them in arch/arm/mm/alignment.c), but ARM's
+ * get_unaligned() is built from byte loads, so use single word
+ * instructions explicitly there.  LDM/STM and LDRD/STRD still need
+ * aligned addresses, which is why the accesses are kept in inline asm
+ * rather than left for the compiler to merge.  This is not used in the
+ * pre-boot environment (STATIC), where the alignment setup is unknown.
+ */
+#if defined(CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS)
+#define LZO_FAST_COPY
+#define COPY4(dst, src)	\
+		put_unaligned(get_unaligned((const u32 *)(src)), (u32 *)(dst))
+#ifdef CONFIG_64BIT
+#define COPY8(dst, src)	\
+		put_unaligned(get_unaligned((const u64 *)(src)), (u64 *)(dst))
+#else
+#define COPY8(dst, src)				\
+	do {					\
+		COPY4(dst, src);		\
+		COPY4((dst) + 4, (src) + 4);	\
+	} while (0)
+#endif
+#elif defined(CONFIG_ARM) && __LINUX_ARM_ARCH__ >= 6 && !defined(STATIC)
+#define LZO_FAST_COPY
+static inline void lzo_copy4(unsigned char *dst, const unsigned char *src)
+{
+	u32 v;
+
+	asm volatile("ldr	%0, %1" : "=r" (v) : "m" (*(const u32 *)src));
+	asm volatile("str	%1, %0" : "=m" (*(u32 *)dst) : "r" (v));
+}
+
+static inline void lzo_copy8(unsigned char *dst, const unsigned char *src)
+{
+	u32 v0, v1;
+
+	asm volatile("ldr	%0, %2\n\t"
+	    "ldr	%1, %3"
+	    : "=&r" (v0), "=r" (v1)
+	    : "m" (*(const u32 *)src), "m" (*(const u32 *)(src + 4)));
+	asm volatile("str	%2, %0\n\t"
+	    "str	%3, %1"
+	    : "=m" (*(u32 *)dst), "=m" (*(u32 *)(dst + 4))
+	    : "r" (v0), "r" (v1));
+}
+#define COPY4(dst, src)	lzo_copy4(dst, src)
+#define COPY8(dst, src)	lzo_copy8(dst, src)
+#endif
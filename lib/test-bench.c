@@ -0,0 +1,208 @@
+/*
+ * Common part of the benchmark modules in lib/, see test-bench.h.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/debugfs.h>
+#include <linux/err.h>
+#include <linux/fs.h>
+#include <linux/completion.h>
+#include <linux/cpu.h>
+#include <linux/kthread.h>
+#include <linux/sched.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+
+#include "test-bench.h"
+
+void bench_printf(struct bench *b, const char *fmt, ...)
+{
+	va_list args;
+
+	va_start(args, fmt);
+	b->results_len += vscnprintf(b->results + b->results_len,
+				     b->size - b->results_len, fmt, args);
+	va_end(args);
+}
+EXPORT_SYMBOL_GPL(bench_printf);
+
+/*
+ * Per cpu threads
+ */
+
+struct bench_cpus {
+	void			(*fn)(void *data, unsigned int index,
+				      unsigned int nr);
+	void			*data;
+	unsigned int		nr;
+	atomic_t		next;
+	atomic_t		running;
+	struct completion	start;
+	struct completion	done;
+};
+
+static int bench_cpu_thread(void *arg)
+{
+	struct bench_cpus *bc = arg;
+
+	wait_for_completion(&bc->start);
+	bc->fn(bc->data, atomic_inc_return(&bc->next) - 1, bc->nr);
+
+	if (atomic_dec_and_test(&bc->running))
+		complete(&bc->done);
+	return 0;
+}
+
+/**
+ * bench_on_each_cpu - run a function on every online cpu at once
+ * @name:	name of the threads, followed by the cpu
+ * @fn:		the function
+ * @data:	its first argument
+ *
+ * Starts one thread per online cpu, each bound to its cpu, and lets them
+ * call @fn together once all of them are created.  Each call gets a
+ * different index from 0 to nr - 1, where nr is the number of threads.
+ * Returns nr once every call has returned, or an error if not all threads
+ * could be created, in which case those that were still run.
+ */
+int bench_on_each_cpu(const char *name,
+		      void (*fn)(void *data, unsigned int index,
+				 unsigned int nr),
+		      void *data)
+{
+	struct bench_cpus bc = {
+		.fn	= fn,
+		.data	= data,
+	};
+	struct task_struct *task;
+	int cpu, nr_cpus, ret = 0;
+
+	init_completion(&bc.start);
+	init_completion(&bc.done);
+
+	get_online_cpus();
+	nr_cpus = num_online_cpus();
+	atomic_set(&bc.running, nr_cpus);
+	for_each_online_cpu(cpu) {
+		task = kthread_create(bench_cpu_thread, &bc, "%s/%d",
+				      name, cpu);
+		if (IS_ERR(task)) {
+			ret = PTR_ERR(task);
+			/* the threads already created must still finish */
+			if (atomic_sub_and_test(nr_cpus - bc.nr, &bc.running))
+				complete(&bc.done);
+			break;
+		}
+		kthread_bind(task, cpu);
+		wake_up_process(task);
+		bc.nr++;
+	}
+	put_online_cpus();
+
+	complete_all(&bc.start);
+	if (bc.nr)
+		wait_for_completion(&bc.done);
+
+	return ret ? ret : bc.nr;
+}
+EXPORT_SYMBOL_GPL(bench_on_each_cpu);
+
+/*
+ * debugfs interface
+ */
+
+static int bench_open(struct inode *inode, struct file *file)
+{
+	file->private_data = inode->i_private;
+	return 0;
+}
+
+static ssize_t bench_run_write(struct file *file, const char __user *ubuf,
+			       size_t count, loff_t *ppos)
+{
+	struct bench *b = file->private_data;
+	char buf[32];
+	int ret;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+
+	mutex_lock(&b->mutex);
+	b->results_len = 0;
+	ret = b->run(b, strim(buf));
+	mutex_unlock(&b->mutex);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations bench_run_fops = {
+	.open	= bench_open,
+	.write	= bench_run_write,
+	.llseek	= noop_llseek,
+};
+
+static ssize_t bench_results_read(struct file *file, char __user *ubuf,
+				  size_t count, loff_t *ppos)
+{
+	struct bench *b = file->private_data;
+	ssize_t ret;
+
+	mutex_lock(&b->mutex);
+	ret = simple_read_from_buffer(ubuf, count, ppos, b->results,
+				      b->results_len);
+	mutex_unlock(&b->mutex);
+
+	return ret;
+}
+
+static const struct file_operations bench_results_fops = {
+	.open	= bench_open,
+	.read	= bench_results_read,
+	.llseek	= default_llseek,
+};
+
+/**
+ * bench_register - create the debugfs directory of a benchmark
+ * @b:		the benchmark, with name, size and run set
+ */
+int bench_register(struct bench *b)
+{
+	int ret;
+
+	mutex_init(&b->mutex);
+	b->results_len = 0;
+	b->results = vzalloc(b->size);
+	if (!b->results)
+		return -ENOMEM;
+
+	b->dir = debugfs_create_dir(b->name, NULL);
+	if (IS_ERR_OR_NULL(b->dir)) {
+		ret = b->dir ? PTR_ERR(b->dir) : -ENOMEM;
+		vfree(b->results);
+		return ret;
+	}
+	debugfs_create_file("run", 0200, b->dir, b, &bench_run_fops);
+	debugfs_create_file("results", 0400, b->dir, b, &bench_results_fops);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(bench_register);
+
+void bench_unregister(struct bench *b)
+{
+	debugfs_remove_recursive(b->dir);
+	vfree(b->results);
+}
+EXPORT_SYMBOL_GPL(bench_unregister);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Common part of the lib/ benchmark modules");
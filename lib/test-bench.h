@@ -0,0 +1,43 @@
+/*
+ * Common part of the benchmark modules in lib/.
+ *
+ * Each benchmark gets a directory in debugfs with a "run" file, whose
+ * writes start a run, and a "results" file, which reads back the report
+ * of the last run.  Runs and reads of the report are serialized by the
+ * mutex of the benchmark, which a module can also take for files of its
+ * own in the directory.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef _LIB_TEST_BENCH_H
+#define _LIB_TEST_BENCH_H
+
+#include <linux/compiler.h>
+#include <linux/mutex.h>
+#include <linux/types.h>
+
+struct dentry;
+
+struct bench {
+	const char	*name;		/* of the debugfs directory */
+	size_t		size;		/* of the report */
+	/* called with mutex held and with what was written to "run" */
+	int		(*run)(struct bench *b, char *arg);
+
+	struct dentry	*dir;
+	struct mutex	mutex;
+	char		*results;
+	size_t		results_len;
+};
+
+extern int bench_register(struct bench *b);
+extern void bench_unregister(struct bench *b);
+extern __printf(2, 3) void bench_printf(struct bench *b, const char *fmt, ...);
+extern int bench_on_each_cpu(const char *name,
+		void (*fn)(void *data, unsigned int index, unsigned int nr),
+		void *data);
+
+#endif /* _LIB_TEST_BENCH_H */
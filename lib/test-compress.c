@@ -0,0 +1,867 @@
+/*
+ * Benchmark for the in-kernel compression libraries.
+ *
+ * Runs lzo, lz4, zlib and xz (decompression only, the kernel has no xz
+ * encoder) from lib/, plus any crypto_comp algorithm, over a set of
+ * corpora split into page-sized and large chunks.  For each combination it
+ * reports the compression ratio, throughput and per-call latency
+ * percentiles, and checks that every chunk decompresses back to the
+ * original data.
+ *
+ * With debugfs mounted on /sys/kernel/debug:
+ *
+ *   cat image > /sys/kernel/debug/compress_bench/corpus     (optional)
+ *   cat image.xz > /sys/kernel/debug/compress_bench/xz_corpus (optional)
+ *   echo all > /sys/kernel/debug/compress_bench/run          (or one codec)
+ *   cat /sys/kernel/debug/compress_bench/results
+ *
+ * Writing "fuzz" to run instead feeds the lib/ decompressors corrupted and
+ * truncated versions of every compressed chunk and reports any that wrote
+ * past the end of their output buffer or claimed to have done so.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/debugfs.h>
+#include <linux/fs.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
+#include <linux/random.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <linux/crypto.h>
+#include <linux/lzo.h>
+#include <linux/lz4.h>
+#include <linux/zlib.h>
+#include <linux/xz.h>
+
+#include "test-bench.h"
+
+static unsigned int iterations = 4;
+module_param(iterations, uint, 0644);
+MODULE_PARM_DESC(iterations, "Passes over each corpus (default: 4)");
+
+static unsigned int large_size = 128 * 1024;
+module_param(large_size, uint, 0444);
+MODULE_PARM_DESC(large_size, "Size of the large chunks in bytes (default: 128K)");
+
+static unsigned int corpus_size = 1024 * 1024;
+module_param(corpus_size, uint, 0444);
+MODULE_PARM_DESC(corpus_size, "Size of each generated corpus (default: 1M)");
+
+static unsigned int max_corpus_size = 8 * 1024 * 1024;
+module_param(max_corpus_size, uint, 0444);
+MODULE_PARM_DESC(max_corpus_size, "Largest user supplied corpus (default: 8M)");
+
+static char *crypto_algs = "deflate,lzo,lz4";
+module_param(crypto_algs, charp, 0444);
+MODULE_PARM_DESC(crypto_algs, "Comma separated crypto_comp algorithms to test");
+
+#define BENCH_MAX_SAMPLES	(64 * 1024)
+#define BENCH_RESULTS_SIZE	(64 * 1024)
+#define BENCH_MAX_CRYPTO	8
+#define BENCH_GUARD_SIZE	64
+#define BENCH_GUARD_BYTE	0xa5
+
+struct bench_corpus {
+	const char	*name;
+	u8		*data;
+	size_t		len;
+};
+
+struct bench_codec {
+	const char	*name;
+	void		*(*alloc)(const struct bench_codec *codec);
+	void		(*free)(void *priv);
+	int		(*compress)(void *priv, const u8 *src, size_t slen,
+				    u8 *dst, size_t *dlen);
+	int		(*decompress)(void *priv, const u8 *src, size_t slen,
+				      u8 *dst, size_t *dlen);
+	const char	*crypto_name;
+};
+
+struct bench_lat {
+	u32		*samples;
+	unsigned int	nr;
+	u64		total_ns;
+};
+
+static int bench_run(struct bench *b, char *arg);
+
+static struct bench compress_bench = {
+	.name	= "compress_bench",
+	.size	= BENCH_RESULTS_SIZE,
+	.run	= bench_run,
+};
+
+#define bench_print(fmt, ...) \
+	bench_printf(&compress_bench, fmt, ##__VA_ARGS__)
+
+static struct bench_corpus gen_corpora[] = {
+	{ .name = "zero" },
+	{ .name = "text" },
+	{ .name = "pages" },
+	{ .name = "random" },
+};
+
+static struct bench_corpus user_corpus = { .name = "custom" };
+static struct bench_corpus xz_corpus = { .name = "xz" };
+
+/*
+ * Codecs
+ */
+
+static void *lzo_bench_alloc(const struct bench_codec *codec)
+{
+	return vmalloc(LZO1X_MEM_COMPRESS);
+}
+
+static int lzo_bench_compress(void *priv, const u8 *src, size_t slen,
+			      u8 *dst, size_t *dlen)
+{
+	return lzo1x_1_compress(src, slen, dst, dlen, priv) == LZO_E_OK ?
+		0 : -EINVAL;
+}
+
+static int lzo_bench_decompress(void *priv, const u8 *src, size_t slen,
+				u8 *dst, size_t *dlen)
+{
+	return lzo1x_decompress_safe(src, slen, dst, dlen) == LZO_E_OK ?
+		0 : -EINVAL;
+}
+
+static void *lz4_bench_alloc(const struct bench_codec *codec)
+{
+	return vmalloc(LZ4_MEM_COMPRESS);
+}
+
+static int lz4_bench_compress(void *priv, const u8 *src, size_t slen,
+			      u8 *dst, size_t *dlen)
+{
+	return lz4_compress(src, slen, dst, dlen, priv) ? -EINVAL : 0;
+}
+
+static int lz4_bench_decompress(void *priv, const u8 *src, size_t slen,
+				u8 *dst, size_t *dlen)
+{
+	return lz4_decompress_unknownoutputsize(src, slen, dst, dlen) ?
+		-EINVAL : 0;
+}
+
+struct zlib_bench {
+	struct z_stream_s	def;
+	struct z_stream_s	inf;
+};
+
+static void zlib_bench_free(void *priv)
+{
+	struct zlib_bench *zb = priv;
+
+	if (!zb)
+		return;
+	vfree(zb->def.workspace);
+	vfree(zb->inf.workspace);
+	kfree(zb);
+}
+
+static void *zlib_bench_alloc(const struct bench_codec *codec)
+{
+	struct zlib_bench *zb = kzalloc(sizeof(*zb), GFP_KERNEL);
+
+	if (!zb)
+		return NULL;
+
+	zb->def.workspace = vzalloc(zlib_deflate_workspacesize(MAX_WBITS,
+							       MAX_MEM_LEVEL));
+	zb->inf.workspace = vzalloc(zlib_inflate_workspacesize());
+	if (!zb->def.workspace || !zb->inf.workspace)
+		goto fail;
+
+	if (zlib_deflateInit2(&zb->def, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+			      MAX_WBITS, MAX_MEM_LEVEL,
+			      Z_DEFAULT_STRATEGY) != Z_OK)
+		goto fail;
+	if (zlib_inflateInit2(&zb->inf, MAX_WBITS) != Z_OK)
+		goto fail;
+
+	return zb;
+
+fail:
+	zlib_bench_free(zb);
+	return NULL;
+}
+
+static int zlib_bench_compress(void *priv, const u8 *src, size_t slen,
+			       u8 *dst, size_t *dlen)
+{
+	struct z_stream_s *stream = &((struct zlib_bench *)priv)->def;
+
+	if (zlib_deflateReset(stream) != Z_OK)
+		return -EINVAL;
+
+	stream->next_in = src;
+	stream->avail_in = slen;
+	stream->next_out = dst;
+	stream->avail_out = *dlen;
+
+	if (zlib_deflate(stream, Z_FINISH) != Z_STREAM_END)
+		return -EINVAL;
+
+	*dlen = stream->total_out;
+	return 0;
+}
+
+static int zlib_bench_decompress(void *priv, const u8 *src, size_t slen,
+				 u8 *dst, size_t *dlen)
+{
+	struct z_stream_s *stream = &((struct zlib_bench *)priv)->inf;
+
+	if (zlib_inflateReset(stream) != Z_OK)
+		return -EINVAL;
+
+	stream->next_in = src;
+	stream->avail_in = slen;
+	stream->next_out = dst;
+	stream->avail_out = *dlen;
+
+	if (zlib_inflate(stream, Z_FINISH) != Z_STREAM_END)
+		return -EINVAL;
+
+	*dlen = stream->total_out;
+	return 0;
+}
+
+static void *crypto_bench_alloc(const struct bench_codec *codec)
+{
+	struct crypto_comp *tfm = crypto_alloc_comp(codec->crypto_name, 0, 0);
+
+	return IS_ERR(tfm) ? NULL : tfm;
+}
+
+static void crypto_bench_free(void *priv)
+{
+	crypto_free_comp(priv);
+}
+
+static int crypto_bench_compress(void *priv, const u8 *src, size_t slen,
+				 u8 *dst, size_t *dlen)
+{
+	unsigned int len = *dlen;
+	int ret;
+
+	ret = crypto_comp_compress(priv, src, slen, dst, &len);
+	*dlen = len;
+	return ret;
+}
+
+static int crypto_bench_decompress(void *priv, const u8 *src, size_t slen,
+				   u8 *dst, size_t *dlen)
+{
+	unsigned int len = *dlen;
+	int ret;
+
+	ret = crypto_comp_decompress(priv, src, slen, dst, &len);
+	*dlen = len;
+	return ret;
+}
+
+static void vfree_priv(void *priv)
+{
+	vfree(priv);
+}
+
+static struct bench_codec lib_codecs[] = {
+	{
+		.name		= "lzo",
+		.alloc		= lzo_bench_alloc,
+		.free		= vfree_priv,
+		.compress	= lzo_bench_compress,
+		.decompress	= lzo_bench_decompress,
+	}, {
+		.name		= "lz4",
+		.alloc		= lz4_bench_alloc,
+		.free		= vfree_priv,
+		.compress	= lz4_bench_compress,
+		.decompress	= lz4_bench_decompress,
+	}, {
+		.name		= "zlib",
+		.alloc		= zlib_bench_alloc,
+		.free		= zlib_bench_free,
+		.compress	= zlib_bench_compress,
+		.decompress	= zlib_bench_decompress,
+	},
+};
+
+static struct bench_codec crypto_codecs[BENCH_MAX_CRYPTO];
+static char crypto_names[BENCH_MAX_CRYPTO][CRYPTO_MAX_ALG_NAME + 8];
+static unsigned int nr_crypto_codecs;
+
+static void __init bench_parse_crypto_algs(void)
+{
+	char *algs, *p, *name;
+
+	algs = kstrdup(crypto_algs, GFP_KERNEL);
+	if (!algs)
+		return;
+
+	p = algs;
+	while ((name = strsep(&p, ",")) != NULL) {
+		struct bench_codec *codec;
+
+		if (!*name || nr_crypto_codecs == BENCH_MAX_CRYPTO)
+			continue;
+
+		codec = &crypto_codecs[nr_crypto_codecs];
+		snprintf(crypto_names[nr_crypto_codecs],
+			 sizeof(crypto_names[0]), "crypto-%s", name);
+		codec->name = crypto_names[nr_crypto_codecs];
+		codec->crypto_name = codec->name + strlen("crypto-");
+		codec->alloc = crypto_bench_alloc;
+		codec->free = crypto_bench_free;
+		codec->compress = crypto_bench_compress;
+		codec->decompress = crypto_bench_decompress;
+		nr_crypto_codecs++;
+	}
+	kfree(algs);
+}
+
+/*
+ * Corpora
+ */
+
+static const char * const bench_words[] = {
+	"the", "kernel", "page", "cache", "of", "and", "to", "a", "in",
+	"memory", "is", "for", "android", "that", "with", "data", "block",
+	"file", "system", "read", "write", "on", "as", "compression",
+	"<item", "name=", "\"value\"", "/>", "{", "}", "return", "0;",
+	"int", "static", "struct", "\n", "\t", "=", "if", "else",
+};
+
+static void bench_fill_text(u8 *buf, size_t len)
+{
+	size_t pos = 0;
+
+	while (pos < len) {
+		const char *w = bench_words[random32() % ARRAY_SIZE(bench_words)];
+		size_t l = min(strlen(w), len - pos);
+
+		memcpy(buf + pos, w, l);
+		pos += l;
+		if (pos < len)
+			buf[pos++] = ' ';
+	}
+}
+
+/*
+ * Mix of page types found in anonymous memory: zero pages, text, arrays
+ * of small integers and pointers, and incompressible data.
+ */
+static void bench_fill_pages(u8 *buf, size_t len)
+{
+	size_t pos, i;
+
+	for (pos = 0; pos < len; pos += PAGE_SIZE) {
+		size_t l = min_t(size_t, PAGE_SIZE, len - pos);
+		u32 *words = (u32 *)(buf + pos);
+
+		switch (random32() % 4) {
+		case 0:
+			memset(buf + pos, 0, l);
+			break;
+		case 1:
+			bench_fill_text(buf + pos, l);
+			break;
+		case 2:
+			for (i = 0; i < l / sizeof(u32); i++)
+				words[i] = (i & 1) ? 0xc0000000 +
+					(random32() & 0xfff0) : random32() & 0xff;
+			break;
+		default:
+			get_random_bytes(buf + pos, l);
+			break;
+		}
+	}
+}
+
+static int __init bench_generate_corpora(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(gen_corpora); i++) {
+		struct bench_corpus *c = &gen_corpora[i];
+
+		c->data = vmalloc(corpus_size);
+		if (!c->data)
+			return -ENOMEM;
+		c->len = corpus_size;
+
+		if (!strcmp(c->name, "zero"))
+			memset(c->data, 0, c->len);
+		else if (!strcmp(c->name, "text"))
+			bench_fill_text(c->data, c->len);
+		else if (!strcmp(c->name, "pages"))
+			bench_fill_pages(c->data, c->len);
+		else
+			get_random_bytes(c->data, c->len);
+	}
+	return 0;
+}
+
+/*
+ * Measurement
+ */
+
+static int bench_cmp_u32(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static inline void bench_record(struct bench_lat *lat, u64 ns)
+{
+	lat->total_ns += ns;
+	if (lat->nr < BENCH_MAX_SAMPLES)
+		lat->samples[lat->nr++] = min_t(u64, ns, ~0U);
+}
+
+static u32 bench_percentile(struct bench_lat *lat, unsigned int pct)
+{
+	if (!lat->nr)
+		return 0;
+	return lat->samples[(lat->nr - 1) * pct / 100];
+}
+
+static unsigned long bench_mbps(u64 bytes, u64 ns)
+{
+	/* bytes per nanosecond * 1000 == MB/s */
+	return ns ? (unsigned long)div64_u64(bytes * 1000, ns) : 0;
+}
+
+static void bench_print_lat(struct bench_lat *lat)
+{
+	sort(lat->samples, lat->nr, sizeof(u32), bench_cmp_u32, NULL);
+	bench_print(" %7u %7u %7u %7u",
+		    bench_percentile(lat, 50), bench_percentile(lat, 90),
+		    bench_percentile(lat, 99), bench_percentile(lat, 100));
+}
+
+struct bench_bufs {
+	u8		*comp;
+	u8		*decomp;
+	size_t		comp_size;
+	struct bench_lat clat;
+	struct bench_lat dlat;
+};
+
+static void bench_one(const struct bench_codec *codec, void *priv,
+		      const struct bench_corpus *corpus, size_t chunk,
+		      struct bench_bufs *b)
+{
+	u64 in_bytes = 0, out_bytes = 0;
+	unsigned int pass, errors = 0;
+	size_t off;
+
+	if (corpus->len < chunk)
+		return;
+
+	b->clat.nr = b->dlat.nr = 0;
+	b->clat.total_ns = b->dlat.total_ns = 0;
+
+	for (pass = 0; pass < iterations; pass++) {
+		for (off = 0; off + chunk <= corpus->len; off += chunk) {
+			const u8 *src = corpus->data + off;
+			size_t clen = b->comp_size, dlen = chunk;
+			ktime_t t0, t1, t2;
+			int ret;
+
+			t0 = ktime_get();
+			ret = codec->compress(priv, src, chunk, b->comp, &clen);
+			t1 = ktime_get();
+			if (ret) {
+				errors++;
+				continue;
+			}
+			ret = codec->decompress(priv, b->comp, clen,
+						b->decomp, &dlen);
+			t2 = ktime_get();
+
+			bench_record(&b->clat, ktime_to_ns(ktime_sub(t1, t0)));
+			bench_record(&b->dlat, ktime_to_ns(ktime_sub(t2, t1)));
+
+			if (ret || dlen != chunk || memcmp(src, b->decomp, chunk))
+				errors++;
+
+			in_bytes += chunk;
+			out_bytes += clen;
+			cond_resched();
+		}
+	}
+
+	bench_print("%-16s %-7s %7zu %5lu.%lu %8lu %8lu",
+		    codec->name, corpus->name, chunk,
+		    in_bytes ? (unsigned long)div64_u64(out_bytes * 100,
+							in_bytes) : 0,
+		    in_bytes ? (unsigned long)div64_u64(out_bytes * 1000,
+							in_bytes) % 10 : 0,
+		    bench_mbps(in_bytes, b->clat.total_ns),
+		    bench_mbps(in_bytes, b->dlat.total_ns));
+	bench_print_lat(&b->clat);
+	bench_print_lat(&b->dlat);
+	bench_print(" %6u\n", errors);
+}
+
+static void bench_codec(const struct bench_codec *codec, struct bench_bufs *b)
+{
+	size_t chunks[] = { PAGE_SIZE, large_size };
+	void *priv;
+	int i, j;
+
+	priv = codec->alloc(codec);
+	if (!priv) {
+		bench_print("%-16s unavailable\n", codec->name);
+		return;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(gen_corpora); i++)
+		for (j = 0; j < ARRAY_SIZE(chunks); j++)
+			bench_one(codec, priv, &gen_corpora[i], chunks[j], b);
+
+	if (user_corpus.len)
+		for (j = 0; j < ARRAY_SIZE(chunks); j++)
+			bench_one(codec, priv, &user_corpus, chunks[j], b);
+
+	codec->free(priv);
+}
+
+/*
+ * xz can only be measured decompressing a user supplied .xz stream.
+ * Latency is per xz_dec_run() call, each producing up to large_size bytes.
+ */
+static void bench_xz(struct bench_bufs *b)
+{
+	struct xz_dec *s;
+	struct xz_buf xb;
+	u64 out_bytes = 0;
+	unsigned int pass;
+	enum xz_ret ret = XZ_OK;
+
+	if (!xz_corpus.len)
+		return;
+
+	s = xz_dec_init(XZ_DYNALLOC, 1 << 26);
+	if (!s) {
+		bench_print("%-16s unavailable\n", "xz");
+		return;
+	}
+
+	b->dlat.nr = 0;
+	b->dlat.total_ns = 0;
+
+	for (pass = 0; pass < iterations; pass++) {
+		xz_dec_reset(s);
+		xb.in = xz_corpus.data;
+		xb.in_pos = 0;
+		xb.in_size = xz_corpus.len;
+
+		do {
+			ktime_t t0;
+
+			xb.out = b->decomp;
+			xb.out_pos = 0;
+			xb.out_size = large_size;
+
+			t0 = ktime_get();
+			ret = xz_dec_run(s, &xb);
+			bench_record(&b->dlat,
+				     ktime_to_ns(ktime_sub(ktime_get(), t0)));
+			out_bytes += xb.out_pos;
+			cond_resched();
+		} while (ret == XZ_OK);
+
+		if (ret != XZ_STREAM_END)
+			break;
+	}
+	xz_dec_end(s);
+
+	bench_print("%-16s %-7s %7u %5lu.%lu %8s %8lu %31s",
+		    "xz", "xz", large_size,
+		    out_bytes ? (unsigned long)div64_u64(xz_corpus.len *
+					(u64)pass * 100, out_bytes) : 0,
+		    out_bytes ? (unsigned long)div64_u64(xz_corpus.len *
+					(u64)pass * 1000, out_bytes) % 10 : 0,
+		    "-", bench_mbps(out_bytes, b->dlat.total_ns), "-");
+	bench_print_lat(&b->dlat);
+	bench_print(" %6u\n", ret == XZ_STREAM_END ? 0 : 1);
+}
+
+static bool bench_guard_intact(const u8 *guard)
+{
+	int i;
+
+	for (i = 0; i < BENCH_GUARD_SIZE; i++)
+		if (guard[i] != BENCH_GUARD_BYTE)
+			return false;
+	return true;
+}
+
+/*
+ * Robustness check: every chunk is compressed, then decompressed again
+ * after either flipping a few random bytes or truncating it at a random
+ * point.  The decompressor may fail, but it must never report more output
+ * than the buffer holds nor touch the guard bytes that follow it.
+ */
+static void bench_fuzz_one(const struct bench_codec *codec, void *priv,
+			   const struct bench_corpus *corpus, size_t chunk,
+			   struct bench_bufs *b)
+{
+	unsigned int pass, runs = 0, rejected = 0, overruns = 0;
+	size_t off;
+
+	if (corpus->len < chunk)
+		return;
+
+	for (pass = 0; pass < iterations; pass++) {
+		for (off = 0; off + chunk <= corpus->len; off += chunk) {
+			size_t clen = b->comp_size, dlen, flen;
+			unsigned int i, nr_flips;
+			u32 rnd;
+			int ret;
+
+			if (codec->compress(priv, corpus->data + off, chunk,
+					    b->comp, &clen))
+				continue;
+
+			rnd = random32();
+			flen = clen;
+			if (rnd & 1) {
+				nr_flips = 1 + (rnd >> 1) % 4;
+				for (i = 0; i < nr_flips; i++)
+					b->comp[random32() % clen] ^=
+						1 + random32() % 255;
+			} else {
+				flen = (rnd >> 1) % clen;
+			}
+
+			memset(b->decomp + chunk, BENCH_GUARD_BYTE,
+			       BENCH_GUARD_SIZE);
+			dlen = chunk;
+			ret = codec->decompress(priv, b->comp, flen,
+						b->decomp, &dlen);
+			runs++;
+			if (ret)
+				rejected++;
+			if (dlen > chunk || !bench_guard_intact(b->decomp + chunk))
+				overruns++;
+			cond_resched();
+		}
+	}
+
+	bench_print("%-16s %-7s %7zu %8u %8u %8u\n", codec->name,
+		    corpus->name, chunk, runs, rejected, overruns);
+}
+
+static void bench_fuzz(const char *only, struct bench_bufs *b)
+{
+	size_t chunks[] = { PAGE_SIZE, large_size };
+	int i, j, k;
+
+	bench_print("%-16s %-7s %7s %8s %8s %8s\n", "codec", "corpus",
+		    "chunk", "runs", "rejected", "overruns");
+
+	for (i = 0; i < ARRAY_SIZE(lib_codecs); i++) {
+		const struct bench_codec *codec = &lib_codecs[i];
+		void *priv;
+
+		if (*only && strcmp(only, codec->name))
+			continue;
+		priv = codec->alloc(codec);
+		if (!priv) {
+			bench_print("%-16s unavailable\n", codec->name);
+			continue;
+		}
+		for (j = 0; j < ARRAY_SIZE(gen_corpora); j++)
+			for (k = 0; k < ARRAY_SIZE(chunks); k++)
+				bench_fuzz_one(codec, priv, &gen_corpora[j],
+					       chunks[k], b);
+		if (user_corpus.len)
+			for (k = 0; k < ARRAY_SIZE(chunks); k++)
+				bench_fuzz_one(codec, priv, &user_corpus,
+					       chunks[k], b);
+		codec->free(priv);
+	}
+}
+
+/*
+ * Runs the codec named by arg, or all of them for "all" or "1", and fuzzes
+ * the decompressors instead if arg starts with "fuzz".
+ */
+static int bench_run(struct bench *bench, char *arg)
+{
+	struct bench_bufs b;
+	size_t max_chunk = max_t(size_t, PAGE_SIZE, large_size);
+	const char *only = arg;
+	bool fuzz = false;
+	int i, ret = -ENOMEM;
+
+	if (!strncmp(only, "fuzz", 4)) {
+		fuzz = true;
+		only = skip_spaces(only + 4);
+	}
+	if (!strcmp(only, "all") || !strcmp(only, "1"))
+		only = "";
+
+	memset(&b, 0, sizeof(b));
+	b.comp_size = lzo1x_worst_compress(max_chunk);
+	b.comp = vmalloc(b.comp_size);
+	b.decomp = vmalloc(max_chunk + BENCH_GUARD_SIZE);
+	b.clat.samples = vmalloc(BENCH_MAX_SAMPLES * sizeof(u32));
+	b.dlat.samples = vmalloc(BENCH_MAX_SAMPLES * sizeof(u32));
+	if (!b.comp || !b.decomp || !b.clat.samples || !b.dlat.samples)
+		goto out;
+
+	if (fuzz) {
+		bench_fuzz(only, &b);
+		ret = 0;
+		goto out;
+	}
+
+	bench_print("# iterations=%u, latencies in ns\n", iterations);
+	bench_print("%-16s %-7s %7s %7s %8s %8s %31s %31s %6s\n",
+		    "codec", "corpus", "chunk", "ratio%", "c_MB/s", "d_MB/s",
+		    "comp p50/p90/p99/max", "decomp p50/p90/p99/max",
+		    "errors");
+
+	for (i = 0; i < ARRAY_SIZE(lib_codecs); i++)
+		if (!*only || !strcmp(only, lib_codecs[i].name))
+			bench_codec(&lib_codecs[i], &b);
+
+	for (i = 0; i < nr_crypto_codecs; i++)
+		if (!*only || !strcmp(only, crypto_codecs[i].name))
+			bench_codec(&crypto_codecs[i], &b);
+
+	if (!*only || !strcmp(only, "xz"))
+		bench_xz(&b);
+
+	ret = 0;
+out:
+	vfree(b.comp);
+	vfree(b.decomp);
+	vfree(b.clat.samples);
+	vfree(b.dlat.samples);
+	return ret;
+}
+
+/*
+ * debugfs interface
+ */
+
+static int bench_corpus_open(struct inode *inode, struct file *file)
+{
+	struct bench_corpus *c = inode->i_private;
+
+	file->private_data = c;
+	if (file->f_flags & O_TRUNC) {
+		mutex_lock(&compress_bench.mutex);
+		c->len = 0;
+		mutex_unlock(&compress_bench.mutex);
+	}
+	return 0;
+}
+
+static ssize_t bench_corpus_write(struct file *file, const char __user *ubuf,
+				  size_t count, loff_t *ppos)
+{
+	struct bench_corpus *c = file->private_data;
+	loff_t pos = *ppos;
+	ssize_t ret = count;
+
+	if (pos < 0 || pos >= max_corpus_size)
+		return -ENOSPC;
+	count = min_t(size_t, count, max_corpus_size - pos);
+
+	mutex_lock(&compress_bench.mutex);
+	if (!c->data) {
+		c->data = vmalloc(max_corpus_size);
+		if (!c->data) {
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+	if (copy_from_user(c->data + pos, ubuf, count)) {
+		ret = -EFAULT;
+		goto out;
+	}
+	c->len = max_t(size_t, c->len, pos + count);
+	*ppos = pos + count;
+	ret = count;
+out:
+	mutex_unlock(&compress_bench.mutex);
+	return ret;
+}
+
+static const struct file_operations bench_corpus_fops = {
+	.open	= bench_corpus_open,
+	.write	= bench_corpus_write,
+	.llseek	= default_llseek,
+};
+
+static void bench_free_corpora(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(gen_corpora); i++)
+		vfree(gen_corpora[i].data);
+	vfree(user_corpus.data);
+	vfree(xz_corpus.data);
+}
+
+static int __init test_compress_init(void)
+{
+	int ret;
+
+	if (large_size < PAGE_SIZE || large_size > corpus_size)
+		return -EINVAL;
+
+	ret = bench_generate_corpora();
+	if (ret)
+		goto fail;
+
+	bench_parse_crypto_algs();
+
+	ret = bench_register(&compress_bench);
+	if (ret)
+		goto fail;
+	debugfs_create_file("corpus", 0200, compress_bench.dir, &user_corpus,
+			    &bench_corpus_fops);
+	debugfs_create_file("xz_corpus", 0200, compress_bench.dir, &xz_corpus,
+			    &bench_corpus_fops);
+
+	return 0;
+
+fail:
+	bench_free_corpora();
+	return ret;
+}
+
+static void __exit test_compress_exit(void)
+{
+	bench_unregister(&compress_bench);
+	bench_free_corpora();
+}
+
+module_init(test_compress_init);
+module_exit(test_compress_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Compression library benchmark");
@@ -0,0 +1,189 @@
+/*
+ * Benchmark for small high-order page allocations.
+ *
+ * Every online cpu takes batches of blocks from alloc_pages() and gives
+ * them back with __free_pages() at the same time, which is when the
+ * per-cpu lists either keep zone->lock out of the way or do not.  Each
+ * order from 0 to PCP_MAX_ORDER gets a run of its own, and a last run
+ * mixes them the way kernel stacks, slabs and network buffers do.
+ *
+ * With debugfs mounted on /sys/kernel/debug:
+ *
+ *   echo 1 > /sys/kernel/debug/page_alloc_bench/run
+ *   cat /sys/kernel/debug/page_alloc_bench/results
+ *
+ * The contention on zone->lock is reported by lock_stat on kernels built
+ * with CONFIG_LOCK_STAT: clear it before the run with
+ * "echo 0 > /proc/lock_stat" and look up the &zone->lock class in
+ * /proc/lock_stat afterwards.  tools/testing/page-alloc/pcp-bench.sh
+ * does both.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/gfp.h>
+#include <linux/mm.h>
+#include <linux/mmzone.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/random.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+
+#include "test-bench.h"
+
+static unsigned int duration_ms = 2000;
+module_param(duration_ms, uint, 0644);
+MODULE_PARM_DESC(duration_ms, "Length of each run in ms (default: 2000)");
+
+static unsigned int batch = 64;
+module_param(batch, uint, 0644);
+MODULE_PARM_DESC(batch, "Blocks held by a thread at once (default: 64)");
+
+#define BENCH_RESULTS_SIZE	4096
+#define BENCH_MAX_BATCH		1024
+#define BENCH_MIXED		-1
+
+struct bench_thread {
+	unsigned long		ops;
+	unsigned long		failed;
+	u64			alloc_ns;
+	u64			free_ns;
+};
+
+static int bench_order;		/* or BENCH_MIXED */
+
+/* Roughly 8:4:2:1 for orders 0 to 3 */
+static int bench_pick_order(int order)
+{
+	u32 r;
+
+	if (order != BENCH_MIXED)
+		return order;
+
+	r = random32() % ((2 << PCP_MAX_ORDER) - 1);
+	for (order = 0; order < PCP_MAX_ORDER; order++) {
+		if (r < (1 << (PCP_MAX_ORDER - order)))
+			break;
+		r -= 1 << (PCP_MAX_ORDER - order);
+	}
+	return order;
+}
+
+static void bench_thread_fn(void *data, unsigned int index, unsigned int nr)
+{
+	struct bench_thread *t = (struct bench_thread *)data + index;
+	struct page **pages;
+	u8 *orders;
+	unsigned long deadline;
+	unsigned int i, n = min_t(unsigned int, batch, BENCH_MAX_BATCH);
+	ktime_t t0, t1, t2;
+
+	pages = kmalloc(n * sizeof(*pages), GFP_KERNEL);
+	orders = kmalloc(n, GFP_KERNEL);
+	if (!pages || !orders)
+		goto out;
+
+	deadline = jiffies + msecs_to_jiffies(duration_ms);
+	while (time_before(jiffies, deadline)) {
+		for (i = 0; i < n; i++)
+			orders[i] = bench_pick_order(bench_order);
+
+		t0 = ktime_get();
+		for (i = 0; i < n; i++)
+			pages[i] = alloc_pages(GFP_KERNEL | __GFP_NOWARN,
+					       orders[i]);
+		t1 = ktime_get();
+		for (i = 0; i < n; i++) {
+			if (pages[i])
+				__free_pages(pages[i], orders[i]);
+			else
+				t->failed++;
+		}
+		t2 = ktime_get();
+
+		t->ops += n;
+		t->alloc_ns += ktime_to_ns(ktime_sub(t1, t0));
+		t->free_ns += ktime_to_ns(ktime_sub(t2, t1));
+		cond_resched();
+	}
+out:
+	kfree(pages);
+	kfree(orders);
+}
+
+static int bench_one(struct bench *b, int order)
+{
+	struct bench_thread *threads;
+	unsigned long ops = 0, failed = 0;
+	u64 alloc_ns = 0, free_ns = 0;
+	int nr, i;
+
+	threads = kcalloc(nr_cpu_ids, sizeof(*threads), GFP_KERNEL);
+	if (!threads)
+		return -ENOMEM;
+
+	bench_order = order;
+	nr = bench_on_each_cpu("page_alloc_bench", bench_thread_fn, threads);
+
+	for (i = 0; i < nr; i++) {
+		ops += threads[i].ops;
+		failed += threads[i].failed;
+		alloc_ns += threads[i].alloc_ns;
+		free_ns += threads[i].free_ns;
+	}
+	kfree(threads);
+	if (nr < 0)
+		return nr;
+
+	if (order == BENCH_MIXED)
+		bench_printf(b, "mixed  ");
+	else
+		bench_printf(b, "order%d ", order);
+	bench_printf(b, " %7d %12llu %9llu %9llu %8lu\n", nr,
+		     div_u64((u64)ops * 1000, max(duration_ms, 1U)),
+		     ops ? div64_u64(alloc_ns, ops) : 0,
+		     ops ? div64_u64(free_ns, ops) : 0, failed);
+	return 0;
+}
+
+static int bench_run(struct bench *b, char *arg)
+{
+	int order, ret;
+
+	bench_printf(b, "run     threads  allocs/sec   alloc-ns   free-ns   failed\n");
+
+	for (order = 0; order <= PCP_MAX_ORDER; order++) {
+		ret = bench_one(b, order);
+		if (ret)
+			return ret;
+	}
+	return bench_one(b, BENCH_MIXED);
+}
+
+static struct bench page_alloc_bench = {
+	.name	= "page_alloc_bench",
+	.size	= BENCH_RESULTS_SIZE,
+	.run	= bench_run,
+};
+
+static int __init test_page_alloc_init(void)
+{
+	return bench_register(&page_alloc_bench);
+}
+
+static void __exit test_page_alloc_exit(void)
+{
+	bench_unregister(&page_alloc_bench);
+}
+
+module_init(test_page_alloc_init);
+module_exit(test_page_alloc_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Page allocator benchmark for small high orders");
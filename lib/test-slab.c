@@ -0,0 +1,220 @@
+/*
+ * Stress benchmark for the slab allocator.
+ *
+ * kmalloc() and kfree() of a few object sizes, on all online cpus at
+ * once.  Each size is run twice:
+ *
+ *   local   a thread frees the objects it allocated, as most short lived
+ *           allocations are freed
+ *   remote  a thread hands each batch to the next thread and
+ *           frees the batch it gets from the previous one, as network
+ *           buffers and binder transactions are freed on another cpu
+ *
+ * The remote runs free into slabs that are not the cpu slab of the
+ * freeing cpu, which is what takes the slow paths and the node
+ * list_lock.
+ *
+ * With debugfs mounted on /sys/kernel/debug:
+ *
+ *   echo 1 > /sys/kernel/debug/slab_bench/run
+ *   cat /sys/kernel/debug/slab_bench/results
+ *
+ * With CONFIG_SLUB_STATS the per cache counters under
+ * /sys/kernel/slab/kmalloc-<size>/ show which paths the runs took, and
+ * with CONFIG_LOCK_STAT /proc/lock_stat shows the contention on
+ * &n->list_lock.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+
+#include "test-bench.h"
+
+static unsigned int duration_ms = 2000;
+module_param(duration_ms, uint, 0644);
+MODULE_PARM_DESC(duration_ms, "Length of each run in ms (default: 2000)");
+
+static unsigned int batch = 128;
+module_param(batch, uint, 0644);
+MODULE_PARM_DESC(batch, "Objects held by a thread at once (default: 128)");
+
+#define BENCH_RESULTS_SIZE	4096
+#define BENCH_MAX_BATCH		1024
+
+/* dentry and binder sized, skbuff head and data sized */
+static const size_t bench_sizes[] = { 64, 192, 512, 2048 };
+
+struct bench_thread {
+	void			**objs;		/* batch owned, or NULL */
+	unsigned long		ops;
+	unsigned long		failed;
+	u64			alloc_ns;
+	u64			free_ns;
+};
+
+static size_t bench_size;
+static bool bench_remote;
+static unsigned int bench_batch;
+/* handoff[i] is the batch waiting to be freed by thread i */
+static void ***handoff;
+
+static void bench_free_batch(struct bench_thread *t, void **objs)
+{
+	ktime_t t0 = ktime_get();
+	unsigned int i;
+
+	for (i = 0; i < bench_batch; i++) {
+		kfree(objs[i]);
+		objs[i] = NULL;
+	}
+	t->free_ns += ktime_to_ns(ktime_sub(ktime_get(), t0));
+}
+
+/*
+ * Pass the batch on to the next thread and take the one left by the
+ * previous thread.  Returns false if the run ended while waiting.
+ */
+static bool bench_pass_batch(struct bench_thread *t, unsigned int index,
+			     unsigned int nr, unsigned long deadline)
+{
+	unsigned int next = (index + 1) % nr;
+
+	while (cmpxchg(&handoff[next], NULL, t->objs) != NULL) {
+		if (time_after(jiffies, deadline))
+			return false;
+		cpu_relax();
+	}
+	t->objs = NULL;
+
+	while (!(t->objs = xchg(&handoff[index], NULL))) {
+		if (time_after(jiffies, deadline))
+			return false;
+		cpu_relax();
+	}
+	return true;
+}
+
+static void bench_thread_fn(void *data, unsigned int index, unsigned int nr)
+{
+	struct bench_thread *t = (struct bench_thread *)data + index;
+	unsigned long deadline;
+	unsigned int i;
+	ktime_t t0;
+
+	deadline = jiffies + msecs_to_jiffies(duration_ms);
+	while (time_before(jiffies, deadline)) {
+		t0 = ktime_get();
+		for (i = 0; i < bench_batch; i++)
+			t->objs[i] = kmalloc(bench_size, GFP_KERNEL);
+		t->alloc_ns += ktime_to_ns(ktime_sub(ktime_get(), t0));
+		for (i = 0; i < bench_batch; i++)
+			if (!t->objs[i])
+				t->failed++;
+		t->ops += bench_batch;
+
+		if (bench_remote && !bench_pass_batch(t, index, nr, deadline))
+			break;
+		bench_free_batch(t, t->objs);
+		cond_resched();
+	}
+}
+
+static int bench_one(struct bench *b, size_t size, bool remote)
+{
+	struct bench_thread *threads;
+	unsigned long ops = 0, failed = 0;
+	u64 alloc_ns = 0, free_ns = 0;
+	void **objs;
+	int nr, ret = 0, i;
+
+	bench_size = size;
+	bench_remote = remote;
+	bench_batch = clamp(batch, 1U, (unsigned int)BENCH_MAX_BATCH);
+
+	threads = kcalloc(nr_cpu_ids, sizeof(*threads), GFP_KERNEL);
+	handoff = kcalloc(nr_cpu_ids, sizeof(*handoff), GFP_KERNEL);
+	/* zeroed, so that kfree() of the slots never filled is harmless */
+	objs = kcalloc(nr_cpu_ids * bench_batch, sizeof(void *), GFP_KERNEL);
+	if (!threads || !handoff || !objs) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < nr_cpu_ids; i++)
+		threads[i].objs = objs + i * bench_batch;
+
+	nr = bench_on_each_cpu("slab_bench", bench_thread_fn, threads);
+
+	/* Batches still held or passed on when the run ended */
+	for (i = 0; i < nr_cpu_ids * bench_batch; i++)
+		kfree(objs[i]);
+
+	for (i = 0; i < nr; i++) {
+		ops += threads[i].ops;
+		failed += threads[i].failed;
+		alloc_ns += threads[i].alloc_ns;
+		free_ns += threads[i].free_ns;
+	}
+	if (nr < 0) {
+		ret = nr;
+		goto out;
+	}
+
+	bench_printf(b, "%-6s %5zu %7d %12llu %9llu %9llu %8lu\n",
+		     remote ? "remote" : "local", size, nr,
+		     div_u64((u64)ops * 1000, max(duration_ms, 1U)),
+		     ops ? div64_u64(alloc_ns, ops) : 0,
+		     ops ? div64_u64(free_ns, ops) : 0, failed);
+out:
+	kfree(objs);
+	kfree(handoff);
+	kfree(threads);
+	return ret;
+}
+
+static int bench_run(struct bench *b, char *arg)
+{
+	int i, ret;
+
+	bench_printf(b, "run     size threads  allocs/sec   alloc-ns   free-ns   failed\n");
+
+	for (i = 0; i < ARRAY_SIZE(bench_sizes); i++) {
+		ret = bench_one(b, bench_sizes[i], false);
+		if (!ret)
+			ret = bench_one(b, bench_sizes[i], true);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+static struct bench slab_bench = {
+	.name	= "slab_bench",
+	.size	= BENCH_RESULTS_SIZE,
+	.run	= bench_run,
+};
+
+static int __init test_slab_init(void)
+{
+	return bench_register(&slab_bench);
+}
+
+static void __exit test_slab_exit(void)
+{
+	bench_unregister(&slab_bench);
+}
+
+module_init(test_slab_init);
+module_exit(test_slab_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Slab allocator stress benchmark");
@@ -0,0 +1,178 @@
+/*
+ * Throughput benchmark for vmap() and vunmap().
+ *
+ * All online cpus keep mapping one shared set of pages with vmap() and
+ * unmapping it with vunmap(), the pattern of ION kernel mappings, binder
+ * buffers and module loads.  The sizes go from one page up to 4MB, and
+ * the pages are never touched, so only the cost of the mappings shows.
+ *
+ * With debugfs mounted on /sys/kernel/debug:
+ *
+ *   echo 1 > /sys/kernel/debug/vmap_bench/run
+ *   cat /sys/kernel/debug/vmap_bench/results
+ *
+ * The vmap_* counters in /proc/vmstat show how many of the areas came
+ * from the per-cpu caches and how many lazy purges and full TLB flushes
+ * the runs caused.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/mm.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+
+#include "test-bench.h"
+
+static unsigned int duration_ms = 1000;
+module_param(duration_ms, uint, 0644);
+MODULE_PARM_DESC(duration_ms, "Length of each run in ms (default: 1000)");
+
+#define BENCH_RESULTS_SIZE	4096
+#define BENCH_MAX_PAGES		1024	/* 4MB with 4K pages */
+
+/* in pages */
+static const unsigned int bench_sizes[] = { 1, 4, 16, 64, 256, BENCH_MAX_PAGES };
+
+struct bench_thread {
+	unsigned long		ops;
+	unsigned long		failed;
+	u64			vmap_ns;
+	u64			vunmap_ns;
+};
+
+static struct page **bench_pages;
+static unsigned int bench_nr_pages;
+
+static void bench_thread_fn(void *data, unsigned int index, unsigned int nr)
+{
+	struct bench_thread *t = (struct bench_thread *)data + index;
+	unsigned long deadline;
+	void *addr;
+	ktime_t t0;
+
+	deadline = jiffies + msecs_to_jiffies(duration_ms);
+	while (time_before(jiffies, deadline)) {
+		t0 = ktime_get();
+		addr = vmap(bench_pages, bench_nr_pages, VM_MAP, PAGE_KERNEL);
+		t->vmap_ns += ktime_to_ns(ktime_sub(ktime_get(), t0));
+		if (!addr) {
+			t->failed++;
+			cond_resched();
+			continue;
+		}
+
+		t0 = ktime_get();
+		vunmap(addr);
+		t->vunmap_ns += ktime_to_ns(ktime_sub(ktime_get(), t0));
+		t->ops++;
+		cond_resched();
+	}
+}
+
+static int bench_one(struct bench *b, unsigned int nr_pages)
+{
+	struct bench_thread *threads;
+	unsigned long ops = 0, failed = 0;
+	u64 vmap_ns = 0, vunmap_ns = 0;
+	int nr, i;
+
+	threads = kcalloc(nr_cpu_ids, sizeof(*threads), GFP_KERNEL);
+	if (!threads)
+		return -ENOMEM;
+
+	bench_nr_pages = nr_pages;
+	nr = bench_on_each_cpu("vmap_bench", bench_thread_fn, threads);
+
+	for (i = 0; i < nr; i++) {
+		ops += threads[i].ops;
+		failed += threads[i].failed;
+		vmap_ns += threads[i].vmap_ns;
+		vunmap_ns += threads[i].vunmap_ns;
+	}
+	kfree(threads);
+	if (nr < 0)
+		return nr;
+
+	bench_printf(b, "%6u %7d %10llu %9llu %9llu %8lu\n",
+		     nr_pages << (PAGE_SHIFT - 10), nr,
+		     div_u64((u64)ops * 1000, max(duration_ms, 1U)),
+		     ops ? div64_u64(vmap_ns, ops) : 0,
+		     ops ? div64_u64(vunmap_ns, ops) : 0, failed);
+	return 0;
+}
+
+static int bench_run(struct bench *b, char *arg)
+{
+	int i, ret;
+
+	bench_printf(b, " size-kb threads   maps/sec   vmap-ns vunmap-ns   failed\n");
+
+	for (i = 0; i < ARRAY_SIZE(bench_sizes); i++) {
+		ret = bench_one(b, bench_sizes[i]);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+static struct bench vmap_bench = {
+	.name	= "vmap_bench",
+	.size	= BENCH_RESULTS_SIZE,
+	.run	= bench_run,
+};
+
+static void bench_free_pages(void)
+{
+	int i;
+
+	for (i = 0; i < BENCH_MAX_PAGES; i++)
+		if (bench_pages[i])
+			__free_page(bench_pages[i]);
+	kfree(bench_pages);
+}
+
+static int __init test_vmap_init(void)
+{
+	int i, ret = -ENOMEM;
+
+	bench_pages = kcalloc(BENCH_MAX_PAGES, sizeof(struct page *),
+			      GFP_KERNEL);
+	if (!bench_pages)
+		return -ENOMEM;
+
+	for (i = 0; i < BENCH_MAX_PAGES; i++) {
+		bench_pages[i] = alloc_page(GFP_KERNEL | __GFP_HIGHMEM);
+		if (!bench_pages[i])
+			goto fail;
+	}
+
+	ret = bench_register(&vmap_bench);
+	if (ret)
+		goto fail;
+	return 0;
+
+fail:
+	bench_free_pages();
+	return ret;
+}
+
+static void __exit test_vmap_exit(void)
+{
+	bench_unregister(&vmap_bench);
+	bench_free_pages();
+}
+
+module_init(test_vmap_init);
+module_exit(test_vmap_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("vmap and vunmap throughput benchmark");
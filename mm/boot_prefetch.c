@@ -0,0 +1,525 @@
+/*
+ * mm/boot_prefetch.c - record the page cache fill of a boot and replay it
+ *
+ * A cold boot reads thousands of small files from /system, one synchronous
+ * read at a time, and the device spends most of that time waiting on
+ * single page requests.  The set of files and offsets barely changes from
+ * one boot to the next.
+ *
+ * Booting with "boot_prefetch=record" hooks the mm_filemap_add_to_page_cache
+ * tracepoint and logs every regular file page read from a block device.
+ * Reading /proc/boot_prefetch/trace stops the recording and returns the
+ * log sorted by device, inode and offset, merged into ranges and turned
+ * into path names:
+ *
+ *	<path> <first page> <nr pages>
+ *
+ * Userspace stores that list and, early on the next boot, writes it back
+ * to /proc/boot_prefetch/list.  When the writer closes the file a kernel
+ * thread opens each path relative to the writer's root and issues the
+ * ranges through force_page_cache_readahead() in list order, so the
+ * reads go out as large asynchronous requests ahead of the processes
+ * that need them.
+ *
+ * See Documentation/vm/boot-prefetch.txt.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/fs.h>
+#include <linux/fs_struct.h>
+#include <linux/mm.h>
+#include <linux/mount.h>
+#include <linux/dcache.h>
+#include <linux/namei.h>
+#include <linux/file.h>
+#include <linux/sched.h>
+#include <linux/kthread.h>
+#include <linux/mutex.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/sort.h>
+#include <linux/swap.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <linux/slab.h>
+#include <linux/jiffies.h>
+#include <trace/events/filemap.h>
+
+/* Pages logged during one recording, 256MB worth with 4K pages */
+#define BOOT_PREFETCH_MAX_RECORDS	65536
+/* Holes up to this many pages are read along with the ranges around them */
+#define BOOT_PREFETCH_MERGE_GAP		8
+/* Largest list accepted on /proc/boot_prefetch/list */
+#define BOOT_PREFETCH_MAX_LIST		(1 << 20)
+
+struct boot_prefetch_record {
+	dev_t		dev;
+	unsigned long	ino;
+	pgoff_t		start;
+	unsigned long	nr;
+};
+
+static bool boot_prefetch_recording;
+static struct boot_prefetch_record *records;
+static atomic_t nr_records = ATOMIC_INIT(0);
+/* Merged ranges, valid once the recording has stopped */
+static struct boot_prefetch_record *ranges;
+static unsigned int nr_ranges;
+
+/* The list being written, and whether a replay already ran */
+static char *list_buf;
+static size_t list_len;
+static bool list_replayed;
+
+static DEFINE_MUTEX(boot_prefetch_mutex);
+
+static int __init boot_prefetch_setup(char *str)
+{
+	if (!strcmp(str, "record"))
+		boot_prefetch_recording = true;
+	return 1;
+}
+__setup("boot_prefetch=", boot_prefetch_setup);
+
+/*
+ * Called for every page added to the page cache, possibly under spinlocks,
+ * so all it does is claim a slot.
+ */
+static void boot_prefetch_probe(void *ignore, struct page *page)
+{
+	struct inode *inode = page->mapping->host;
+	struct boot_prefetch_record *rec;
+	unsigned int i;
+
+	if (!inode || !S_ISREG(inode->i_mode) || !inode->i_sb->s_bdev)
+		return;
+
+	i = atomic_inc_return(&nr_records) - 1;
+	if (i >= BOOT_PREFETCH_MAX_RECORDS)
+		return;
+
+	rec = &records[i];
+	rec->dev = inode->i_sb->s_dev;
+	rec->ino = inode->i_ino;
+	rec->start = page->index;
+	rec->nr = 1;
+}
+
+static int boot_prefetch_record_cmp(const void *a, const void *b)
+{
+	const struct boot_prefetch_record *l = a, *r = b;
+
+	if (l->dev != r->dev)
+		return l->dev < r->dev ? -1 : 1;
+	if (l->ino != r->ino)
+		return l->ino < r->ino ? -1 : 1;
+	if (l->start != r->start)
+		return l->start < r->start ? -1 : 1;
+	return 0;
+}
+
+/* Stop logging and fold the log into sorted, merged ranges */
+static void boot_prefetch_stop_recording(void)
+{
+	struct boot_prefetch_record *rec, *out;
+	unsigned int i, nr;
+
+	unregister_trace_mm_filemap_add_to_page_cache(boot_prefetch_probe,
+						       NULL);
+	tracepoint_synchronize_unregister();
+	boot_prefetch_recording = false;
+
+	nr = min_t(unsigned int, atomic_read(&nr_records),
+		   BOOT_PREFETCH_MAX_RECORDS);
+	sort(records, nr, sizeof(*records), boot_prefetch_record_cmp, NULL);
+
+	out = NULL;
+	for (i = 0; i < nr; i++) {
+		rec = &records[i];
+		if (out && out->dev == rec->dev && out->ino == rec->ino &&
+		    rec->start <= out->start + out->nr +
+				  BOOT_PREFETCH_MERGE_GAP) {
+			if (rec->start + rec->nr > out->start + out->nr)
+				out->nr = rec->start + rec->nr - out->start;
+			continue;
+		}
+		out = out ? out + 1 : records;
+		*out = *rec;
+	}
+	nr_ranges = out ? out - records + 1 : 0;
+
+	ranges = vmalloc(max(nr_ranges, 1U) * sizeof(*ranges));
+	if (ranges)
+		memcpy(ranges, records, nr_ranges * sizeof(*ranges));
+	else
+		nr_ranges = 0;
+	vfree(records);
+	records = NULL;
+
+	printk(KERN_INFO "boot_prefetch: recorded %u pages in %u ranges%s\n",
+	       nr, nr_ranges, atomic_read(&nr_records) > nr ? ", log full" : "");
+}
+
+struct boot_prefetch_iter {
+	struct vfsmount	*mounts;	/* private copy of the mount tree */
+	dev_t		dev;		/* last inode looked up */
+	unsigned long	ino;
+	char		*path;		/* its name, NULL if it has none */
+	char		buf[PATH_MAX];
+};
+
+struct boot_prefetch_match {
+	struct super_block *sb;
+	struct vfsmount	*mnt;
+};
+
+static int boot_prefetch_match_mount(struct vfsmount *mnt, void *arg)
+{
+	struct boot_prefetch_match *match = arg;
+
+	if (mnt->mnt_sb != match->sb || mnt->mnt_root != match->sb->s_root)
+		return 0;
+	match->mnt = mnt;
+	return 1;
+}
+
+/*
+ * Name the inode by a path from the reader's root, through a mount of the
+ * whole filesystem.  Inodes that were evicted or unlinked since they were
+ * read are skipped.
+ */
+static char *boot_prefetch_resolve(struct boot_prefetch_iter *iter,
+				   dev_t dev, unsigned long ino)
+{
+	struct boot_prefetch_match match = { .mnt = NULL };
+	struct super_block *sb;
+	struct inode *inode;
+	struct dentry *dentry;
+	char *name = NULL;
+
+	sb = user_get_super(dev);
+	if (!sb)
+		return NULL;
+
+	match.sb = sb;
+	iterate_mounts(boot_prefetch_match_mount, &match, iter->mounts);
+	inode = match.mnt ? ilookup(sb, ino) : NULL;
+	dentry = inode ? d_find_alias(inode) : NULL;
+	if (dentry && !d_unlinked(dentry)) {
+		struct path path = { .mnt = match.mnt, .dentry = dentry };
+		struct path root = {
+			.mnt = iter->mounts,
+			.dentry = iter->mounts->mnt_root,
+		};
+
+		name = __d_path(&path, &root, iter->buf, sizeof(iter->buf));
+		if (IS_ERR(name) || strchr(name, '\n'))
+			name = NULL;
+	}
+	dput(dentry);
+	iput(inode);
+	drop_super(sb);
+	return name;
+}
+
+static void *boot_prefetch_seq_start(struct seq_file *m, loff_t *pos)
+{
+	return *pos < nr_ranges ? &ranges[*pos] : NULL;
+}
+
+static void *boot_prefetch_seq_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	++*pos;
+	return boot_prefetch_seq_start(m, pos);
+}
+
+static void boot_prefetch_seq_stop(struct seq_file *m, void *v)
+{
+}
+
+static int boot_prefetch_seq_show(struct seq_file *m, void *v)
+{
+	struct boot_prefetch_iter *iter = m->private;
+	struct boot_prefetch_record *range = v;
+
+	if (range->dev != iter->dev || range->ino != iter->ino) {
+		iter->dev = range->dev;
+		iter->ino = range->ino;
+		iter->path = boot_prefetch_resolve(iter, range->dev,
+						   range->ino);
+	}
+	if (!iter->path)
+		return SEQ_SKIP;
+
+	seq_printf(m, "%s %lu %lu\n", iter->path, range->start, range->nr);
+	return 0;
+}
+
+static const struct seq_operations boot_prefetch_seq_ops = {
+	.start	= boot_prefetch_seq_start,
+	.next	= boot_prefetch_seq_next,
+	.stop	= boot_prefetch_seq_stop,
+	.show	= boot_prefetch_seq_show,
+};
+
+static int boot_prefetch_trace_open(struct inode *inode, struct file *file)
+{
+	struct boot_prefetch_iter *iter;
+	struct path root;
+	int ret;
+
+	iter = kzalloc(sizeof(*iter), GFP_KERNEL);
+	if (!iter)
+		return -ENOMEM;
+
+	get_fs_root(current->fs, &root);
+	iter->mounts = collect_mounts(&root);
+	path_put(&root);
+	if (IS_ERR_OR_NULL(iter->mounts)) {
+		kfree(iter);
+		return -ENOMEM;
+	}
+
+	mutex_lock(&boot_prefetch_mutex);
+	if (boot_prefetch_recording)
+		boot_prefetch_stop_recording();
+	mutex_unlock(&boot_prefetch_mutex);
+
+	ret = seq_open(file, &boot_prefetch_seq_ops);
+	if (ret) {
+		drop_collected_mounts(iter->mounts);
+		kfree(iter);
+		return ret;
+	}
+	((struct seq_file *)file->private_data)->private = iter;
+	return 0;
+}
+
+static int boot_prefetch_trace_release(struct inode *inode, struct file *file)
+{
+	struct boot_prefetch_iter *iter =
+		((struct seq_file *)file->private_data)->private;
+
+	drop_collected_mounts(iter->mounts);
+	kfree(iter);
+	return seq_release(inode, file);
+}
+
+static const struct file_operations boot_prefetch_trace_fops = {
+	.open		= boot_prefetch_trace_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= boot_prefetch_trace_release,
+};
+
+struct boot_prefetch_entry {
+	const char	*path;
+	pgoff_t		start;
+	unsigned long	nr;
+};
+
+struct boot_prefetch_list {
+	struct path	root;		/* the writer's root */
+	char		*buf;
+	unsigned int	nr_entries;
+	struct boot_prefetch_entry entries[0];
+};
+
+/*
+ * Split the list into entries in place.  Consecutive lines for the same
+ * file are merged the same way the recording was.
+ */
+static unsigned int boot_prefetch_parse(char *buf, size_t len,
+					struct boot_prefetch_entry *entries)
+{
+	struct boot_prefetch_entry *e = NULL;
+	char *line, *next, *end = buf + len;
+	unsigned long start, nr;
+	char *p;
+
+	for (line = buf; line < end; line = next) {
+		next = memchr(line, '\n', end - line);
+		if (!next)
+			break;
+		*next++ = '\0';
+
+		/* the path may contain blanks, so the numbers are taken last */
+		p = strrchr(line, ' ');
+		if (!p || strict_strtoul(p + 1, 10, &nr) || !nr)
+			continue;
+		*p = '\0';
+		p = strrchr(line, ' ');
+		if (!p || strict_strtoul(p + 1, 10, &start))
+			continue;
+		*p = '\0';
+		if (line[0] != '/')
+			continue;
+
+		if (e && !strcmp(e->path, line) &&
+		    start >= e->start &&
+		    start <= e->start + e->nr + BOOT_PREFETCH_MERGE_GAP) {
+			if (start + nr > e->start + e->nr)
+				e->nr = start + nr - e->start;
+			continue;
+		}
+		e = e ? e + 1 : entries;
+		e->path = line;
+		e->start = start;
+		e->nr = nr;
+	}
+	return e ? e - entries + 1 : 0;
+}
+
+static int boot_prefetch_thread(void *arg)
+{
+	struct boot_prefetch_list *list = arg;
+	unsigned long budget = totalram_pages / 4;
+	unsigned long start_time = jiffies;
+	unsigned long pages = 0;
+	unsigned int i, files = 0;
+	struct file *file = NULL;
+	const char *path = NULL;
+	int ret;
+
+	for (i = 0; i < list->nr_entries && budget; i++) {
+		struct boot_prefetch_entry *e = &list->entries[i];
+		unsigned long nr = min(e->nr, budget);
+
+		if (!path || strcmp(path, e->path)) {
+			if (file)
+				fput(file);
+			path = e->path;
+			file = file_open_root(list->root.dentry, list->root.mnt,
+					      path, O_RDONLY | O_LARGEFILE);
+			if (IS_ERR(file)) {
+				file = NULL;
+				continue;
+			}
+			files++;
+		}
+		if (!file)
+			continue;
+
+		ret = force_page_cache_readahead(file->f_mapping, file,
+						 e->start, nr);
+		if (ret > 0)
+			pages += ret;
+		budget -= nr;
+	}
+	if (file)
+		fput(file);
+
+	printk(KERN_INFO "boot_prefetch: read %lu pages from %u files in %u ms\n",
+	       pages, files, jiffies_to_msecs(jiffies - start_time));
+
+	path_put(&list->root);
+	vfree(list->buf);
+	vfree(list);
+	return 0;
+}
+
+static int boot_prefetch_list_open(struct inode *inode, struct file *file)
+{
+	int ret = 0;
+
+	mutex_lock(&boot_prefetch_mutex);
+	if (list_replayed || list_buf) {
+		ret = -EBUSY;
+	} else {
+		list_buf = vmalloc(BOOT_PREFETCH_MAX_LIST);
+		list_len = 0;
+		if (!list_buf)
+			ret = -ENOMEM;
+	}
+	mutex_unlock(&boot_prefetch_mutex);
+	return ret;
+}
+
+static ssize_t boot_prefetch_list_write(struct file *file,
+					const char __user *buf,
+					size_t count, loff_t *ppos)
+{
+	ssize_t ret;
+
+	mutex_lock(&boot_prefetch_mutex);
+	if (count > BOOT_PREFETCH_MAX_LIST - list_len) {
+		ret = -EFBIG;
+	} else if (copy_from_user(list_buf + list_len, buf, count)) {
+		ret = -EFAULT;
+	} else {
+		list_len += count;
+		ret = count;
+	}
+	mutex_unlock(&boot_prefetch_mutex);
+	return ret;
+}
+
+static int boot_prefetch_list_release(struct inode *inode, struct file *file)
+{
+	struct boot_prefetch_list *list;
+	struct task_struct *task;
+	unsigned int max_entries;
+
+	mutex_lock(&boot_prefetch_mutex);
+	list_replayed = true;
+
+	/* a line takes at least five bytes: "/ 0 1" */
+	max_entries = list_len / 6 + 1;
+	list = vmalloc(sizeof(*list) +
+		       max_entries * sizeof(struct boot_prefetch_entry));
+	if (!list)
+		goto out;
+
+	list->buf = list_buf;
+	list->nr_entries = boot_prefetch_parse(list_buf, list_len,
+					       list->entries);
+	get_fs_root(current->fs, &list->root);
+
+	task = kthread_run(boot_prefetch_thread, list, "boot_prefetch");
+	if (IS_ERR(task)) {
+		path_put(&list->root);
+		vfree(list);
+		goto out;
+	}
+	list_buf = NULL;
+out:
+	vfree(list_buf);
+	list_buf = NULL;
+	mutex_unlock(&boot_prefetch_mutex);
+	return 0;
+}
+
+static const struct file_operations boot_prefetch_list_fops = {
+	.open		= boot_prefetch_list_open,
+	.write		= boot_prefetch_list_write,
+	.llseek		= noop_llseek,
+	.release	= boot_prefetch_list_release,
+};
+
+static int __init boot_prefetch_init(void)
+{
+	struct proc_dir_entry *dir;
+
+	dir = proc_mkdir("boot_prefetch", NULL);
+	if (!dir)
+		return -ENOMEM;
+	proc_create("trace", S_IRUSR, dir, &boot_prefetch_trace_fops);
+	proc_create("list", S_IWUSR, dir, &boot_prefetch_list_fops);
+
+	if (!boot_prefetch_recording)
+		return 0;
+
+	records = vmalloc(BOOT_PREFETCH_MAX_RECORDS * sizeof(*records));
+	if (!records ||
+	    register_trace_mm_filemap_add_to_page_cache(boot_prefetch_probe,
+							NULL)) {
+		printk(KERN_ERR "boot_prefetch: cannot start recording\n");
+		vfree(records);
+		records = NULL;
+		boot_prefetch_recording = false;
+	}
+	return 0;
+}
+/* Before the root filesystem is mounted, so the whole boot is recorded */
+fs_initcall(boot_prefetch_init);
@@ -0,0 +1,375 @@
+/*
+ * mm/cma.c - Contiguous Memory Allocator
+ *
+ * Drivers that need large physically contiguous buffers (ION heaps for
+ * video and camera) have so far been given carveouts removed from memory
+ * at boot, which sit unused whenever no such buffer is allocated.
+ *
+ * A contiguous memory area is instead reserved with memblock and, once
+ * the page allocator is up, its pageblocks are freed as MIGRATE_CMA.  The
+ * page allocator serves movable allocations only from them, so while the
+ * area is not claimed it holds page cache and anonymous memory.
+ * cma_alloc() looks for a free range in the area's bitmap and uses
+ * alloc_contig_range() to isolate it, migrate the pages in use out of it
+ * and take it off the free lists.
+ *
+ * Allocation latencies are kept per area and shown in
+ * /sys/kernel/debug/cma/<name>.
+ */
+
+#define pr_fmt(fmt) "cma: " fmt
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/mm.h>
+#include <linux/mmzone.h>
+#include <linux/memblock.h>
+#include <linux/highmem.h>
+#include <linux/bitmap.h>
+#include <linux/slab.h>
+#include <linux/mutex.h>
+#include <linux/hrtimer.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/cma.h>
+
+/* Allocation latency histogram buckets: <1ms, <2ms, <4ms ... >=512ms */
+#define CMA_LATENCY_BUCKETS	11
+
+struct cma_stats {
+	unsigned long		nr_allocs;
+	unsigned long		nr_failed;
+	unsigned long		nr_releases;
+	unsigned long		nr_retries;	/* ranges that were busy */
+	u64			total_us;
+	u64			max_us;
+	unsigned long		latency[CMA_LATENCY_BUCKETS];
+};
+
+struct cma {
+	const char		*name;
+	unsigned long		base_pfn;
+	unsigned long		count;		/* pages */
+	unsigned long		used;		/* pages */
+	unsigned long		*bitmap;	/* a bit per page */
+	struct mutex		lock;
+	struct cma_stats	stats;
+};
+
+static struct cma cma_areas[MAX_CMA_AREAS];
+static unsigned int cma_area_count;
+
+phys_addr_t cma_get_base(struct cma *cma)
+{
+	return PFN_PHYS(cma->base_pfn);
+}
+EXPORT_SYMBOL_GPL(cma_get_base);
+
+unsigned long cma_get_size(struct cma *cma)
+{
+	return cma->count << PAGE_SHIFT;
+}
+EXPORT_SYMBOL_GPL(cma_get_size);
+
+/*
+ * Lets the architecture prepare the mapping of an area, ARM maps them
+ * with pages so that what a driver allocates can be made uncached.
+ */
+void __init __weak cma_early_fixup(phys_addr_t base, phys_addr_t size)
+{
+}
+
+/**
+ * cma_declare_contiguous() - reserve a contiguous memory area
+ * @size:	size of the area
+ * @base:	base address of the area, or 0 to place it anywhere
+ * @limit:	end address the area must lie below, or 0 for no limit
+ * @name:	name of the area in the statistics
+ * @res_cma:	the area, for cma_alloc()
+ *
+ * Called from the machine's reserve callback, while memblock is the
+ * allocator.  The area must be aligned to MAX_ORDER and pageblock size and
+ * lie in a single zone.  It is handed to the page allocator by a
+ * core_initcall.
+ */
+int __init cma_declare_contiguous(phys_addr_t size, phys_addr_t base,
+				  phys_addr_t limit, const char *name,
+				  struct cma **res_cma)
+{
+	struct cma *cma;
+	phys_addr_t alignment;
+
+	if (cma_area_count == ARRAY_SIZE(cma_areas)) {
+		pr_err("%s: too many areas\n", name);
+		return -ENOSPC;
+	}
+	if (!size)
+		return -EINVAL;
+
+	alignment = PAGE_SIZE << max(MAX_ORDER - 1, pageblock_order);
+	if ((base | size) & (alignment - 1)) {
+		pr_err("%s: %lu MiB at %#lx not aligned to %lu KiB\n", name,
+		       (unsigned long)(size >> 20), (unsigned long)base,
+		       (unsigned long)(alignment >> 10));
+		return -EINVAL;
+	}
+
+	if (base) {
+		if (limit && base + size > limit)
+			return -EINVAL;
+		if (!memblock_is_region_memory(base, size) ||
+		    memblock_is_region_reserved(base, size) ||
+		    memblock_reserve(base, size) < 0)
+			return -EBUSY;
+	} else {
+		base = __memblock_alloc_base(size, alignment,
+				limit ? limit : MEMBLOCK_ALLOC_ANYWHERE);
+		if (!base)
+			return -ENOMEM;
+	}
+
+	cma = &cma_areas[cma_area_count++];
+	cma->name = name;
+	cma->base_pfn = PFN_DOWN(base);
+	cma->count = size >> PAGE_SHIFT;
+	*res_cma = cma;
+
+	cma_early_fixup(base, size);
+
+	pr_info("%s: reserved %lu MiB at %#lx\n", name,
+		(unsigned long)(size >> 20), (unsigned long)base);
+	return 0;
+}
+
+static int __init cma_activate_area(struct cma *cma)
+{
+	unsigned long pfn, end_pfn = cma->base_pfn + cma->count;
+	struct page *page;
+	struct zone *zone;
+	int ret;
+
+	mutex_init(&cma->lock);
+
+	/* alloc_contig_range() works within one zone */
+	zone = NULL;
+	for (pfn = cma->base_pfn; pfn < end_pfn; pfn++) {
+		if (pfn_valid(pfn)) {
+			if (!zone)
+				zone = page_zone(pfn_to_page(pfn));
+			if (page_zone(pfn_to_page(pfn)) == zone)
+				continue;
+		}
+		pr_err("%s: area crosses a zone or a memory hole\n", cma->name);
+		ret = -EINVAL;
+		goto err;
+	}
+
+	cma->bitmap = kzalloc(BITS_TO_LONGS(cma->count) * sizeof(long),
+			      GFP_KERNEL);
+	if (!cma->bitmap) {
+		ret = -ENOMEM;
+		goto err;
+	}
+
+	for (pfn = cma->base_pfn; pfn < end_pfn; pfn += pageblock_nr_pages)
+		init_cma_reserved_pageblock(pfn_to_page(pfn));
+	return 0;
+
+err:
+	/* Nothing was given out yet, the area becomes ordinary memory */
+	for (pfn = cma->base_pfn; pfn < end_pfn; pfn++) {
+		if (!pfn_valid(pfn))
+			continue;
+		page = pfn_to_page(pfn);
+		ClearPageReserved(page);
+		init_page_count(page);
+		__free_page(page);
+		totalram_pages++;
+#ifdef CONFIG_HIGHMEM
+		if (PageHighMem(page))
+			totalhigh_pages++;
+#endif
+	}
+	cma->count = 0;
+	return ret;
+}
+
+static int __init cma_init_reserved_areas(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < cma_area_count; i++)
+		cma_activate_area(&cma_areas[i]);
+	return 0;
+}
+core_initcall(cma_init_reserved_areas);
+
+static void cma_account(struct cma *cma, ktime_t start, bool failed)
+{
+	struct cma_stats *stats = &cma->stats;
+	u64 us = ktime_us_delta(ktime_get(), start);
+	unsigned int bucket;
+
+	if (failed)
+		stats->nr_failed++;
+	else
+		stats->nr_allocs++;
+	stats->total_us += us;
+	stats->max_us = max(stats->max_us, us);
+
+	bucket = us < USEC_PER_MSEC ? 0 : ilog2(div_u64(us, USEC_PER_MSEC)) + 1;
+	stats->latency[min_t(unsigned int, bucket,
+			     CMA_LATENCY_BUCKETS - 1)]++;
+}
+
+/**
+ * cma_alloc() - allocate pages from a contiguous memory area
+ * @cma:	the area
+ * @count:	number of pages
+ * @align:	alignment of the first page, as an order
+ *
+ * Returns the first of @count physically contiguous pages, each with a
+ * reference count of one, or NULL.  May sleep for as long as it takes to
+ * migrate the pages in use out of the range.
+ */
+struct page *cma_alloc(struct cma *cma, unsigned long count,
+		       unsigned int align)
+{
+	unsigned long mask, pageno, start = 0;
+	struct page *page = NULL;
+	ktime_t t0;
+	int ret;
+
+	if (!cma || !cma->count || !count)
+		return NULL;
+
+	mask = (1UL << min_t(unsigned int, align, MAX_ORDER - 1)) - 1;
+
+	mutex_lock(&cma->lock);
+	t0 = ktime_get();
+	for (;;) {
+		pageno = bitmap_find_next_zero_area(cma->bitmap, cma->count,
+						    start, count, mask);
+		if (pageno >= cma->count)
+			break;
+
+		ret = alloc_contig_range(cma->base_pfn + pageno,
+					 cma->base_pfn + pageno + count,
+					 MIGRATE_CMA);
+		if (!ret) {
+			bitmap_set(cma->bitmap, pageno, count);
+			cma->used += count;
+			page = pfn_to_page(cma->base_pfn + pageno);
+			break;
+		}
+		if (ret != -EBUSY)
+			break;
+
+		/* Pinned pages in the way, try the next range */
+		cma->stats.nr_retries++;
+		start = pageno + mask + 1;
+	}
+	cma_account(cma, t0, !page);
+	mutex_unlock(&cma->lock);
+
+	return page;
+}
+EXPORT_SYMBOL_GPL(cma_alloc);
+
+/**
+ * cma_release() - give pages from cma_alloc() back
+ * @cma:	the area
+ * @pages:	the first page returned by cma_alloc()
+ * @count:	number of pages
+ *
+ * Returns false if the pages do not belong to @cma.
+ */
+bool cma_release(struct cma *cma, struct page *pages, unsigned long count)
+{
+	unsigned long pfn;
+
+	if (!cma || !pages)
+		return false;
+
+	pfn = page_to_pfn(pages);
+	if (pfn < cma->base_pfn || pfn + count > cma->base_pfn + cma->count)
+		return false;
+
+	free_contig_range(pfn, count);
+
+	mutex_lock(&cma->lock);
+	bitmap_clear(cma->bitmap, pfn - cma->base_pfn, count);
+	cma->used -= count;
+	cma->stats.nr_releases++;
+	mutex_unlock(&cma->lock);
+
+	return true;
+}
+EXPORT_SYMBOL_GPL(cma_release);
+
+#ifdef CONFIG_DEBUG_FS
+static int cma_stats_show(struct seq_file *m, void *v)
+{
+	struct cma *cma = m->private;
+	struct cma_stats *stats = &cma->stats;
+	unsigned long calls;
+	unsigned int i;
+
+	mutex_lock(&cma->lock);
+	calls = stats->nr_allocs + stats->nr_failed;
+	seq_printf(m, "base            %#llx\n",
+		   (unsigned long long)cma_get_base(cma));
+	seq_printf(m, "size_kb         %lu\n", cma->count << (PAGE_SHIFT - 10));
+	seq_printf(m, "used_kb         %lu\n", cma->used << (PAGE_SHIFT - 10));
+	seq_printf(m, "allocs          %lu\n", stats->nr_allocs);
+	seq_printf(m, "failed          %lu\n", stats->nr_failed);
+	seq_printf(m, "releases        %lu\n", stats->nr_releases);
+	seq_printf(m, "busy_retries    %lu\n", stats->nr_retries);
+	seq_printf(m, "latency_avg_us  %llu\n",
+		   calls ? div64_u64(stats->total_us, calls) : 0);
+	seq_printf(m, "latency_max_us  %llu\n", stats->max_us);
+	seq_printf(m, "latency_ms     ");
+	for (i = 0; i < CMA_LATENCY_BUCKETS - 1; i++)
+		seq_printf(m, " <%u:%lu", 1 << i, stats->latency[i]);
+	seq_printf(m, " >=%u:%lu\n", 1 << (CMA_LATENCY_BUCKETS - 2),
+		   stats->latency[CMA_LATENCY_BUCKETS - 1]);
+	mutex_unlock(&cma->lock);
+
+	return 0;
+}
+
+static int cma_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cma_stats_show, inode->i_private);
+}
+
+static const struct file_operations cma_stats_fops = {
+	.open		= cma_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init cma_debugfs_init(void)
+{
+	struct dentry *dir;
+	unsigned int i;
+
+	if (!cma_area_count)
+		return 0;
+
+	dir = debugfs_create_dir("cma", NULL);
+	if (IS_ERR_OR_NULL(dir))
+		return -ENOMEM;
+
+	for (i = 0; i < cma_area_count; i++)
+		if (cma_areas[i].count)
+			debugfs_create_file(cma_areas[i].name, 0444, dir,
+					    &cma_areas[i], &cma_stats_fops);
+	return 0;
+}
+late_initcall(cma_debugfs_init);
+#endif /* CONFIG_DEBUG_FS */
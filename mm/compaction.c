@@ -14,6 +14,9 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#include <linux/timer.h>
 #include "internal.h"
 
 #define CREATE_TRACE_POINTS
@@ -42,8 +45,11 @@ struct compact_control {
 	unsigned int order;		/* order a direct compactor needs */
 	int migratetype;		/* MOVABLE, RECLAIMABLE etc */
 	struct zone *zone;
+	bool proactive;			/* kcompactd working to its target */
 };
 
+static bool kcompactd_should_yield(void);
+
 static unsigned long release_freepages(struct list_head *freelist)
 {
 	struct page *page, *next;
@@ -123,8 +129,8 @@ static bool suitable_migration_target(struct page *page)
 	if (PageBuddy(page) && page_order(page) >= pageblock_order)
 		return true;
 
-	/* If the block is MIGRATE_MOVABLE, allow migration */
-	if (migratetype == MIGRATE_MOVABLE)
+	/* If the block is MIGRATE_MOVABLE or MIGRATE_CMA, allow migration */
+	if (migratetype == MIGRATE_MOVABLE || is_migrate_cma(migratetype))
 		return true;
 
 	/* Otherwise skip the block */
@@ -442,6 +448,16 @@ static int compact_finished(struct zone *zone,
 	if (cc->free_pfn <= cc->migrate_pfn)
 		return COMPACT_COMPLETE;
 
+	/* kcompactd stops at its target, or when the system gets busy */
+	if (cc->proactive) {
+		if (kcompactd_should_yield())
+			return COMPACT_PARTIAL;
+		if (unusable_index(zone, sysctl_compaction_target_order) <=
+		    sysctl_compaction_frag_target)
+			return COMPACT_PARTIAL;
+		return COMPACT_CONTINUE;
+	}
+
 	/*
 	 * order == -1 is expected when compacting via
 	 * /proc/sys/vm/compact_memory
@@ -565,6 +581,12 @@ static int compact_zone(struct zone *zone, struct compact_control *cc)
 
 		count_vm_event(COMPACTBLOCKS);
 		count_vm_events(COMPACTPAGES, nr_migrate - nr_remaining);
+		if (cc->proactive)
+			count_vm_events(KCOMPACTD_PAGES,
+					nr_migrate - nr_remaining);
+		else if (cc->order != -1)
+			count_vm_events(COMPACTDIRECTPAGES,
+					nr_migrate - nr_remaining);
 		if (nr_remaining)
 			count_vm_events(COMPACTPAGEFAILED, nr_remaining);
 		trace_mm_compaction_migratepages(nr_migrate - nr_remaining,
@@ -645,6 +667,9 @@ unsigned long try_to_compact_pages(struct zonelist *zonelist,
 		status = compact_zone_order(zone, order, gfp_mask, sync);
 		rc = max(status, rc);
 
+		/* Get the rest of the node in shape for the next allocation */
+		wakeup_kcompactd(zone->zone_pgdat);
+
 		/* If a normal allocation would succeed, stop compacting */
 		if (zone_watermark_ok(zone, order, low_wmark_pages(zone), 0, 0))
 			break;
@@ -653,6 +678,181 @@ unsigned long try_to_compact_pages(struct zonelist *zonelist,
 	return rc;
 }
 
+/*
+ * kcompactd: proactive compaction
+ *
+ * Every KCOMPACTD_INTERVAL_MS, and whenever a direct compactor had to
+ * run, the per-node kcompactd thread checks how much of each zone's free
+ * memory is unusable for an allocation of sysctl_compaction_target_order
+ * (the unusable free space index, in thousandths).  Zones above
+ * sysctl_compaction_frag_target are compacted with asynchronous migration
+ * until they reach it, but only while at least one cpu is idle.  When a
+ * pass leaves a zone above the target, the rest of the free memory is
+ * pinned by unmovable pages and the interval is doubled, up to
+ * 1 << KCOMPACTD_MAX_BACKOFF times.
+ *
+ * fragmentation_index() cannot serve as the target: it is only defined
+ * once an allocation of the order would fail, which is what this tries
+ * to prevent.
+ */
+#define KCOMPACTD_INTERVAL_MS	2000
+#define KCOMPACTD_MAX_BACKOFF	6
+
+/* 1000 disables kcompactd */
+int sysctl_compaction_frag_target = 500;
+/* 64K with 4K pages: ION chunks, camera buffers, jumbo skbs */
+int sysctl_compaction_target_order = 4;
+
+static bool kcompactd_should_yield(void)
+{
+	/* kcompactd itself is one of the running tasks */
+	return kthread_should_stop() || nr_running() > num_online_cpus();
+}
+
+static bool kcompactd_zone_needs_work(struct zone *zone)
+{
+	int order = sysctl_compaction_target_order;
+
+	if (!populated_zone(zone))
+		return false;
+	if (unusable_index(zone, order) <= sysctl_compaction_frag_target)
+		return false;
+
+	/* Same order-0 watermark as compaction_suitable() */
+	return zone_watermark_ok(zone, 0,
+				 low_wmark_pages(zone) + (2UL << order), 0, 0);
+}
+
+/* Returns false if a zone was left above the target */
+static bool kcompactd_do_work(pg_data_t *pgdat)
+{
+	bool done = true, woken = false;
+	int zoneid;
+
+	for (zoneid = 0; zoneid < MAX_NR_ZONES; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+		struct compact_control cc = {
+			.nr_freepages = 0,
+			.nr_migratepages = 0,
+			.order = -1,
+			.sync = false,
+			.proactive = true,
+			.zone = zone,
+		};
+
+		if (!kcompactd_zone_needs_work(zone))
+			continue;
+		if (kcompactd_should_yield())
+			return true;
+
+		if (!woken) {
+			count_vm_event(KCOMPACTD_WAKE);
+			lru_add_drain();
+			woken = true;
+		}
+
+		INIT_LIST_HEAD(&cc.freepages);
+		INIT_LIST_HEAD(&cc.migratepages);
+		if (compact_zone(zone, &cc) == COMPACT_COMPLETE &&
+		    kcompactd_zone_needs_work(zone))
+			done = false;
+
+		VM_BUG_ON(!list_empty(&cc.freepages));
+		VM_BUG_ON(!list_empty(&cc.migratepages));
+	}
+
+	return done;
+}
+
+static int kcompactd(void *p)
+{
+	pg_data_t *pgdat = p;
+	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+	unsigned int backoff = 0;
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
+	set_user_nice(current, 19);
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		unsigned long timeout;
+
+		timeout = msecs_to_jiffies(KCOMPACTD_INTERVAL_MS) << backoff;
+		wait_event_freezable_timeout(pgdat->kcompactd_wait,
+				pgdat->kcompactd_woken || kthread_should_stop(),
+				round_jiffies_relative(timeout));
+
+		if (pgdat->kcompactd_woken) {
+			pgdat->kcompactd_woken = false;
+			backoff = 0;
+		}
+		if (kthread_should_stop())
+			break;
+		if (sysctl_compaction_frag_target >= 1000)
+			continue;
+
+		if (kcompactd_do_work(pgdat))
+			backoff = 0;
+		else if (backoff < KCOMPACTD_MAX_BACKOFF)
+			backoff++;
+	}
+
+	return 0;
+}
+
+void wakeup_kcompactd(pg_data_t *pgdat)
+{
+	if (!pgdat->kcompactd || sysctl_compaction_frag_target >= 1000)
+		return;
+
+	pgdat->kcompactd_woken = true;
+	wake_up_interruptible(&pgdat->kcompactd_wait);
+}
+
+/*
+ * Called by init and node hot-add.
+ */
+int kcompactd_run(int nid)
+{
+	pg_data_t *pgdat = NODE_DATA(nid);
+	struct task_struct *task;
+
+	if (pgdat->kcompactd)
+		return 0;
+
+	task = kthread_run(kcompactd, pgdat, "kcompactd%d", nid);
+	if (IS_ERR(task)) {
+		printk(KERN_ERR "Failed to start kcompactd on node %d\n", nid);
+		return PTR_ERR(task);
+	}
+	pgdat->kcompactd = task;
+	return 0;
+}
+
+/*
+ * Called by memory hotplug when all memory in a node is offlined.
+ */
+void kcompactd_stop(int nid)
+{
+	pg_data_t *pgdat = NODE_DATA(nid);
+
+	if (pgdat->kcompactd) {
+		kthread_stop(pgdat->kcompactd);
+		pgdat->kcompactd = NULL;
+	}
+}
+
+static int __init kcompactd_init(void)
+{
+	int nid;
+
+	for_each_node_state(nid, N_HIGH_MEMORY)
+		kcompactd_run(nid);
+	return 0;
+}
+module_init(kcompactd_init)
+
 
 /* Compact all zones within a node */
 static int compact_node(int nid)
@@ -724,6 +924,21 @@ int sysctl_extfrag_handler(struct ctl_table *table, int write,
 	return 0;
 }
 
+/* A new target or order takes effect right away */
+int sysctl_compaction_proactive_handler(struct ctl_table *table, int write,
+			void __user *buffer, size_t *length, loff_t *ppos)
+{
+	int ret, nid;
+
+	ret = proc_dointvec_minmax(table, write, buffer, length, ppos);
+	if (ret || !write)
+		return ret;
+
+	for_each_node_state(nid, N_HIGH_MEMORY)
+		wakeup_kcompactd(NODE_DATA(nid));
+	return 0;
+}
+
 #if defined(CONFIG_SYSFS) && defined(CONFIG_NUMA)
 ssize_t sysfs_compact_node(struct sys_device *dev,
 			struct sysdev_attribute *attr,
@@ -49,6 +49,8 @@
 #include <linux/page_cgroup.h>
 #include <linux/cpu.h>
 #include <linux/oom.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
 #include "internal.h"
 
 #include <asm/uaccess.h>
@@ -97,6 +99,10 @@ enum mem_cgroup_events_index {
 	MEM_CGROUP_EVENTS_COUNT,	/* # of pages paged in/out */
 	MEM_CGROUP_EVENTS_PGFAULT,	/* # of page-faults */
 	MEM_CGROUP_EVENTS_PGMAJFAULT,	/* # of major page-faults */
+	MEM_CGROUP_EVENTS_DIRECT_RECLAIM, /* # of charges that reclaimed */
+	MEM_CGROUP_EVENTS_DIRECT_STEAL,	/* # of pages they reclaimed */
+	MEM_CGROUP_EVENTS_KSWAPD_WAKE,	/* # of background reclaim runs */
+	MEM_CGROUP_EVENTS_KSWAPD_STEAL,	/* # of pages they reclaimed */
 	MEM_CGROUP_EVENTS_NSTATS,
 };
 /*
@@ -268,6 +274,17 @@ struct mem_cgroup {
 	/* For oom notifier event fd */
 	struct list_head oom_notify;
 
+	/*
+	 * Background reclaim, see mem_cgroup_kswapd().  The distances are
+	 * headroom below the limit, in bytes, and are set under
+	 * cgroup_mutex.
+	 */
+	u64		low_wmark_distance;
+	u64		high_wmark_distance;
+	struct task_struct *kswapd;
+	wait_queue_head_t kswapd_wait;
+	bool		kswapd_wake;
+
 	/*
 	 * Should we move charges of a task when a task is moved into this
 	 * mem_cgroup ? And what type of charges should we move ?
@@ -364,6 +381,7 @@ static void mem_cgroup_get(struct mem_cgroup *mem);
 static void mem_cgroup_put(struct mem_cgroup *mem);
 static struct mem_cgroup *parent_mem_cgroup(struct mem_cgroup *mem);
 static void drain_all_stock_async(struct mem_cgroup *mem);
+static void mem_cgroup_wake_kswapd(struct mem_cgroup *mem);
 
 static struct mem_cgroup_per_zone *
 mem_cgroup_zoneinfo(struct mem_cgroup *mem, int nid, int zid)
@@ -597,6 +615,20 @@ void mem_cgroup_pgmajfault(struct mem_cgroup *mem, int val)
 	this_cpu_add(mem->stat->events[MEM_CGROUP_EVENTS_PGMAJFAULT], val);
 }
 
+static void mem_cgroup_reclaim_statistics(struct mem_cgroup *mem,
+					  bool kswapd, int nr_reclaimed)
+{
+	if (kswapd) {
+		this_cpu_inc(mem->stat->events[MEM_CGROUP_EVENTS_KSWAPD_WAKE]);
+		this_cpu_add(mem->stat->events[MEM_CGROUP_EVENTS_KSWAPD_STEAL],
+			     nr_reclaimed);
+	} else {
+		this_cpu_inc(mem->stat->events[MEM_CGROUP_EVENTS_DIRECT_RECLAIM]);
+		this_cpu_add(mem->stat->events[MEM_CGROUP_EVENTS_DIRECT_STEAL],
+			     nr_reclaimed);
+	}
+}
+
 static unsigned long mem_cgroup_read_events(struct mem_cgroup *mem,
 					    enum mem_cgroup_events_index idx)
 {
@@ -702,6 +734,7 @@ static void memcg_check_events(struct mem_cgroup *mem, struct page *page)
 	/* threshold event is triggered in finer grain than soft limit */
 	if (unlikely(__memcg_event_check(mem, MEM_CGROUP_TARGET_THRESH))) {
 		mem_cgroup_threshold(mem);
+		mem_cgroup_wake_kswapd(mem);
 		__mem_cgroup_target_update(mem, MEM_CGROUP_TARGET_THRESH);
 		if (unlikely(__memcg_event_check(mem,
 			     MEM_CGROUP_TARGET_SOFTLIMIT))) {
@@ -1800,6 +1833,75 @@ static int mem_cgroup_hierarchical_reclaim(struct mem_cgroup *root_mem,
 	return total;
 }
 
+/*
+ * Background reclaim.  Once the headroom of a group below its limit drops
+ * under low_wmark_distance, the group's kswapd thread reclaims from it
+ * until the headroom is back at high_wmark_distance, so that tasks in the
+ * group charge pages without reclaiming themselves.
+ */
+static bool mem_cgroup_wmark_ok(struct mem_cgroup *mem, u64 distance)
+{
+	u64 limit = res_counter_read_u64(&mem->res, RES_LIMIT);
+	u64 usage = res_counter_read_u64(&mem->res, RES_USAGE);
+
+	/* No limit, or the watermark does not fit under it */
+	if (limit == RESOURCE_MAX || distance >= limit)
+		return true;
+	return usage + distance <= limit;
+}
+
+static void mem_cgroup_wake_kswapd(struct mem_cgroup *mem)
+{
+	for (; mem; mem = parent_mem_cgroup(mem)) {
+		if (!mem->kswapd || !waitqueue_active(&mem->kswapd_wait))
+			continue;
+		if (mem_cgroup_wmark_ok(mem, mem->low_wmark_distance))
+			continue;
+		mem->kswapd_wake = true;
+		wake_up_interruptible(&mem->kswapd_wait);
+	}
+}
+
+static void mem_cgroup_kswapd_reclaim(struct mem_cgroup *mem)
+{
+	u64 high = max(mem->high_wmark_distance, mem->low_wmark_distance);
+	int nr_retries = MEM_CGROUP_RECLAIM_RETRIES;
+	int total = 0, ret;
+
+	while (!mem_cgroup_wmark_ok(mem, high) && !kthread_should_stop()) {
+		ret = mem_cgroup_hierarchical_reclaim(mem, NULL, GFP_KERNEL,
+				MEM_CGROUP_RECLAIM_SHRINK, NULL);
+		total += ret;
+		/* Leave what cannot be reclaimed now to the next wakeup */
+		if (!ret && !--nr_retries)
+			break;
+		cond_resched();
+	}
+	mem_cgroup_reclaim_statistics(mem, true, total);
+}
+
+static int mem_cgroup_kswapd(void *data)
+{
+	struct mem_cgroup *mem = data;
+
+	/*
+	 * Not PF_KSWAPD or PF_MEMALLOC: this thread must neither be taken
+	 * for the global kswapd by reclaim and writeback nor dip into the
+	 * reserves that are kept for the global reclaimers.
+	 */
+	current->flags |= PF_SWAPWRITE;
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		wait_event_freezable(mem->kswapd_wait,
+				     mem->kswapd_wake || kthread_should_stop());
+		mem->kswapd_wake = false;
+		if (!kthread_should_stop())
+			mem_cgroup_kswapd_reclaim(mem);
+	}
+	return 0;
+}
+
 /*
  * Check OOM-Killer is already running under our hierarchy.
  * If someone is running, return false.
@@ -2241,8 +2343,10 @@ static int mem_cgroup_do_charge(struct mem_cgroup *mem, gfp_t gfp_mask,
 	if (!(gfp_mask & __GFP_WAIT))
 		return CHARGE_WOULDBLOCK;
 
+	mem_cgroup_wake_kswapd(mem_over_limit);
 	ret = mem_cgroup_hierarchical_reclaim(mem_over_limit, NULL,
 					      gfp_mask, flags, NULL);
+	mem_cgroup_reclaim_statistics(mem_over_limit, false, ret);
 	if (mem_cgroup_margin(mem_over_limit) >= nr_pages)
 		return CHARGE_RETRY;
 	/*
@@ -4099,6 +4203,10 @@ enum {
 	MCS_INACTIVE_FILE,
 	MCS_ACTIVE_FILE,
 	MCS_UNEVICTABLE,
+	MCS_DIRECT_RECLAIM,
+	MCS_DIRECT_STEAL,
+	MCS_KSWAPD_WAKE,
+	MCS_KSWAPD_STEAL,
 	NR_MCS_STAT,
 };
 
@@ -4122,7 +4230,11 @@ struct {
 	{"active_anon", "total_active_anon"},
 	{"inactive_file", "total_inactive_file"},
 	{"active_file", "total_active_file"},
-	{"unevictable", "total_unevictable"}
+	{"unevictable", "total_unevictable"},
+	{"direct_reclaim", "total_direct_reclaim"},
+	{"direct_steal", "total_direct_steal"},
+	{"kswapd_wake", "total_kswapd_wake"},
+	{"kswapd_steal", "total_kswapd_steal"},
 };
 
 
@@ -4150,6 +4262,14 @@ mem_cgroup_get_local_stat(struct mem_cgroup *mem, struct mcs_total_stat *s)
 	s->stat[MCS_PGFAULT] += val;
 	val = mem_cgroup_read_events(mem, MEM_CGROUP_EVENTS_PGMAJFAULT);
 	s->stat[MCS_PGMAJFAULT] += val;
+	val = mem_cgroup_read_events(mem, MEM_CGROUP_EVENTS_DIRECT_RECLAIM);
+	s->stat[MCS_DIRECT_RECLAIM] += val;
+	val = mem_cgroup_read_events(mem, MEM_CGROUP_EVENTS_DIRECT_STEAL);
+	s->stat[MCS_DIRECT_STEAL] += val;
+	val = mem_cgroup_read_events(mem, MEM_CGROUP_EVENTS_KSWAPD_WAKE);
+	s->stat[MCS_KSWAPD_WAKE] += val;
+	val = mem_cgroup_read_events(mem, MEM_CGROUP_EVENTS_KSWAPD_STEAL);
+	s->stat[MCS_KSWAPD_STEAL] += val;
 
 	/* per zone stat */
 	val = mem_cgroup_get_local_zonestat(mem, LRU_INACTIVE_ANON);
@@ -4321,6 +4441,76 @@ static int mem_cgroup_swappiness_write(struct cgroup *cgrp, struct cftype *cft,
 	return 0;
 }
 
+enum {
+	MEM_WMARK_LOW,
+	MEM_WMARK_HIGH,
+};
+
+static u64 mem_cgroup_wmark_read(struct cgroup *cgrp, struct cftype *cft)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_cont(cgrp);
+
+	if (cft->private == MEM_WMARK_LOW)
+		return memcg->low_wmark_distance;
+	return memcg->high_wmark_distance;
+}
+
+static int mem_cgroup_wmark_write(struct cgroup *cgrp, struct cftype *cft,
+				  const char *buffer)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_cont(cgrp);
+	struct task_struct *kswapd;
+	unsigned long long val;
+	int ret;
+
+	if (mem_cgroup_is_root(memcg))
+		return -EINVAL;
+
+	ret = res_counter_memparse_write_strategy(buffer, &val);
+	if (ret)
+		return ret;
+
+	cgroup_lock();
+	if (cft->private == MEM_WMARK_LOW)
+		memcg->low_wmark_distance = val;
+	else
+		memcg->high_wmark_distance = val;
+
+	if (memcg->low_wmark_distance && !memcg->kswapd) {
+		kswapd = kthread_run(mem_cgroup_kswapd, memcg,
+				     "memcg_kswapd/%d", css_id(&memcg->css));
+		if (IS_ERR(kswapd)) {
+			memcg->low_wmark_distance = 0;
+			ret = PTR_ERR(kswapd);
+		} else
+			memcg->kswapd = kswapd;
+	} else if (!memcg->low_wmark_distance && memcg->kswapd) {
+		kthread_stop(memcg->kswapd);
+		memcg->kswapd = NULL;
+	}
+	cgroup_unlock();
+
+	if (!ret)
+		mem_cgroup_wake_kswapd(memcg);
+	return ret;
+}
+
+static int mem_cgroup_wmark_show(struct cgroup *cgrp, struct cftype *cft,
+				 struct cgroup_map_cb *cb)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_cont(cgrp);
+	u64 limit = res_counter_read_u64(&memcg->res, RES_LIMIT);
+	u64 low = memcg->low_wmark_distance;
+	u64 high = max(memcg->high_wmark_distance, low);
+
+	/* Background reclaim is off */
+	if (!low || limit == RESOURCE_MAX || high >= limit)
+		low = high = 0;
+	cb->fill(cb, "low_wmark", limit - low);
+	cb->fill(cb, "high_wmark", limit - high);
+	return 0;
+}
+
 static void __mem_cgroup_threshold(struct mem_cgroup *memcg, bool swap)
 {
 	struct mem_cgroup_threshold_ary *t;
@@ -4723,6 +4913,22 @@ static struct cftype mem_cgroup_files[] = {
 		.read_u64 = mem_cgroup_move_charge_read,
 		.write_u64 = mem_cgroup_move_charge_write,
 	},
+	{
+		.name = "low_wmark_distance",
+		.private = MEM_WMARK_LOW,
+		.read_u64 = mem_cgroup_wmark_read,
+		.write_string = mem_cgroup_wmark_write,
+	},
+	{
+		.name = "high_wmark_distance",
+		.private = MEM_WMARK_HIGH,
+		.read_u64 = mem_cgroup_wmark_read,
+		.write_string = mem_cgroup_wmark_write,
+	},
+	{
+		.name = "reclaim_wmarks",
+		.read_map = mem_cgroup_wmark_show,
+	},
 	{
 		.name = "oom_control",
 		.read_map = mem_cgroup_oom_control_read,
@@ -4995,6 +5201,7 @@ mem_cgroup_create(struct cgroup_subsys *ss, struct cgroup *cont)
 	mem->last_scanned_child = 0;
 	mem->last_scanned_node = MAX_NUMNODES;
 	INIT_LIST_HEAD(&mem->oom_notify);
+	init_waitqueue_head(&mem->kswapd_wait);
 
 	if (parent)
 		mem->swappiness = get_swappiness(parent);
@@ -5021,6 +5228,8 @@ static void mem_cgroup_destroy(struct cgroup_subsys *ss,
 {
 	struct mem_cgroup *mem = mem_cgroup_from_cont(cont);
 
+	if (mem->kswapd)
+		kthread_stop(mem->kswapd);
 	mem_cgroup_put(mem);
 }
 
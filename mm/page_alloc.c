@@ -48,6 +48,8 @@
 #include <linux/backing-dev.h>
 #include <linux/fault-inject.h>
 #include <linux/page-isolation.h>
+#include <linux/migrate.h>
+#include <linux/mm_inline.h>
 #include <linux/page_cgroup.h>
 #include <linux/debugobjects.h>
 #include <linux/kmemleak.h>
@@ -597,7 +599,7 @@ static inline int free_pages_check(struct page *page)
 /*
  * Frees a number of pages from the PCP lists
  * Assumes all pages on list are in same zone, and of same order.
- * count is the number of pages to free.
+ * count is the number of blocks of that order to free.
  *
  * If the zone was previously in an "all pages pinned" state then look to
  * see if this freeing clears that state.
@@ -606,7 +608,7 @@ static inline int free_pages_check(struct page *page)
  * pinned" detection logic.
  */
 static void free_pcppages_bulk(struct zone *zone, int count,
-					struct per_cpu_pages *pcp)
+				struct list_head *lists, unsigned int order)
 {
 	int migratetype = 0;
 	int batch_free = 0;
@@ -631,7 +633,7 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 			batch_free++;
 			if (++migratetype == MIGRATE_PCPTYPES)
 				migratetype = 0;
-			list = &pcp->lists[migratetype];
+			list = &lists[migratetype];
 		} while (list_empty(list));
 
 		/* This is the only non-empty list. Free them all. */
@@ -643,11 +645,11 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 			/* must delete as __free_one_page list manipulates */
 			list_del(&page->lru);
 			/* MIGRATE_MOVABLE list may include MIGRATE_RESERVEs */
-			__free_one_page(page, zone, 0, page_private(page));
-			trace_mm_page_pcpu_drain(page, 0, page_private(page));
+			__free_one_page(page, zone, order, page_private(page));
+			trace_mm_page_pcpu_drain(page, order, page_private(page));
 		} while (--to_free && --batch_free && !list_empty(list));
 	}
-	__mod_zone_page_state(zone, NR_FREE_PAGES, count);
+	__mod_zone_page_state(zone, NR_FREE_PAGES, count << order);
 	spin_unlock(&zone->lock);
 }
 
@@ -663,6 +665,55 @@ static void free_one_page(struct zone *zone, struct page *page, int order,
 	spin_unlock(&zone->lock);
 }
 
+/*
+ * Free a block of order 1 to PCP_MAX_ORDER to this cpu's lists.  Called
+ * with interrupts disabled.
+ */
+static void free_pcp_order_page(struct zone *zone, struct page *page,
+				unsigned int order, int migratetype)
+{
+	struct per_cpu_order_pages *opcp;
+
+	/* The block is cached as a plain one, prep_new_page() redoes this */
+	if (unlikely(PageCompound(page)))
+		if (unlikely(destroy_compound_page(page, order)))
+			return;
+
+	/* Same as free_hot_cold_page() */
+	set_page_private(page, migratetype);
+	if (migratetype >= MIGRATE_PCPTYPES) {
+		if (unlikely(migratetype == MIGRATE_ISOLATE)) {
+			free_one_page(zone, page, order, migratetype);
+			return;
+		}
+		migratetype = MIGRATE_MOVABLE;
+	}
+
+	opcp = &this_cpu_ptr(zone->pageset)->pcp.orders[order - 1];
+	list_add(&page->lru, &opcp->lists[migratetype]);
+	opcp->count++;
+	if (opcp->count >= opcp->high) {
+		free_pcppages_bulk(zone, opcp->batch, opcp->lists, order);
+		opcp->count -= opcp->batch;
+	}
+}
+
+/* Return all blocks of order 1 to PCP_MAX_ORDER to the buddy lists */
+static void drain_pcp_orders(struct zone *zone, struct per_cpu_pages *pcp)
+{
+	unsigned int order;
+
+	for (order = 1; order <= PCP_MAX_ORDER; order++) {
+		struct per_cpu_order_pages *opcp = &pcp->orders[order - 1];
+
+		if (opcp->count) {
+			free_pcppages_bulk(zone, opcp->count, opcp->lists,
+					   order);
+			opcp->count = 0;
+		}
+	}
+}
+
 static bool free_pages_prepare(struct page *page, unsigned int order)
 {
 	int i;
@@ -701,7 +752,11 @@ static void __free_pages_ok(struct page *page, unsigned int order)
 	if (unlikely(wasMlocked))
 		free_page_mlock(page);
 	__count_vm_events(PGFREE, 1 << order);
-	free_one_page(page_zone(page), page, order,
+	if (order <= PCP_MAX_ORDER)
+		free_pcp_order_page(page_zone(page), page, order,
+				    get_pageblock_migratetype(page));
+	else
+		free_one_page(page_zone(page), page, order,
 					get_pageblock_migratetype(page));
 	local_irq_restore(flags);
 }
@@ -842,11 +897,17 @@ struct page *__rmqueue_smallest(struct zone *zone, unsigned int order,
  * This array describes the order lists are fallen back to when
  * the free lists for the desirable migrate type are depleted
  */
-static int fallbacks[MIGRATE_TYPES][MIGRATE_TYPES-1] = {
-	[MIGRATE_UNMOVABLE]   = { MIGRATE_RECLAIMABLE, MIGRATE_MOVABLE,   MIGRATE_RESERVE },
-	[MIGRATE_RECLAIMABLE] = { MIGRATE_UNMOVABLE,   MIGRATE_MOVABLE,   MIGRATE_RESERVE },
-	[MIGRATE_MOVABLE]     = { MIGRATE_RECLAIMABLE, MIGRATE_UNMOVABLE, MIGRATE_RESERVE },
-	[MIGRATE_RESERVE]     = { MIGRATE_RESERVE,     MIGRATE_RESERVE,   MIGRATE_RESERVE }, /* Never used */
+static int fallbacks[MIGRATE_TYPES][4] = {
+	[MIGRATE_UNMOVABLE]   = { MIGRATE_RECLAIMABLE, MIGRATE_MOVABLE,     MIGRATE_RESERVE },
+	[MIGRATE_RECLAIMABLE] = { MIGRATE_UNMOVABLE,   MIGRATE_MOVABLE,     MIGRATE_RESERVE },
+#ifdef CONFIG_CMA
+	[MIGRATE_MOVABLE]     = { MIGRATE_CMA,         MIGRATE_RECLAIMABLE, MIGRATE_UNMOVABLE, MIGRATE_RESERVE },
+	[MIGRATE_CMA]         = { MIGRATE_RESERVE }, /* Never used */
+#else
+	[MIGRATE_MOVABLE]     = { MIGRATE_RECLAIMABLE, MIGRATE_UNMOVABLE,   MIGRATE_RESERVE },
+#endif
+	[MIGRATE_RESERVE]     = { MIGRATE_RESERVE }, /* Never used */
+	[MIGRATE_ISOLATE]     = { MIGRATE_RESERVE }, /* Never used */
 };
 
 /*
@@ -941,12 +1002,12 @@ __rmqueue_fallback(struct zone *zone, int order, int start_migratetype)
 	/* Find the largest possible block of pages in the other list */
 	for (current_order = MAX_ORDER-1; current_order >= order;
 						--current_order) {
-		for (i = 0; i < MIGRATE_TYPES - 1; i++) {
+		for (i = 0;; i++) {
 			migratetype = fallbacks[start_migratetype][i];
 
 			/* MIGRATE_RESERVE handled later if necessary */
 			if (migratetype == MIGRATE_RESERVE)
-				continue;
+				break;
 
 			area = &(zone->free_area[current_order]);
 			if (list_empty(&area->free_list[migratetype]))
@@ -960,11 +1021,15 @@ __rmqueue_fallback(struct zone *zone, int order, int start_migratetype)
 			 * If breaking a large block of pages, move all free
 			 * pages to the preferred allocation list. If falling
 			 * back for a reclaimable kernel allocation, be more
-			 * aggressive about taking ownership of free pages
+			 * aggressive about taking ownership of free pages.
+			 * CMA pageblocks and their free pages are never
+			 * taken over, nothing but movable pages may end up
+			 * in them.
 			 */
-			if (unlikely(current_order >= (pageblock_order >> 1)) ||
+			if (!is_migrate_cma(migratetype) &&
+			    (unlikely(current_order >= (pageblock_order >> 1)) ||
 					start_migratetype == MIGRATE_RECLAIMABLE ||
-					page_group_by_mobility_disabled) {
+					page_group_by_mobility_disabled)) {
 				unsigned long pages;
 				pages = move_freepages_block(zone, page,
 								start_migratetype);
@@ -983,7 +1048,8 @@ __rmqueue_fallback(struct zone *zone, int order, int start_migratetype)
 			rmv_page_order(page);
 
 			/* Take ownership for orders >= pageblock_order */
-			if (current_order >= pageblock_order)
+			if (current_order >= pageblock_order &&
+			    !is_migrate_cma(migratetype))
 				change_pageblock_range(page, current_order,
 							start_migratetype);
 
@@ -1059,7 +1125,11 @@ static int rmqueue_bulk(struct zone *zone, unsigned int order,
 			list_add(&page->lru, list);
 		else
 			list_add_tail(&page->lru, list);
-		set_page_private(page, migratetype);
+		/* Pages from a CMA block must go back to it when freed */
+		if (is_migrate_cma(get_pageblock_migratetype(page)))
+			set_page_private(page, MIGRATE_CMA);
+		else
+			set_page_private(page, migratetype);
 		list = &page->lru;
 	}
 	__mod_zone_page_state(zone, NR_FREE_PAGES, -(i << order));
@@ -1086,8 +1156,9 @@ void drain_zone_pages(struct zone *zone, struct per_cpu_pages *pcp)
 		to_drain = pcp->batch;
 	else
 		to_drain = pcp->count;
-	free_pcppages_bulk(zone, to_drain, pcp);
+	free_pcppages_bulk(zone, to_drain, pcp->lists, 0);
 	pcp->count -= to_drain;
+	drain_pcp_orders(zone, pcp);
 	local_irq_restore(flags);
 }
 #endif
@@ -1113,9 +1184,10 @@ static void drain_pages(unsigned int cpu)
 
 		pcp = &pset->pcp;
 		if (pcp->count) {
-			free_pcppages_bulk(zone, pcp->count, pcp);
+			free_pcppages_bulk(zone, pcp->count, pcp->lists, 0);
 			pcp->count = 0;
 		}
+		drain_pcp_orders(zone, pcp);
 		local_irq_restore(flags);
 	}
 }
@@ -1216,7 +1288,7 @@ void free_hot_cold_page(struct page *page, int cold)
 		list_add(&page->lru, &pcp->lists[migratetype]);
 	pcp->count++;
 	if (pcp->count >= pcp->high) {
-		free_pcppages_bulk(zone, pcp->batch, pcp);
+		free_pcppages_bulk(zone, pcp->batch, pcp->lists, 0);
 		pcp->count -= pcp->batch;
 	}
 
@@ -1291,7 +1363,9 @@ int split_free_page(struct page *page)
 	if (order >= pageblock_order - 1) {
 		struct page *endpage = page + (1 << order) - 1;
 		for (; page < endpage; page += pageblock_nr_pages)
-			set_pageblock_migratetype(page, MIGRATE_MOVABLE);
+			if (!is_migrate_cma(get_pageblock_migratetype(page)))
+				set_pageblock_migratetype(page,
+							  MIGRATE_MOVABLE);
 	}
 
 	return 1 << order;
@@ -1311,6 +1385,20 @@ struct page *buffered_rmqueue(struct zone *preferred_zone,
 	struct page *page;
 	int cold = !!(gfp_flags & __GFP_COLD);
 
+	if (unlikely(order && (gfp_flags & __GFP_NOFAIL))) {
+		/*
+		 * __GFP_NOFAIL is not to be used in new code.
+		 *
+		 * All __GFP_NOFAIL callers should be fixed so that they
+		 * properly detect and handle allocation failures.
+		 *
+		 * We most definitely don't want callers attempting to
+		 * allocate greater than order-1 page units with
+		 * __GFP_NOFAIL.
+		 */
+		WARN_ON_ONCE(order > 1);
+	}
+
 again:
 	if (likely(order == 0)) {
 		struct per_cpu_pages *pcp;
@@ -1334,20 +1422,25 @@ again:
 
 		list_del(&page->lru);
 		pcp->count--;
-	} else {
-		if (unlikely(gfp_flags & __GFP_NOFAIL)) {
-			/*
-			 * __GFP_NOFAIL is not to be used in new code.
-			 *
-			 * All __GFP_NOFAIL callers should be fixed so that they
-			 * properly detect and handle allocation failures.
-			 *
-			 * We most definitely don't want callers attempting to
-			 * allocate greater than order-1 page units with
-			 * __GFP_NOFAIL.
-			 */
-			WARN_ON_ONCE(order > 1);
+	} else if (order <= PCP_MAX_ORDER) {
+		struct per_cpu_order_pages *opcp;
+		struct list_head *list;
+
+		local_irq_save(flags);
+		opcp = &this_cpu_ptr(zone->pageset)->pcp.orders[order - 1];
+		list = &opcp->lists[migratetype];
+		if (list_empty(list)) {
+			opcp->count += rmqueue_bulk(zone, order,
+					opcp->batch, list,
+					migratetype, cold);
+			if (unlikely(list_empty(list)))
+				goto failed;
 		}
+
+		page = list_entry(list->next, struct page, lru);
+		list_del(&page->lru);
+		opcp->count--;
+	} else {
 		spin_lock_irqsave(&zone->lock, flags);
 		page = __rmqueue(zone, order, migratetype);
 		spin_unlock(&zone->lock);
@@ -3594,10 +3687,28 @@ static int zone_batchsize(struct zone *zone)
 #endif
 }
 
+/*
+ * The higher orders get smaller batches and watermarks, in blocks, so that
+ * each order holds about a fourth of what order 0 may hold.  Caching more
+ * would keep too many blocks away from merging.
+ */
+static void setup_pageset_orders(struct per_cpu_pages *pcp)
+{
+	unsigned int order;
+
+	for (order = 1; order <= PCP_MAX_ORDER; order++) {
+		struct per_cpu_order_pages *opcp = &pcp->orders[order - 1];
+
+		opcp->batch = max(1, pcp->batch >> (order + 1));
+		opcp->high = max(opcp->batch, pcp->high >> (order + 2));
+	}
+}
+
 static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 {
 	struct per_cpu_pages *pcp;
 	int migratetype;
+	unsigned int order;
 
 	memset(p, 0, sizeof(*p));
 
@@ -3607,6 +3718,12 @@ static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 	pcp->batch = max(1UL, 1 * batch);
 	for (migratetype = 0; migratetype < MIGRATE_PCPTYPES; migratetype++)
 		INIT_LIST_HEAD(&pcp->lists[migratetype]);
+
+	for (order = 1; order <= PCP_MAX_ORDER; order++)
+		for (migratetype = 0; migratetype < MIGRATE_PCPTYPES;
+		     migratetype++)
+			INIT_LIST_HEAD(&pcp->orders[order - 1].lists[migratetype]);
+	setup_pageset_orders(pcp);
 }
 
 /*
@@ -3624,6 +3741,7 @@ static void setup_pagelist_highmark(struct per_cpu_pageset *p,
 	pcp->batch = max(1UL, high/4);
 	if ((high/4) > (PAGE_SHIFT * 8))
 		pcp->batch = PAGE_SHIFT * 8;
+	setup_pageset_orders(pcp);
 }
 
 static void setup_zone_pageset(struct zone *zone)
@@ -3713,7 +3831,8 @@ static int __zone_pcp_update(void *data)
 		pcp = &pset->pcp;
 
 		local_irq_save(flags);
-		free_pcppages_bulk(zone, pcp->count, pcp);
+		free_pcppages_bulk(zone, pcp->count, pcp->lists, 0);
+		drain_pcp_orders(zone, pcp);
 		setup_pageset(pset, batch);
 		local_irq_restore(flags);
 	}
@@ -4318,6 +4437,9 @@ static void __paginginit free_area_init_core(struct pglist_data *pgdat,
 	pgdat_resize_init(pgdat);
 	pgdat->nr_zones = 0;
 	init_waitqueue_head(&pgdat->kswapd_wait);
+#ifdef CONFIG_COMPACTION
+	init_waitqueue_head(&pgdat->kcompactd_wait);
+#endif
 	pgdat->kswapd_max_order = 0;
 	pgdat_page_cgroup_init(pgdat);
 	
@@ -5542,7 +5664,8 @@ __count_immobile_pages(struct zone *zone, struct page *page, int count)
 	if (zone_idx(zone) == ZONE_MOVABLE)
 		return true;
 
-	if (get_pageblock_migratetype(page) == MIGRATE_MOVABLE)
+	if (get_pageblock_migratetype(page) == MIGRATE_MOVABLE ||
+	    is_migrate_cma(get_pageblock_migratetype(page)))
 		return true;
 
 	pfn = page_to_pfn(page);
@@ -5641,7 +5764,7 @@ out:
 	return ret;
 }
 
-void unset_migratetype_isolate(struct page *page)
+void unset_migratetype_isolate(struct page *page, int migratetype)
 {
 	struct zone *zone;
 	unsigned long flags;
@@ -5649,12 +5772,231 @@ void unset_migratetype_isolate(struct page *page)
 	spin_lock_irqsave(&zone->lock, flags);
 	if (get_pageblock_migratetype(page) != MIGRATE_ISOLATE)
 		goto out;
-	set_pageblock_migratetype(page, MIGRATE_MOVABLE);
-	move_freepages_block(zone, page, MIGRATE_MOVABLE);
+	set_pageblock_migratetype(page, migratetype);
+	move_freepages_block(zone, page, migratetype);
 out:
 	spin_unlock_irqrestore(&zone->lock, flags);
 }
 
+#ifdef CONFIG_CMA
+/*
+ * Give a pageblock of a contiguous memory area, reserved with memblock at
+ * boot, to the buddy allocator.  Its pages are handed out to movable
+ * allocations only, until alloc_contig_range() takes them back.
+ */
+void __init init_cma_reserved_pageblock(struct page *page)
+{
+	unsigned int i = pageblock_nr_pages;
+	struct page *p = page;
+
+	do {
+		__ClearPageReserved(p);
+		set_page_count(p, 0);
+	} while (++p, --i);
+
+	set_page_refcounted(page);
+	set_pageblock_migratetype(page, MIGRATE_CMA);
+	__free_pages(page, pageblock_order);
+	totalram_pages += pageblock_nr_pages;
+#ifdef CONFIG_HIGHMEM
+	if (PageHighMem(page))
+		totalhigh_pages += pageblock_nr_pages;
+#endif
+}
+
+/* Isolation works on whole MAX_ORDER blocks, free pages may span them */
+static unsigned long contig_align_down(unsigned long pfn)
+{
+	return pfn & ~(max_t(unsigned long, MAX_ORDER_NR_PAGES,
+			     pageblock_nr_pages) - 1);
+}
+
+static unsigned long contig_align_up(unsigned long pfn)
+{
+	return ALIGN(pfn, max_t(unsigned long, MAX_ORDER_NR_PAGES,
+				pageblock_nr_pages));
+}
+
+static struct page *
+contig_migrate_alloc(struct page *page, unsigned long private, int **x)
+{
+	gfp_t gfp_mask = GFP_USER | __GFP_MOVABLE;
+
+	if (PageHighMem(page))
+		gfp_mask |= __GFP_HIGHMEM;
+	return alloc_page(gfp_mask);
+}
+
+#define NR_CONTIG_MIGRATE_PAGES	(256)
+#define NR_CONTIG_MIGRATE_TRIES	5
+
+/*
+ * Move every page in use in [start, end) elsewhere.  Like memory hot-remove
+ * this only deals with pages on the LRU, anything else keeps the range
+ * busy.  Returns the number of pages that could not be moved or -errno.
+ */
+static int contig_migrate_range(unsigned long start, unsigned long end)
+{
+	unsigned long pfn = start;
+	int failed = 0;
+	LIST_HEAD(source);
+
+	while (pfn < end) {
+		int nr = 0, ret;
+
+		if (fatal_signal_pending(current))
+			return -EINTR;
+
+		for (; pfn < end && nr < NR_CONTIG_MIGRATE_PAGES; pfn++) {
+			struct page *page;
+
+			if (!pfn_valid_within(pfn))
+				continue;
+			page = pfn_to_page(pfn);
+			if (!get_page_unless_zero(page))
+				continue;
+			if (!isolate_lru_page(page)) {
+				list_add_tail(&page->lru, &source);
+				inc_zone_page_state(page, NR_ISOLATED_ANON +
+						    page_is_file_cache(page));
+				nr++;
+			} else {
+				failed++;
+			}
+			put_page(page);
+		}
+
+		if (list_empty(&source))
+			continue;
+		ret = migrate_pages(&source, contig_migrate_alloc, 0,
+				    false, true);
+		if (ret) {
+			putback_lru_pages(&source);
+			if (ret < 0)
+				return ret;
+			failed += ret;
+		}
+	}
+	return failed;
+}
+
+/*
+ * Take the free pages of [start, end) off the free lists.  The range is
+ * isolated and test_pages_isolated() found all of it free, so each pfn is
+ * either the head of a free buddy block or inside one.  Returns the end of
+ * the last block taken, which may lie beyond @end, or 0 if a page was not
+ * free after all.
+ */
+static unsigned long isolate_free_range(struct zone *zone,
+					unsigned long start, unsigned long end)
+{
+	unsigned long pfn = start;
+
+	spin_lock_irq(&zone->lock);
+	while (pfn < end) {
+		struct page *page = pfn_to_page(pfn);
+		unsigned int order;
+
+		if (!PageBuddy(page))
+			break;
+		order = page_order(page);
+		list_del(&page->lru);
+		zone->free_area[order].nr_free--;
+		rmv_page_order(page);
+		__mod_zone_page_state(zone, NR_FREE_PAGES, -(1UL << order));
+
+		set_page_refcounted(page);
+		split_page(page, order);
+		pfn += 1UL << order;
+	}
+	spin_unlock_irq(&zone->lock);
+
+	if (pfn < end) {
+		free_contig_range(start, pfn - start);
+		return 0;
+	}
+	kernel_map_pages(pfn_to_page(start), pfn - start, 1);
+	return pfn;
+}
+
+/**
+ * alloc_contig_range() -- allocate a range of pages
+ * @start:	first pfn of the range
+ * @end:	one past the last pfn of the range
+ * @migratetype: type of the pageblocks of the range, MIGRATE_CMA or
+ *		MIGRATE_MOVABLE
+ *
+ * The range must lie in a single zone and consist of pageblocks of the
+ * given type.  The pageblocks are isolated, the pages in use are migrated
+ * out and the then free range is taken off the buddy lists.  On success
+ * every page of the range has a reference count of one and is given back
+ * with free_contig_range().  Sleeps; returns 0 or -errno.
+ */
+int alloc_contig_range(unsigned long start, unsigned long end,
+		       int migratetype)
+{
+	struct zone *zone = page_zone(pfn_to_page(start));
+	unsigned long outer_start, outer_end;
+	int ret, order, tries = 0;
+
+	ret = start_isolate_page_range(contig_align_down(start),
+				       contig_align_up(end), migratetype);
+	if (ret)
+		return ret;
+
+	migrate_prep();
+	for (;;) {
+		ret = contig_migrate_range(start, end);
+		if (ret < 0)
+			goto done;
+
+		/* Flush out the pages held by pagevecs and per-cpu lists */
+		lru_add_drain_all();
+		drain_all_pages();
+
+		/* The first free block may start below @start */
+		order = 0;
+		outer_start = start;
+		while (!PageBuddy(pfn_to_page(outer_start)) &&
+		       ++order < MAX_ORDER)
+			outer_start &= ~0UL << order;
+		if (order == MAX_ORDER)
+			outer_start = start;
+
+		if (!test_pages_isolated(outer_start, end))
+			break;
+		if (++tries == NR_CONTIG_MIGRATE_TRIES) {
+			ret = -EBUSY;
+			goto done;
+		}
+		cond_resched();
+	}
+
+	outer_end = isolate_free_range(zone, outer_start, end);
+	if (!outer_end) {
+		ret = -EBUSY;
+		goto done;
+	}
+	ret = 0;
+
+	/* Give back what the first and last blocks had outside the range */
+	if (start != outer_start)
+		free_contig_range(outer_start, start - outer_start);
+	if (end != outer_end)
+		free_contig_range(end, outer_end - end);
+done:
+	undo_isolate_page_range(contig_align_down(start),
+				contig_align_up(end), migratetype);
+	return ret;
+}
+
+void free_contig_range(unsigned long pfn, unsigned long nr_pages)
+{
+	for (; nr_pages--; pfn++)
+		__free_page(pfn_to_page(pfn));
+}
+#endif /* CONFIG_CMA */
+
 #ifdef CONFIG_MEMORY_HOTREMOVE
 /*
  * All pages in the range must be isolated before calling this.
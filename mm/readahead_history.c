@@ -0,0 +1,335 @@
+/*
+ * mm/readahead_history.c - replay per-file access history as readahead
+ *
+ * ondemand_readahead() only builds up windows for sequential streams.
+ * Application start-up instead faults in scattered pieces of large files
+ * (apks, odex files, shared libraries), and each of those pieces costs a
+ * synchronous read.
+ *
+ * For regular files of at least RA_HISTORY_MIN_PAGES, remember which
+ * chunks of the file missed in the page cache during the first
+ * record_window_ms after an open.  On a later open the recorded chunks
+ * are read back in as batched asynchronous readahead from a workqueue,
+ * so by the time the application touches them they are, or are about to
+ * be, in the page cache.
+ *
+ * Each launch records into a fresh bitmap.  Chunks that were replayed no
+ * longer miss, so a replayed chunk is kept for one more launch without
+ * being seen again, and then dropped: the history follows what the file
+ * is used for instead of growing to everything it was ever used for.
+ *
+ * The history hangs off the address_space and lives as long as the inode
+ * is cached; it is not stored on disk.  It is controlled through
+ * /sys/kernel/mm/readahead_history/.
+ */
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/pagemap.h>
+#include <linux/slab.h>
+#include <linux/file.h>
+#include <linux/bitops.h>
+#include <linux/jiffies.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
+#include <linux/workqueue.h>
+
+/* Files smaller than this are covered by normal readahead anyway */
+#define RA_HISTORY_MIN_PAGES	64
+/* Smallest chunk tracked by one bit, in pages (1 << shift) */
+#define RA_HISTORY_MIN_SHIFT	2
+/* Largest bitmap kept per file */
+#define RA_HISTORY_MAX_BITS	4096
+
+/* flags */
+#define RA_HISTORY_REPLAYING	0
+
+struct ra_history {
+	unsigned long		flags;
+	unsigned long		open_stamp;	/* jiffies of the last open */
+	unsigned long		launch;		/* jiffies the launch started */
+	unsigned int		shift;		/* pages per bit, log2 */
+	unsigned int		nr_bits;
+	struct work_struct	work;
+	struct file		*file;		/* pinned during replay */
+	unsigned long		*miss;		/* recorded in this launch */
+	unsigned long		*kept;		/* replayed, not missed since */
+	unsigned long		bits[0];	/* to replay, then miss, kept */
+};
+
+static bool ra_history_enabled __read_mostly = true;
+static unsigned int ra_history_window_ms __read_mostly = 5000;
+static unsigned int ra_history_max_replay_kb __read_mostly = 16 * 1024;
+
+static atomic_long_t ra_history_nr_replays = ATOMIC_LONG_INIT(0);
+static atomic_long_t ra_history_nr_replay_pages = ATOMIC_LONG_INIT(0);
+
+static void ra_history_replay(struct work_struct *work)
+{
+	struct ra_history *hist = container_of(work, struct ra_history, work);
+	struct file *file = hist->file;
+	struct address_space *mapping = file->f_mapping;
+	unsigned long budget = ra_history_max_replay_kb >> (PAGE_SHIFT - 10);
+	unsigned long start, end, pages = 0;
+	int ret;
+
+	start = find_first_bit(hist->bits, hist->nr_bits);
+	while (start < hist->nr_bits && budget) {
+		unsigned long nr;
+
+		end = find_next_zero_bit(hist->bits, hist->nr_bits, start);
+		nr = min((end - start) << hist->shift, budget);
+
+		ret = force_page_cache_readahead(mapping, file,
+						 start << hist->shift, nr);
+		if (ret < 0)
+			break;
+		pages += ret;
+		budget -= nr;
+
+		start = find_next_bit(hist->bits, hist->nr_bits, end);
+	}
+
+	atomic_long_inc(&ra_history_nr_replays);
+	atomic_long_add(pages, &ra_history_nr_replay_pages);
+
+	hist->file = NULL;
+	clear_bit(RA_HISTORY_REPLAYING, &hist->flags);
+	fput(file);
+}
+
+static struct ra_history *ra_history_alloc(struct address_space *mapping,
+					   pgoff_t size)
+{
+	struct ra_history *hist, *old;
+	unsigned int shift = RA_HISTORY_MIN_SHIFT;
+	unsigned long nr_bits;
+
+	while ((size >> shift) >= RA_HISTORY_MAX_BITS)
+		shift++;
+	nr_bits = (size + (1UL << shift) - 1) >> shift;
+
+	hist = kzalloc(sizeof(*hist) +
+		       3 * BITS_TO_LONGS(nr_bits) * sizeof(long), GFP_KERNEL);
+	if (!hist)
+		return NULL;
+
+	hist->shift = shift;
+	hist->nr_bits = nr_bits;
+	hist->miss = hist->bits + BITS_TO_LONGS(nr_bits);
+	hist->kept = hist->miss + BITS_TO_LONGS(nr_bits);
+	INIT_WORK(&hist->work, ra_history_replay);
+
+	old = cmpxchg(&mapping->ra_history, NULL, hist);
+	if (old) {
+		kfree(hist);
+		hist = old;
+	}
+	return hist;
+}
+
+/*
+ * At the start of a launch, the chunks missed in the last one are to be
+ * replayed, along with those replayed then that were not kept over
+ * already.  Misses recorded meanwhile are not lost, the words of the miss
+ * bitmap are taken with xchg().
+ */
+static void ra_history_age(struct ra_history *hist)
+{
+	unsigned long i, miss;
+
+	for (i = 0; i < BITS_TO_LONGS(hist->nr_bits); i++) {
+		miss = xchg(&hist->miss[i], 0);
+		hist->bits[i] = (hist->bits[i] & ~hist->kept[i]) | miss;
+		hist->kept[i] = hist->bits[i] & ~miss;
+	}
+}
+
+/*
+ * Called on every open: start the recording window and, on the first open
+ * of a launch, queue the replay of what the earlier launches used.
+ */
+void readahead_history_open(struct file *file)
+{
+	struct address_space *mapping = file->f_mapping;
+	struct inode *inode = mapping->host;
+	struct ra_history *hist;
+	unsigned long window;
+	pgoff_t size;
+
+	if (!ra_history_enabled || !S_ISREG(inode->i_mode))
+		return;
+	if (!(file->f_mode & FMODE_READ) || (file->f_flags & O_DIRECT))
+		return;
+	if (!file->f_ra.ra_pages || !mapping->a_ops->readpage)
+		return;
+
+	size = (i_size_read(inode) + PAGE_CACHE_SIZE - 1) >> PAGE_CACHE_SHIFT;
+	if (size < RA_HISTORY_MIN_PAGES)
+		return;
+
+	hist = mapping->ra_history;
+	if (!hist) {
+		hist = ra_history_alloc(mapping, size);
+		if (!hist)
+			return;
+	}
+
+	window = msecs_to_jiffies(ra_history_window_ms);
+	hist->open_stamp = jiffies;
+
+	/*
+	 * Opens within one window of the start of a launch belong to it,
+	 * most of what they need is already being read.
+	 */
+	if (hist->launch && time_before(jiffies, hist->launch + window))
+		return;
+	if (test_and_set_bit(RA_HISTORY_REPLAYING, &hist->flags))
+		return;
+	if (hist->launch && time_before(jiffies, hist->launch + window))
+		goto out;
+
+	hist->launch = jiffies ? : 1;
+	ra_history_age(hist);
+	if (find_first_bit(hist->bits, hist->nr_bits) >= hist->nr_bits)
+		goto out;
+
+	get_file(file);
+	hist->file = file;
+	schedule_work(&hist->work);
+	return;
+out:
+	clear_bit(RA_HISTORY_REPLAYING, &hist->flags);
+}
+
+/*
+ * Called on a page cache miss at @offset for a read of @nr pages.
+ */
+void readahead_history_record(struct address_space *mapping, pgoff_t offset,
+			      unsigned long nr)
+{
+	struct ra_history *hist = mapping->ra_history;
+	unsigned long bit, last;
+
+	if (!hist || !ra_history_enabled)
+		return;
+	if (time_after(jiffies, hist->open_stamp +
+				msecs_to_jiffies(ra_history_window_ms)))
+		return;
+
+	bit = offset >> hist->shift;
+	last = (offset + max(nr, 1UL) - 1) >> hist->shift;
+	for (; bit <= last && bit < hist->nr_bits; bit++)
+		if (!test_bit(bit, hist->miss))
+			set_bit(bit, hist->miss);
+}
+
+void readahead_history_free(struct address_space *mapping)
+{
+	kfree(mapping->ra_history);
+	mapping->ra_history = NULL;
+}
+
+#ifdef CONFIG_SYSFS
+static ssize_t enabled_show(struct kobject *kobj,
+			    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", ra_history_enabled);
+}
+
+static ssize_t enabled_store(struct kobject *kobj,
+			     struct kobj_attribute *attr,
+			     const char *buf, size_t count)
+{
+	unsigned long val;
+
+	if (strict_strtoul(buf, 10, &val) || val > 1)
+		return -EINVAL;
+	ra_history_enabled = val;
+	return count;
+}
+static struct kobj_attribute enabled_attr =
+	__ATTR(enabled, 0644, enabled_show, enabled_store);
+
+static ssize_t record_window_ms_show(struct kobject *kobj,
+				     struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ra_history_window_ms);
+}
+
+static ssize_t record_window_ms_store(struct kobject *kobj,
+				      struct kobj_attribute *attr,
+				      const char *buf, size_t count)
+{
+	unsigned long val;
+
+	if (strict_strtoul(buf, 10, &val) || val > UINT_MAX)
+		return -EINVAL;
+	ra_history_window_ms = val;
+	return count;
+}
+static struct kobj_attribute record_window_ms_attr =
+	__ATTR(record_window_ms, 0644, record_window_ms_show,
+	       record_window_ms_store);
+
+static ssize_t max_replay_kb_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ra_history_max_replay_kb);
+}
+
+static ssize_t max_replay_kb_store(struct kobject *kobj,
+				   struct kobj_attribute *attr,
+				   const char *buf, size_t count)
+{
+	unsigned long val;
+
+	if (strict_strtoul(buf, 10, &val) || val > UINT_MAX)
+		return -EINVAL;
+	ra_history_max_replay_kb = val;
+	return count;
+}
+static struct kobj_attribute max_replay_kb_attr =
+	__ATTR(max_replay_kb, 0644, max_replay_kb_show, max_replay_kb_store);
+
+static ssize_t replays_show(struct kobject *kobj,
+			    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%ld\n", atomic_long_read(&ra_history_nr_replays));
+}
+static struct kobj_attribute replays_attr = __ATTR_RO(replays);
+
+static ssize_t replay_pages_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%ld\n",
+		       atomic_long_read(&ra_history_nr_replay_pages));
+}
+static struct kobj_attribute replay_pages_attr = __ATTR_RO(replay_pages);
+
+static struct attribute *ra_history_attrs[] = {
+	&enabled_attr.attr,
+	&record_window_ms_attr.attr,
+	&max_replay_kb_attr.attr,
+	&replays_attr.attr,
+	&replay_pages_attr.attr,
+	NULL,
+};
+
+static struct attribute_group ra_history_attr_group = {
+	.attrs = ra_history_attrs,
+	.name = "readahead_history",
+};
+
+static int __init readahead_history_init(void)
+{
+	int err;
+
+	err = sysfs_create_group(mm_kobj, &ra_history_attr_group);
+	if (err)
+		printk(KERN_ERR "readahead_history: register sysfs failed\n");
+	return err;
+}
+module_init(readahead_history_init)
+#endif /* CONFIG_SYSFS */
@@ -37,10 +37,33 @@
 /* How many pages do we try to swap or page in/out together? */
 int page_cluster;
 
-static DEFINE_PER_CPU(struct pagevec[NR_LRU_LISTS], lru_add_pvecs);
+/*
+ * Pages on their way onto the LRU lists are queued per cpu and added in
+ * batches, so that zone->lru_lock is taken once per batch rather than per
+ * page.  A batch is added when it holds limit pages.  The limit starts at
+ * PAGEVEC_SIZE and doubles, up to LRU_ADD_BATCH_MAX, whenever adding a
+ * batch finds the lock contended.  Queued pages are invisible to reclaim
+ * and migration, so after LRU_BATCH_CALM uncontended batches in a row the
+ * limit is halved again.
+ */
+#define LRU_ADD_BATCH_MAX	64
+#define LRU_BATCH_CALM		16
+
+struct lru_add_batch {
+	unsigned int	nr[NR_LRU_LISTS];
+	unsigned int	total;
+	unsigned int	limit;		/* 0 means PAGEVEC_SIZE */
+	unsigned int	calm;		/* uncontended batches in a row */
+	struct page	*pages[NR_LRU_LISTS][LRU_ADD_BATCH_MAX];
+};
+
+static DEFINE_PER_CPU(struct lru_add_batch, lru_add_batches);
 static DEFINE_PER_CPU(struct pagevec, lru_rotate_pvecs);
 static DEFINE_PER_CPU(struct pagevec, lru_deactivate_pvecs);
 
+static void drain_cpu_pagevecs(int cpu);
+static void ____pagevec_lru_add_fn(struct page *page, void *arg);
+
 /*
  * This path almost never happens for VM activity - pages are normally
  * freed via pagevecs.  But it gets used by networking.
@@ -179,29 +202,62 @@ void put_pages_list(struct list_head *pages)
 }
 EXPORT_SYMBOL(put_pages_list);
 
+/*
+ * The zone->lru_lock held while moving a run of pages that may span zones.
+ * It is only dropped when the next page belongs to another zone.
+ * Interrupts must be disabled while it is in use.
+ */
+struct lru_lock_hold {
+	struct zone	*zone;
+	bool		contended;
+};
+
+static void lru_lock_zone(struct lru_lock_hold *hold, struct zone *zone)
+{
+	if (zone == hold->zone)
+		return;
+	if (hold->zone)
+		spin_unlock(&hold->zone->lru_lock);
+	hold->zone = zone;
+	if (!spin_trylock(&zone->lru_lock)) {
+		spin_lock(&zone->lru_lock);
+		__count_vm_event(LRU_LOCK_CONTENDED);
+		hold->contended = true;
+	}
+	__count_vm_event(LRU_LOCK_ACQUIRE);
+}
+
+static void lru_unlock_zone(struct lru_lock_hold *hold)
+{
+	if (hold->zone)
+		spin_unlock(&hold->zone->lru_lock);
+	hold->zone = NULL;
+}
+
+static void lru_move_pages(struct page **pages, unsigned int nr,
+			   void (*move_fn)(struct page *page, void *arg),
+			   void *arg, struct lru_lock_hold *hold)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr; i++) {
+		lru_lock_zone(hold, page_zone(pages[i]));
+		(*move_fn)(pages[i], arg);
+	}
+}
+
 static void pagevec_lru_move_fn(struct pagevec *pvec,
 				void (*move_fn)(struct page *page, void *arg),
 				void *arg)
 {
-	int i;
-	struct zone *zone = NULL;
-	unsigned long flags = 0;
+	struct lru_lock_hold hold = { NULL, false };
+	unsigned long flags;
 
-	for (i = 0; i < pagevec_count(pvec); i++) {
-		struct page *page = pvec->pages[i];
-		struct zone *pagezone = page_zone(page);
+	local_irq_save(flags);
+	lru_move_pages(pvec->pages, pagevec_count(pvec), move_fn, arg, &hold);
+	lru_unlock_zone(&hold);
+	local_irq_restore(flags);
 
-		if (pagezone != zone) {
-			if (zone)
-				spin_unlock_irqrestore(&zone->lru_lock, flags);
-			zone = pagezone;
-			spin_lock_irqsave(&zone->lru_lock, flags);
-		}
-
-		(*move_fn)(page, arg);
-	}
-	if (zone)
-		spin_unlock_irqrestore(&zone->lru_lock, flags);
 	release_pages(pvec->pages, pvec->nr, pvec->cold);
 	pagevec_reinit(pvec);
 }
@@ -293,12 +349,9 @@ static void __activate_page(struct page *page, void *arg)
 #ifdef CONFIG_SMP
 static DEFINE_PER_CPU(struct pagevec, activate_page_pvecs);
 
-static void activate_page_drain(int cpu)
+static struct pagevec *activate_page_pvec(int cpu)
 {
-	struct pagevec *pvec = &per_cpu(activate_page_pvecs, cpu);
-
-	if (pagevec_count(pvec))
-		pagevec_lru_move_fn(pvec, __activate_page, NULL);
+	return &per_cpu(activate_page_pvecs, cpu);
 }
 
 void activate_page(struct page *page)
@@ -308,14 +361,15 @@ void activate_page(struct page *page)
 
 		page_cache_get(page);
 		if (!pagevec_add(pvec, page))
-			pagevec_lru_move_fn(pvec, __activate_page, NULL);
+			drain_cpu_pagevecs(smp_processor_id());
 		put_cpu_var(activate_page_pvecs);
 	}
 }
 
 #else
-static inline void activate_page_drain(int cpu)
+static inline struct pagevec *activate_page_pvec(int cpu)
 {
+	return NULL;
 }
 
 void activate_page(struct page *page)
@@ -341,6 +395,7 @@ void mark_page_accessed(struct page *page)
 			PageReferenced(page) && PageLRU(page)) {
 		activate_page(page);
 		ClearPageReferenced(page);
+		workingset_activation(page);
 	} else if (!PageReferenced(page)) {
 		SetPageReferenced(page);
 	}
@@ -348,14 +403,38 @@ void mark_page_accessed(struct page *page)
 
 EXPORT_SYMBOL(mark_page_accessed);
 
+static unsigned int lru_batch_limit(struct lru_add_batch *batch)
+{
+	return batch->limit ? batch->limit : PAGEVEC_SIZE;
+}
+
+static void lru_batch_adapt(struct lru_add_batch *batch, bool contended)
+{
+	unsigned int limit = lru_batch_limit(batch);
+
+	if (contended) {
+		batch->calm = 0;
+		if (limit < LRU_ADD_BATCH_MAX) {
+			batch->limit = min_t(unsigned int, limit * 2,
+					     LRU_ADD_BATCH_MAX);
+			count_vm_event(LRU_BATCH_GROW);
+		}
+	} else if (++batch->calm >= LRU_BATCH_CALM) {
+		batch->calm = 0;
+		batch->limit = max_t(unsigned int, limit / 2, PAGEVEC_SIZE);
+	}
+}
+
 void __lru_cache_add(struct page *page, enum lru_list lru)
 {
-	struct pagevec *pvec = &get_cpu_var(lru_add_pvecs)[lru];
+	struct lru_add_batch *batch = &get_cpu_var(lru_add_batches);
 
 	page_cache_get(page);
-	if (!pagevec_add(pvec, page))
-		____pagevec_lru_add(pvec, lru);
-	put_cpu_var(lru_add_pvecs);
+	batch->pages[lru][batch->nr[lru]++] = page;
+	/* nr[lru] <= total <= limit <= LRU_ADD_BATCH_MAX */
+	if (++batch->total >= lru_batch_limit(batch))
+		drain_cpu_pagevecs(smp_processor_id());
+	put_cpu_var(lru_add_batches);
 }
 EXPORT_SYMBOL(__lru_cache_add);
 
@@ -467,38 +546,62 @@ static void lru_deactivate_fn(struct page *page, void *arg)
 	update_page_reclaim_stat(zone, page, file, 0);
 }
 
+static void release_pagevec(struct pagevec *pvec)
+{
+	if (pvec && pagevec_count(pvec)) {
+		release_pages(pvec->pages, pvec->nr, pvec->cold);
+		pagevec_reinit(pvec);
+	}
+}
+
 /*
  * Drain pages out of the cpu's pagevecs.
  * Either "cpu" is the current CPU, and preemption has already been
  * disabled; or "cpu" is being hot-unplugged, and is already dead.
+ *
+ * The additions, activations, deactivations and rotations queued on the
+ * cpu are done in a single pass.  The lru_lock is held from one page to
+ * the next and only retaken when the zone changes, rather than taken
+ * again for each kind.  Interrupts stay disabled for the whole pass
+ * because the rotations are queued from interrupt context.
  */
 static void drain_cpu_pagevecs(int cpu)
 {
-	struct pagevec *pvecs = per_cpu(lru_add_pvecs, cpu);
-	struct pagevec *pvec;
-	int lru;
-
+	struct lru_add_batch *batch = &per_cpu(lru_add_batches, cpu);
+	struct pagevec *activate = activate_page_pvec(cpu);
+	struct pagevec *deactivate = &per_cpu(lru_deactivate_pvecs, cpu);
+	struct pagevec *rotate = &per_cpu(lru_rotate_pvecs, cpu);
+	struct lru_lock_hold hold = { NULL, false };
+	unsigned long flags;
+	enum lru_list lru;
+	int rotated = 0;
+
+	local_irq_save(flags);
+	for_each_lru(lru)
+		lru_move_pages(batch->pages[lru], batch->nr[lru],
+			       ____pagevec_lru_add_fn, (void *)lru, &hold);
+	if (activate)
+		lru_move_pages(activate->pages, pagevec_count(activate),
+			       __activate_page, NULL, &hold);
+	lru_move_pages(deactivate->pages, pagevec_count(deactivate),
+		       lru_deactivate_fn, NULL, &hold);
+	lru_move_pages(rotate->pages, pagevec_count(rotate),
+		       pagevec_move_tail_fn, &rotated, &hold);
+	lru_unlock_zone(&hold);
+	__count_vm_events(PGROTATED, rotated);
+	release_pagevec(rotate);
+	local_irq_restore(flags);
+
+	if (batch->total)
+		lru_batch_adapt(batch, hold.contended);
 	for_each_lru(lru) {
-		pvec = &pvecs[lru - LRU_BASE];
-		if (pagevec_count(pvec))
-			____pagevec_lru_add(pvec, lru);
+		if (batch->nr[lru])
+			release_pages(batch->pages[lru], batch->nr[lru], 0);
+		batch->nr[lru] = 0;
 	}
-
-	pvec = &per_cpu(lru_rotate_pvecs, cpu);
-	if (pagevec_count(pvec)) {
-		unsigned long flags;
-
-		/* No harm done if a racing interrupt already did this */
-		local_irq_save(flags);
-		pagevec_move_tail(pvec);
-		local_irq_restore(flags);
-	}
-
-	pvec = &per_cpu(lru_deactivate_pvecs, cpu);
-	if (pagevec_count(pvec))
-		pagevec_lru_move_fn(pvec, lru_deactivate_fn, NULL);
-
-	activate_page_drain(cpu);
+	batch->total = 0;
+	release_pagevec(activate);
+	release_pagevec(deactivate);
 }
 
 /**
@@ -522,7 +625,7 @@ void deactivate_page(struct page *page)
 		struct pagevec *pvec = &get_cpu_var(lru_deactivate_pvecs);
 
 		if (!pagevec_add(pvec, page))
-			pagevec_lru_move_fn(pvec, lru_deactivate_fn, NULL);
+			drain_cpu_pagevecs(smp_processor_id());
 		put_cpu_var(lru_deactivate_pvecs);
 	}
 }
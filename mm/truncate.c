@@ -217,6 +217,7 @@ void truncate_inode_pages_range(struct address_space *mapping,
 	int i;
 
 	cleancache_flush_inode(mapping);
+	workingset_forget(mapping);
 	if (mapping->nrpages == 0)
 		return;
 
@@ -295,6 +296,7 @@ void truncate_inode_pages_range(struct address_space *mapping,
 		mem_cgroup_uncharge_end();
 	}
 	cleancache_flush_inode(mapping);
+	workingset_forget(mapping);
 }
 EXPORT_SYMBOL(truncate_inode_pages_range);
 
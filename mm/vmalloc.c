@@ -26,6 +26,8 @@
 #include <linux/rcupdate.h>
 #include <linux/pfn.h>
 #include <linux/kmemleak.h>
+#include <linux/log2.h>
+#include <linux/vmstat.h>
 #include <asm/atomic.h>
 #include <asm/uaccess.h>
 #include <asm/tlbflush.h>
@@ -272,6 +274,30 @@ static unsigned long cached_align;
 
 static unsigned long vmap_area_pcpu_hole;
 
+/*
+ * A freed area goes onto the lazy list of the cpu that freed it and stays
+ * in the rbtree until a purge has flushed the TLB for it.  After the flush
+ * areas of up to VMAP_CACHE_MAX_PAGES are kept in the rbtree on the free
+ * lists of that cpu, from where alloc_vmap_area() takes one of the same
+ * size without vmap_area_lock, the rbtree walk and a kmalloc.  A cpu holds
+ * at most VMAP_CACHE_PAGES of address space that way, and all of it is
+ * given back when an allocation does not fit.
+ */
+#define VMAP_CACHE_MAX_PAGES	256	/* 1MB with 4K pages, guard included */
+#define VMAP_CACHE_ORDERS	9	/* ilog2(VMAP_CACHE_MAX_PAGES) + 1 */
+#define VMAP_CACHE_PAGES	1024
+#define VMAP_CACHE_SCAN		8	/* areas looked at per allocation */
+
+struct vmap_cache {
+	spinlock_t lock;
+	struct list_head lazy;		/* unmapped, TLB not flushed yet */
+	struct list_head free[VMAP_CACHE_ORDERS]; /* by ilog2 of the pages */
+	unsigned long nr_free;		/* pages on the free lists */
+	struct list_head purging;	/* owned by the purger */
+};
+
+static DEFINE_PER_CPU(struct vmap_cache, vmap_cache);
+
 static struct vmap_area *__find_vmap_area(unsigned long addr)
 {
 	struct rb_node *n = vmap_area_root.rb_node;
@@ -325,6 +351,53 @@ static void __insert_vmap_area(struct vmap_area *va)
 
 static void purge_vmap_area_lazy(void);
 
+/*
+ * Take a flushed area of exactly @size that fits the constraints from this
+ * cpu's cache.
+ */
+static struct vmap_area *vmap_cache_get(unsigned long size,
+				unsigned long align,
+				unsigned long vstart, unsigned long vend)
+{
+	unsigned long pages = size >> PAGE_SHIFT;
+	struct vmap_area *va, *found = NULL;
+	struct vmap_cache *vc;
+	int scanned = 0;
+
+	if (pages > VMAP_CACHE_MAX_PAGES)
+		return NULL;
+
+	vc = &get_cpu_var(vmap_cache);
+	/* Also keeps us away from the lists before vmalloc_init() */
+	if (!vc->nr_free)
+		goto out;
+
+	spin_lock(&vc->lock);
+	list_for_each_entry(va, &vc->free[ilog2(pages)], purge_list) {
+		if (va->va_end - va->va_start == size &&
+		    va->va_start >= vstart && va->va_end <= vend &&
+		    !(va->va_start & (align - 1))) {
+			list_del(&va->purge_list);
+			vc->nr_free -= pages;
+			found = va;
+			break;
+		}
+		if (++scanned == VMAP_CACHE_SCAN)
+			break;
+	}
+	spin_unlock(&vc->lock);
+out:
+	put_cpu_var(vmap_cache);
+
+	if (found) {
+		found->flags = 0;
+		found->private = NULL;
+		count_vm_event(VMAP_CACHE_HIT);
+	} else
+		count_vm_event(VMAP_CACHE_MISS);
+	return found;
+}
+
 /*
  * Allocate a region of KVA of the specified size and alignment, within the
  * vstart and vend.
@@ -344,6 +417,10 @@ static struct vmap_area *alloc_vmap_area(unsigned long size,
 	BUG_ON(size & ~PAGE_MASK);
 	BUG_ON(!is_power_of_2(align));
 
+	va = vmap_cache_get(size, align, vstart, vend);
+	if (va)
+		return va;
+
 	va = kmalloc_node(sizeof(struct vmap_area),
 			gfp_mask & GFP_RECLAIM_MASK, node);
 	if (unlikely(!va))
@@ -560,6 +637,23 @@ static unsigned long lazy_max_pages(void)
 
 static atomic_t vmap_lazy_nr = ATOMIC_INIT(0);
 
+/*
+ * The lazily freed areas are scattered over the vmalloc space, so the
+ * range flushed by a purge can span many more pages than were unmapped.
+ * Past VMAP_FLUSH_ALL_PAGES invalidating the range page by page costs
+ * more than refilling the TLB after flushing all of it.
+ */
+#define VMAP_FLUSH_ALL_PAGES	PTRS_PER_PTE
+
+static void vmap_flush_tlb(unsigned long start, unsigned long end)
+{
+	if ((end - start) >> PAGE_SHIFT > VMAP_FLUSH_ALL_PAGES) {
+		count_vm_event(VMAP_FLUSH_ALL);
+		flush_tlb_all();
+	} else
+		flush_tlb_kernel_range(start, end);
+}
+
 /* for per-CPU blocks */
 static void purge_fragmented_blocks_allcpus(void);
 
@@ -590,6 +684,7 @@ static void __purge_vmap_area_lazy(unsigned long *start, unsigned long *end,
 	struct vmap_area *va;
 	struct vmap_area *n_va;
 	int nr = 0;
+	int cpu;
 
 	/*
 	 * If sync is 0 but force_flush is 1, we'll go sync anyway but callers
@@ -605,28 +700,56 @@ static void __purge_vmap_area_lazy(unsigned long *start, unsigned long *end,
 	if (sync)
 		purge_fragmented_blocks_allcpus();
 
-	rcu_read_lock();
-	list_for_each_entry_rcu(va, &vmap_area_list, list) {
-		if (va->flags & VM_LAZY_FREE) {
+	for_each_possible_cpu(cpu) {
+		struct vmap_cache *vc = &per_cpu(vmap_cache, cpu);
+
+		spin_lock(&vc->lock);
+		list_splice_init(&vc->lazy, &vc->purging);
+		spin_unlock(&vc->lock);
+
+		list_for_each_entry(va, &vc->purging, purge_list) {
 			if (va->va_start < *start)
 				*start = va->va_start;
 			if (va->va_end > *end)
 				*end = va->va_end;
 			nr += (va->va_end - va->va_start) >> PAGE_SHIFT;
-			list_add_tail(&va->purge_list, &valist);
 			va->flags |= VM_LAZY_FREEING;
 			va->flags &= ~VM_LAZY_FREE;
 		}
 	}
-	rcu_read_unlock();
 
-	if (nr)
+	if (nr) {
 		atomic_sub(nr, &vmap_lazy_nr);
+		count_vm_event(VMAP_PURGE);
+		count_vm_events(VMAP_PURGE_PAGES, nr);
+	}
 
 	if (nr || force_flush)
-		flush_tlb_kernel_range(*start, *end);
+		vmap_flush_tlb(*start, *end);
 
-	if (nr) {
+	/* Flushed now: keep what fits in the caches, free the rest */
+	for_each_possible_cpu(cpu) {
+		struct vmap_cache *vc = &per_cpu(vmap_cache, cpu);
+
+		if (list_empty(&vc->purging))
+			continue;
+
+		spin_lock(&vc->lock);
+		list_for_each_entry_safe(va, n_va, &vc->purging, purge_list) {
+			unsigned long pages;
+
+			pages = (va->va_end - va->va_start) >> PAGE_SHIFT;
+			if (pages > VMAP_CACHE_MAX_PAGES ||
+			    vc->nr_free + pages > VMAP_CACHE_PAGES)
+				continue;
+			list_move(&va->purge_list, &vc->free[ilog2(pages)]);
+			vc->nr_free += pages;
+		}
+		spin_unlock(&vc->lock);
+		list_splice_init(&vc->purging, &valist);
+	}
+
+	if (!list_empty(&valist)) {
 		spin_lock(&vmap_area_lock);
 		list_for_each_entry_safe(va, n_va, &valist, purge_list)
 			__free_vmap_area(va);
@@ -635,6 +758,35 @@ static void __purge_vmap_area_lazy(unsigned long *start, unsigned long *end,
 	spin_unlock(&purge_lock);
 }
 
+/*
+ * Give the areas kept in the per-cpu caches back to the rbtree.
+ */
+static void vmap_cache_drain_allcpus(void)
+{
+	LIST_HEAD(valist);
+	struct vmap_area *va;
+	struct vmap_area *n_va;
+	int cpu, i;
+
+	for_each_possible_cpu(cpu) {
+		struct vmap_cache *vc = &per_cpu(vmap_cache, cpu);
+
+		spin_lock(&vc->lock);
+		for (i = 0; i < VMAP_CACHE_ORDERS; i++)
+			list_splice_init(&vc->free[i], &valist);
+		vc->nr_free = 0;
+		spin_unlock(&vc->lock);
+	}
+
+	if (list_empty(&valist))
+		return;
+
+	spin_lock(&vmap_area_lock);
+	list_for_each_entry_safe(va, n_va, &valist, purge_list)
+		__free_vmap_area(va);
+	spin_unlock(&vmap_area_lock);
+}
+
 /*
  * Kick off a purge of the outstanding lazy areas. Don't bother if somebody
  * is already purging.
@@ -647,13 +799,15 @@ static void try_purge_vmap_area_lazy(void)
 }
 
 /*
- * Kick off a purge of the outstanding lazy areas.
+ * Kick off a purge of the outstanding lazy areas, and give back the cached
+ * ones, for an allocation that did not fit.
  */
 static void purge_vmap_area_lazy(void)
 {
 	unsigned long start = ULONG_MAX, end = 0;
 
 	__purge_vmap_area_lazy(&start, &end, 1, 0);
+	vmap_cache_drain_allcpus();
 }
 
 /*
@@ -663,7 +817,15 @@ static void purge_vmap_area_lazy(void)
  */
 static void free_vmap_area_noflush(struct vmap_area *va)
 {
+	struct vmap_cache *vc;
+
 	va->flags |= VM_LAZY_FREE;
+	vc = &get_cpu_var(vmap_cache);
+	spin_lock(&vc->lock);
+	list_add_tail(&va->purge_list, &vc->lazy);
+	spin_unlock(&vc->lock);
+	put_cpu_var(vmap_cache);
+
 	atomic_add((va->va_end - va->va_start) >> PAGE_SHIFT, &vmap_lazy_nr);
 	if (unlikely(atomic_read(&vmap_lazy_nr) > lazy_max_pages()))
 		try_purge_vmap_area_lazy();
@@ -1165,10 +1327,19 @@ void __init vmalloc_init(void)
 
 	for_each_possible_cpu(i) {
 		struct vmap_block_queue *vbq;
+		struct vmap_cache *vc;
+		int j;
 
 		vbq = &per_cpu(vmap_block_queue, i);
 		spin_lock_init(&vbq->lock);
 		INIT_LIST_HEAD(&vbq->free);
+
+		vc = &per_cpu(vmap_cache, i);
+		spin_lock_init(&vc->lock);
+		INIT_LIST_HEAD(&vc->lazy);
+		for (j = 0; j < VMAP_CACHE_ORDERS; j++)
+			INIT_LIST_HEAD(&vc->free[j]);
+		INIT_LIST_HEAD(&vc->purging);
 	}
 
 	/* Import existing vmlist entries. */
@@ -0,0 +1,222 @@
+/*
+ * mm/workingset.c - refault detection for the file LRU
+ *
+ * A page cache page reclaimed from the inactive list leaves nothing
+ * behind.  When it is read back in shortly after, it starts over at the
+ * head of the inactive list and is usually reclaimed again before a second
+ * access can promote it.  With more app code in use than fits next to the
+ * active list, the same pages are read from flash over and over.
+ *
+ * Each zone counts the pages it evicts and activates in inactive_age.  On
+ * eviction a shadow entry with the current count is remembered for the
+ * page's (mapping, index).  When that page is faulted or read back in, the
+ * difference between the count now and the shadow, the refault distance,
+ * is how many more inactive pages the zone would have needed for the page
+ * to still be resident.  The active file list could have given up that
+ * many pages, so if the distance is no larger than it, the page goes
+ * straight onto the active list and competes with the pages there.
+ * Otherwise the access pattern is too large to cache anyway and the page
+ * starts out inactive as before.
+ *
+ * The shadow entries are kept in a fixed size hash table next to the page
+ * cache rather than in its radix tree, so that no page cache lookup has to
+ * skip over them.  It holds one entry per two pages of memory in buckets
+ * that forget their oldest entry first.  An entry is identified by the
+ * hash of mapping, index and the mapping's shadow generation only; the
+ * rare collision costs one misplaced page.  The generation comes from a
+ * global counter when the inode is set up and again when the file is
+ * truncated, so that neither a truncated file nor a new inode in the
+ * memory of a freed one finds the shadows left behind.
+ *
+ * The counters show up as workingset_refault and workingset_activate in
+ * /proc/vmstat.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/mmzone.h>
+#include <linux/swap.h>
+#include <linux/hash.h>
+#include <linux/log2.h>
+#include <linux/spinlock.h>
+#include <linux/vmalloc.h>
+#include <linux/vmstat.h>
+
+#define SHADOW_BUCKET_SIZE	8
+
+#define EVICTION_SHIFT		(NODES_SHIFT + ZONES_SHIFT)
+#define EVICTION_MASK		(~0U >> EVICTION_SHIFT)
+
+struct shadow_entry {
+	u32		key;		/* 0 when unused */
+	u32		eviction;	/* inactive_age, node and zone */
+};
+
+struct shadow_bucket {
+	spinlock_t		lock;
+	struct shadow_entry	entries[SHADOW_BUCKET_SIZE];	/* newest first */
+};
+
+static struct shadow_bucket *shadow_table __read_mostly;
+static unsigned int shadow_hash_bits __read_mostly;
+static atomic_long_t shadow_generation = ATOMIC_LONG_INIT(0);
+
+static struct shadow_bucket *shadow_lookup(struct address_space *mapping,
+					   pgoff_t index, u32 *key)
+{
+	unsigned long hash;
+
+	hash = hash_long(index, BITS_PER_LONG) ^
+	       hash_long(ACCESS_ONCE(mapping->shadow_gen), BITS_PER_LONG);
+	hash = hash_long((unsigned long)mapping ^ hash, BITS_PER_LONG);
+	*key = (u32)(hash >> shadow_hash_bits) | 1;
+	return &shadow_table[hash & ((1UL << shadow_hash_bits) - 1)];
+}
+
+static u32 pack_shadow(unsigned long eviction, struct zone *zone)
+{
+	eviction = (eviction << NODES_SHIFT) | zone_to_nid(zone);
+	eviction = (eviction << ZONES_SHIFT) | zone_idx(zone);
+	return eviction;
+}
+
+static struct zone *unpack_shadow(u32 shadow, unsigned long *eviction)
+{
+	int zid, nid;
+
+	zid = shadow & ((1U << ZONES_SHIFT) - 1);
+	shadow >>= ZONES_SHIFT;
+	nid = shadow & ((1U << NODES_SHIFT) - 1);
+	shadow >>= NODES_SHIFT;
+	*eviction = shadow;
+	return NODE_DATA(nid)->node_zones + zid;
+}
+
+/**
+ * workingset_eviction - remember a page cache page that is being reclaimed
+ * @mapping: address space the page is removed from
+ * @page: the page
+ *
+ * Called by reclaim when the page leaves the page cache, under the
+ * mapping's tree_lock with interrupts disabled.
+ */
+void workingset_eviction(struct address_space *mapping, struct page *page)
+{
+	struct zone *zone = page_zone(page);
+	struct shadow_bucket *bucket;
+	unsigned long eviction;
+	u32 key;
+
+	if (!shadow_table)
+		return;
+
+	eviction = atomic_long_inc_return(&zone->inactive_age);
+	bucket = shadow_lookup(mapping, page->index, &key);
+
+	spin_lock(&bucket->lock);
+	memmove(&bucket->entries[1], &bucket->entries[0],
+		(SHADOW_BUCKET_SIZE - 1) * sizeof(struct shadow_entry));
+	bucket->entries[0].key = key;
+	bucket->entries[0].eviction = pack_shadow(eviction, zone);
+	spin_unlock(&bucket->lock);
+}
+
+/**
+ * workingset_refault - decide where a page coming back in should start
+ * @mapping: address space the page is added to
+ * @index: offset of the page
+ *
+ * Returns true if the page was evicted recently enough that it would have
+ * stayed resident at the expense of the active list, and should be added
+ * to the active list.  The shadow entry is consumed.
+ */
+bool workingset_refault(struct address_space *mapping, pgoff_t index)
+{
+	struct shadow_bucket *bucket;
+	unsigned long refault, eviction, distance;
+	struct zone *zone;
+	u32 key, shadow = 0;
+	int i;
+
+	if (!shadow_table)
+		return false;
+
+	bucket = shadow_lookup(mapping, index, &key);
+	spin_lock_irq(&bucket->lock);
+	for (i = 0; i < SHADOW_BUCKET_SIZE; i++) {
+		if (bucket->entries[i].key == key) {
+			bucket->entries[i].key = 0;
+			shadow = bucket->entries[i].eviction;
+			break;
+		}
+	}
+	spin_unlock_irq(&bucket->lock);
+	if (i == SHADOW_BUCKET_SIZE)
+		return false;
+
+	zone = unpack_shadow(shadow, &eviction);
+	refault = atomic_long_read(&zone->inactive_age);
+	distance = (refault - eviction) & EVICTION_MASK;
+
+	inc_zone_state(zone, WORKINGSET_REFAULT);
+	if (distance <= zone_page_state(zone, NR_ACTIVE_FILE)) {
+		inc_zone_state(zone, WORKINGSET_ACTIVATE);
+		return true;
+	}
+	return false;
+}
+
+/**
+ * workingset_activation - note a page activation
+ * @page: page that was promoted to the active list
+ *
+ * An activation pushes the inactive pages one step closer to eviction, as
+ * an eviction does.
+ */
+void workingset_activation(struct page *page)
+{
+	atomic_long_inc(&page_zone(page)->inactive_age);
+}
+
+/**
+ * workingset_forget - drop the shadow entries of a mapping
+ * @mapping: address space that is set up or truncated
+ *
+ * Moves @mapping to a new shadow generation, the entries of the old one
+ * no longer match and age out of the table.
+ */
+void workingset_forget(struct address_space *mapping)
+{
+	mapping->shadow_gen = atomic_long_inc_return(&shadow_generation);
+}
+
+static int __init workingset_init(void)
+{
+	struct shadow_bucket *table;
+	unsigned long nr_buckets, i;
+
+	nr_buckets = max(totalram_pages / 2 / SHADOW_BUCKET_SIZE, 1UL);
+	shadow_hash_bits = ilog2(nr_buckets);
+	nr_buckets = 1UL << shadow_hash_bits;
+
+	table = vmalloc(nr_buckets * sizeof(struct shadow_bucket));
+	if (!table) {
+		printk(KERN_ERR "workingset: no memory for %lu shadow buckets\n",
+		       nr_buckets);
+		return -ENOMEM;
+	}
+	for (i = 0; i < nr_buckets; i++) {
+		spin_lock_init(&table[i].lock);
+		memset(table[i].entries, 0, sizeof(table[i].entries));
+	}
+	/* reclaim may already be running */
+	smp_wmb();
+	shadow_table = table;
+
+	printk(KERN_INFO "workingset: %lu shadow entries\n",
+	       nr_buckets * SHADOW_BUCKET_SIZE);
+	return 0;
+}
+module_init(workingset_init);
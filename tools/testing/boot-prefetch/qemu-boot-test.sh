@@ -0,0 +1,116 @@
+#!/bin/sh
+#
+# Measure the effect of CONFIG_BOOT_PREFETCH on a simulated cold boot.
+#
+#   qemu-boot-test.sh <kernel image> [nr files]
+#
+# A tree of small and medium files is generated and packed into an ext4
+# image that is mounted as /system, together with a workload that reads
+# the start of every file in a fixed random order, the way a boot walks
+# through libraries, jars and resources.  A busybox initramfs mounts the
+# image, runs the workload and prints the time it took from the start of
+# init ("time to home screen").
+#
+# The kernel is booted three times: without prefetch, with
+# boot_prefetch=record, and replaying the list recorded by the second
+# boot.  The disk is opened with cache=none and limited to $IOPS requests
+# per second so that the host page cache does not hide the reads.
+#
+# Needs qemu-system-$ARCH, mkfs.ext4 with -d support and a static
+# busybox ($BUSYBOX).  The kernel must have virtio-blk, ext4, devtmpfs,
+# a serial console and CONFIG_BOOT_PREFETCH built in.
+#
+
+KERNEL=$1
+NR_FILES=${2:-4000}
+ARCH=${ARCH:-x86_64}
+BUSYBOX=${BUSYBOX:-$(which busybox)}
+IOPS=${IOPS:-2000}
+CONSOLE=${CONSOLE:-ttyS0}
+TMP=$(mktemp -d /tmp/boot-prefetch.XXXXXX) || exit 1
+
+cleanup()
+{
+	rm -rf $TMP
+}
+trap cleanup EXIT INT TERM
+
+if [ -z "$KERNEL" ] || [ ! -x "$BUSYBOX" ]; then
+	echo "usage: [BUSYBOX=<static busybox>] $0 <kernel image> [nr files]"
+	exit 1
+fi
+
+# The /system stand-in: 90% of the files up to 32K, the rest up to 1M
+echo "generating $NR_FILES files"
+TREE=$TMP/tree
+mkdir -p $TREE
+i=0
+while [ $i -lt $NR_FILES ]; do
+	dir=$TREE/d$((i % 64))
+	mkdir -p $dir
+	r=$(od -An -N4 -tu4 /dev/urandom)
+	if [ $((r % 10)) -eq 0 ]; then
+		kb=$((r % 1024 + 1))
+	else
+		kb=$((r % 32 + 1))
+	fi
+	head -c $((kb * 1024)) /dev/urandom > $dir/f$i
+	# read the first half of the file, at least one page
+	echo "d$((i % 64))/f$i $(((kb + 7) / 8))" >> $TMP/workload
+	i=$((i + 1))
+done
+od -An -tu4 -w4 -N$((NR_FILES * 4)) /dev/urandom | paste - $TMP/workload |
+	sort -n | cut -f2 > $TREE/workload.txt
+
+IMG=$TMP/system.img
+SIZE_MB=$(($(du -sm $TREE | cut -f1) * 3 / 2 + 64))
+mkfs.ext4 -q -F -d $TREE $IMG ${SIZE_MB}M || exit 1
+
+# The initramfs
+mkdir -p $TMP/initrd/bin $TMP/initrd/proc $TMP/initrd/dev $TMP/initrd/system
+cp $BUSYBOX $TMP/initrd/bin/busybox
+cat > $TMP/initrd/init <<'EOF'
+#!/bin/busybox sh
+/bin/busybox --install -s /bin
+mount -t proc proc /proc
+mount -t devtmpfs dev /dev
+start=$(cut -d' ' -f1 /proc/uptime)
+mount -t ext4 /dev/vda /system
+case "$(cat /proc/cmdline)" in
+*bptest=replay*)
+	cat /system/boot_prefetch.list > /proc/boot_prefetch/list ;;
+esac
+while read f n; do
+	dd if=/system/$f of=/dev/null bs=4096 count=$n 2>/dev/null
+done < /system/workload.txt
+end=$(cut -d' ' -f1 /proc/uptime)
+echo "BPTEST $start $end"
+case "$(cat /proc/cmdline)" in
+*bptest=record*)
+	cat /proc/boot_prefetch/trace > /system/boot_prefetch.list
+	echo "BPTEST recorded $(wc -l < /system/boot_prefetch.list) ranges" ;;
+esac
+umount /system
+poweroff -f
+EOF
+chmod +x $TMP/initrd/init
+(cd $TMP/initrd && find . | cpio -o -H newc 2>/dev/null | gzip) \
+	> $TMP/initrd.gz
+
+boot()
+{
+	qemu-system-$ARCH $QEMU_OPTS -m 512 -nographic -no-reboot \
+		-kernel $KERNEL -initrd $TMP/initrd.gz \
+		-append "console=$CONSOLE quiet $1" \
+		-drive file=$IMG,if=virtio,format=raw,cache=none,throttling.iops-total=$IOPS \
+		2>&1 | tee $TMP/console.log | grep "BPTEST\|boot_prefetch:"
+	awk '/^BPTEST [0-9]/ { printf "time to home screen: %.2f s\n", $3 - $2 }' \
+		$TMP/console.log
+}
+
+echo "--- no prefetch"
+boot "bptest=none"
+echo "--- recording"
+boot "bptest=record boot_prefetch=record"
+echo "--- replaying"
+boot "bptest=replay"
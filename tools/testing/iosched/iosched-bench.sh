@@ -0,0 +1,74 @@
+#!/bin/sh
+#
+# Compare the I/O schedulers on a block device under mixed reads and writes.
+#
+#   iosched-bench.sh <disk> [seconds]
+#
+# For each scheduler the device offers, runs fio with a synchronous 4KB
+# random reader, the stand-in for an app being launched, next to a
+# buffered random writer that is fsynced every 256 writes, as an app
+# update or a download does.  Prints the read latencies and the throughput
+# of both jobs, and for the flash scheduler its latency_stats.
+#
+# <disk> is the name under /sys/block, e.g. mmcblk1.  Its contents are
+# overwritten, so use a scratch device.  The simulated eMMC card does,
+# with the cost of scattered writes made visible:
+#
+#   modprobe mmc_sim size_mb=512 cmd_us=100 gc_us=2000
+#
+# SCHEDS overrides the list of schedulers to run.  Needs root and fio.
+#
+
+DISK=$1
+TIME=${2:-30}
+QUEUE=/sys/block/$DISK/queue
+
+if [ -z "$DISK" ] || [ ! -w $QUEUE/scheduler ]; then
+	echo "usage: [SCHEDS=\"flash cfq ...\"] $0 <disk> [seconds]"
+	exit 1
+fi
+if ! which fio > /dev/null 2>&1; then
+	echo "fio not found"
+	exit 1
+fi
+
+OLD=$(sed 's/.*\[\(.*\)\].*/\1/' $QUEUE/scheduler)
+SCHEDS=${SCHEDS:-$(sed 's/[][]//g' $QUEUE/scheduler)}
+OUT=/tmp/iosched-bench.$$
+
+cleanup()
+{
+	echo $OLD > $QUEUE/scheduler
+	rm -f $OUT
+}
+trap cleanup EXIT INT TERM
+
+# Fields of the fio terse output, version 3
+field()
+{
+	awk -F';' -v job=$1 -v f=$2 '$3 == job { print $f }' $OUT
+}
+
+printf "%-10s %10s %10s %10s %10s %10s\n" sched read-kbs \
+	read-avg-us read-max-us read-p99-us write-kbs
+for s in $SCHEDS; do
+	echo $s > $QUEUE/scheduler || continue
+	if [ -w $QUEUE/iosched/latency_stats ]; then
+		echo 0 > $QUEUE/iosched/latency_stats
+	fi
+
+	fio --minimal --terse-version=3 --filename=/dev/$DISK \
+		--runtime=$TIME --time_based --bs=4k \
+		--name=reader --rw=randread --direct=1 --ioengine=sync \
+		--name=writer --rw=randwrite --ioengine=sync --fsync=256 \
+		> $OUT 2>/dev/null || { echo "$s: fio failed"; continue; }
+
+	# p99 is the 13th of the completion latency percentiles
+	printf "%-10s %10s %10s %10s %10s %10s\n" $s \
+		$(field reader 7) $(field reader 40) $(field reader 39) \
+		$(field reader 30 | cut -d= -f2) $(field writer 48)
+
+	if [ -r $QUEUE/iosched/latency_stats ]; then
+		cat $QUEUE/iosched/latency_stats
+	fi
+done
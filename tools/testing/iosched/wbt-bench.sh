@@ -0,0 +1,80 @@
+#!/bin/sh
+#
+# Compare read latency under background writeback with and without
+# writeback throttling.
+#
+#   wbt-bench.sh <disk> [seconds]
+#
+# Runs fio with a synchronous 4KB random reader, the stand-in for an app
+# being launched, next to a buffered sequential writer that leaves all of
+# its writing to background writeback, as a download or an app install
+# does.  It runs once with wbt_lat_usec set to 0 and once with the target
+# latency, and prints the read latency percentiles, the throughput of
+# both jobs and the wbt_stats of the second run.
+#
+# <disk> is the name under /sys/block, e.g. mmcblk1.  Its contents are
+# overwritten, so use a scratch device, such as the simulated eMMC card:
+#
+#   modprobe mmc_sim size_mb=512 cmd_us=100 gc_us=2000
+#
+# LAT_USEC sets the target latency, the default of the queue otherwise.
+# Needs root, fio and a kernel with CONFIG_BLK_WBT.
+#
+
+DISK=$1
+TIME=${2:-30}
+QUEUE=/sys/block/$DISK/queue
+
+if [ -z "$DISK" ] || [ ! -w $QUEUE/wbt_lat_usec ]; then
+	echo "usage: [LAT_USEC=usec] $0 <disk> [seconds]"
+	exit 1
+fi
+if ! which fio > /dev/null 2>&1; then
+	echo "fio not found"
+	exit 1
+fi
+
+OLD=$(cat $QUEUE/wbt_lat_usec)
+LAT=${LAT_USEC:-$OLD}
+[ "$LAT" = 0 ] && LAT=2000
+OUT=/tmp/wbt-bench.$$
+
+cleanup()
+{
+	echo $OLD > $QUEUE/wbt_lat_usec
+	rm -f $OUT
+}
+trap cleanup EXIT INT TERM
+
+# Fields of the fio terse output, version 3
+field()
+{
+	awk -F';' -v job=$1 -v f=$2 '$3 == job { print $f }' $OUT
+}
+
+# The completion latency percentiles are fields 18 to 37: 50 is the 7th,
+# 99 the 13th and 99.9 the 15th.
+pct()
+{
+	field reader $1 | cut -d= -f2
+}
+
+printf "%-9s %9s %9s %9s %9s %9s %9s\n" wbt-usec read-kbs \
+	p50-us p99-us p99.9-us max-us write-kbs
+for lat in 0 $LAT; do
+	echo $lat > $QUEUE/wbt_lat_usec
+	sync
+	echo 3 > /proc/sys/vm/drop_caches
+
+	fio --minimal --terse-version=3 --filename=/dev/$DISK \
+		--runtime=$TIME --time_based \
+		--name=reader --rw=randread --bs=4k --direct=1 --ioengine=sync \
+		--name=writer --rw=write --bs=64k --ioengine=sync \
+		> $OUT 2>/dev/null || { echo "$lat: fio failed"; continue; }
+
+	printf "%-9s %9s %9s %9s %9s %9s %9s\n" $lat $(field reader 7) \
+		$(pct 24) $(pct 30) $(pct 32) $(field reader 39) \
+		$(field writer 48)
+done
+
+cat $QUEUE/wbt_stats
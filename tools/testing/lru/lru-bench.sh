@@ -0,0 +1,76 @@
+#!/bin/sh
+#
+# LRU batching benchmark: parallel page cache faults through mmap.
+#
+#   lru-bench.sh <dir> [threads]
+#
+# Creates one file per thread in <dir>, drops the page cache and faults
+# them all back in with mmap-read, <threads> at a time (default: the
+# number of online cpus).  Prints the time taken and the changes in the
+# lru_lock counters of /proc/vmstat over the run:
+#
+#   lru_lock_acquire    zone->lru_lock acquisitions by the LRU batches
+#   lru_lock_contended  those that had to wait for another cpu
+#   lru_batch_grow      times a cpu's add batch limit was doubled
+#
+# On kernels built with CONFIG_LOCK_STAT the &zone->lru_lock line of
+# /proc/lock_stat is printed as well.  <dir> must be on a block device,
+# not tmpfs.  Needs root to drop caches.  FILE_MB sets the size of each
+# file (default 32).
+#
+
+DIR=$1
+THREADS=${2:-$(grep -c ^processor /proc/cpuinfo)}
+FILE_MB=${FILE_MB:-32}
+BENCH=$(dirname $0)/mmap-read
+
+if [ -z "$DIR" ] || [ ! -d "$DIR" ] || [ ! -x $BENCH ]; then
+	echo "usage: [FILE_MB=n] $0 <dir> [threads], after make"
+	exit 1
+fi
+
+WORK=$DIR/lru-bench.$$
+
+cleanup()
+{
+	rm -rf $WORK
+}
+trap cleanup EXIT INT TERM
+
+mkdir -p $WORK || exit 1
+i=0
+while [ $i -lt $THREADS ]; do
+	dd if=/dev/zero of=$WORK/$i bs=1M count=$FILE_MB 2>/dev/null
+	i=$((i + 1))
+done
+sync
+echo 3 > /proc/sys/vm/drop_caches
+
+vmstat()
+{
+	awk -v k=$1 '$1 == k { print $2 }' /proc/vmstat
+}
+
+STATS="lru_lock_acquire lru_lock_contended lru_batch_grow"
+for s in $STATS; do
+	eval before_$s=$(vmstat $s)
+done
+[ -w /proc/lock_stat ] && echo 0 > /proc/lock_stat
+
+$BENCH $THREADS $WORK/*
+
+echo
+for s in $STATS; do
+	eval before=\$before_$s
+	after=$(vmstat $s)
+	if [ -n "$after" ]; then
+		echo "$s: $((after - before))"
+	else
+		echo "$s: not available"
+	fi
+done
+
+if [ -r /proc/lock_stat ]; then
+	echo
+	grep -A1 -m1 '&zone->lru_lock' /proc/lock_stat
+fi
@@ -0,0 +1,115 @@
+/*
+ * mmap-read: fault in files through mmap from several threads at once.
+ *
+ *	mmap-read <threads> <file>...
+ *
+ * Each thread maps its own share of the files and touches one byte per
+ * page, so every page cache miss adds a page to the LRU lists from the
+ * faulting cpu.  With a cold page cache this is the LRU add path at its
+ * busiest: many cpus adding pages of the same zone at the same time.
+ * Prints the pages touched and the time taken in milliseconds.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+struct reader {
+	pthread_t	thread;
+	int		first;
+	unsigned long	pages;
+};
+
+static char **files;
+static int nr_files, nr_threads;
+static long page_size;
+static volatile unsigned char sink;
+
+static void read_file(struct reader *r, const char *path)
+{
+	struct stat st;
+	unsigned char *map;
+	off_t off;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		perror(path);
+		exit(1);
+	}
+	if (!st.st_size) {
+		close(fd);
+		return;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		perror(path);
+		exit(1);
+	}
+	for (off = 0; off < st.st_size; off += page_size) {
+		sink += map[off];
+		r->pages++;
+	}
+	munmap(map, st.st_size);
+	close(fd);
+}
+
+static void *reader_fn(void *arg)
+{
+	struct reader *r = arg;
+	int i;
+
+	for (i = r->first; i < nr_files; i += nr_threads)
+		read_file(r, files[i]);
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	struct reader *readers;
+	struct timeval start, end;
+	unsigned long pages = 0;
+	int i;
+
+	if (argc < 3 || (nr_threads = atoi(argv[1])) < 1) {
+		fprintf(stderr, "usage: %s <threads> <file>...\n", argv[0]);
+		return 1;
+	}
+	files = argv + 2;
+	nr_files = argc - 2;
+	page_size = sysconf(_SC_PAGESIZE);
+
+	readers = calloc(nr_threads, sizeof(*readers));
+	if (!readers)
+		return 1;
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < nr_threads; i++) {
+		readers[i].first = i;
+		if (pthread_create(&readers[i].thread, NULL, reader_fn,
+				   &readers[i])) {
+			fprintf(stderr, "cannot start thread %d\n", i);
+			return 1;
+		}
+	}
+	for (i = 0; i < nr_threads; i++) {
+		pthread_join(readers[i].thread, NULL);
+		pages += readers[i].pages;
+	}
+	gettimeofday(&end, NULL);
+
+	printf("%d threads, %lu pages, %ld ms\n", nr_threads, pages,
+	       (end.tv_sec - start.tv_sec) * 1000 +
+	       (end.tv_usec - start.tv_usec) / 1000);
+	return 0;
+}
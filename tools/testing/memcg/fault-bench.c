@@ -0,0 +1,94 @@
+/*
+ * fault-bench: fault a file in through mmap, over and over.
+ *
+ *	fault-bench <file> [passes]
+ *
+ * Maps the file and touches one byte per page, <passes> times (default
+ * 4).  Run inside a memory cgroup whose limit is below the size of the
+ * file, every pass faults the whole file back in and each fault has to
+ * charge a page to a cgroup that is full.  Whether the faulting task
+ * reclaims for that charge itself or finds the room already made by
+ * background reclaim shows in the fault latencies.
+ *
+ * Prints, for each pass, the time taken, the average and the longest
+ * time to touch a page, and the number of pages that took longer than
+ * a millisecond.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static volatile unsigned char sink;
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long long start, t0, t, max, slow;
+	unsigned char *map;
+	long page_size;
+	struct stat st;
+	int fd, passes, pass;
+	off_t off;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <file> [passes]\n", argv[0]);
+		return 1;
+	}
+	passes = argc > 2 ? atoi(argv[2]) : 4;
+	page_size = sysconf(_SC_PAGESIZE);
+
+	fd = open(argv[1], O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) < 0 || !st.st_size) {
+		perror(argv[1]);
+		return 1;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+	/* Every access faults, not just the first page of a readahead */
+	madvise(map, st.st_size, MADV_RANDOM);
+
+	printf("pass    ms   avg-us   max-us  over-1ms\n");
+	for (pass = 0; pass < passes; pass++) {
+		max = slow = 0;
+		start = now_ns();
+		for (off = 0; off < st.st_size; off += page_size) {
+			t0 = now_ns();
+			sink += map[off];
+			t = now_ns() - t0;
+			if (t > max)
+				max = t;
+			if (t > 1000000)
+				slow++;
+		}
+		t = now_ns() - start;
+		printf("%4d %5llu %8llu %8llu %9llu\n", pass, t / 1000000,
+		       t / 1000 / (st.st_size / page_size + 1), max / 1000,
+		       slow);
+
+		/* Drop the mapping's pages so that the next pass faults */
+		madvise(map, st.st_size, MADV_DONTNEED);
+	}
+
+	munmap(map, st.st_size);
+	close(fd);
+	return 0;
+}
@@ -0,0 +1,92 @@
+#!/bin/sh
+#
+# Memory cgroup background reclaim benchmark.
+#
+#   memcg-bench.sh <dir> [passes]
+#
+# Creates a memory cgroup limited to LIMIT_MB (default 64) and runs
+# fault-bench in it on a file of twice that size in <dir>, first with
+# background reclaim off and then with memory.low_wmark_distance and
+# memory.high_wmark_distance set to LOW_MB and HIGH_MB (default 4 and
+# 8).  For each run prints fault-bench's per pass latencies and the
+# changes in the reclaim counters of the group's memory.stat:
+#
+#   direct_reclaim  charges that had to reclaim in the faulting task
+#   direct_steal    pages they reclaimed
+#   kswapd_wake     background reclaim runs
+#   kswapd_steal    pages they reclaimed
+#
+# The memory cgroup hierarchy is mounted on MEMCG (default /dev/memcg)
+# if it is not already.  <dir> must be on a block device, not tmpfs.
+# Needs root.
+#
+
+DIR=$1
+PASSES=${2:-4}
+MEMCG=${MEMCG:-/dev/memcg}
+LIMIT_MB=${LIMIT_MB:-64}
+LOW_MB=${LOW_MB:-4}
+HIGH_MB=${HIGH_MB:-8}
+BENCH=$(dirname $0)/fault-bench
+
+if [ -z "$DIR" ] || [ ! -d "$DIR" ] || [ ! -x $BENCH ]; then
+	echo "usage: [LIMIT_MB=n] [LOW_MB=n] [HIGH_MB=n] $0 <dir> [passes]," \
+	     "after make"
+	exit 1
+fi
+
+if [ ! -f $MEMCG/memory.stat ]; then
+	mkdir -p $MEMCG
+	mount -t cgroup -o memory none $MEMCG || exit 1
+fi
+
+GROUP=$MEMCG/memcg-bench.$$
+FILE=$DIR/memcg-bench.$$
+
+cleanup()
+{
+	rmdir $GROUP 2>/dev/null
+	rm -f $FILE
+}
+trap cleanup EXIT INT TERM
+
+mkdir $GROUP || exit 1
+echo ${LIMIT_MB}M > $GROUP/memory.limit_in_bytes
+dd if=/dev/urandom of=$FILE bs=1M count=$((LIMIT_MB * 2)) 2>/dev/null
+sync
+
+STATS="direct_reclaim direct_steal kswapd_wake kswapd_steal"
+
+stat()
+{
+	awk -v k=$1 '$1 == k { print $2 }' $GROUP/memory.stat
+}
+
+run()
+{
+	echo 3 > /proc/sys/vm/drop_caches
+	for s in $STATS; do
+		eval before_$s=$(stat $s)
+	done
+
+	sh -c "echo \$\$ > $GROUP/tasks && exec $BENCH $FILE $PASSES"
+
+	for s in $STATS; do
+		eval before=\$before_$s
+		echo "$s: $(($(stat $s) - before))"
+	done
+	# Leave the group empty for the next run
+	echo 0 > $GROUP/memory.force_empty
+}
+
+echo "background reclaim off, limit ${LIMIT_MB}M:"
+run
+
+echo
+echo "background reclaim at ${LOW_MB}M to ${HIGH_MB}M below the limit:"
+echo ${HIGH_MB}M > $GROUP/memory.high_wmark_distance
+echo ${LOW_MB}M > $GROUP/memory.low_wmark_distance
+cat $GROUP/memory.reclaim_wmarks
+run
+
+echo 0 > $GROUP/memory.low_wmark_distance
@@ -0,0 +1,74 @@
+#!/bin/sh
+#
+# IOPS scaling of the block layer across cpus, on the null block device.
+#
+#   iops-scaling.sh [seconds] [stage_batch]
+#
+# Loads null_blk and runs fio with 4KB O_DIRECT random reads from 1 job up
+# to one job per online cpu, each job bound to its own cpu.  Each count of
+# jobs is run with per-cpu request staging off and then with stage_batch
+# (default 16).  Prints the total IOPS of each run.
+#
+# With CONFIG_LOCK_STAT the contention on the queue_lock of the device
+# (&nullb->lock) over the whole benchmark is printed at the end.
+#
+# NULLB_ARGS gives null_blk its parameters when the script loads it, for
+# example "irqmode=2 completion_nsec=20000".  Needs root and fio.
+#
+
+TIME=${1:-10}
+BATCH=${2:-16}
+QUEUE=/sys/block/nullb0/queue
+CPUS=$(grep -c ^processor /proc/cpuinfo)
+
+if ! which fio > /dev/null 2>&1; then
+	echo "fio not found"
+	exit 1
+fi
+
+if [ ! -d $QUEUE ]; then
+	modprobe null_blk $NULLB_ARGS || exit 1
+	LOADED=1
+fi
+
+cleanup()
+{
+	echo 0 > $QUEUE/stage_batch
+	[ -n "$LOADED" ] && rmmod null_blk
+}
+trap cleanup EXIT INT TERM
+
+echo noop > $QUEUE/scheduler
+if [ -w /proc/lock_stat ]; then
+	echo 0 > /proc/lock_stat
+fi
+
+run()
+{
+	fio --minimal --terse-version=3 --filename=/dev/nullb0 --name=iops \
+		--rw=randread --bs=4k --direct=1 --ioengine=libaio \
+		--iodepth=32 --iodepth_batch=8 --numjobs=$1 \
+		--cpus_allowed=0-$(($1 - 1)) --cpus_allowed_policy=split \
+		--group_reporting \
+		--runtime=$TIME --time_based 2>/dev/null |
+		awk -F';' '{ print $8 }'
+}
+
+printf "%4s %12s %12s\n" jobs iops "iops-staged"
+jobs=1
+while [ $jobs -le $CPUS ]; do
+	echo 0 > $QUEUE/stage_batch
+	plain=$(run $jobs)
+	echo $BATCH > $QUEUE/stage_batch
+	staged=$(run $jobs)
+	printf "%4d %12s %12s\n" $jobs "$plain" "$staged"
+	jobs=$((jobs * 2))
+	if [ $jobs -gt $CPUS ] && [ $((jobs / 2)) -lt $CPUS ]; then
+		jobs=$CPUS
+	fi
+done
+
+if [ -r /proc/lock_stat ]; then
+	echo
+	grep -A1 'nullb->lock' /proc/lock_stat | head -4
+fi
@@ -0,0 +1,45 @@
+#!/bin/sh
+#
+# Run the page allocator benchmark (CONFIG_TEST_PAGE_ALLOC) and report the
+# zone->lock contention it caused.
+#
+#   pcp-bench.sh [duration ms] [batch]
+#
+# The contention figures need a kernel built with CONFIG_LOCK_STAT; they
+# cover the whole benchmark, all runs together.  Needs root and debugfs.
+#
+
+DURATION=${1:-2000}
+BATCH=${2:-64}
+DEBUGFS=$(awk '$3 == "debugfs" { print $2; exit }' /proc/mounts)
+DIR=$DEBUGFS/page_alloc_bench
+
+if [ -z "$DEBUGFS" ]; then
+	mount -t debugfs none /sys/kernel/debug || exit 1
+	DIR=/sys/kernel/debug/page_alloc_bench
+fi
+
+if [ ! -d $DIR ]; then
+	modprobe test-page-alloc duration_ms=$DURATION batch=$BATCH || exit 1
+else
+	echo $DURATION > /sys/module/test_page_alloc/parameters/duration_ms
+	echo $BATCH > /sys/module/test_page_alloc/parameters/batch
+fi
+
+if [ -w /proc/lock_stat ]; then
+	echo 0 > /proc/lock_stat
+	echo 1 > /proc/sys/kernel/lock_stat
+fi
+
+echo 1 > $DIR/run || exit 1
+cat $DIR/results
+
+if [ -r /proc/lock_stat ]; then
+	echo
+	# the header, then the zone->lock class and its contention points
+	sed -n '1,4p' /proc/lock_stat
+	awk '/&zone->lock/ { p = 1 } p && /^$/ { exit } p' /proc/lock_stat
+else
+	echo
+	echo "no /proc/lock_stat, enable CONFIG_LOCK_STAT for zone->lock figures"
+fi
@@ -0,0 +1,50 @@
+#!/bin/sh
+#
+# Launch-time benchmark for readahead history (CONFIG_READAHEAD_HISTORY).
+#
+#   launch-bench.sh <trace> [runs]
+#
+# The trace is replayed with launch-trace (see launch-trace.c for the
+# format) from a cold page cache:
+#
+#   baseline  history disabled
+#   record    history enabled, first launch records the accessed chunks
+#   replay    history enabled, later launches get the chunks read ahead
+#
+# Needs root.  The inodes must stay cached between runs for the history
+# to survive, so only the page cache is dropped (drop_caches=1).
+#
+
+TRACE=$1
+RUNS=${2:-5}
+DIR=$(dirname $0)
+SYSFS=/sys/kernel/mm/readahead_history
+
+if [ -z "$TRACE" ] || [ ! -d $SYSFS ]; then
+	echo "usage: $0 <trace> [runs], needs CONFIG_READAHEAD_HISTORY"
+	exit 1
+fi
+
+cold_run()
+{
+	sync
+	echo 1 > /proc/sys/vm/drop_caches
+	$DIR/launch-trace $TRACE
+}
+
+echo 0 > $SYSFS/enabled
+i=0
+while [ $i -lt $RUNS ]; do
+	echo "baseline $(cold_run) ms"
+	i=$((i + 1))
+done
+
+echo 1 > $SYSFS/enabled
+echo "record   $(cold_run) ms"
+i=0
+while [ $i -lt $RUNS ]; do
+	echo "replay   $(cold_run) ms"
+	i=$((i + 1))
+done
+
+echo "replays $(cat $SYSFS/replays), pages $(cat $SYSFS/replay_pages)"
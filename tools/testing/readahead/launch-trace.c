@@ -0,0 +1,157 @@
+/*
+ * launch-trace: replay a scripted file access trace and time it.
+ *
+ * Each line of the trace is
+ *
+ *	<r|m> <path> <offset> <length>
+ *
+ * "r" reads the range with pread(), "m" maps the file and touches one
+ * byte per page of the range, like the loader and dalvik do for shared
+ * libraries, apks and odex files.  Files are opened on first use and
+ * kept open until the end, as an application being launched would.
+ * The time taken by the whole trace is printed in milliseconds.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#define MAX_FILES	1024
+
+struct trace_file {
+	char	*path;
+	int	fd;
+	char	*map;
+	off_t	size;
+};
+
+static struct trace_file files[MAX_FILES];
+static int nr_files;
+static long page_size;
+
+static struct trace_file *get_file(const char *path)
+{
+	struct trace_file *f;
+	struct stat st;
+	int i;
+
+	for (i = 0; i < nr_files; i++)
+		if (!strcmp(files[i].path, path))
+			return &files[i];
+
+	if (nr_files == MAX_FILES) {
+		fprintf(stderr, "too many files\n");
+		exit(1);
+	}
+
+	f = &files[nr_files];
+	f->fd = open(path, O_RDONLY);
+	if (f->fd < 0 || fstat(f->fd, &st) < 0) {
+		perror(path);
+		exit(1);
+	}
+	f->path = strdup(path);
+	f->size = st.st_size;
+	f->map = NULL;
+	nr_files++;
+	return f;
+}
+
+static void do_read(struct trace_file *f, off_t off, size_t len)
+{
+	static char buf[128 * 1024];
+
+	while (len) {
+		size_t n = len < sizeof(buf) ? len : sizeof(buf);
+		ssize_t ret = pread(f->fd, buf, n, off);
+
+		if (ret <= 0)
+			break;
+		off += ret;
+		len -= ret;
+	}
+}
+
+static unsigned long do_touch(struct trace_file *f, off_t off, size_t len)
+{
+	volatile char *p;
+	unsigned long sum = 0;
+	off_t end;
+
+	if (!f->map) {
+		f->map = mmap(NULL, f->size, PROT_READ, MAP_SHARED, f->fd, 0);
+		if (f->map == MAP_FAILED) {
+			perror(f->path);
+			exit(1);
+		}
+	}
+
+	end = off + (off_t)len;
+	if (end > f->size)
+		end = f->size;
+	for (off &= ~(page_size - 1); off < end; off += page_size) {
+		p = f->map + off;
+		sum += *p;
+	}
+	return sum;
+}
+
+int main(int argc, char **argv)
+{
+	struct timeval start, end;
+	char line[4096], path[4096], op;
+	unsigned long long off, len;
+	FILE *trace;
+	int i;
+
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s <trace>\n", argv[0]);
+		return 1;
+	}
+
+	trace = fopen(argv[1], "r");
+	if (!trace) {
+		perror(argv[1]);
+		return 1;
+	}
+	page_size = sysconf(_SC_PAGESIZE);
+
+	gettimeofday(&start, NULL);
+	while (fgets(line, sizeof(line), trace)) {
+		struct trace_file *f;
+
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+		if (sscanf(line, "%c %4095s %llu %llu",
+			   &op, path, &off, &len) != 4) {
+			fprintf(stderr, "bad trace line: %s", line);
+			return 1;
+		}
+
+		f = get_file(path);
+		if (op == 'm')
+			do_touch(f, off, len);
+		else
+			do_read(f, off, len);
+	}
+	gettimeofday(&end, NULL);
+
+	printf("%ld\n", (end.tv_sec - start.tv_sec) * 1000 +
+			(end.tv_usec - start.tv_usec) / 1000);
+
+	for (i = 0; i < nr_files; i++) {
+		if (files[i].map)
+			munmap(files[i].map, files[i].size);
+		close(files[i].fd);
+	}
+	return 0;
+}
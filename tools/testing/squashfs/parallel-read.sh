@@ -0,0 +1,65 @@
+#!/bin/sh
+#
+# Measure squashfs read throughput with an increasing number of parallel
+# readers, to compare the single and per-cpu decompressor options.
+#
+#   parallel-read.sh <source dir | squashfs image> [max readers] [comp]
+#
+# A source directory is first packed with mksquashfs using the given
+# compressor (gzip by default).  The image is attached to a loop device
+# and mounted, then for 1, 2, 4 ... max readers the page cache is dropped
+# and every file is read once, split among the readers with xargs -P.
+# Needs root, and mksquashfs only when starting from a directory.
+#
+
+SRC=$1
+MAX_JOBS=${2:-$(grep -c ^processor /proc/cpuinfo)}
+COMP=${3:-gzip}
+TMP=$(mktemp -d /tmp/sqfs-bench.XXXXXX) || exit 1
+MNT=$TMP/mnt
+LOOP=
+
+cleanup()
+{
+	umount $MNT 2>/dev/null
+	[ -n "$LOOP" ] && losetup -d $LOOP
+	rm -rf $TMP
+}
+trap cleanup EXIT INT TERM
+
+if [ -z "$SRC" ]; then
+	echo "usage: $0 <source dir | squashfs image> [max readers] [comp]"
+	exit 1
+fi
+
+if [ -d "$SRC" ]; then
+	IMG=$TMP/image.sqfs
+	mksquashfs "$SRC" $IMG -comp $COMP -noappend >/dev/null || exit 1
+else
+	IMG=$SRC
+fi
+
+mkdir $MNT
+LOOP=$(losetup -f) || exit 1
+losetup $LOOP $IMG || exit 1
+mount -t squashfs -o ro $LOOP $MNT || exit 1
+
+BYTES=$(du -sb $MNT | cut -f1)
+echo "image $IMG, $BYTES bytes of file data"
+echo "readers   msecs    MB/s"
+
+JOBS=1
+while [ $JOBS -le $MAX_JOBS ]; do
+	sync
+	echo 3 > /proc/sys/vm/drop_caches
+
+	START=$(date +%s%N)
+	find $MNT -type f -print0 | xargs -0 -r -n 8 -P $JOBS cat > /dev/null
+	END=$(date +%s%N)
+
+	MSECS=$(( (END - START) / 1000000 ))
+	[ $MSECS -eq 0 ] && MSECS=1
+	printf "%7d %7d %7d\n" $JOBS $MSECS $(( BYTES / 1000 / MSECS ))
+
+	JOBS=$(( JOBS * 2 ))
+done
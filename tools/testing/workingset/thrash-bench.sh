@@ -0,0 +1,92 @@
+#!/bin/sh
+#
+# Page cache thrashing benchmark for refault detection (mm/workingset.c).
+#
+#   thrash-bench.sh <dir> [rounds]
+#
+# A "hot" set of files, the stand-in for the code of the apps in use, is
+# read again every round, with a slice of a large "cold" file streamed
+# through the page cache between two rounds.  The hot set is sized to fit
+# in memory next to the cold slice but is larger than the inactive list,
+# so without refault detection every round evicts and re-reads it.
+#
+# Prints the time to read the hot set in each round, and the changes in
+# the workingset and major fault counters of /proc/vmstat over the run.
+# <dir> must be on a block device, not tmpfs.  Needs root to drop caches.
+#
+# HOT_PCT and COLD_PCT set the size of the hot set and of a cold slice as
+# a percentage of MemTotal (default 50 and 40).
+#
+
+DIR=$1
+ROUNDS=${2:-10}
+HOT_PCT=${HOT_PCT:-50}
+COLD_PCT=${COLD_PCT:-40}
+FILE_MB=4
+
+if [ -z "$DIR" ] || [ ! -d "$DIR" ]; then
+	echo "usage: [HOT_PCT=n] [COLD_PCT=n] $0 <dir> [rounds]"
+	exit 1
+fi
+
+MEM_MB=$(awk '/^MemTotal:/ { print int($2 / 1024) }' /proc/meminfo)
+HOT_FILES=$((MEM_MB * HOT_PCT / 100 / FILE_MB))
+COLD_MB=$((MEM_MB * COLD_PCT / 100))
+WORK=$DIR/thrash-bench.$$
+
+cleanup()
+{
+	rm -rf $WORK
+}
+trap cleanup EXIT INT TERM
+
+mkdir -p $WORK/hot || exit 1
+echo "$MEM_MB MB of memory: $HOT_FILES hot files of $FILE_MB MB," \
+     "$ROUNDS cold slices of $COLD_MB MB"
+
+i=0
+while [ $i -lt $HOT_FILES ]; do
+	dd if=/dev/urandom of=$WORK/hot/$i bs=1M count=$FILE_MB 2>/dev/null
+	i=$((i + 1))
+done
+dd if=/dev/zero of=$WORK/cold bs=1M count=$((COLD_MB * ROUNDS)) 2>/dev/null
+sync
+echo 3 > /proc/sys/vm/drop_caches
+
+vmstat()
+{
+	awk -v k=$1 '$1 == k { print $2 }' /proc/vmstat
+}
+
+now_ms()
+{
+	awk '{ printf "%d\n", $1 * 1000 }' /proc/uptime
+}
+
+STATS="workingset_refault workingset_activate pgmajfault pgpgin"
+for s in $STATS; do
+	eval before_$s=$(vmstat $s)
+done
+
+r=0
+while [ $r -lt $ROUNDS ]; do
+	start=$(now_ms)
+	cat $WORK/hot/* > /dev/null
+	end=$(now_ms)
+	echo "round $r: hot set read in $((end - start)) ms"
+
+	dd if=$WORK/cold of=/dev/null bs=1M count=$COLD_MB \
+		skip=$((r * COLD_MB)) 2>/dev/null
+	r=$((r + 1))
+done
+
+echo
+for s in $STATS; do
+	eval before=\$before_$s
+	after=$(vmstat $s)
+	if [ -n "$after" ]; then
+		echo "$s: $((after - before))"
+	else
+		echo "$s: not available"
+	fi
+done